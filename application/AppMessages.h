@@ -71,4 +71,19 @@ const uint32 APP_EDIT_ACCOUNT = 'CYea';
 //! Toggle a specific account
 const uint32 APP_TOGGLE_ACCOUNT = 'CYta';
 
+//! Deliver the queued user status changes
+const uint32 APP_FLUSH_STATUS = 'CYfs';
+
+//! A user's avatar has been loaded by the ServerWorker
+const uint32 APP_AVATAR_LOADED = 'CYal';
+
+//! A page of a room's logs has been read by the ServerWorker
+const uint32 APP_LOGS_READ = 'CYlr';
+
+//! An account's ServerShard's changes, for the Server to apply
+const uint32 APP_CHANGE_SET = 'CYcs';
+
+//! The window has applied a ServerShard's change-set
+const uint32 APP_CHANGES_APPLIED = 'CYca';
+
 #endif	// _APP_MESSAGES_H
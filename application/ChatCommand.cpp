@@ -10,15 +10,24 @@
 
 #include "Conversation.h"
 #include "MainWindow.h"
+#include "ProtocolLooper.h"
 #include "TheApp.h"
+#include "User.h"
 
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "ChatCommand"
 
 
+static bool
+user_has_name(User* user, void* name)
+{
+	return user != NULL && user->GetName() == *(const BString*)name;
+}
+
+
 ChatCommand::ChatCommand(const char* name, BMessage msg, bool toProtocol,
-						 List<int32> argTypes)
+						 const List<int32>& argTypes)
 	:
 	fName(name),
 	fMessage(msg),
@@ -53,8 +62,8 @@ ChatCommand::Archive(BMessage* data, bool deep)
 	data->AddBool("_proto", fToProto);
 	data->AddMessage("_msg", new BMessage(fMessage));
 
-	for (int i = 0; i < fArgTypes.CountItems(); i++)
-		data->AddInt32("_argtype", fArgTypes.ItemAt(i));
+	for (int32 argType : fArgTypes)
+		data->AddInt32("_argtype", argType);
 	return ret;
 }
 
@@ -121,7 +130,7 @@ ChatCommand::_ProcessArgs(BString args, BMessage* msg, BString* errorMsg,
 			}
 			case CMD_KNOWN_USER:
 			{
-				User* user = _FindUser(arg, chat->GetProtocolLooper()->Users());
+				User* user = _FindKnownUser(arg, chat->GetProtocolLooper());
 				if (user == NULL) {
 					errorMsg->SetTo(B_TRANSLATE("You aren't contacts with and "
 						"have no chats in common with %user%. Shame."));
@@ -149,13 +158,13 @@ ChatCommand::_ProcessArgs(BString args, BMessage* msg, BString* errorMsg,
 
 
 User*
-ChatCommand::_FindUser(BString idOrName, UserMap users)
+ChatCommand::_FindUser(const BString& idOrName, const UserMap& users)
 {
 	if (idOrName.IsEmpty() == true)
 		return NULL;
 
 	bool idFound = false;
-	User* user = users.ValueFor(idOrName, &idFound);
+	User* user = users.ValueFor(idOrName.String(), &idFound);
 	if (idFound == false)
 		for (int i = 0; i < users.CountItems(); i++) {
 			User* check = users.ValueAt(i);
@@ -166,6 +175,19 @@ ChatCommand::_FindUser(BString idOrName, UserMap users)
 }
 
 
+User*
+ChatCommand::_FindKnownUser(const BString& idOrName, ProtocolLooper* looper)
+{
+	if (idOrName.IsEmpty() == true)
+		return NULL;
+
+	User* user = looper->UserById(idOrName);
+	if (user == NULL)
+		user = looper->DoForEachUser(&user_has_name, (void*)&idOrName);
+	return user;
+}
+
+
 bool
 ChatCommand::_Send(BMessage* msg, Conversation* chat)
 {
@@ -9,13 +9,15 @@
 #include <Message.h>
 #include <String.h>
 
+#include <libsupport/Atom.h>
 #include <libsupport/KeyMap.h>
 #include <libsupport/List.h>
 
 class Conversation;
+class ProtocolLooper;
 class User;
 
-typedef KeyMap<BString, User*> UserMap;
+typedef KeyMap<Atom, User*> UserMap;
 
 
 enum cmd_arg_type
@@ -31,7 +33,7 @@ enum cmd_arg_type
 class ChatCommand : public BArchivable {
 public:
 					ChatCommand(const char* name, BMessage msg, bool toProtocol,
-								List<int32> argTypes);
+								const List<int32>& argTypes);
 					ChatCommand(BMessage* data);
 
 	status_t		Archive(BMessage* data, bool deep=true);
@@ -49,7 +51,9 @@ private:
 	bool			_ProcessArgs(BString args, BMessage* msg, BString* errorMsg,
 								 Conversation* chat);
 
-	User*			_FindUser(BString idOrName, UserMap users);
+	User*			_FindUser(const BString& idOrName, const UserMap& users);
+	User*			_FindKnownUser(const BString& idOrName,
+								ProtocolLooper* looper);
 
 	bool			_Send(BMessage* msg, Conversation* chat);
 
@@ -5,9 +5,13 @@
 
 #include "Conversation.h"
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <Beep.h>
 #include <Catalog.h>
-#include <DateTimeFormat.h>
+#include <Debug.h>
 #include <Locale.h>
 #include <Notification.h>
 #include <StringFormat.h>
@@ -27,10 +31,42 @@
 #include "ProtocolLooper.h"
 #include "ProtocolManager.h"
 #include "Server.h"
+#include "ServerShard.h"
+#include "ServerWorker.h"
 #include "TheApp.h"
 #include "Utils.h"
 
 
+// Remove the messages at the end of logs that are the first of the count
+// shown, in order, as they were shown already
+static void
+drop_shown(BMessage* logs, const BMessage& shown, int32 count)
+{
+	type_code type;
+	int32 logged = 0;
+	logs->GetInfo("message", &type, &logged);
+	for (int32 start = std::max((int32)0, logged - count); start < logged;
+			start++) {
+		bool matches = true;
+		for (int32 i = start; i < logged && matches == true; i++) {
+			BMessage entry;
+			BMessage live;
+			matches = logs->FindMessage("message", i, &entry) == B_OK
+				&& shown.FindMessage("message", i - start, &live) == B_OK
+				&& entry.GetInt64("when", 0) == live.GetInt64("when", 0)
+				&& strcmp(entry.GetString("body", ""),
+					live.GetString("body", "")) == 0;
+		}
+		if (matches == false)
+			continue;
+
+		for (int32 i = logged - 1; i >= start; i--)
+			logs->RemoveData("message", i);
+		return;
+	}
+}
+
+
 Conversation::Conversation(BString id, BMessenger msgn)
 	:
 	fID(id),
@@ -39,12 +75,14 @@ Conversation::Conversation(BString id, BMessenger msgn)
 	fChatView(NULL),
 	fLooper(NULL),
 	fIcon(ImageCache::Get()->GetImage("kOnePersonIcon")),
-	fDateFormatter(),
+	fLogsRequested(false),
+	fReadingLogs(false),
 	fRoomFlags(0),
 	fDisallowedFlags(0),
 	fNotifyMessageCount(0),
 	fNotifyMentionCount(0),
-	fUserIcon(false)
+	fUserIcon(false),
+	fAddingUsers(false)
 {
 	fConversationItem = new ConversationItem(fName.String(), this);
 	RegisterObserver(fConversationItem);
@@ -60,6 +98,9 @@ Conversation::~Conversation()
 
 	delete fChatView;
 	delete fConversationItem;
+
+	if (fLogsRequested == true)
+		ServerWorker::Get()->CloseLogs(this);
 }
 
 
@@ -71,9 +112,14 @@ Conversation::GetId() const
 
 
 void
-Conversation::ImMessage(BMessage* msg)
+Conversation::ImMessage(BMessage* msg, const ImEvent* event)
 {
-	int32 im_what = msg->FindInt32("im_what");
+	ImEvent parsed;
+	if (event == NULL) {
+		parsed.SetTo(msg);
+		event = &parsed;
+	}
+	int32 im_what = event->What();
 
 	switch(im_what)
 	{
@@ -82,11 +128,13 @@ Conversation::ImMessage(BMessage* msg)
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "Conversation ― Notifications"
 
-			_EnsureUser(msg);
+			_EnsureUser(event->UserId().String(), event->UserName());
+			// Asked for its logs before this is in them
+			ConversationView* view = GetView();
 			_LogChatMessage(msg);
-			GetView()->MessageReceived(msg);
+			view->ImMessage(msg, event);
 
-			BString text = msg->FindString("body");
+			const BString& text = event->Body();
 			Contact* contact = GetOwnContact();
 			BWindow* win = fChatView->Window();
 
@@ -167,8 +215,9 @@ Conversation::ImMessage(BMessage* msg)
 		}
 		case IM_MESSAGE_SENT:
 		{
+			ConversationView* view = GetView();
 			_LogChatMessage(msg);
-			GetView()->MessageReceived(msg);
+			view->ImMessage(msg, event);
 			break;
 		}
 		case IM_SEND_MESSAGE:
@@ -213,15 +262,12 @@ Conversation::ImMessage(BMessage* msg)
 			if (msg->FindString("subject", &subject) == B_OK)
 				SetNotifySubject(subject.String());
 
-			int32 defaultFlags;
-			if (msg->FindInt32("room_default_flags", &defaultFlags) == B_OK)
-				if (fRoomFlags == 0)
-					fRoomFlags = defaultFlags;
+			// Defaulted and cached by the ServerShard
+			fRoomFlags = msg->GetInt32("room_flags", fRoomFlags);
 
 			int32 disabledFlags;
 			if (msg->FindInt32("room_disallowed_flags", &disabledFlags) == B_OK)
 					fDisallowedFlags = disabledFlags;
-			_CacheRoomFlags();
 			break;
 		}
 		case IM_ROOM_PARTICIPANTS:
@@ -238,23 +284,25 @@ Conversation::ImMessage(BMessage* msg)
 			if (msg->FindStrings("user_id", &ids) != B_OK)
 				break;
 
-			for (int i = 0; i < ids.CountStrings(); i++) {
-				BMessage user;
-				user.AddString("user_name", names.StringAt(i));
-				user.AddString("user_id", ids.StringAt(i));
-				_EnsureUser(&user, false);
-			}
+			// Listed all at once, rather than as each one's added
+			fAddingUsers = true;
+			for (int i = 0; i < ids.CountStrings(); i++)
+				_EnsureUser(ids.StringAt(i), names.StringAt(i), false);
+			fAddingUsers = false;
+
+			GetView()->UpdateUserList(fUsers);
+			NotifyInteger(INT_ROOM_MEMBERS, fUsers.CountItems());
 			break;
 		}
 		case IM_ROOM_PARTICIPANT_JOINED:
 		{
-			BString user_id;
-			if (msg->FindString("user_id", &user_id) != B_OK)
+			const Atom& user_id = event->UserId();
+			if (user_id.IsEmpty() == true)
 				break;
 
-			if (UserById(user_id) == NULL) {
-				_EnsureUser(msg, false);
-				GetView()->MessageReceived(msg);
+			if (fUsers.IndexOf(user_id) < 0) {
+				_EnsureUser(user_id.String(), event->UserName(), false);
+				GetView()->ImMessage(msg, event);
 			}
 			break;
 		}
@@ -262,30 +310,29 @@ Conversation::ImMessage(BMessage* msg)
 		case IM_ROOM_PARTICIPANT_KICKED:
 		case IM_ROOM_PARTICIPANT_BANNED:
 		{
-			BString user_id = msg->FindString("user_id");
 			User* user;
-			if (user_id.IsEmpty() == true || (user = UserById(user_id)) == NULL)
+			if (event->UserId().IsEmpty() == true
+				|| (user = fUsers.ValueFor(event->UserId())) == NULL)
 				break;
 
-			GetView()->MessageReceived(msg);
+			GetView()->ImMessage(msg, event);
 			RemoveUser(user);
 			break;
 		}
 		case IM_ROOM_ROLECHANGED:
 		{
-			BString user_id;
 			Role* role = _GetRole(msg);
-			if (msg->FindString("user_id", &user_id) != B_OK || role == NULL)
+			if (event->UserId().IsEmpty() == true || role == NULL)
 				break;
 
-			SetRole(user_id, role);
-			GetView()->MessageReceived(msg);
+			SetRole(event->UserId().String(), role);
+			GetView()->ImMessage(msg, event);
 			break;
 		}
 		case IM_USER_NICKNAME_SET:
 		{
-			BString user_id = msg->FindString("user_id");
-			BString user_name = msg->FindString("user_name");
+			BString user_id = event->UserId().String();
+			const BString& user_name = event->UserName();
 			if (user_id.IsEmpty() == false && user_name.IsEmpty() == false) {
 				User* user = UserById(user_id);
 
@@ -395,7 +442,6 @@ void
 Conversation::SetProtocolLooper(ProtocolLooper* looper)
 {
 	fLooper = looper;
-	_LoadRoomFlags();
 }
 
 
@@ -445,13 +491,57 @@ Conversation::GetView()
 	if (!(fRoomFlags & ROOM_POPULATE_LOGS))
 		return fChatView;
 
-	BMessage logMsg;
-	if (_GetChatLogs(&logMsg) == B_OK)
-		fChatView->MessageReceived(&logMsg);
+	_EnsureCachePath();
+	fLogsRequested = true;
+	fReadingLogs = true;
+	ServerWorker::Get()->ReadLogs(this);
 	return fChatView;
 }
 
 
+status_t
+Conversation::GetOlderLogs()
+{
+	if (fLogsRequested == false)
+		return B_ENTRY_NOT_FOUND;
+	ServerWorker::Get()->ReadOlderLogs(this,
+		AppPreferences::Get()->ScrollbackDepth);
+	return B_OK;
+}
+
+
+void
+Conversation::LogsTrimmed(int64 when, int32 sameTime)
+{
+	if (fLogsRequested == true)
+		ServerWorker::Get()->LogsTrimmed(this, when, sameTime);
+}
+
+
+void
+Conversation::LogsRead(BMessage* logs)
+{
+	if (fChatView == NULL)
+		return;
+	logs->what = IM_MESSAGE;
+	if (logs->GetBool("older", false) == true) {
+		fChatView->LogsRead(logs, true);
+		return;
+	}
+
+	// The messages shown as they came while the page was read may be at
+	// its end too, and they're to be after it
+	fReadingLogs = false;
+	type_code type;
+	int32 shown = 0;
+	fShownWhileReading.GetInfo("message", &type, &shown);
+	if (shown > 0)
+		drop_shown(logs, fShownWhileReading, shown);
+	fShownWhileReading.MakeEmpty();
+	fChatView->LogsRead(logs, shown > 0);
+}
+
+
 void
 Conversation::ShowView(bool typing, bool userAction)
 {
@@ -466,8 +556,8 @@ Conversation::GetListItem()
 }
 
 
-UserMap
-Conversation::Users()
+const UserMap&
+Conversation::Users() const
 {
 	return fUsers;
 }
@@ -477,7 +567,7 @@ User*
 Conversation::UserById(BString id)
 {
 	bool found = false;
-	return fUsers.ValueFor(id, &found);
+	return fUsers.ValueFor(id.String(), &found);
 }
 
 
@@ -486,10 +576,7 @@ Conversation::AddUser(User* user)
 {
 	if (user == NULL)
 		return;
-	BMessage msg;
-	msg.AddString("user_id", user->GetId());
-	msg.AddString("user_name", user->GetName());
-	_EnsureUser(&msg, false);
+	_EnsureUser(user->GetId(), user->GetName(), false);
 	_SortConversationList();
 }
 
@@ -501,7 +588,7 @@ Conversation::RemoveUser(User* user)
 		return;
 	fUsers.RemoveItemFor(user->GetId());
 	user->UnregisterObserver(this);
-	GetView()->UpdateUserList(fUsers);
+	GetView()->RemoveUser(user);
 	_SortConversationList();
 
 	_UpdateIcon();
@@ -519,20 +606,25 @@ Conversation::GetOwnContact()
 void
 Conversation::SetRole(BString id, Role* role)
 {
-	Role* oldRole = fRoles.ValueFor(id);
+	Atom key(id);
+	Role* oldRole = fRoles.ValueFor(key);
 	if (oldRole != NULL) {
-		fRoles.RemoveItemFor(id);
+		fRoles.RemoveItemFor(key);
 		delete oldRole;
 	}
 	if (role != NULL)
-		fRoles.AddItem(id, role);
+		fRoles.AddItem(key, role);
+
+	User* user = UserById(id);
+	if (user != NULL)
+		GetView()->UpdateUserRole(user);
 }
 
 
 Role*
 Conversation::GetRole(BString id)
 {
-	return fRoles.ValueFor(id);
+	return fRoles.ValueFor(id.String());
 }
 
 
@@ -540,7 +632,8 @@ void
 Conversation::SetFlags(int32 flags)
 {
 	fRoomFlags = flags;
-	_CacheRoomFlags();
+	if (fLooper != NULL)
+		fLooper->GetShard()->CacheRoomFlags(fID, flags);
 }
 
 
@@ -557,74 +650,19 @@ Conversation::_WarnUser(BString message)
 void
 Conversation::_LogChatMessage(BMessage* msg)
 {
-	// Binary logs
-	// TODO: Don't hardcode 31, expose maximum as a setting
-	const int32 MAX = 31;
-
-	BMessage logMsg(IM_MESSAGE);
-	if (_GetChatLogs(&logMsg) != B_OK) {
-		logMsg.what = IM_MESSAGE;
-		logMsg.AddInt32("im_what", IM_LOGS_RECEIVED);
+	// Those from the protocol were logged by the ServerShard already, the
+	// rest are logged by it in turn
+	if (msg->GetBool("logged", false) == false) {
+		msg->AddInt64("when", time(NULL));
+		fLooper->GetShard()->LogMessage(fID, msg);
 	}
 
-	BMessage last;
-	if (logMsg.FindMessage("message", MAX, &last) == B_OK)
-		logMsg.RemoveData("message", 0);
-	msg->AddInt64("when", time(NULL));
-	logMsg.AddMessage("message", msg);
-
-	BFile logFile(fCachePath.Path(), B_READ_WRITE | B_OPEN_AT_END | B_CREATE_FILE);
-	WriteAttributeMessage(&logFile, "Chat:logs", &logMsg);
-
-	// Plain-text logs
-	// Gotta make sure the formatting's pretty!
-	BString date;
-	fDateFormatter.Format(date, time(0), B_SHORT_DATE_FORMAT, B_MEDIUM_TIME_FORMAT);
-	BString id = msg->FindString("user_id");
-	BString name = msg->FindString("user_name");
-	BString body = msg->FindString("body");
-
-	if (id.IsEmpty() == true && name.IsEmpty() == true)
-		return;
-	else if (name.IsEmpty() == true) {
-		User* user = UserById(id);
-		name = user ? user->GetName() : id;
-	}
-
-	BString logLine("[");
-	logLine << date << "] <" << name << "> " << body << "\n";
-	logFile.Write(logLine.String(), logLine.Length());
-}
-
-
-status_t
-Conversation::_GetChatLogs(BMessage* msg)
-{
-	_EnsureCachePath();
-	BFile logFile(fCachePath.Path(), B_READ_WRITE | B_CREATE_FILE);
-	return ReadAttributeMessage(&logFile, "Chat:logs", msg);
-}
-
+	if (fReadingLogs == true)
+		fShownWhileReading.AddMessage("message", msg);
 
-void
-Conversation::_CacheRoomFlags()
-{
-	_EnsureCachePath();
-	BFile cacheFile(fCachePath.Path(), B_READ_WRITE | B_CREATE_FILE);
-	if (cacheFile.InitCheck() != B_OK)
-		return;
-	cacheFile.WriteAttr("Chat:flags", B_INT32_TYPE, 0, &fRoomFlags, sizeof(int32));
-}
-
-
-void
-Conversation::_LoadRoomFlags()
-{
-	_EnsureCachePath();
-	BFile cacheFile(fCachePath.Path(), B_READ_ONLY);
-	if (cacheFile.InitCheck() != B_OK)
-		return;
-	cacheFile.ReadAttr("Chat:flags", B_INT32_TYPE, 0, &fRoomFlags, sizeof(int32));
+	// Only for the view, the log has its own copy
+	if (msg->HasBool("logged") == false)
+		msg->AddBool("logged", true);
 }
 
 
@@ -635,14 +673,13 @@ Conversation::_EnsureCachePath()
 		return;
 	fCachePath.SetTo(RoomCachePath(fLooper->Protocol()->GetName(),
 									   fID.String()));
+	fLogPath.SetTo(RoomLogPath(fLooper->Protocol()->GetName(), fID.String()));
 }
 
 
 User*
-Conversation::_EnsureUser(BMessage* msg, bool implicit)
+Conversation::_EnsureUser(BString id, BString name, bool implicit)
 {
-	BString id = msg->FindString("user_id");
-	BString name = msg->FindString("user_name");
 	if (id.IsEmpty() == true) return NULL;
 
 	User* user = UserById(id);
@@ -665,15 +702,16 @@ Conversation::_EnsureUser(BMessage* msg, bool implicit)
 		BMessage msg(IM_MESSAGE);
 		msg.AddInt32("im_what", IM_GET_ROOM_PARTICIPANTS);
 		msg.AddString("chat_id", fID);
-		fLooper->MessageReceived(&msg);
+		fLooper->PostRequest(&msg);
 	}
 
 	if (UserById(id) == NULL) {
 		fUsers.AddItem(id, user);
-		fUsers.AddItem(id, user);
-		GetView()->UpdateUserList(fUsers);
 		_UpdateIcon(user);
-		NotifyInteger(INT_ROOM_MEMBERS, fUsers.CountItems());
+		if (fAddingUsers == false) {
+			GetView()->AddUser(user);
+			NotifyInteger(INT_ROOM_MEMBERS, fUsers.CountItems());
+		}
 	}
 
 	if (name.IsEmpty() == false && user->GetName() != name)
@@ -5,13 +5,14 @@
 #ifndef CONVERSATION_H
 #define CONVERSATION_H
 
-#include <DateTimeFormat.h>
 #include <Messenger.h>
 #include <Path.h>
 #include <StringList.h>
 
+#include <libsupport/Atom.h>
 #include <libsupport/KeyMap.h>
 
+#include "ImEvent.h"
 #include "Observer.h"
 #include "Role.h"
 #include "Server.h"
@@ -24,8 +25,8 @@ class ProtocolLooper;
 class Server;
 
 
-typedef KeyMap<BString, User*> UserMap;
-typedef KeyMap<BString, Role*> RoleMap;
+typedef KeyMap<Atom, User*> UserMap;
+typedef KeyMap<Atom, Role*> RoleMap;
 
 
 class Conversation : public Notifier, public Observer {
@@ -35,7 +36,8 @@ public:
 
 	BString				GetId() const;
 
-	void				ImMessage(BMessage* msg);
+	void				ImMessage(BMessage* msg,
+							const ImEvent* event = NULL);
 
 	// Tell the ConversationView to invalidate user list
 	void				ObserveString(int32 what, BString str);
@@ -58,11 +60,25 @@ public:
 	BBitmap*			ProtocolBitmap() const;
 	BBitmap*			IconBitmap() const;
 
+	// The logs are read by the ServerWorker, and shown once they have been,
+	// see LogsRead()
 	ConversationView*	GetView();
 	void				ShowView(bool typing, bool userAction);
+	// Have the page of logged messages preceding those shown read;
+	// B_ENTRY_NOT_FOUND if there are no logs
+	status_t			GetOlderLogs();
+	// The view dropped the messages before when, and sameTime more from
+	// that second; get them from the logs again
+	void				LogsTrimmed(int64 when, int32 sameTime);
+	// A page of logs the ServerWorker read, as APP_LOGS_READ
+	void				LogsRead(BMessage* logs);
 	ConversationItem*	GetListItem();
 
-	UserMap				Users();
+	// Of its ChatLog, and of its plain-text log, the room's cache file
+	const BPath&		LogPath() const { return fLogPath; }
+	const BPath&		CachePath() const { return fCachePath; }
+
+	const UserMap&		Users() const;
 	User*				UserById(BString id);
 	Contact*			GetOwnContact();
 
@@ -73,20 +89,20 @@ public:
 	Role*				GetRole(BString id);
 
 	int32				GetFlags() { return fRoomFlags; }
+	// Kept in the room's cache by the ServerShard
 	void				SetFlags(int32 flags);
+	// As the ServerShard read them from the cache
+	void				SetCachedFlags(int32 flags) { fRoomFlags = flags; }
 	int32				DisallowedFlags() { return fDisallowedFlags; }
 
 private:
 	void				_WarnUser(BString message);
 
 	void				_LogChatMessage(BMessage* msg);
-	status_t			_GetChatLogs(BMessage* msg);
-
-	void				_CacheRoomFlags();
-	void				_LoadRoomFlags();
 
 	void				_EnsureCachePath();
-	User*				_EnsureUser(BMessage* msg, bool implicit = true);
+	User*				_EnsureUser(BString id, BString name,
+							bool implicit = true);
 	Role*				_GetRole(BMessage* msg);
 
 	void				_UpdateIcon(User* user = NULL);
@@ -111,12 +127,16 @@ private:
 	bool fUserIcon;
 
 	BPath fCachePath;
-	BDateTimeFormat fDateFormatter;
+	BPath fLogPath;
+	bool fLogsRequested;
+	bool fReadingLogs; // The first page hasn't been read yet
+	BMessage fShownWhileReading;
 
 	int32 fRoomFlags;
 	int32 fDisallowedFlags;
 
 	UserMap fUsers; // For defined, certain members of the room
+	bool fAddingUsers; // Listed once they've all been added
 	BStringList fGuests; // IDs of implicitly-defined users
 	RoleMap fRoles;
 };
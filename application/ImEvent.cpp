@@ -0,0 +1,140 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ImEvent.h"
+
+#include <Message.h>
+
+#include "ChatProtocolMessages.h"
+
+
+ImEvent::ImEvent()
+	:
+	fWhat(-1),
+	fFields(0),
+	fInstance(-1),
+	fWhen(0),
+	fStatus(-1)
+{
+}
+
+
+ImEvent::ImEvent(const BMessage* msg)
+	:
+	fWhat(-1),
+	fFields(0),
+	fInstance(-1),
+	fWhen(0),
+	fStatus(-1)
+{
+	SetTo(msg);
+}
+
+
+status_t
+ImEvent::SetTo(const BMessage* msg)
+{
+	fWhat = -1;
+	fFields = 0;
+	fChatId = Atom();
+	fUserId = Atom();
+	fUserName = "";
+	fBody = "";
+	fStatusMessage = "";
+	fFaces.MakeEmpty();
+	fColors.MakeEmpty();
+
+	if (msg == NULL)
+		return B_BAD_VALUE;
+
+	if (msg->FindInt64("instance", &fInstance) == B_OK)
+		fFields |= kInstance;
+
+	if (msg->FindInt32("im_what", &fWhat) != B_OK)
+		fWhat = -1;
+	else if (IsCompact(fWhat) == false)
+		return B_OK;
+
+	const char* string = NULL;
+	if (msg->FindString("chat_id", &string) == B_OK)
+		fChatId = Atom(string);
+	if (msg->FindString("user_id", &string) == B_OK)
+		fUserId = Atom(string);
+	if (msg->FindString("user_name", &string) == B_OK)
+		fUserName = string;
+
+	if (msg->FindString("body", &string) == B_OK) {
+		fBody = string;
+		fFields |= kBody;
+	}
+	if (msg->FindInt64("when", &fWhen) == B_OK)
+		fFields |= kWhen;
+	if (msg->FindInt32("status", &fStatus) == B_OK)
+		fFields |= kStatus;
+	if (msg->FindString("message", &string) == B_OK) {
+		fStatusMessage = string;
+		fFields |= kMessage;
+	}
+
+	if (fFields & kBody)
+		_ReadSpans(msg);
+	return B_OK;
+}
+
+
+/* static */ bool
+ImEvent::IsCompact(int32 im_what)
+{
+	switch (im_what) {
+		case IM_MESSAGE_RECEIVED:
+		case IM_MESSAGE_SENT:
+		case IM_USER_STATUS_SET:
+		case IM_USER_NICKNAME_SET:
+		case IM_USER_AVATAR_SET:
+		case IM_ROOM_PARTICIPANT_JOINED:
+		case IM_ROOM_PARTICIPANT_LEFT:
+		case IM_ROOM_PARTICIPANT_KICKED:
+		case IM_ROOM_PARTICIPANT_BANNED:
+		case IM_ROOM_ROLECHANGED:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+void
+ImEvent::_ReadSpans(const BMessage* msg)
+{
+	type_code type;
+	int32 count = 0;
+
+	// Spans missing their length or face are dropped, as ConversationView
+	// always did.
+	if (msg->GetInfo("face_start", &type, &count) == B_OK) {
+		fFaces.Reserve(count);
+		for (int32 i = 0; i < count; i++) {
+			text_span span;
+			if (msg->FindInt32("face_start", i, &span.start) != B_OK
+				|| msg->FindInt32("face_length", i, &span.length) != B_OK
+				|| msg->FindUInt16("face", i, &span.face) != B_OK)
+				continue;
+			fFaces.AddItem(span);
+		}
+	}
+
+	if (msg->GetInfo("color_start", &type, &count) == B_OK) {
+		fColors.Reserve(count);
+		for (int32 i = 0; i < count; i++) {
+			text_span span;
+			span.face = 0;
+			if (msg->FindInt32("color_start", i, &span.start) != B_OK
+				|| msg->FindInt32("color_length", i, &span.length) != B_OK
+				|| msg->FindColor("color", i, &span.color) != B_OK)
+				continue;
+			fColors.AddItem(span);
+		}
+	}
+}
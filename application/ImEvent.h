@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _IM_EVENT_H
+#define _IM_EVENT_H
+
+#include <GraphicsDefs.h>
+#include <String.h>
+
+#include <libsupport/Atom.h>
+#include <libsupport/List.h>
+
+class BMessage;
+
+
+// One "face_*" or "color_*" run of a message body, see IM_MESSAGE_RECEIVED.
+struct text_span {
+	int32		start;
+	int32		length;
+	uint16		face;
+	rgb_color	color;
+};
+
+typedef List<text_span> TextSpans;
+
+
+// Typed copy of the fields of the most frequent IM_MESSAGEs, read once
+// when the message enters the app and handed down to Conversation and
+// ConversationView instead of every layer looking fields up by name.
+// Other im_what codes only get What() and Instance(); use the BMessage.
+// Messages without an im_what (logged lines, notices) are read as text.
+class ImEvent {
+public:
+						ImEvent();
+						ImEvent(const BMessage* msg);
+
+			status_t	SetTo(const BMessage* msg);
+
+	static	bool		IsCompact(int32 im_what);
+
+			int32		What() const { return fWhat; }
+			bool		HasInstance() const { return fFields & kInstance; }
+			int64		Instance() const { return fInstance; }
+
+			const Atom&	ChatId() const { return fChatId; }
+			const Atom&	UserId() const { return fUserId; }
+			const BString& UserName() const { return fUserName; }
+
+			bool		HasBody() const { return fFields & kBody; }
+			const BString& Body() const { return fBody; }
+			bool		HasWhen() const { return fFields & kWhen; }
+			int64		When() const { return fWhen; }
+
+			bool		HasStatus() const { return fFields & kStatus; }
+			int32		Status() const { return fStatus; }
+			bool		HasStatusMessage() const { return fFields & kMessage; }
+			const BString& StatusMessage() const { return fStatusMessage; }
+
+			const TextSpans& Faces() const { return fFaces; }
+			const TextSpans& Colors() const { return fColors; }
+
+private:
+	enum {
+		kInstance	= 1 << 0,
+		kBody		= 1 << 1,
+		kWhen		= 1 << 2,
+		kStatus		= 1 << 3,
+		kMessage	= 1 << 4
+	};
+
+			void		_ReadSpans(const BMessage* msg);
+
+	int32				fWhat;
+	uint32				fFields;
+	int64				fInstance;
+
+	Atom				fChatId;
+	Atom				fUserId;
+	BString				fUserName;
+
+	BString				fBody;
+	int64				fWhen;
+	int32				fStatus;
+	BString				fStatusMessage;
+
+	TextSpans			fFaces;
+	TextSpans			fColors;
+};
+
+
+#endif // _IM_EVENT_H
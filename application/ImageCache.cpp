@@ -44,10 +44,9 @@ ImageCache::ImageCache()
 
 ImageCache::~ImageCache()
 {
-	while (fBitmaps.CountItems()) {
-		BBitmap* bit = fBitmaps.ValueFor(0);
-		delete bit;
-	}
+	for (uint32 i = 0; i < fBitmaps.CountItems(); i++)
+		delete fBitmaps.ValueAt(i);
+	fBitmaps.MakeEmpty();
 }
 
 
@@ -12,6 +12,7 @@
 
 #include "ProtocolLooper.h"
 
+#include <Autolock.h>
 #include <Bitmap.h>
 #include <String.h>
 
@@ -27,13 +28,16 @@
 #include "TheApp.h"
 
 
-ProtocolLooper::ProtocolLooper(ChatProtocol* protocol, int64 instance)
+ProtocolLooper::ProtocolLooper(ChatProtocol* protocol, int64 instance,
+	ServerShard* shard)
 	:
 	BLooper(),
 	fProtocol(protocol),
 	fInstance(instance),
+	fShard(shard),
 	fListItem(NULL),
-	fMySelf(NULL)
+	fMySelf(NULL),
+	fRequestLock("Protocol requests")
 {
 	Account* account = reinterpret_cast<Account*>(
 		protocol->MessengerInterface());
@@ -70,6 +74,32 @@ ProtocolLooper::MessageReceived(BMessage* msg)
 {
 	if (Protocol()->Process(msg) != B_OK)
 		BLooper::MessageReceived(msg);
+
+	BString key = _RequestKey(msg);
+	if (key.IsEmpty() == false) {
+		BAutolock _(fRequestLock);
+		fRequests.RemoveItemFor(key);
+	}
+}
+
+
+status_t
+ProtocolLooper::PostRequest(BMessage* msg)
+{
+	BString key = _RequestKey(msg);
+	if (key.IsEmpty() == false) {
+		BAutolock _(fRequestLock);
+		if (fRequests.HasKey(key) == true)
+			return B_OK;
+		fRequests.AddItem(key, true);
+	}
+
+	status_t ret = PostMessage(msg);
+	if (ret != B_OK && key.IsEmpty() == false) {
+		BAutolock _(fRequestLock);
+		fRequests.RemoveItemFor(key);
+	}
+	return ret;
 }
 
 
@@ -96,7 +126,7 @@ ProtocolLooper::Protocol()
 }
 
 
-ChatMap
+const ChatMap&
 ProtocolLooper::Conversations() const
 {
 	return fChatMap;
@@ -107,7 +137,7 @@ Conversation*
 ProtocolLooper::ConversationById(BString id)
 {
 	bool found = false;
-	return fChatMap.ValueFor(id, &found);
+	return fChatMap.ValueFor(id.String(), &found);
 }
 
 
@@ -127,7 +157,7 @@ ProtocolLooper::RemoveConversation(Conversation* chat)
 }
 
 
-RosterMap
+const RosterMap&
 ProtocolLooper::Contacts() const
 {
 	return fRosterMap;
@@ -138,7 +168,7 @@ Contact*
 ProtocolLooper::ContactById(BString id)
 {
 	bool found = false;
-	return fRosterMap.ValueFor(id, &found);
+	return fRosterMap.ValueFor(id.String(), &found);
 }
 
 
@@ -150,6 +180,13 @@ ProtocolLooper::AddContact(Contact* contact)
 }
 
 
+void
+ProtocolLooper::AddContacts(const RosterMap& contacts)
+{
+	fRosterMap.AddList(contacts);
+}
+
+
 void
 ProtocolLooper::RemoveContact(Contact* contact)
 {
@@ -180,12 +217,33 @@ ProtocolLooper::UserById(BString id)
 	bool found = false;
 	User* user = ContactById(id);
 	if (user == NULL)
-		user = fUserMap.ValueFor(id, &found);
+		user = fUserMap.ValueFor(id.String(), &found);
 
 	return user;
 }
 
 
+User*
+ProtocolLooper::DoForEachUser(user_visitor func, void* cookie) const
+{
+	// Walk the live maps rather than merging them like Users(); a contact
+	// takes precedence over a plain user with the same ID.
+	for (uint32 i = 0; i < fRosterMap.CountItems(); i++) {
+		User* user = fRosterMap.ValueAt(i);
+		if (func(user, cookie) == true)
+			return user;
+	}
+	for (uint32 i = 0; i < fUserMap.CountItems(); i++) {
+		if (fRosterMap.IndexOf(fUserMap.KeyAt(i)) >= 0)
+			continue;
+		User* user = fUserMap.ValueAt(i);
+		if (func(user, cookie) == true)
+			return user;
+	}
+	return NULL;
+}
+
+
 void
 ProtocolLooper::AddUser(User* user)
 {
@@ -194,7 +252,7 @@ ProtocolLooper::AddUser(User* user)
 }
 
 
-CommandMap
+const CommandMap&
 ProtocolLooper::Commands() const
 {
 	return fCommands;
@@ -275,3 +333,25 @@ ProtocolLooper::_InitChatView()
 	if (icon != NULL)
 		fSystemChatView->ObservePointer(PTR_ROOM_BITMAP, (void*)icon);
 }
+
+
+BString
+ProtocolLooper::_RequestKey(BMessage* msg)
+{
+	BString key;
+	int32 im_what = -1;
+	if (msg->what != IM_MESSAGE || msg->FindInt32("im_what", &im_what) != B_OK)
+		return key;
+
+	// Only queries can be merged; anything that changes state is sent as-is
+	switch (im_what) {
+		case IM_GET_CONTACT_INFO:
+		case IM_GET_EXTENDED_CONTACT_INFO:
+		case IM_GET_ROOM_METADATA:
+		case IM_GET_ROOM_PARTICIPANTS:
+			key << im_what << "/" << msg->GetString("chat_id", "") << "/"
+				<< msg->GetString("user_id", "");
+			break;
+	}
+	return key;
+}
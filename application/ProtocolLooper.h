@@ -7,10 +7,12 @@
 #ifndef _PROTOCOL_LOOPER_H
 #define _PROTOCOL_LOOPER_H
 
+#include <Locker.h>
 #include <Looper.h>
 #include <ObjectList.h>
 #include <String.h>
 
+#include <libsupport/Atom.h>
 #include <libsupport/KeyMap.h>
 
 #include "ChatProtocol.h"
@@ -20,42 +22,56 @@ class Contact;
 class Conversation;
 class ConversationAccountItem;
 class ConversationView;
+class ServerShard;
 class User;
 
 
-typedef KeyMap<BString, Conversation*> ChatMap;
-typedef KeyMap<BString, Contact*> RosterMap;
-typedef KeyMap<BString, User*> UserMap;
+typedef KeyMap<Atom, Conversation*> ChatMap;
+typedef KeyMap<Atom, Contact*> RosterMap;
+typedef KeyMap<Atom, User*> UserMap;
+
+// Return true to stop iterating, as with BList::DoForEach()
+typedef bool (*user_visitor)(User* user, void* cookie);
 
 
 class ProtocolLooper : public BLooper {
 public:		
-							ProtocolLooper(ChatProtocol* protocol, int64 instance);
+							ProtocolLooper(ChatProtocol* protocol, int64 instance,
+								ServerShard* shard);
 							~ProtocolLooper();
 
 			void			MessageReceived(BMessage* msg);
 
+			// Queue a request for the protocol, rather than calling it on
+			// the caller's thread; a query equal to one still pending is
+			// merged into it.
+			status_t		PostRequest(BMessage* msg);
+
 			ConversationView*
 							GetView();
 			void			ShowView();
 
 			ChatProtocol*	Protocol();
+			// Where the protocol's messages are handled, see ServerShard
+			ServerShard*	GetShard() const { return fShard; }
 
-			ChatMap			Conversations() const;
+			const ChatMap&	Conversations() const;
 			Conversation*	ConversationById(BString id);
 			void			AddConversation(Conversation* chat);
 			void			RemoveConversation(Conversation* chat);
 
-			RosterMap		Contacts() const;
+			const RosterMap& Contacts() const;
 			Contact*		ContactById(BString id);
 			void			AddContact(Contact* contact);
+			void			AddContacts(const RosterMap& contacts);
 			void			RemoveContact(Contact* contact);
 
 			UserMap			Users() const;
 			User*			UserById(BString id);
+			User*			DoForEachUser(user_visitor func, void* cookie) const;
 			void			AddUser(User* user);
 
-			CommandMap		Commands() const;
+			const CommandMap& Commands() const;
 			ChatCommand*	CommandById(BString id);
 
 			Contact*		GetOwnContact();
@@ -71,8 +87,11 @@ public:
 private:
 			void			_InitChatView();
 
+	static	BString			_RequestKey(BMessage* msg);
+
 			ChatProtocol*	fProtocol;
 			int64			fInstance;
+			ServerShard*	fShard;
 
 			Contact*		fMySelf;
 
@@ -81,6 +100,9 @@ private:
 			UserMap			fUserMap;
 			CommandMap		fCommands;
 
+			BLocker			fRequestLock;
+			KeyMap<BString, bool> fRequests;
+
 			ConversationView*
 							fSystemChatView;
 			ConversationAccountItem*
@@ -24,6 +24,7 @@
 #include "ChatProtocol.h"
 #include "MainWindow.h"
 #include "Server.h"
+#include "ServerShard.h"
 #include "TheApp.h"
 #include "Utils.h"
 
@@ -138,16 +139,24 @@ ProtocolManager::AddAccount(ChatProtocolAddOn* addOn, const char* account,
 
 	bigtime_t instanceId = system_time();
 	ChatProtocol* cayap = addOn->Protocol();
+
+	// The protocol talks to its shard from the start, which passes on to
+	// target what's for it; it's only run once it has its looper.
+	ServerShard* shard = new ServerShard(instanceId, BMessenger(target));
 	Account* acc =
-		new Account(instanceId, cayap, account, addOn->Signature(), target);
+		new Account(instanceId, cayap, account, addOn->Signature(), shard);
 
 	// If account is disabled, just let it go
 	if (acc->InitCheck() == B_DONT_DO_THAT) {
 		delete acc;
+		shard->Lock();
+		shard->Quit();
 		return;
 	}
 	// Send a "whoops" notification if hits a failure
 	else if (acc->InitCheck() != B_OK) {
+		shard->Lock();
+		shard->Quit();
 		BMessage error(APP_ACCOUNT_FAILED);
 		cayap->Icon()->Archive(&error);
 		error.AddString("name", account);
@@ -157,7 +166,7 @@ ProtocolManager::AddAccount(ChatProtocolAddOn* addOn, const char* account,
 
 	fProtocolMap.AddItem(instanceId, cayap);
 
-	_Server()->AddProtocolLooper(instanceId, cayap);
+	_Server()->AddProtocolLooper(instanceId, cayap, shard);
 }
 
 
@@ -18,7 +18,6 @@
 #include <Application.h>
 #include <Catalog.h>
 #include <Debug.h>
-#include <Directory.h>
 #include <Entry.h>
 #include <Notification.h>
 #include <Path.h>
@@ -40,6 +39,8 @@
 #include "ProtocolLooper.h"
 #include "ProtocolManager.h"
 #include "RosterItem.h"
+#include "ServerShard.h"
+#include "ServerWorker.h"
 #include "StatusManager.h"
 #include "UserInfoWindow.h"
 #include "Utils.h"
@@ -53,6 +54,9 @@ Server::Server()
 	:
 	BMessageFilter(B_ANY_DELIVERY, B_ANY_SOURCE)
 {
+	// Started here, as the shards use it too and it's made on first use
+	ServerWorker::Get();
+
 	if (fUserItems.IsEmpty() == false || fCommands.CountItems() > 0)
 		return;
 
@@ -88,6 +92,8 @@ Server::Quit()
 {
 	for (int i = 0; i < fLoopers.CountItems(); i++)
 		RemoveProtocolLooper(fLoopers.KeyAt(i));
+
+	ServerWorker::Release();
 }
 
 
@@ -118,6 +124,10 @@ Server::Filter(BMessage* message, BHandler **target)
 	filter_result result = B_DISPATCH_MESSAGE;
 
 	switch (message->what) {
+		case APP_CHANGE_SET:
+			_ApplyChanges(message);
+			result = B_SKIP_MESSAGE;
+			break;
 		case IM_MESSAGE:
 			result = ImMessage(message);
 			break;
@@ -167,6 +177,36 @@ Server::Filter(BMessage* message, BHandler **target)
 			statusMan->ReplicantStatusNotify(statusMan->Status());
 			break;
 		}
+		case APP_AVATAR_LOADED:
+		{
+			BBitmap* bitmap = NULL;
+			if (message->FindPointer("bitmap", (void**)&bitmap) != B_OK)
+				break;
+
+			ProtocolLooper* looper = _LooperFromMessage(message);
+			User* user = NULL;
+			if (looper != NULL)
+				user = looper->UserById(message->FindString("user_id"));
+
+			if (user != NULL)
+				user->SetNotifyAvatarBitmap(bitmap);
+			else
+				delete bitmap;
+			result = B_SKIP_MESSAGE;
+			break;
+		}
+		case APP_LOGS_READ:
+		{
+			ProtocolLooper* looper = _LooperFromMessage(message);
+			Conversation* chat = NULL;
+			if (looper != NULL)
+				chat = looper->ConversationById(
+					message->FindString("chat_id"));
+			if (chat != NULL)
+				chat->LogsRead(message);
+			result = B_SKIP_MESSAGE;
+			break;
+		}
 		case APP_ROOM_INFO:
 		{
 			Conversation* chat = _EnsureConversation(message);
@@ -249,16 +289,16 @@ filter_result
 Server::ImMessage(BMessage* msg)
 {
 	filter_result result = B_DISPATCH_MESSAGE;
-	int32 im_what = msg->FindInt32("im_what");
+	ImEvent event(msg);
+	int32 im_what = event.What();
 
 	switch (im_what) {
 		case IM_ROSTER:
 		{
-			int i = 0;
-			BString id;
-			while (msg->FindString("user_id", i++, &id) == B_OK)
-				_EnsureContact(msg);
-			result = B_SKIP_MESSAGE;
+			// Contacts are all added before the message reaches the roster
+			// views, which then insert and sort their items once.
+			if (_AddRoster(msg) == 0)
+				result = B_SKIP_MESSAGE;
 			break;
 		}
 		case IM_ROSTER_CONTACT_REMOVED:
@@ -292,25 +332,9 @@ Server::ImMessage(BMessage* msg)
 				looper->GetView()->MessageReceived(&info);
 			}
 
+			// Notified of by the ServerShard
 			Contact* contact = looper->GetOwnContact();
 			if (contact != NULL) {
-				// Send notification, if appropriate
-				UserStatus oldStatus = contact->GetNotifyStatus();
-				if ((oldStatus == STATUS_ONLINE && status == STATUS_OFFLINE)
-					|| (oldStatus == STATUS_OFFLINE && status == STATUS_ONLINE))
-				{
-					if (status == STATUS_ONLINE)
-						if (AppPreferences::Get()->NotifyProtocolStatus == true)
-							_ProtocolNotification(looper,
-								BString(B_TRANSLATE("Connected")),
-								BString(B_TRANSLATE("%user% has connected!")));
-					else
-						if (AppPreferences::Get()->NotifyProtocolStatus == true)
-							_ProtocolNotification(looper,
-								BString(B_TRANSLATE("Disconnected")),
-								BString(B_TRANSLATE("%user% is now offline!")));
-				}
-
 				contact->SetNotifyStatus((UserStatus)status);
 
 				BString statusMsg;
@@ -332,36 +356,38 @@ Server::ImMessage(BMessage* msg)
 		}
 		case IM_USER_NICKNAME_SET:
 		{
-			BString nick;
-			if (msg->FindString("user_name", &nick) != B_OK)
+			if (msg->HasString("user_name") == false)
 				return B_SKIP_MESSAGE;
 
-			User* user = _EnsureUser(msg);
+			User* user = _EnsureUser(event);
 			if (user == NULL)
 				break;
 
-			ChatMap conv = user->Conversations();
+			const ChatMap& conv = user->Conversations();
 			for (int i = 0; i < conv.CountItems(); i++)
-				conv.ValueAt(i)->ImMessage(msg);
+				conv.ValueAt(i)->ImMessage(msg, &event);
 
-			user->SetNotifyName(nick);
+			user->SetNotifyName(event.UserName());
 			break;
 		}
 		case IM_USER_STATUS_SET:
 		{
-			int32 status;
-
-			if (msg->FindInt32("status", &status) != B_OK)
-				return B_SKIP_MESSAGE;
-
-			User* user = _EnsureUser(msg);
-			if (!user)
-				break;
-
-			user->SetNotifyStatus((UserStatus)status);
-			BString statusMsg;
-			if (msg->FindString("message", &statusMsg) == B_OK) {
-				user->SetNotifyPersonalStatus(statusMsg);
+			// Coalesced by the ServerShard, each user's fields at the same
+			// index
+			const char* id = NULL;
+			for (int32 i = 0; msg->FindString("user_id", i, &id) == B_OK;
+					i++) {
+				ProtocolLooper* looper
+					= GetProtocolLooper(msg->GetInt64("instance", i, -1));
+				User* user;
+				if (looper == NULL || (user = _EnsureUser(id, looper)) == NULL)
+					continue;
+
+				user->SetNotifyStatus((UserStatus)msg->GetInt32("status", i,
+					STATUS_OFFLINE));
+				if (msg->GetBool("has_message", i, false) == true)
+					user->SetNotifyPersonalStatus(msg->GetString("message", i,
+						""));
 			}
 			break;
 		}
@@ -422,27 +448,21 @@ Server::ImMessage(BMessage* msg)
 		case IM_OWN_AVATAR_SET:
 		{
 			ProtocolLooper* looper = _LooperFromMessage(msg);
-			Contact* contact = looper->GetOwnContact();
 			entry_ref ref;
-
-			if (msg->FindRef("ref", &ref) == B_OK) {
-				BBitmap* bitmap = BTranslationUtils::GetBitmap(&ref);
-				if (bitmap != NULL)
-					contact->SetNotifyAvatarBitmap(bitmap);
-			}
+			if (looper != NULL && msg->FindRef("ref", &ref) == B_OK)
+				ServerWorker::Get()->SetAvatar(looper->GetOwnContact(), ref);
 			break;
 		}
 		case IM_USER_AVATAR_SET:
 		{
-			User* user = _EnsureUser(msg);
+			User* user = _EnsureUser(event);
 			if (!user)
 				break;
 
+			// Decoded and cached off-thread, see APP_AVATAR_LOADED
 			entry_ref ref;
-			if (msg->FindRef("ref", &ref) == B_OK) {
-				BBitmap* bitmap = BTranslationUtils::GetBitmap(&ref);
-				user->SetNotifyAvatarBitmap(bitmap);
-			}
+			if (msg->FindRef("ref", &ref) == B_OK)
+				ServerWorker::Get()->SetAvatar(user, ref);
 			break;
 		}
 		case IM_CREATE_CHAT:
@@ -469,22 +489,30 @@ Server::ImMessage(BMessage* msg)
 			break;
 		}
 		case IM_MESSAGE_RECEIVED:
-			if (msg->HasString("chat_id") == false) {
-				ProtocolLooper* looper = _LooperFromMessage(msg);
+			if (event.ChatId().IsEmpty() == true) {
+				ProtocolLooper* looper = GetProtocolLooper(event.Instance());
 				if (looper != NULL)
-					looper->GetView()->MessageReceived(msg);
+					looper->GetView()->ImMessage(msg, &event);
 				return B_SKIP_MESSAGE;
 			}
 		case IM_MESSAGE_SENT:
-		case IM_ROOM_JOINED:
-		case IM_ROOM_CREATED:
-		case IM_ROOM_METADATA:
 		case IM_ROOM_ROLECHANGED:
-		case IM_ROOM_PARTICIPANTS:
 		case IM_ROOM_PARTICIPANT_JOINED:
 		case IM_ROOM_PARTICIPANT_LEFT:
 		case IM_ROOM_PARTICIPANT_BANNED:
 		case IM_ROOM_PARTICIPANT_KICKED:
+		{
+			Conversation* chat = _EnsureConversation(event.ChatId().String(),
+				GetProtocolLooper(event.Instance()),
+				msg->GetInt32("room_flags", 0));
+			if (chat != NULL)
+				chat->ImMessage(msg, &event);
+			break;
+		}
+		case IM_ROOM_JOINED:
+		case IM_ROOM_CREATED:
+		case IM_ROOM_METADATA:
+		case IM_ROOM_PARTICIPANTS:
 		{
 			Conversation* chat = _EnsureConversation(msg);
 			if (chat != NULL)
@@ -562,50 +590,6 @@ Server::ImMessage(BMessage* msg)
 			invite->Go();
 			break;
 		}
-		case IM_ROOM_PARTICIPANT_STARTED_TYPING:
-		case IM_ROOM_PARTICIPANT_STOPPED_TYPING:
-		{
-//			User* user = _EnsureUser();
-//			Conversation* chat = _EnsureConversation();
-			result = B_SKIP_MESSAGE;
-			break;
-		}
-		case IM_PROGRESS:
-		{
-			ProtocolLooper* looper = _LooperFromMessage(msg);
-			const char* protocol = NULL;
-			const char* title = NULL;
-			const char* message = NULL;
-			float progress = 0.0f;
-
-			if (looper == NULL)
-				return result;
-			if (msg->FindString("title", &title) != B_OK)
-				return result;
-			if (msg->FindString("message", &message) != B_OK)
-				return result;
-			if (msg->FindFloat("progress", &progress) != B_OK)
-				return result;
-
-			if (!AppPreferences::Get()->NotifyProtocolStatus)
-				break;
-
-			BNotification notification(B_PROGRESS_NOTIFICATION);
-			notification.SetGroup(BString(APP_NAME));
-			notification.SetTitle(title);
-			notification.SetIcon(looper->Protocol()->Icon());
-			notification.SetContent(message);
-			notification.SetProgress(progress);
-			notification.Send();
-			break;
-		}
-		case IM_NOTIFICATION: {
-			_ProtocolNotification(_LooperFromMessage(msg),
-				msg->FindString("title"), msg->FindString("message"),
-				(notification_type)msg->GetInt32("type",
-					B_INFORMATION_NOTIFICATION));
-			break;
-		}
 		case IM_PROTOCOL_RELOAD_COMMANDS:
 		{
 			ProtocolLooper* looper = _LooperFromMessage(msg);
@@ -618,42 +602,8 @@ Server::ImMessage(BMessage* msg)
 			ProtocolLooper* looper = _LooperFromMessage(msg);
 			if (looper == NULL) break;
 
+			// Its cached rooms are joined by the ServerShard
 			fAccountEnabled.AddItem(looper->Protocol()->GetName(), true);
-
-			// Ready notification
-			if (AppPreferences::Get()->NotifyProtocolStatus == true)
-				_ProtocolNotification(looper, BString(B_TRANSLATE("Connected")),
-					BString(B_TRANSLATE("%user% has connected!")));
-
-			// Join cached rooms
-			BEntry entry;
-			char fileName[B_FILE_NAME_LENGTH] = {'\0'};
-			BDirectory dir(RoomsCachePath(looper->Protocol()->GetName()));
-
-			while (dir.GetNextEntry(&entry, true) == B_OK)
-				if (entry.GetName(fileName) == B_OK) {
-					int32 flags;
-					BFile file(&entry, B_READ_ONLY);
-					if (file.InitCheck() != B_OK)
-						continue;
-
-					if (file.ReadAttr("Chat:flags", B_INT32_TYPE, 0, &flags,
-							sizeof(int32)) < 0)
-						continue;
-
-					if (!(flags & ROOM_AUTOJOIN) && !(flags & ROOM_AUTOCREATE))
-						continue;
-
-					BMessage join(IM_MESSAGE);
-					int32 im_what = IM_JOIN_ROOM;
-					if (flags & ROOM_AUTOCREATE) {
-						im_what = IM_CREATE_CHAT;
-						join.AddString("user_id", fileName);
-					}
-					join.AddInt32("im_what", im_what);
-					join.AddString("chat_id", fileName);
-					looper->PostMessage(&join);
-				}
 			NotifyInteger(INT_ACCOUNTS_UPDATED, 0);
 			break;
 		}
@@ -699,9 +649,13 @@ Server::ImError(BMessage* msg)
 
 
 void
-Server::AddProtocolLooper(bigtime_t instanceId, ChatProtocol* cayap)
+Server::AddProtocolLooper(bigtime_t instanceId, ChatProtocol* cayap,
+	ServerShard* shard)
 {
-	ProtocolLooper* looper = new ProtocolLooper(cayap, instanceId);
+	ProtocolLooper* looper = new ProtocolLooper(cayap, instanceId, shard);
+	shard->SetProtocolLooper(looper);
+	shard->Run();
+
 	fLoopers.AddItem(instanceId, looper);
 	fAccounts.AddItem(cayap->GetName(), instanceId);
 	fAccountEnabled.AddItem(cayap->GetName(), false);
@@ -733,8 +687,21 @@ Server::RemoveProtocolLooper(bigtime_t instanceId)
 	fLoopers.RemoveItemFor(instanceId);
 	fAccounts.RemoveItemFor(looper->Protocol()->GetName());
 	fAccountEnabled.AddItem(looper->Protocol()->GetName(), false);
+
+	// The shard passes on what the protocol sends as it shuts down, and
+	// then what it has left
+	ServerShard* shard = looper->GetShard();
+	if (shard->Lock() == true) {
+		shard->SetProtocolLooper(NULL);
+		shard->Unlock();
+	}
 	looper->Lock();
 	looper->Quit();
+
+	// Waited for, so that nothing it has queued is lost, such as messages
+	// to log; it never waits on the window.
+	BMessage reply;
+	BMessenger(shard).SendMessage(B_QUIT_REQUESTED, &reply);
 }
 
 
@@ -859,6 +826,18 @@ Server::UserById(BString id, int64 instance)
 }
 
 
+User*
+Server::DoForEachUser(user_visitor func, void* cookie) const
+{
+	for (uint32 i = 0; i < fLoopers.CountItems(); i++) {
+		User* user = fLoopers.ValueAt(i)->DoForEachUser(func, cookie);
+		if (user != NULL)
+			return user;
+	}
+	return NULL;
+}
+
+
 void
 Server::AddUser(User* user, int64 instance)
 {
@@ -934,6 +913,22 @@ Server::UserPopUpItems()
 }
 
 
+void
+Server::_ApplyChanges(BMessage* changes)
+{
+	// In the order the shard made them, each as if it had been sent to the
+	// window on its own
+	BMessage change;
+	for (int32 i = 0; changes->FindMessage("change", i, &change) == B_OK;
+			i++) {
+		BHandler* target = Looper();
+		if (Filter(&change, &target) == B_DISPATCH_MESSAGE)
+			Looper()->MessageReceived(&change);
+	}
+	changes->SendReply(APP_CHANGES_APPLIED);
+}
+
+
 ProtocolLooper*
 Server::_LooperFromMessage(BMessage* message)
 {
@@ -973,6 +968,34 @@ Server::_EnsureContact(BMessage* message)
 }
 
 
+int32
+Server::_AddRoster(BMessage* message)
+{
+	ProtocolLooper* looper = _LooperFromMessage(message);
+	type_code type;
+	int32 count = 0;
+	if (looper == NULL
+		|| message->GetInfo("user_id", &type, &count) != B_OK || count == 0)
+		return 0;
+
+	RosterMap added;
+	added.Reserve(count);
+
+	const char* id = NULL;
+	for (int32 i = 0; message->FindString("user_id", i, &id) == B_OK; i++) {
+		if (id[0] == '\0' || added.IndexOf(id) >= 0
+			|| looper->ContactById(id) != NULL)
+			continue;
+
+		Contact* contact = new Contact(id, Looper());
+		contact->SetProtocolLooper(looper);
+		added.AddItem(contact->GetId(), contact);
+	}
+	looper->AddContacts(added);
+	return added.CountItems();
+}
+
+
 User*
 Server::_EnsureUser(BMessage* message)
 {
@@ -981,6 +1004,16 @@ Server::_EnsureUser(BMessage* message)
 }
 
 
+User*
+Server::_EnsureUser(const ImEvent& event)
+{
+	ProtocolLooper* looper = GetProtocolLooper(event.Instance());
+	if (looper == NULL)
+		return NULL;
+	return _EnsureUser(event.UserId().String(), looper);
+}
+
+
 User*
 Server::_EnsureUser(BString id, ProtocolLooper* protoLooper)
 {
@@ -999,33 +1032,33 @@ Server::_EnsureUser(BString id, ProtocolLooper* protoLooper)
 Conversation*
 Server::_EnsureConversation(BMessage* message)
 {
-	ProtocolLooper* looper;
-	if (!message || (looper = _LooperFromMessage(message)) == NULL)
+	if (!message)
+		return NULL;
+	return _EnsureConversation(message->GetString("chat_id", ""),
+		_LooperFromMessage(message), message->GetInt32("room_flags", 0));
+}
+
+
+Conversation*
+Server::_EnsureConversation(BString chat_id, ProtocolLooper* looper,
+	int32 flags)
+{
+	if (looper == NULL)
 		return NULL;
 
-	BString chat_id = message->GetString("chat_id", "");
 	Conversation* item = NULL;
 
 	if (chat_id.IsEmpty() == false) {
 		item = looper->ConversationById(chat_id);
 
 		if (item == NULL) {
+			// Its flags and metadata are read and asked for by the shard
 			item = new Conversation(chat_id, Looper());
 			item->SetProtocolLooper(looper);
+			item->SetCachedFlags(flags);
 			if (looper->GetOwnContact() != NULL)
 				item->AddUser(looper->GetOwnContact());
 			looper->AddConversation(item);
-
-			BMessage meta(IM_MESSAGE);
-			meta.AddInt32("im_what", IM_GET_ROOM_METADATA);
-			meta.AddString("chat_id", chat_id);
-
-			BMessage users(IM_MESSAGE);
-			users.AddInt32("im_what", IM_GET_ROOM_PARTICIPANTS);
-			users.AddString("chat_id", chat_id);
-
-			looper->MessageReceived(&meta);
-			looper->MessageReceived(&users);
 		}
 	}
 	return item;
@@ -16,6 +16,7 @@
 #include "ChatCommand.h"
 #include "Contact.h"
 #include "Conversation.h"
+#include "ImEvent.h"
 #include "Notifier.h"
 #include "ProtocolLooper.h"
 #include "User.h"
@@ -23,6 +24,7 @@
 class ChatProtocol;
 class RosterItem;
 class ProtocolLooper;
+class ServerShard;
 
 
 typedef KeyMap<bigtime_t, ProtocolLooper*> ProtocolLoopers;
@@ -30,6 +32,12 @@ typedef KeyMap<BString, bigtime_t> AccountInstances;
 typedef KeyMap<BString, bool> BoolMap;
 
 
+// Applies the protocols' changes to the model (conversations, users and
+// contacts) as a filter on the main window, which owns their views and list
+// items. The protocols' messages are handled by a ServerShard per account,
+// on its own looper, which does the disk and notification work and leaves
+// only ordered APP_CHANGE_SETs for the window; see _ApplyChanges(). What
+// the UI asks of the protocols still goes through here on its way to them.
 class Server: public BMessageFilter, public Notifier {
 public:
 							Server();
@@ -42,7 +50,7 @@ public:
 			void			ImError(BMessage* msg);
 
 			void			AddProtocolLooper(bigtime_t instanceId,
-								ChatProtocol* cayap);
+								ChatProtocol* cayap, ServerShard* shard);
 			void			RemoveProtocolLooper(bigtime_t instanceId);
 			ProtocolLooper*	GetProtocolLooper(bigtime_t instanceId);
 
@@ -58,6 +66,7 @@ public:
 
 			UserMap			Users() const;
 			User*			UserById(BString id, int64 instance);
+			User*			DoForEachUser(user_visitor func, void* cookie) const;
 			void			AddUser(User* user, int64 instance);
 
 			ChatMap			Conversations() const;
@@ -70,13 +79,19 @@ public:
 			BObjectList<BMessage> UserPopUpItems();
 
 private:
+			void			_ApplyChanges(BMessage* changes);
+
 			ProtocolLooper*	_LooperFromMessage(BMessage* message);
 
 			Contact*		_EnsureContact(BMessage* message);
+			int32			_AddRoster(BMessage* message);
 			User*			_EnsureUser(BMessage* message);
 			User*			_EnsureUser(BString id, ProtocolLooper* protoLooper);
+			User*			_EnsureUser(const ImEvent& event);
 			Contact*		_GetOwnContact(BMessage* message);
 			Conversation*	_EnsureConversation(BMessage* message);
+			Conversation*	_EnsureConversation(BString chat_id,
+								ProtocolLooper* looper, int32 flags = 0);
 
 			void			_ProtocolNotification(ProtocolLooper* looper,
 								BString title, BString desc,
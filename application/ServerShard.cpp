@@ -0,0 +1,678 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ServerShard.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <Catalog.h>
+#include <Debug.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <MessageQueue.h>
+#include <MessageRunner.h>
+
+#include <libchatlog/ChatLog.h>
+
+#include "AppMessages.h"
+#include "AppPreferences.h"
+#include "ChatOMatic.h"
+#include "ChatProtocolMessages.h"
+#include "Flags.h"
+#include "ImEvent.h"
+#include "ProtocolLooper.h"
+#include "ServerWorker.h"
+#include "Utils.h"
+
+
+// Its notifications were the Server's, and are translated as such
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "Server"
+
+
+const uint32 kLogMessage = 'SSlm';
+const uint32 kCacheRoomFlags = 'SScf';
+const uint32 kRetryChanges = 'SSrc';
+
+// Most changes in one change-set, the rest wait for the next
+const int32 kMaxChanges = 64;
+// How soon a change-set is sent again when the window's port was full
+const bigtime_t kRetryDelay = 10000;
+
+// Status changes are held back this long and then delivered at once; a few
+// frames, enough to swallow the bursts seen on login and netsplits.
+const bigtime_t kStatusFlushDelay = 50000;
+
+
+ServerShard::ServerShard(int64 instance, BMessenger target)
+	:
+	BLooper("Server shard"),
+	fInstance(instance),
+	fTarget(target),
+	fLooper(NULL),
+	fOwnStatus(STATUS_ONLINE),
+	fDateFormatter(),
+	fStatusFlushQueued(false),
+	fInFlight(false),
+	fRetryQueued(false)
+{
+	memset(&fStats, 0, sizeof(shard_stats));
+}
+
+
+ServerShard::~ServerShard()
+{
+	for (uint32 i = 0; i < fUsers.CountItems(); i++)
+		delete fUsers.ValueAt(i);
+	for (uint32 i = 0; i < fChats.CountItems(); i++)
+		delete fChats.ValueAt(i);
+	for (uint32 i = 0; i < fPendingStatus.CountItems(); i++)
+		delete fPendingStatus.ValueAt(i);
+	for (BMessage* set : fChangeSets)
+		delete set;
+}
+
+
+void
+ServerShard::MessageReceived(BMessage* msg)
+{
+	switch (msg->what) {
+		case IM_MESSAGE:
+			fStats.received++;
+			_ImMessage(msg);
+			break;
+		case kLogMessage:
+		{
+			BMessage message;
+			shard_chat* chat = _EnsureChat(msg->GetString("chat_id", ""));
+			if (chat != NULL && msg->FindMessage("message", &message) == B_OK)
+				_Log(chat, &message);
+			break;
+		}
+		case kCacheRoomFlags:
+		{
+			shard_chat* chat = _EnsureChat(msg->GetString("chat_id", ""));
+			if (chat == NULL)
+				break;
+			chat->flags = msg->GetInt32("flags", chat->flags);
+			_CacheRoomFlags(chat);
+			break;
+		}
+		case APP_FLUSH_STATUS:
+			_FlushStatus();
+			break;
+		case APP_CHANGES_APPLIED:
+			fInFlight = false;
+			break;
+		case kRetryChanges:
+			fRetryQueued = false;
+			break;
+		default:
+			// Errors and the like, for the window in order with the rest
+			fStats.received++;
+			_AddChange(DetachCurrentMessage());
+			break;
+	}
+	_FlushIfIdle();
+}
+
+
+bool
+ServerShard::QuitRequested()
+{
+	// What the window's no room for is dropped, it's quitting too
+	_FlushStatus();
+	while (fChangeSets.IsEmpty() == false)
+		if (_FlushChanges() != B_OK)
+			break;
+
+	PRINT(("%s: %" B_PRIu32 " messages, %" B_PRIu32 " changes in %" B_PRIu32
+		" change-sets; %" B_PRIu32 " status updates, %" B_PRIu32 " merged\n",
+		fAccountName.String(), fStats.received, fStats.changes,
+		fStats.changeSets, fStats.statuses, fStats.statusesMerged));
+	return true;
+}
+
+
+void
+ServerShard::SetProtocolLooper(ProtocolLooper* looper)
+{
+	fLooper = looper;
+	if (looper == NULL)
+		return;
+
+	fAccountName = looper->Protocol()->GetName();
+	BString name("Server shard - ");
+	name << fAccountName;
+	SetName(name.String());
+}
+
+
+void
+ServerShard::LogMessage(const char* chatId, BMessage* msg)
+{
+	BMessage log(kLogMessage);
+	log.AddString("chat_id", chatId);
+	log.AddMessage("message", msg);
+	PostMessage(&log);
+}
+
+
+void
+ServerShard::CacheRoomFlags(const char* chatId, int32 flags)
+{
+	BMessage cache(kCacheRoomFlags);
+	cache.AddString("chat_id", chatId);
+	cache.AddInt32("flags", flags);
+	PostMessage(&cache);
+}
+
+
+void
+ServerShard::_ImMessage(BMessage* msg)
+{
+	ImEvent event(msg);
+	int32 im_what = event.What();
+	const char* chatId = msg->GetString("chat_id", "");
+
+	// Those the Server makes a conversation for, if there's none yet
+	shard_chat* chat = NULL;
+	switch (im_what) {
+		case IM_MESSAGE_RECEIVED:
+		case IM_MESSAGE_SENT:
+		case IM_CHAT_CREATED:
+		case IM_ROOM_JOINED:
+		case IM_ROOM_CREATED:
+		case IM_ROOM_METADATA:
+		case IM_ROOM_PARTICIPANTS:
+		case IM_ROOM_NAME_SET:
+		case IM_ROOM_SUBJECT_SET:
+		case IM_ROOM_ROLECHANGED:
+		case IM_ROOM_PARTICIPANT_JOINED:
+		case IM_ROOM_PARTICIPANT_LEFT:
+		case IM_ROOM_PARTICIPANT_BANNED:
+		case IM_ROOM_PARTICIPANT_KICKED:
+			chat = _EnsureChat(chatId);
+			break;
+		default:
+			chat = fChats.ValueFor(chatId);
+	}
+
+	switch (im_what) {
+		case IM_ROSTER:
+			if (_AddRoster(msg) == false)
+				return;
+			break;
+		case IM_ROSTER_CONTACT_REMOVED:
+		{
+			shard_user* user = fUsers.ValueFor(msg->GetString("user_id", ""));
+			if (user != NULL)
+				user->contact = false;
+			break;
+		}
+		case IM_OWN_STATUS_SET:
+		{
+			int32 status;
+			if (msg->FindInt32("status", &status) != B_OK)
+				return;
+
+			// Only once the window's been told who the account is
+			if (fOwnId.IsEmpty() == false
+				&& AppPreferences::Get()->NotifyProtocolStatus == true) {
+				if (fOwnStatus == STATUS_OFFLINE && status == STATUS_ONLINE)
+					_ProtocolNotification(B_TRANSLATE("Connected"),
+						B_TRANSLATE("%user% has connected!"));
+				else if (fOwnStatus == STATUS_ONLINE
+					&& status == STATUS_OFFLINE)
+					_ProtocolNotification(B_TRANSLATE("Disconnected"),
+						B_TRANSLATE("%user% is now offline!"));
+			}
+			if (fOwnId.IsEmpty() == false)
+				fOwnStatus = (UserStatus)status;
+			break;
+		}
+		case IM_OWN_CONTACT_INFO:
+		{
+			const char* id = msg->GetString("user_id", "");
+			if (id[0] == '\0')
+				return;
+			fOwnId = id;
+			const char* name = NULL;
+			if (msg->FindString("user_name", &name) == B_OK)
+				_EnsureUser(id)->name = name;
+			break;
+		}
+		case IM_USER_NICKNAME_SET:
+		{
+			if (msg->HasString("user_name") == false)
+				return;
+			shard_user* user = _EnsureUser(event.UserId().String());
+			if (user != NULL)
+				user->name = event.UserName();
+			break;
+		}
+		case IM_USER_STATUS_SET:
+			if (event.HasStatus() == false)
+				return;
+			// Held back until the next flush, so that a burst of them
+			// reaches the users' observers once
+			_QueueStatus(msg, event);
+			return;
+		case IM_CONTACT_INFO:
+			if (_ContactInfo(msg) == false)
+				return;
+			break;
+		case IM_MESSAGE_RECEIVED:
+		case IM_MESSAGE_SENT:
+			if (chat != NULL)
+				_Log(chat, msg);
+			break;
+		case IM_ROOM_METADATA:
+			if (chat != NULL)
+				_RoomMetadata(chat, msg);
+			break;
+		case IM_ROOM_PARTICIPANTS:
+		{
+			const char* id = NULL;
+			const char* name = NULL;
+			for (int32 i = 0; msg->FindString("user_id", i, &id) == B_OK;
+					i++) {
+				shard_user* user = _EnsureUser(id);
+				if (user != NULL
+					&& msg->FindString("user_name", i, &name) == B_OK
+					&& name[0] != '\0')
+					user->name = name;
+			}
+			break;
+		}
+		case IM_ROOM_PARTICIPANT_JOINED:
+		{
+			shard_user* user = _EnsureUser(event.UserId().String());
+			if (user != NULL && event.UserName().IsEmpty() == false)
+				user->name = event.UserName();
+			break;
+		}
+		case IM_ROOM_LEFT:
+			delete fChats.RemoveItemFor(Atom(chatId));
+			chat = NULL;
+			break;
+		case IM_ROOM_PARTICIPANT_STARTED_TYPING:
+		case IM_ROOM_PARTICIPANT_STOPPED_TYPING:
+			return;
+		case IM_PROGRESS:
+		{
+			const char* title = NULL;
+			const char* message = NULL;
+			float progress = 0.0f;
+
+			if (fLooper == NULL
+				|| AppPreferences::Get()->NotifyProtocolStatus == false
+				|| msg->FindString("title", &title) != B_OK
+				|| msg->FindString("message", &message) != B_OK
+				|| msg->FindFloat("progress", &progress) != B_OK)
+				return;
+
+			BNotification notification(B_PROGRESS_NOTIFICATION);
+			notification.SetGroup(BString(APP_NAME));
+			notification.SetTitle(title);
+			notification.SetIcon(fLooper->Protocol()->Icon());
+			notification.SetContent(message);
+			notification.SetProgress(progress);
+			notification.Send();
+			return;
+		}
+		case IM_NOTIFICATION:
+			_ProtocolNotification(msg->FindString("title"),
+				msg->FindString("message"),
+				(notification_type)msg->GetInt32("type",
+					B_INFORMATION_NOTIFICATION));
+			return;
+		case IM_PROTOCOL_READY:
+			if (AppPreferences::Get()->NotifyProtocolStatus == true)
+				_ProtocolNotification(B_TRANSLATE("Connected"),
+					B_TRANSLATE("%user% has connected!"));
+			_JoinCachedRooms();
+			break;
+		default:
+			break;
+	}
+
+	// The conversation's made with them, if it's not there
+	if (chat != NULL)
+		msg->AddInt32("room_flags", chat->flags);
+	_AddChange(DetachCurrentMessage());
+}
+
+
+bool
+ServerShard::_AddRoster(BMessage* msg)
+{
+	// Only passed on if there's someone new in it
+	bool added = false;
+	const char* id = NULL;
+	for (int32 i = 0; msg->FindString("user_id", i, &id) == B_OK; i++) {
+		shard_user* user = _EnsureUser(id);
+		if (user == NULL || user->contact == true)
+			continue;
+		user->contact = true;
+		added = true;
+	}
+	return added;
+}
+
+
+bool
+ServerShard::_ContactInfo(BMessage* msg)
+{
+	shard_user* user = _EnsureUser(msg->GetString("user_id", ""));
+	if (user == NULL)
+		return false;
+
+	// Nothing to show if it's only what's known already
+	bool changed = msg->HasInt32("status");
+	BString name;
+	if (msg->FindString("user_name", &name) == B_OK
+		&& name.IsEmpty() == false && name != user->name) {
+		user->name = name;
+		changed = true;
+	}
+	BString status;
+	if (msg->FindString("message", &status) == B_OK
+		&& status != user->personalStatus) {
+		user->personalStatus = status;
+		changed = true;
+	}
+	return changed;
+}
+
+
+void
+ServerShard::_RoomMetadata(shard_chat* chat, BMessage* msg)
+{
+	int32 defaultFlags;
+	if (chat->flags == 0
+		&& msg->FindInt32("room_default_flags", &defaultFlags) == B_OK)
+		chat->flags = defaultFlags;
+	_CacheRoomFlags(chat);
+}
+
+
+void
+ServerShard::_JoinCachedRooms()
+{
+	if (fLooper == NULL)
+		return;
+
+	BEntry entry;
+	char fileName[B_FILE_NAME_LENGTH] = {'\0'};
+	BDirectory dir(RoomsCachePath(fAccountName.String()));
+
+	while (dir.GetNextEntry(&entry, true) == B_OK)
+		if (entry.GetName(fileName) == B_OK) {
+			int32 flags;
+			BFile file(&entry, B_READ_ONLY);
+			if (file.InitCheck() != B_OK)
+				continue;
+
+			if (file.ReadAttr("Chat:flags", B_INT32_TYPE, 0, &flags,
+					sizeof(int32)) < 0)
+				continue;
+
+			if (!(flags & ROOM_AUTOJOIN) && !(flags & ROOM_AUTOCREATE))
+				continue;
+
+			BMessage join(IM_MESSAGE);
+			int32 im_what = IM_JOIN_ROOM;
+			if (flags & ROOM_AUTOCREATE) {
+				im_what = IM_CREATE_CHAT;
+				join.AddString("user_id", fileName);
+			}
+			join.AddInt32("im_what", im_what);
+			join.AddString("chat_id", fileName);
+			fLooper->PostMessage(&join);
+		}
+}
+
+
+ServerShard::shard_user*
+ServerShard::_EnsureUser(const char* id)
+{
+	if (id == NULL || id[0] == '\0')
+		return NULL;
+
+	shard_user* user = fUsers.ValueFor(id);
+	if (user == NULL) {
+		user = new shard_user;
+		user->contact = false;
+		fUsers.AddItem(Atom(id), user);
+	}
+	return user;
+}
+
+
+ServerShard::shard_chat*
+ServerShard::_EnsureChat(const char* id)
+{
+	if (id == NULL || id[0] == '\0' || fLooper == NULL)
+		return NULL;
+
+	shard_chat* chat = fChats.ValueFor(id);
+	if (chat != NULL)
+		return chat;
+
+	chat = new shard_chat;
+	chat->flags = 0;
+	chat->logPath = RoomLogPath(fAccountName.String(), id);
+	chat->cachePath = RoomCachePath(fAccountName.String(), id);
+	BFile cacheFile(chat->cachePath.String(), B_READ_ONLY);
+	if (cacheFile.InitCheck() == B_OK)
+		cacheFile.ReadAttr("Chat:flags", B_INT32_TYPE, 0, &chat->flags,
+			sizeof(int32));
+	fChats.AddItem(Atom(id), chat);
+
+	BMessage meta(IM_MESSAGE);
+	meta.AddInt32("im_what", IM_GET_ROOM_METADATA);
+	meta.AddString("chat_id", id);
+
+	BMessage users(IM_MESSAGE);
+	users.AddInt32("im_what", IM_GET_ROOM_PARTICIPANTS);
+	users.AddString("chat_id", id);
+
+	fLooper->PostRequest(&meta);
+	fLooper->PostRequest(&users);
+	return chat;
+}
+
+
+void
+ServerShard::_CacheRoomFlags(shard_chat* chat)
+{
+	BFile cacheFile(chat->cachePath.String(), B_READ_WRITE | B_CREATE_FILE);
+	if (cacheFile.InitCheck() != B_OK)
+		return;
+	cacheFile.WriteAttr("Chat:flags", B_INT32_TYPE, 0, &chat->flags,
+		sizeof(int32));
+}
+
+
+void
+ServerShard::_Log(shard_chat* chat, BMessage* msg)
+{
+	msg->AddInt64("when", time(NULL));
+
+	uint32 flags = 0;
+	if (msg->GetInt32("im_what", 0) == IM_MESSAGE_SENT)
+		flags |= LOG_OWN_MESSAGE;
+
+	// Plain-text logs
+	// Gotta make sure the formatting's pretty!
+	BString date;
+	fDateFormatter.Format(date, time(0), B_SHORT_DATE_FORMAT, B_MEDIUM_TIME_FORMAT);
+	BString id = msg->FindString("user_id");
+	BString name = msg->FindString("user_name");
+	BString body = msg->FindString("body");
+	if (body.StartsWith("/me ") == true)
+		flags |= LOG_ACTION;
+
+	BString logLine;
+	if (id.IsEmpty() == false || name.IsEmpty() == false) {
+		if (name.IsEmpty() == true) {
+			shard_user* user = fUsers.ValueFor(id.String());
+			name = (user != NULL && user->name.IsEmpty() == false)
+				? user->name : id;
+		}
+		logLine << "[" << date << "] <" << name << "> " << body << "\n";
+	}
+
+	ServerWorker::Get()->LogMessage(
+		chat->logPath.IsEmpty() == true ? NULL : chat->logPath.String(),
+		chat->cachePath.String(), msg, flags, logLine);
+
+	// Only for the view, the log has its own copy
+	msg->AddBool("logged", true);
+}
+
+
+void
+ServerShard::_ProtocolNotification(BString title, BString desc,
+	notification_type type)
+{
+	if (fLooper == NULL || title.IsEmpty() == true)
+		return;
+	title.ReplaceAll("%user%", fAccountName);
+	desc.ReplaceAll("%user%", fAccountName);
+
+	BNotification notification(type);
+	notification.SetGroup(BString(APP_NAME));
+	notification.SetTitle(title);
+	if (desc.IsEmpty() == false)
+		notification.SetContent(desc);
+	notification.SetMessageID(fAccountName);
+	notification.SetIcon(fLooper->Protocol()->Icon());
+	notification.Send();
+}
+
+
+void
+ServerShard::_QueueStatus(BMessage* msg, const ImEvent& event)
+{
+	fStats.statuses++;
+
+	BMessage* pending = fPendingStatus.ValueFor(event.UserId());
+	if (pending != NULL) {
+		// Only the latest status counts, but keep an earlier personal
+		// message if the latest change didn't bring one.
+		BString statusMsg;
+		bool hadMsg = pending->FindString("message", &statusMsg) == B_OK;
+		*pending = *msg;
+		if (hadMsg == true && event.HasStatusMessage() == false)
+			pending->AddString("message", statusMsg);
+		fStats.statusesMerged++;
+	}
+	else
+		fPendingStatus.AddItem(event.UserId(), new BMessage(*msg));
+
+	if (fStatusFlushQueued == false) {
+		BMessage flush(APP_FLUSH_STATUS);
+		fStatusFlushQueued = BMessageRunner::StartSending(BMessenger(this),
+			&flush, kStatusFlushDelay, 1) == B_OK;
+		if (fStatusFlushQueued == false)
+			_FlushStatus();
+	}
+}
+
+
+void
+ServerShard::_FlushStatus()
+{
+	fStatusFlushQueued = false;
+	if (fPendingStatus.CountItems() == 0)
+		return;
+
+	// All of them in one change, so the roster's updated only once
+	BMessage* batch = new BMessage(IM_MESSAGE);
+	batch->AddInt32("im_what", IM_USER_STATUS_SET);
+	for (uint32 i = 0; i < fPendingStatus.CountItems(); i++) {
+		BMessage* msg = fPendingStatus.ValueAt(i);
+		BString statusMsg;
+		bool hasMsg = msg->FindString("message", &statusMsg) == B_OK;
+
+		batch->AddString("user_id", msg->GetString("user_id", ""));
+		batch->AddInt64("instance", fInstance);
+		batch->AddInt32("status", msg->GetInt32("status", STATUS_OFFLINE));
+		batch->AddBool("has_message", hasMsg);
+		batch->AddString("message", statusMsg);
+		delete msg;
+	}
+	fPendingStatus.MakeEmpty();
+	_AddChange(batch);
+}
+
+
+void
+ServerShard::_AddChange(BMessage* change)
+{
+	if (change == NULL)
+		return;
+
+	type_code type;
+	int32 count = 0;
+	BMessage* set = fChangeSets.IsEmpty() == true ? NULL
+		: fChangeSets.ItemAt(fChangeSets.CountItems() - 1);
+	if (set != NULL)
+		set->GetInfo("change", &type, &count);
+	if (set == NULL || count >= kMaxChanges) {
+		set = new BMessage(APP_CHANGE_SET);
+		set->AddInt64("instance", fInstance);
+		fChangeSets.AddItem(set);
+	}
+
+	set->AddMessage("change", change);
+	delete change;
+	fStats.changes++;
+}
+
+
+void
+ServerShard::_FlushIfIdle()
+{
+	if (fInFlight == true || fChangeSets.IsEmpty() == true)
+		return;
+
+	// Once caught up with the protocol, or with a full set to send
+	if (MessageQueue()->IsEmpty() == false && fChangeSets.CountItems() < 2)
+		return;
+
+	status_t ret = _FlushChanges();
+	if ((ret == B_WOULD_BLOCK || ret == B_TIMED_OUT) && fRetryQueued == false) {
+		BMessage retry(kRetryChanges);
+		fRetryQueued = BMessageRunner::StartSending(BMessenger(this),
+			&retry, kRetryDelay, 1) == B_OK;
+	}
+}
+
+
+status_t
+ServerShard::_FlushChanges()
+{
+	BMessage* set = fChangeSets.ItemAt(0);
+
+	// Never waits for room in the window's port, as the window may be
+	// waiting for this looper; the set's kept to be sent again instead.
+	// The window replies once it's applied it.
+	status_t ret = fTarget.SendMessage(set, this, 0);
+	if (ret == B_WOULD_BLOCK || ret == B_TIMED_OUT)
+		return ret;
+
+	fChangeSets.RemoveItemAt(0);
+	delete set;
+	if (ret == B_OK) {
+		fInFlight = true;
+		fStats.changeSets++;
+	}
+	return ret;
+}
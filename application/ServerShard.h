@@ -0,0 +1,123 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _SERVER_SHARD_H
+#define _SERVER_SHARD_H
+
+#include <DateTimeFormat.h>
+#include <Looper.h>
+#include <Messenger.h>
+#include <Notification.h>
+#include <String.h>
+
+#include <libsupport/Atom.h>
+#include <libsupport/KeyMap.h>
+#include <libsupport/List.h>
+
+#include "UserStatus.h"
+
+class ImEvent;
+class ProtocolLooper;
+
+
+// How much of an account's traffic is left for the window
+struct shard_stats {
+	uint32	received;		// Messages sent by the protocol
+	uint32	changes;		// … passed on to the window
+	uint32	changeSets;		// … in this many APP_CHANGE_SETs
+	uint32	statuses;		// Status changes sent by the protocol
+	uint32	statusesMerged;	// … replaced by a later one of the same user
+};
+
+
+// The Server's model of one account instance, on a looper of its own: the
+// account's protocol sends everything here rather than to the main window.
+// It keeps what it needs of the account's users and rooms (names, which
+// are contacts, room flags), and does the work that needn't be on the
+// window's thread: room caches are read and written, messages logged and
+// notifications sent here, redundant updates are dropped and bursts of
+// status changes coalesced.
+// What's left is posted to the window as APP_CHANGE_SETs, each an ordered
+// list of "change" messages that the Server applies to the conversations,
+// users and contacts; those stay the window's, as they're tied to its
+// views. Only one change-set is in flight at a time, and each holds
+// kMaxChanges at most: while the window's busy, changes pile up here
+// instead of in its port, and applying one never holds up input for long.
+class ServerShard : public BLooper {
+public:
+							ServerShard(int64 instance, BMessenger target);
+							~ServerShard();
+
+	virtual	void			MessageReceived(BMessage* msg);
+	// Posts whatever changes are left, then quits
+	virtual	bool			QuitRequested();
+
+	// Set before it's run, and unset (locked) before the looper's quit
+			void			SetProtocolLooper(ProtocolLooper* looper);
+
+	// Append a message shown in the room (but not sent by the protocol) to
+	// its logs, as those that are have been
+			void			LogMessage(const char* chatId, BMessage* msg);
+	// Write the room's flags to its cache file
+			void			CacheRoomFlags(const char* chatId, int32 flags);
+
+private:
+	struct shard_user {
+		BString		name;
+		BString		personalStatus;
+		bool		contact;
+	};
+
+	struct shard_chat {
+		int32		flags;
+		BString		logPath;
+		BString		cachePath;
+	};
+
+			void			_ImMessage(BMessage* msg);
+			bool			_AddRoster(BMessage* msg);
+			bool			_ContactInfo(BMessage* msg);
+			void			_RoomMetadata(shard_chat* chat, BMessage* msg);
+			void			_JoinCachedRooms();
+
+			shard_user*		_EnsureUser(const char* id);
+			shard_chat*		_EnsureChat(const char* id);
+			void			_CacheRoomFlags(shard_chat* chat);
+			void			_Log(shard_chat* chat, BMessage* msg);
+
+			void			_ProtocolNotification(BString title,
+								BString desc,
+								notification_type type
+									= B_INFORMATION_NOTIFICATION);
+
+			void			_QueueStatus(BMessage* msg, const ImEvent& event);
+			void			_FlushStatus();
+
+			void			_AddChange(BMessage* change);
+			void			_FlushIfIdle();
+			status_t		_FlushChanges();
+
+			int64			fInstance;
+			BMessenger		fTarget;
+			ProtocolLooper*	fLooper;
+			BString			fAccountName;
+
+			KeyMap<Atom, shard_user*> fUsers;
+			KeyMap<Atom, shard_chat*> fChats;
+			BString			fOwnId;
+			UserStatus		fOwnStatus;
+			BDateTimeFormat	fDateFormatter;
+
+			KeyMap<Atom, BMessage*> fPendingStatus;
+			bool			fStatusFlushQueued;
+
+			List<BMessage*>	fChangeSets;	// The first is sent next
+			bool			fInFlight;
+			bool			fRetryQueued;
+
+			shard_stats		fStats;
+};
+
+
+#endif // _SERVER_SHARD_H
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ServerWorker.h"
+
+#include <algorithm>
+
+#include <Bitmap.h>
+#include <BitmapStream.h>
+#include <Debug.h>
+#include <File.h>
+#include <Messenger.h>
+#include <Path.h>
+#include <TranslationUtils.h>
+#include <TranslatorRoster.h>
+
+#include <libchatlog/ChatLog.h>
+#include <libchatlog/LogCompactor.h>
+#include <libchatlog/LogIndexer.h>
+#include <libchatlog/LogWriter.h>
+
+#include "AppMessages.h"
+#include "AppPreferences.h"
+#include "ChatProtocolMessages.h"
+#include "Conversation.h"
+#include "ProtocolLooper.h"
+#include "User.h"
+#include "Utils.h"
+
+
+const uint32 kLoadAvatar = 'SWla';
+const uint32 kSetAvatar = 'SWsa';
+const uint32 kReadLogs = 'SWrl';
+const uint32 kReadOlderLogs = 'SWro';
+const uint32 kLogsTrimmed = 'SWlt';
+const uint32 kCloseLogs = 'SWcl';
+
+// How many logged messages are read at once, when a view is created and
+// then as it's scrolled up
+const uint64 kLogsPage = 50;
+
+// How often the logs are checked against their retention
+const bigtime_t kCompactInterval = 60 * 60 * 1000000LL;
+
+
+// A request about a room's logs, with where they're to be posted
+static BMessage
+logs_request(uint32 what, Conversation* chat)
+{
+	BMessage request(what);
+	request.AddString("log_path", chat->LogPath().Path());
+	request.AddString("cache_path", chat->CachePath().Path());
+	request.AddString("chat_id", chat->GetId());
+	if (chat->GetProtocolLooper() != NULL)
+		request.AddInt64("instance",
+			chat->GetProtocolLooper()->GetInstance());
+	request.AddMessenger("target", chat->Messenger());
+	return request;
+}
+
+
+// Rooms last written to before there were ChatLogs kept their last few
+// messages in their cache file's attribute; those older than the ChatLog's
+// first entry are added to logs
+static void
+read_legacy_logs(const char* cachePath, ChatLog* log, BMessage* logs)
+{
+	BFile file(cachePath, B_READ_ONLY);
+	BMessage legacy;
+	if (ReadAttributeMessage(&file, "Chat:logs", &legacy) != B_OK)
+		return;
+
+	log_entry first;
+	bool logged = log->EntryAt(log->FirstEntry(), &first) == B_OK;
+	BMessage message;
+	for (int32 i = 0; legacy.FindMessage("message", i, &message) == B_OK;
+			i++)
+		if (logged == false || message.GetInt64("when", 0) < first.when)
+			logs->AddMessage("message", &message);
+}
+
+
+ServerWorker* ServerWorker::fInstance = NULL;
+
+
+ServerWorker::ServerWorker()
+	:
+	BLooper("Server worker", B_LOW_PRIORITY)
+{
+	AppPreferences* prefs = AppPreferences::Get();
+	log_policy policy;
+	policy.flushInterval = B_INFINITE_TIMEOUT;
+	if (prefs->LogFlushInterval >= 0)
+		policy.flushInterval = (bigtime_t)prefs->LogFlushInterval * 1000;
+	policy.flushRecords = prefs->LogFlushRecords;
+	policy.maxQueued = prefs->LogMaxQueued;
+	policy.sync = prefs->LogSync;
+	policy.rotation = (int64)prefs->LogRotation * 60 * 60;
+	policy.textSize = (off_t)prefs->TextLogMaxSize * 1024;
+	fLogWriter = new LogWriter(policy);
+
+	log_retention retention;
+	retention.maxAge = (int64)prefs->LogMaxAge * 24 * 60 * 60;
+	retention.maxSize = (off_t)prefs->LogMaxSize * 1024 * 1024;
+	retention.keepLast = prefs->LogKeepLast;
+	BPath accounts(CachePath());
+	accounts.Append("Accounts");
+	fLogIndexer = new LogIndexer(accounts.Path(), fLogWriter);
+	fLogCompactor = new LogCompactor(accounts.Path(), retention,
+		kCompactInterval, fLogWriter);
+	fLogCompactor->SetRateLimit((size_t)prefs->LogCompactRate * 1024);
+	fLogCompactor->SetCompression(prefs->LogCompression);
+	fLogCompactor->Compact();
+}
+
+
+ServerWorker::~ServerWorker()
+{
+	log_writer_stats stats = fLogWriter->Stats();
+	PRINT(("Chat logs: %" B_PRIu64 " written in %" B_PRIu32 " flushes, "
+		"%" B_PRIu32 " errors, %" B_PRId64 " us longest flush\n",
+		stats.written, stats.flushes, stats.errors, stats.maxFlush));
+	PRINT(("Chat logs: %" B_PRIu32 " queued at most, logging waited %"
+		B_PRIu32 " times for %" B_PRId64 " us\n", stats.peakQueued,
+		stats.stalls, stats.stallTime));
+	if (stats.compressedBytes > 0)
+		PRINT(("Chat logs: %" B_PRIu64 " bytes compressed to %" B_PRIu64
+			" (%.1f:1)\n", stats.sealedBytes, stats.compressedBytes,
+			(double)stats.sealedBytes / stats.compressedBytes));
+
+	// Stops mid-pass, what's left is done next time
+	log_compactor_progress progress = fLogCompactor->Progress();
+	PRINT(("Chat logs: %" B_PRIu32 " compactions, %" B_PRIu64 " messages "
+		"pruned, %" B_PRIu64 " bytes freed, %" B_PRIu64 " compressed\n",
+		progress.passes, progress.entriesPruned, progress.bytesFreed,
+		progress.bytesRead));
+	delete fLogCompactor;
+
+	// What it hasn't indexed yet is caught up on next time
+	log_indexer_stats indexed = fLogIndexer->Stats();
+	PRINT(("Chat logs: %" B_PRIu64 " messages indexed in %" B_PRIu32
+		" catch-ups, %" B_PRId64 " us, %" B_PRIu32 " errors\n",
+		indexed.indexed, indexed.catchUps, indexed.busyTime,
+		indexed.errors));
+	delete fLogIndexer;
+
+	// Writes whatever's still queued
+	delete fLogWriter;
+
+	for (uint32 i = 0; i < fLogReaders.CountItems(); i++) {
+		delete fLogReaders.ValueAt(i)->log;
+		delete fLogReaders.ValueAt(i);
+	}
+}
+
+
+ServerWorker*
+ServerWorker::Get()
+{
+	if (fInstance == NULL) {
+		fInstance = new ServerWorker();
+		fInstance->Run();
+	}
+	return fInstance;
+}
+
+
+void
+ServerWorker::Release()
+{
+	if (fInstance != NULL && fInstance->Lock()) {
+		fInstance->Quit();
+		fInstance = NULL;
+	}
+}
+
+
+void
+ServerWorker::MessageReceived(BMessage* msg)
+{
+	switch (msg->what) {
+		case kLoadAvatar:
+			_LoadAvatar(msg);
+			break;
+		case kSetAvatar:
+			_SetAvatar(msg);
+			break;
+		case kReadLogs:
+		case kReadOlderLogs:
+			_ReadLogs(msg);
+			break;
+		case kLogsTrimmed:
+			_LogsTrimmed(msg);
+			break;
+		case kCloseLogs:
+			_CloseLogs(msg);
+			break;
+		default:
+			BLooper::MessageReceived(msg);
+	}
+}
+
+
+void
+ServerWorker::LoadAvatar(User* user)
+{
+	if (user == NULL || user->GetProtocolLooper() == NULL)
+		return;
+
+	BMessage load(kLoadAvatar);
+	load.AddString("path", user->CachePath().Path());
+	load.AddString("user_id", user->GetId());
+	load.AddInt64("instance", user->GetProtocolLooper()->GetInstance());
+	load.AddMessenger("target", user->Messenger());
+	PostMessage(&load);
+}
+
+
+void
+ServerWorker::SetAvatar(User* user, const entry_ref& ref)
+{
+	if (user == NULL || user->GetProtocolLooper() == NULL)
+		return;
+
+	BMessage set(kSetAvatar);
+	set.AddRef("ref", &ref);
+	set.AddString("path", user->CachePath().Path());
+	set.AddString("user_id", user->GetId());
+	set.AddInt64("instance", user->GetProtocolLooper()->GetInstance());
+	set.AddMessenger("target", user->Messenger());
+	PostMessage(&set);
+}
+
+
+void
+ServerWorker::LogMessage(const char* logPath, const char* textPath,
+	BMessage* msg, uint32 flags, const BString& line)
+{
+	if (logPath == NULL)
+		return;
+
+	// Queued straight to the writer, the looper's port isn't involved
+	fLogWriter->Log(logPath, textPath, msg, msg->GetInt64("when", 0),
+		msg->FindString("user_id"), flags, line.String());
+}
+
+
+void
+ServerWorker::ReadLogs(Conversation* chat)
+{
+	BMessage read = logs_request(kReadLogs, chat);
+	PostMessage(&read);
+}
+
+
+void
+ServerWorker::ReadOlderLogs(Conversation* chat, int32 depth)
+{
+	BMessage read = logs_request(kReadOlderLogs, chat);
+	read.AddInt32("depth", depth);
+	PostMessage(&read);
+}
+
+
+void
+ServerWorker::LogsTrimmed(Conversation* chat, int64 when, int32 sameTime)
+{
+	BMessage trimmed = logs_request(kLogsTrimmed, chat);
+	trimmed.AddInt64("when", when);
+	trimmed.AddInt32("same_time", sameTime);
+	PostMessage(&trimmed);
+}
+
+
+void
+ServerWorker::CloseLogs(Conversation* chat)
+{
+	BMessage close = logs_request(kCloseLogs, chat);
+	PostMessage(&close);
+}
+
+
+void
+ServerWorker::_LoadAvatar(BMessage* msg)
+{
+	BFile cacheFile(msg->FindString("path"), B_READ_ONLY);
+	if (cacheFile.InitCheck() != B_OK)
+		return;
+
+	BBitmap* bitmap = BTranslationUtils::GetBitmap(&cacheFile);
+	if (bitmap != NULL && bitmap->IsValid() == false) {
+		delete bitmap;
+		bitmap = NULL;
+	}
+	if (bitmap != NULL)
+		_AvatarLoaded(msg, bitmap);
+}
+
+
+void
+ServerWorker::_SetAvatar(BMessage* msg)
+{
+	entry_ref ref;
+	if (msg->FindRef("ref", &ref) != B_OK)
+		return;
+
+	BBitmap* bitmap = BTranslationUtils::GetBitmap(&ref);
+	if (bitmap == NULL)
+		return;
+
+	BFile cacheFile(msg->FindString("path"), B_WRITE_ONLY | B_CREATE_FILE);
+	if (cacheFile.InitCheck() == B_OK) {
+		BBitmapStream stream(bitmap);
+		BTranslatorRoster* roster = BTranslatorRoster::Default();
+
+		int32 format_count;
+		translator_info info;
+		const translation_format* formats = NULL;
+		roster->Identify(&stream, NULL, &info, 0, "image");
+		roster->GetOutputFormats(info.translator, &formats, &format_count);
+
+		roster->Translate(info.translator, &stream, NULL, &cacheFile,
+			formats[0].type);
+
+		BBitmap* detached = NULL;
+		stream.DetachBitmap(&detached);
+	}
+	_AvatarLoaded(msg, bitmap);
+}
+
+
+void
+ServerWorker::_AvatarLoaded(BMessage* request, BBitmap* bitmap)
+{
+	BMessenger target;
+	if (request->FindMessenger("target", &target) != B_OK) {
+		delete bitmap;
+		return;
+	}
+
+	BMessage loaded(APP_AVATAR_LOADED);
+	loaded.AddString("user_id", request->FindString("user_id"));
+	loaded.AddInt64("instance", request->FindInt64("instance"));
+	loaded.AddPointer("bitmap", bitmap);
+	if (target.SendMessage(&loaded) != B_OK)
+		delete bitmap;
+}
+
+
+void
+ServerWorker::_ReadLogs(BMessage* msg)
+{
+	BString path(msg->FindString("log_path"));
+	log_reader* reader = fLogReaders.ValueFor(path);
+	if (reader == NULL) {
+		reader = new log_reader;
+		reader->log = new ChatLog(path.String());
+		reader->first = 0;
+		reader->legacy = false;
+		fLogReaders.AddItem(path, reader);
+	} else if (msg->what == kReadLogs)
+		reader->log->Refresh();
+
+	BMessage logs(APP_LOGS_READ);
+	logs.AddString("chat_id", msg->FindString("chat_id"));
+	logs.AddInt64("instance", msg->GetInt64("instance", -1));
+	logs.AddBool("older", msg->what == kReadOlderLogs);
+	logs.AddInt32("im_what", IM_LOGS_RECEIVED);
+
+	ChatLog* log = reader->log;
+	uint64 count = log->CountEntries();
+	uint64 oldest = log->FirstEntry();
+	int32 depth = msg->GetInt32("depth", -1);
+	if (msg->what == kReadLogs) {
+		reader->first = std::max(count > kLogsPage ? count - kLogsPage : 0,
+			oldest);
+		reader->legacy = false;
+		if (log->InitCheck() == B_OK)
+			log->ReadEntries(reader->first, count - reader->first, &logs);
+	} else {
+		if (depth >= 0 && count > oldest + depth)
+			oldest = count - depth;
+		uint64 first = oldest;
+		if (reader->first > oldest + kLogsPage)
+			first = reader->first - kLogsPage;
+		if (reader->first > oldest && log->InitCheck() == B_OK
+			&& log->ReadEntries(first, reader->first - first, &logs) == B_OK)
+			reader->first = first;
+	}
+
+	// Those from before the ChatLog, once it's been read back to its start.
+	// They're never in the same page as the ChatLog's, which are "logged",
+	// so they're counted if trimmed.
+	bool legacy = false;
+	if (logs.HasMessage("message") == false && reader->legacy == false
+		&& reader->first == 0 && (depth < 0 || count < (uint64)depth)) {
+		reader->legacy = legacy = true;
+		read_legacy_logs(msg->FindString("cache_path"), log, &logs);
+	}
+	logs.AddBool("logged", legacy == false);
+
+	BMessenger target;
+	if (msg->FindMessenger("target", &target) == B_OK)
+		target.SendMessage(&logs);
+}
+
+
+void
+ServerWorker::_LogsTrimmed(BMessage* msg)
+{
+	log_reader* reader = fLogReaders.ValueFor(msg->FindString("log_path"));
+	if (reader == NULL)
+		return;
+
+	// Messages logged since it was opened may have been trimmed too.
+	// Times are by the second, so those trimmed from the same second as
+	// the first one left are counted past, to be read back as the rest.
+	ChatLog* log = reader->log;
+	log->Refresh();
+	uint64 first = std::min(log->IndexOf(msg->GetInt64("when", 0))
+		+ msg->GetInt32("same_time", 0), log->CountEntries());
+	reader->first = std::max(reader->first, first);
+
+	// Those from the cache file are older than any, so they're all gone
+	// if any of the ChatLog's are
+	if (reader->first > 0)
+		reader->legacy = false;
+}
+
+
+void
+ServerWorker::_CloseLogs(BMessage* msg)
+{
+	BString path(msg->FindString("log_path"));
+	log_reader* reader = fLogReaders.RemoveItemFor(path);
+	if (reader == NULL)
+		return;
+
+	log_compression_stats stats = reader->log->CompressionStats();
+	if (stats.decodeTime > 0)
+		PRINT(("%s logs: %" B_PRIu64 " bytes inflated at %.1f MB/s\n",
+			msg->FindString("chat_id"), stats.decodedBytes,
+			(double)stats.decodedBytes / stats.decodeTime));
+	delete reader->log;
+	delete reader;
+}
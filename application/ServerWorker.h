@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _SERVER_WORKER_H
+#define _SERVER_WORKER_H
+
+#include <Looper.h>
+#include <String.h>
+
+#include <libsupport/KeyMap.h>
+
+class ChatLog;
+class Conversation;
+class LogCompactor;
+class LogIndexer;
+class LogWriter;
+class User;
+
+
+// Does the disk and image work of the Server's model (chat logs, avatars)
+// on its own thread, so that it never holds up the main window. Requests
+// are handled in the order they're made; results are posted back to the
+// window as APP_* messages for the Server to apply.
+// Chat logs are handed over to a LogWriter, which batches them per room,
+// indexed behind it by a LogIndexer, and kept to the retention preferences
+// by a LogCompactor. They're read back here too, a page at a time, each
+// posted as APP_LOGS_READ.
+class ServerWorker : public BLooper {
+public:
+	static	ServerWorker*	Get();
+
+	virtual	void			MessageReceived(BMessage* msg);
+
+	// Read the user's cached avatar, if any
+			void			LoadAvatar(User* user);
+
+	// Decode the avatar at ref and cache it for the user
+			void			SetAvatar(User* user, const entry_ref& ref);
+
+	// Append a message to the room's ChatLog at logPath, and line (if any)
+	// to the plain-text log at textPath
+			void			LogMessage(const char* logPath,
+								const char* textPath, BMessage* msg,
+								uint32 flags, const BString& line);
+
+	// Read the last page of the room's logs; if it has none, those of its
+	// cache file from before there were ChatLogs
+			void			ReadLogs(Conversation* chat);
+	// The page before the last one read, or none past depth messages (if
+	// not negative) from the newest
+			void			ReadOlderLogs(Conversation* chat, int32 depth);
+	// The view dropped the messages before when, and sameTime more from
+	// that second, so they're to be read again
+			void			LogsTrimmed(Conversation* chat, int64 when,
+								int32 sameTime);
+			void			CloseLogs(Conversation* chat);
+
+	/* Quits the worker after handling the pending requests, must be
+	 * called when the application quits.
+	 */
+	static	void			Release();
+
+private:
+							ServerWorker();
+							~ServerWorker();
+
+			void			_LoadAvatar(BMessage* msg);
+			void			_SetAvatar(BMessage* msg);
+
+			void			_AvatarLoaded(BMessage* request, BBitmap* bitmap);
+
+			void			_ReadLogs(BMessage* msg);
+			void			_LogsTrimmed(BMessage* msg);
+			void			_CloseLogs(BMessage* msg);
+
+			LogWriter*		fLogWriter;
+			LogCompactor*	fLogCompactor;
+			LogIndexer*		fLogIndexer;
+
+	struct log_reader {
+		ChatLog*	log;
+		uint64		first;		// Oldest entry read
+		bool		legacy;		// Whether the cache file's been read
+	};
+			KeyMap<BString, log_reader*> fLogReaders;
+
+	static	ServerWorker*	fInstance;
+};
+
+
+#endif // _SERVER_WORKER_H
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "TextRunBuilder.h"
+
+#include <algorithm>
+
+#include <Font.h>
+
+
+// Where a span starts or ends, in characters
+struct span_edge {
+	int32	at;
+	int32	span;		// Index in its list
+	bool	isFace;
+	bool	isStart;
+};
+
+
+static void
+add_edges(const TextSpans& spans, bool isFace, List<span_edge>* edges)
+{
+	for (int32 i = 0; i < (int32)spans.CountItems(); i++) {
+		const text_span& span = spans.ItemAt(i);
+		if (span.length <= 0 || span.start < 0)
+			continue;
+		span_edge edge = { span.start, i, isFace, true };
+		edges->AddItem(edge);
+		edge.at = span.start + span.length;
+		edge.isStart = false;
+		edges->AddItem(edge);
+	}
+}
+
+
+TextRunBuilder::TextRunBuilder()
+{
+}
+
+
+void
+TextRunBuilder::Add(const char* text, rgb_color color, uint16 face)
+{
+	if (text == NULL || text[0] == '\0')
+		return;
+	_AddRun(fText.Length(), face, color);
+	fText << text;
+}
+
+
+void
+TextRunBuilder::Add(const char* text, const TextSpans& faces,
+	const TextSpans& colors, rgb_color color)
+{
+	if (text == NULL || text[0] == '\0')
+		return;
+
+	List<span_edge> edges;
+	add_edges(faces, true, &edges);
+	add_edges(colors, false, &edges);
+	std::stable_sort(edges.begin(), edges.end(),
+		[](const span_edge& a, const span_edge& b) { return a.at < b.at; });
+
+	// Faces may overlap, even the same one, so each bit is counted; the
+	// color is that of the latest span still going
+	int32 faceCounts[16] = {};
+	List<int32> openColors;
+
+	int32 base = fText.Length();
+	const char* c = text;
+	int32 character = 0;
+	uint32 i = 0;
+	_AddRun(base, 0, color);
+	while (i < edges.CountItems() && *c != '\0') {
+		int32 at = edges.ItemAt(i).at;
+		while (character < at && *c != '\0') {
+			// Past the character and its continuation bytes
+			c++;
+			while ((*c & 0xc0) == 0x80)
+				c++;
+			character++;
+		}
+
+		for (; i < edges.CountItems() && edges.ItemAt(i).at == at; i++) {
+			const span_edge& edge = edges.ItemAt(i);
+			if (edge.isFace == true) {
+				uint16 face = faces.ItemAt(edge.span).face;
+				for (int32 bit = 0; bit < 16; bit++) {
+					if ((face & (1 << bit)) != 0)
+						faceCounts[bit] += edge.isStart == true ? 1 : -1;
+				}
+			} else if (edge.isStart == true)
+				openColors.AddItem(edge.span);
+			else
+				openColors.RemoveItem(edge.span);
+		}
+
+		uint16 face = 0;
+		for (int32 bit = 0; bit < 16; bit++) {
+			if (faceCounts[bit] > 0)
+				face |= 1 << bit;
+		}
+		rgb_color runColor = color;
+		if (openColors.IsEmpty() == false)
+			runColor = colors.ItemAt(openColors.ItemAt(
+				openColors.CountItems() - 1)).color;
+		if (*c != '\0')
+			_AddRun(base + (c - text), face, runColor);
+	}
+	fText << text;
+}
+
+
+void
+TextRunBuilder::Add(const TextRunBuilder& other)
+{
+	int32 base = fText.Length();
+	for (const run& item : other.fRuns)
+		_AddRun(base + item.offset, item.face, item.color);
+	fText << other.fText;
+}
+
+
+text_run_array*
+TextRunBuilder::RunArray() const
+{
+	text_run_array* array = BTextView::AllocRunArray(fRuns.CountItems());
+	if (array == NULL)
+		return NULL;
+
+	for (int32 i = 0; i < (int32)fRuns.CountItems(); i++) {
+		const run& item = fRuns.ItemAt(i);
+		text_run& textRun = array->runs[i];
+		textRun.offset = item.offset;
+		textRun.font = BFont();
+		if (item.face != 0)
+			textRun.font.SetFace(item.face);
+		textRun.color = item.color;
+	}
+	return array;
+}
+
+
+void
+TextRunBuilder::MakeEmpty()
+{
+	fText.Truncate(0);
+	fRuns.MakeEmpty();
+}
+
+
+void
+TextRunBuilder::_AddRun(int32 offset, uint16 face, rgb_color color)
+{
+	if (fRuns.IsEmpty() == false) {
+		run& last = fRuns.ItemAt(fRuns.CountItems() - 1);
+		if (last.face == face && last.color == color)
+			return;
+		// Nothing of it was added
+		if (last.offset == offset) {
+			fRuns.RemoveItemAt(fRuns.CountItems() - 1);
+			_AddRun(offset, face, color);
+			return;
+		}
+	}
+
+	run item = { offset, face, color };
+	fRuns.AddItem(item);
+}
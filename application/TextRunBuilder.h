@@ -0,0 +1,59 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _TEXT_RUN_BUILDER_H
+#define _TEXT_RUN_BUILDER_H
+
+#include <GraphicsDefs.h>
+#include <String.h>
+#include <TextView.h>
+
+#include <libsupport/List.h>
+
+#include "ImEvent.h"
+
+
+// Gathers styled text and its runs, so that a whole line can be inserted
+// into a text view at once.
+// A body's face and color spans are merged in one sweep over their starts
+// and ends, rather than by checking all of them at each character, so it's
+// O(n + k log k) for n bytes of text and k spans.
+class TextRunBuilder {
+public:
+						TextRunBuilder();
+
+	// Text in one style; a face of 0 is the regular font
+			void		Add(const char* text, rgb_color color,
+							uint16 face = 0);
+	// A message body, styled by its spans (in characters), and in color
+	// wherever a color span isn't
+			void		Add(const char* text, const TextSpans& faces,
+							const TextSpans& colors, rgb_color color);
+	// Another builder's text and runs, after these
+			void		Add(const TextRunBuilder& other);
+
+			const char*	Text() const { return fText.String(); }
+			int32		Length() const { return fText.Length(); }
+			int32		CountRuns() const { return fRuns.CountItems(); }
+
+	// To be freed with BTextView::FreeRunArray()
+			text_run_array* RunArray() const;
+
+			void		MakeEmpty();
+
+private:
+	struct run {
+		int32		offset;
+		uint16		face;
+		rgb_color	color;
+	};
+
+			void		_AddRun(int32 offset, uint16 face, rgb_color color);
+
+			BString		fText;
+			List<run>	fRuns;
+};
+
+
+#endif // _TEXT_RUN_BUILDER_H
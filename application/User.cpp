@@ -11,9 +11,6 @@
 #include "User.h"
 
 #include <Bitmap.h>
-#include <BitmapStream.h>
-#include <TranslationUtils.h>
-#include <TranslatorRoster.h>
 
 #include "ChatProtocolAddOn.h"
 #include "AppResources.h"
@@ -22,6 +19,7 @@
 #include "NotifyMessage.h"
 #include "ProtocolLooper.h"
 #include "ProtocolManager.h"
+#include "ServerWorker.h"
 #include "UserPopUp.h"
 #include "Utils.h"
 
@@ -165,11 +163,7 @@ User::SetProtocolLooper(ProtocolLooper* looper)
 {
 	if (looper != NULL) {
 		fLooper = looper;
-		BBitmap* avatar = _GetCachedAvatar();
-		if (avatar != NULL && avatar->IsValid()) {
-			fAvatarBitmap = avatar;
-			NotifyPointer(PTR_AVATAR_BITMAP, (void*)avatar);
-		}
+		ServerWorker::Get()->LoadAvatar(this);
 	}
 }
 
@@ -189,8 +183,7 @@ User::SetNotifyAvatarBitmap(BBitmap* bitmap)
 {
 	if ((fAvatarBitmap != bitmap) && (bitmap != NULL)) {
 		fAvatarBitmap = bitmap;
-		_SetCachedAvatar(bitmap);
-		NotifyPointer(PTR_AVATAR_BITMAP, (void*)_GetCachedAvatar());
+		NotifyPointer(PTR_AVATAR_BITMAP, (void*)bitmap);
 	}
 }
 
@@ -215,54 +208,27 @@ User::SetNotifyPersonalStatus(BString personalStatus)
 }
 
 
-ChatMap
-User::Conversations()
+const ChatMap&
+User::Conversations() const
 {
 	return fConversations;
 }
 
 
-void
-User::_EnsureCachePath()
-{
-	if (fCachePath.InitCheck() == B_OK)
-		return;
-	fCachePath.SetTo(UserCachePath(fLooper->Protocol()->GetName(),
-									   fID.String()));
-}
-
-
-BBitmap*
-User::_GetCachedAvatar()
+const BPath&
+User::CachePath()
 {
 	_EnsureCachePath();
-
-	// Try loading cached avatar
-	BFile cacheFile(fCachePath.Path(), B_READ_ONLY);
-	BBitmap* bitmap = BTranslationUtils::GetBitmap(&cacheFile);
-	if (bitmap != NULL && bitmap->IsValid() == true)
-		return bitmap;
-	return NULL;
+	return fCachePath;
 }
 
 
 void
-User::_SetCachedAvatar(BBitmap* bitmap)
+User::_EnsureCachePath()
 {
-	_EnsureCachePath();
-	BFile cacheFile(fCachePath.Path(), B_WRITE_ONLY | B_CREATE_FILE);
-	if (cacheFile.InitCheck() != B_OK)
+	if (fCachePath.InitCheck() == B_OK)
 		return;
-
-	BBitmapStream stream(bitmap);
-	BTranslatorRoster* roster = BTranslatorRoster::Default();
-
-	int32 format_count;
-	translator_info info;
-	const translation_format* formats = NULL;
-	roster->Identify(&stream, new BMessage(), &info, 0, "image");
-	roster->GetOutputFormats(info.translator, &formats, &format_count);
-
-	roster->Translate(info.translator, &stream, NULL, &cacheFile,
-		formats[0].type);
+	fCachePath.SetTo(UserCachePath(fLooper->Protocol()->GetName(),
+									   fID.String()));
 }
+
@@ -14,6 +14,7 @@
 #include <Path.h>
 #include <String.h>
 
+#include <libsupport/Atom.h>
 #include <libsupport/KeyMap.h>
 
 #include "Notifier.h"
@@ -26,7 +27,7 @@ class ProtocolLooper;
 class UserPopUp;
 
 
-typedef KeyMap<BString, Conversation*> ChatMap;
+typedef KeyMap<Atom, Conversation*> ChatMap;
 
 
 class User : public Notifier {
@@ -57,20 +58,20 @@ public:
 	BString			GetNotifyPersonalStatus() const;
 
 	void			SetNotifyName(BString name);
+	// The bitmap is expected to be cached already, see ServerWorker
 	void			SetNotifyAvatarBitmap(BBitmap* bitmap);
 	void			SetNotifyStatus(UserStatus status);
 	void			SetNotifyPersonalStatus(BString personalStatus);
 
-	ChatMap			Conversations();
+	const ChatMap&	Conversations() const;
+
+	const BPath&	CachePath();
 
 	rgb_color		fItemColor;
 
 protected:
 	virtual void	_EnsureCachePath();
 
-	BBitmap*		_GetCachedAvatar();
-	void			_SetCachedAvatar(BBitmap* avatar);
-
 	BMessenger		fMessenger;
 	ProtocolLooper*	fLooper;
 
@@ -206,6 +206,21 @@ RoomCachePath(const char* accountName, const char* roomIdentifier)
 }
 
 
+const char*
+RoomLogPath(const char* accountName, const char* roomIdentifier)
+{
+	BPath path(AccountCachePath(accountName));
+	if (path.InitCheck() != B_OK)
+		return NULL;
+
+	path.Append("Logs");
+	if (create_directory(path.Path(), 0755) != B_OK)
+		return NULL;
+	path.Append(roomIdentifier);
+	return path.Path();
+}
+
+
 const char*
 UserCachePath(const char* accountName, const char* userIdentifier)
 {
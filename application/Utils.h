@@ -40,6 +40,7 @@ const char* CachePath();
 const char* AccountCachePath(const char* accountName);
 const char* RoomsCachePath(const char* accountName);
 const char* RoomCachePath(const char* accountName, const char* roomIdentifier);
+const char* RoomLogPath(const char* accountName, const char* roomIdentifier);
 const char* UserCachePath(const char* accountName, const char* userIdentifier);
 const char* ContactCachePath(const char* accountName, const char* userIdentifier);
 
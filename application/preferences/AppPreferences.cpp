@@ -47,6 +47,23 @@ AppPreferences::Load()
 	IgnoreEmoticons = settings.GetBool("IgnoreEmoticons", true);
 	HideOffline = settings.GetBool("HideOffline", false);
 
+	LogFlushInterval = settings.GetInt32("LogFlushInterval", 500);
+	LogFlushRecords = settings.GetInt32("LogFlushRecords", 256);
+	LogMaxQueued = settings.GetInt32("LogMaxQueued", 65536);
+	LogSync = settings.GetBool("LogSync", false);
+	LogCompression = settings.GetBool("LogCompression", false);
+	LogRotation = settings.GetInt32("LogRotation", 24 * 7);
+	LogMaxAge = settings.GetInt32("LogMaxAge", 0);
+	LogMaxSize = settings.GetInt32("LogMaxSize", 0);
+	LogKeepLast = settings.GetInt32("LogKeepLast", 0);
+	LogCompactRate = settings.GetInt32("LogCompactRate", 1024);
+	TextLogMaxSize = settings.GetInt32("TextLogMaxSize", 0);
+	ScrollbackDepth = settings.GetInt32("ScrollbackDepth", -1);
+	ScrollbackLines = settings.GetInt32("ScrollbackLines", 10000);
+	ScrollbackSize = settings.GetInt32("ScrollbackSize", 0);
+	VirtualChatView = settings.GetBool("VirtualChatView", false);
+	VirtualScrollback = settings.GetInt32("VirtualScrollback", 1000000);
+
 	MainWindowListWeight = settings.GetFloat("MainWindowListWeight", 1);
 	MainWindowChatWeight = settings.GetFloat("MainWindowChatWeight", 5);
 
@@ -80,6 +97,23 @@ AppPreferences::Save()
 	settings.AddBool("IgnoreEmoticons", IgnoreEmoticons);
 	settings.AddBool("HideOffline", HideOffline);
 
+	settings.AddInt32("LogFlushInterval", LogFlushInterval);
+	settings.AddInt32("LogFlushRecords", LogFlushRecords);
+	settings.AddInt32("LogMaxQueued", LogMaxQueued);
+	settings.AddBool("LogSync", LogSync);
+	settings.AddBool("LogCompression", LogCompression);
+	settings.AddInt32("LogRotation", LogRotation);
+	settings.AddInt32("LogMaxAge", LogMaxAge);
+	settings.AddInt32("LogMaxSize", LogMaxSize);
+	settings.AddInt32("LogKeepLast", LogKeepLast);
+	settings.AddInt32("LogCompactRate", LogCompactRate);
+	settings.AddInt32("TextLogMaxSize", TextLogMaxSize);
+	settings.AddInt32("ScrollbackDepth", ScrollbackDepth);
+	settings.AddInt32("ScrollbackLines", ScrollbackLines);
+	settings.AddInt32("ScrollbackSize", ScrollbackSize);
+	settings.AddBool("VirtualChatView", VirtualChatView);
+	settings.AddInt32("VirtualScrollback", VirtualScrollback);
+
 	settings.AddFloat("MainWindowListWeight", MainWindowListWeight);
 	settings.AddFloat("MainWindowChatWeight", MainWindowChatWeight);
 
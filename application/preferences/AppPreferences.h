@@ -36,6 +36,23 @@ public:
 			
 			bool	HideOffline;
 
+			int32	LogFlushInterval; // ms, or -1 to only write on quit
+			int32	LogFlushRecords;
+			int32	LogMaxQueued; // Records before logging waits, or 0
+			bool	LogSync;
+			bool	LogCompression; // Of the sealed log segments
+			int32	LogRotation; // Hours a log segment spans, or 0
+			int32	LogMaxAge; // Days, or 0 to keep logs forever
+			int32	LogMaxSize; // MiB per room, or 0
+			int32	LogKeepLast; // Messages per room, or 0
+			int32	LogCompactRate; // KiB/s the compactor rewrites, or 0
+			int32	TextLogMaxSize; // KiB, or 0
+			int32	ScrollbackDepth; // Logged messages, or -1 for all
+			int32	ScrollbackLines; // Shown at once, or 0 for all
+			int32	ScrollbackSize; // KiB shown at once, or 0
+			bool	VirtualChatView; // Only lays out the messages in view
+			int32	VirtualScrollback; // Messages it shows at once, or 0
+
 			float	MainWindowListWeight;
 			float	MainWindowChatWeight;
 
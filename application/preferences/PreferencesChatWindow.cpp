@@ -21,6 +21,7 @@
 
 
 const uint32 kIgnoreEmoticons = 'CBhe';
+const uint32 kVirtualChatView = 'CBvc';
 
 
 PreferencesChatWindow::PreferencesChatWindow()
@@ -30,8 +31,13 @@ PreferencesChatWindow::PreferencesChatWindow()
 	chatBox->SetLabel(B_TRANSLATE("Chat settings"));
 
 	fIgnoreEmoticons = new BCheckBox("IgnoreEmoticons",
-		B_TRANSLATE("Ignore emoticons"), new BMessage(kIgnoreEmoticons));
-	fIgnoreEmoticons->SetEnabled(false); // No emoticon support currently
+		B_TRANSLATE("Ignore emoticons (from the next conversation opened)"),
+		new BMessage(kIgnoreEmoticons));
+
+	fVirtualChatView = new BCheckBox("VirtualChatView",
+		B_TRANSLATE("Only lay out messages in view (for long conversations, "
+			"from the next one opened)"),
+		new BMessage(kVirtualChatView));
 
 	const float spacing = be_control_look->DefaultItemSpacing();
 
@@ -39,6 +45,7 @@ PreferencesChatWindow::PreferencesChatWindow()
 	BLayoutBuilder::Group<>(chatBox, B_VERTICAL)
 		.SetInsets(spacing, spacing * 2, spacing, spacing)
 		.Add(fIgnoreEmoticons)
+		.Add(fVirtualChatView)
 	.End();
 
 	BLayoutBuilder::Group<>(this, B_VERTICAL)
@@ -54,6 +61,10 @@ PreferencesChatWindow::AttachedToWindow()
 {
 	fIgnoreEmoticons->SetTarget(this);
 	fIgnoreEmoticons->SetValue(AppPreferences::Get()->IgnoreEmoticons);
+	fVirtualChatView->SetTarget(this);
+	fVirtualChatView->SetValue(AppPreferences::Get()->VirtualChatView);
+	// Only the virtual chat view draws emoticons
+	fIgnoreEmoticons->SetEnabled(fVirtualChatView->Value() == B_CONTROL_ON);
 }
 
 
@@ -65,6 +76,12 @@ PreferencesChatWindow::MessageReceived(BMessage* message)
 			AppPreferences::Get()->IgnoreEmoticons
 				= fIgnoreEmoticons->Value();
 			break;
+		case kVirtualChatView:
+			AppPreferences::Get()->VirtualChatView
+				= fVirtualChatView->Value();
+			fIgnoreEmoticons->SetEnabled(
+				fVirtualChatView->Value() == B_CONTROL_ON);
+			break;
 		default:
 			BView::MessageReceived(message);
 	}
@@ -19,6 +19,7 @@ public:
 
 private:
 	BCheckBox*		fIgnoreEmoticons;
+	BCheckBox*		fVirtualChatView;
 };
 
 #endif	// _PREFERENCES_BEHAVIOR_H
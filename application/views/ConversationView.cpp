@@ -10,9 +10,14 @@
 
 #include "ConversationView.h"
 
+#include <stdio.h>
+
+#include <algorithm>
+
 #include <Catalog.h>
 #include <LayoutBuilder.h>
 #include <ListView.h>
+#include <MessageRunner.h>
 #include <ScrollView.h>
 #include <SplitView.h>
 #include <StringList.h>
@@ -30,25 +35,45 @@
 #include "ProtocolManager.h"
 #include "RenderView.h"
 #include "SendTextView.h"
+#include "TextRunBuilder.h"
 #include "User.h"
+#include "UserItem.h"
 #include "UserListView.h"
 #include "Utils.h"
+#include "VirtualRenderView.h"
 
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "ConversationView"
 
 
+const uint32 kFlushAppends = 'CVfa';
+
+// Appends are held for a frame, and for up to kFloodInterval while they
+// come in faster than kFloodRate a second
+const bigtime_t kFrameInterval = 16667;
+const bigtime_t kFloodInterval = 250000;
+const int32 kFloodRate = 50;
+
+
 ConversationView::ConversationView(Conversation* chat)
 	:
 	BGroupView("chatView", B_VERTICAL, B_USE_DEFAULT_SPACING),
 	fMessageQueue(),
-	fConversation(chat)
+	fConversation(chat),
+	fAppendFlushQueued(false),
+	fAppendScrollPending(false),
+	fPrepending(false),
+	fAppendWindow(kFrameInterval),
+	fLastAppendFlush(0)
 {
+	fAppendStats.received = 0;
+	fAppendStats.frames = 0;
 	_InitInterface();
 	if (chat != NULL) {
 		SetConversation(chat);
 		fUserList->SetConversation(chat);
+		UpdateUserList(chat->Users());
 	}
 	else
 		_FakeChat();
@@ -58,6 +83,10 @@ ConversationView::ConversationView(Conversation* chat)
 void
 ConversationView::AttachedToWindow()
 {
+	// A flush queued before it was last detached might never come
+	fAppendFlushQueued = false;
+	_FlushAppends();
+
 	while (fMessageQueue.IsEmpty() == false) {
 		BMessage* msg = fMessageQueue.RemoveItemAt(0);
 		MessageReceived(msg);
@@ -74,6 +103,16 @@ ConversationView::AttachedToWindow()
 }
 
 
+void
+ConversationView::DetachedFromWindow()
+{
+	_FlushAppends();
+	if (fAppendStats.received > fAppendStats.frames)
+		_ReportAppends(fAppendWindow);
+	BGroupView::DetachedFromWindow();
+}
+
+
 void
 ConversationView::MessageReceived(BMessage* message)
 {
@@ -99,6 +138,21 @@ ConversationView::MessageReceived(BMessage* message)
 		case kClearText:
 			_AppendOrEnqueueMessage(message);
 			break;
+		case kFlushAppends:
+			fAppendFlushQueued = false;
+			_FlushAppends();
+			break;
+		case kBackfill:
+			// They're prepended once they've been read, see LogsRead()
+			if (fConversation == NULL
+				|| fConversation->GetOlderLogs() != B_OK)
+				fReceiveView->StopBackfill();
+			break;
+		case kTrimmed:
+			if (fConversation != NULL)
+				fConversation->LogsTrimmed(message->GetInt64("when", 0),
+					message->GetInt32("same_time", 0));
+			break;
 		case IM_MESSAGE:
 			ImMessage(message);
 			break;
@@ -111,9 +165,14 @@ ConversationView::MessageReceived(BMessage* message)
 
 
 void
-ConversationView::ImMessage(BMessage* msg)
+ConversationView::ImMessage(BMessage* msg, const ImEvent* event)
 {
-	int32 im_what = msg->FindInt32("im_what");
+	ImEvent parsed;
+	if (event == NULL) {
+		parsed.SetTo(msg);
+		event = &parsed;
+	}
+	int32 im_what = event->What();
 
 	switch (im_what) {
 		case IM_ROOM_LEFT:
@@ -124,16 +183,21 @@ ConversationView::ImMessage(BMessage* msg)
 		}
 		case IM_MESSAGE_RECEIVED:
 		{
-			_AppendOrEnqueueMessage(msg);
-			fReceiveView->ScrollToBottom();
+			_AppendOrEnqueueMessage(msg, event);
+			_ScrollToBottom();
 			break;
 		}
 		case IM_MESSAGE_SENT:
+		{
+			_AppendOrEnqueueMessage(msg, event);
+			_ScrollToBottom();
+			break;
+		}
 		case IM_LOGS_RECEIVED:
 		{
-			_AppendOrEnqueueMessage(msg);
-			if (im_what == IM_MESSAGE_SENT)
-				fReceiveView->ScrollToBottom();
+			BMessage text;
+			for (int32 i = 0; _LogAt(msg, i, &text) == B_OK; i++)
+				_AppendOrEnqueueMessage(&text);
 			break;
 		}
 		case IM_ROOM_JOINED:
@@ -141,45 +205,46 @@ ConversationView::ImMessage(BMessage* msg)
 			BMessage msg;
 			msg.AddString("body", B_TRANSLATE("** You joined the room.\n"));
 			_AppendOrEnqueueMessage(&msg);
-			fReceiveView->ScrollToBottom();
+			_ScrollToBottom();
 		}
 		case IM_ROOM_CREATED:
 		{
 			BMessage msg;
 			msg.AddString("body", B_TRANSLATE("** You created the room.\n"));
 			_AppendOrEnqueueMessage(&msg);
-			fReceiveView->ScrollToBottom();
+			_ScrollToBottom();
 		}
 		case IM_ROOM_PARTICIPANT_JOINED:
 		{
 			_UserMessage(B_TRANSLATE("%user% has joined the room.\n"),
 						 B_TRANSLATE("%user% has joined the room (%body%).\n"),
-						 msg);
+						 *event);
 			break;
 		}
 		case IM_ROOM_PARTICIPANT_LEFT:
 		{
 			_UserMessage(B_TRANSLATE("%user% has left the room.\n"),
 						 B_TRANSLATE("%user% has left the room (%body%).\n"),
-						 msg);
+						 *event);
 			break;
 		}
 		case IM_ROOM_PARTICIPANT_KICKED:
 		{
 			_UserMessage(B_TRANSLATE("%user% was kicked.\n"),
-						 B_TRANSLATE("%user% was kicked (%body%).\n"),msg);
+						 B_TRANSLATE("%user% was kicked (%body%).\n"),
+						 *event);
 			break;
 		}
 		case IM_ROOM_PARTICIPANT_BANNED:
 		{
 			_UserMessage(B_TRANSLATE("%user% has been banned.\n"),
 						 B_TRANSLATE("%user% has been banned (%body%).\n"),
-						 msg);
+						 *event);
 			break;
 		}
 		case IM_ROOM_ROLECHANGED:
 		{
-			BString user_id = msg->FindString("user_id");
+			BString user_id = event->UserId().String();
 
 			if (user_id == fConversation->GetOwnContact()->GetId()) {
 				Role* role = fConversation->GetRole(user_id);
@@ -196,7 +261,7 @@ ConversationView::ImMessage(BMessage* msg)
 		{
 			if (fConversation == NULL)
 				return;
-			fConversation->GetProtocolLooper()->MessageReceived(msg);
+			fConversation->GetProtocolLooper()->PostRequest(msg);
 
 			// Reset to current values; if the change went through, it'll
 			// come back.
@@ -239,28 +304,54 @@ ConversationView::SetConversation(Conversation* chat)
 	fSubjectTextView->SetTarget(this);
 
 	fProtocolView->SetBitmap(chat->ProtocolBitmap());
+	fReceiveView->SetBackfillTarget(this);
 }
 
 
 void
-ConversationView::UpdateUserList(UserMap users)
+ConversationView::UpdateUserList(const UserMap& users)
 {
-	fUserList->MakeEmpty();
-	for (int i = 0; i < users.CountItems(); i++) {
+	for (int32 i = fUserList->CountItems() - 1; i >= 0; i--) {
+		User* user = ((UserItem*)fUserList->ItemAt(i))->GetUser();
+		if (users.ValueFor(user->GetId().String()) != user)
+			fUserList->RemoveUser(user);
+	}
+
+	List<User*> added;
+	for (uint32 i = 0; i < users.CountItems(); i++) {
 		User* user = users.ValueAt(i);
-		if (fUserList->HasUser(user) == false) {
-			fUserList->AddUser(user);
-			fUserList->Sort();
-		}
+		if (fUserList->HasUser(user) == false)
+			added.AddItem(user);
 	}
+	fUserList->AddUsers(added);
+}
+
+
+void
+ConversationView::AddUser(User* user)
+{
+	fUserList->AddUser(user);
+}
+
+
+void
+ConversationView::RemoveUser(User* user)
+{
+	fUserList->RemoveUser(user);
+}
+
+
+void
+ConversationView::UpdateUserRole(User* user)
+{
+	fUserList->UpdateRole(user);
 }
 
 
 void
 ConversationView::InvalidateUserList()
 {
-	for (int i = 0; i < fUserList->CountItems(); i++)
-		fUserList->InvalidateItem(i);
+	fUserList->Invalidate();
 }
 
 
@@ -330,9 +421,20 @@ ConversationView::SetWeights(float horizChat, float horizList, float vertChat,
 void
 ConversationView::_InitInterface()
 {
-	fReceiveView = new RenderView("receiveView");
+	AppPreferences* prefs = AppPreferences::Get();
+	if (prefs->VirtualChatView == true) {
+		VirtualRenderView* receiveView = new VirtualRenderView("receiveView");
+		receiveView->SetEmoticons(prefs->IgnoreEmoticons == false);
+		fReceiveView = receiveView;
+		fReceiveView->SetScrollback(prefs->VirtualScrollback,
+			prefs->ScrollbackSize * 1024);
+	} else {
+		fReceiveView = new RenderView("receiveView");
+		fReceiveView->SetScrollback(prefs->ScrollbackLines,
+			prefs->ScrollbackSize * 1024);
+	}
 	BScrollView* scrollViewReceive = new BScrollView("receiveScrollView",
-		fReceiveView, B_WILL_DRAW, false, true, B_NO_BORDER);
+		fReceiveView->View(), B_WILL_DRAW, false, true, B_NO_BORDER);
 
 	fSendView = new SendTextView("sendView", this);
 
@@ -385,14 +487,14 @@ ConversationView::_InitInterface()
 
 
 bool
-ConversationView::_AppendOrEnqueueMessage(BMessage* msg)
+ConversationView::_AppendOrEnqueueMessage(BMessage* msg, const ImEvent* event)
 {
 	if (msg->HasInt64("when") == false)
 		msg->AddInt64("when", (int64)time(NULL));
 
 	// If not attached to the chat window, then re-handle this message
 	// later [AttachedToWindow()], since you can't edit an unattached 
-	// RenderView.
+	// message view.
 	if (Window() == NULL) {
 		// If contains multiple chat messages (e.g., IM_LOGS_RECEIVED), add all
 		int32 i = -1;
@@ -408,34 +510,42 @@ ConversationView::_AppendOrEnqueueMessage(BMessage* msg)
 	}
 
 	// Alright, we're good to append!
-	_AppendMessage(msg);
+	_AppendMessage(msg, event);
 	return true;
 }
 
 
 void
-ConversationView::_AppendMessage(BMessage* msg)
+ConversationView::_AppendMessage(BMessage* msg, const ImEvent* event)
 {
 	// If ordered to clear buffer… well, I guess we can't refuse
 	if (msg->what == kClearText) {
-		fReceiveView->SetText("");
+		fPendingAppends.text.MakeEmpty();
+		fPendingAppends.messages.MakeEmpty();
+		fAppendScrollPending = false;
+		fReceiveView->Clear();
 		return;
 	}
 
 	// Otherwise, it's message time!
-	int64 timeInt;
-	BString user_id;
-	BString user_name = msg->FindString("user_name");
-	BString body;
-	rgb_color userColor = ui_color(B_PANEL_TEXT_COLOR);
+	ImEvent parsed;
+	if (event == NULL) {
+		parsed.SetTo(msg);
+		event = &parsed;
+	}
 
-	if (msg->FindString("body", &body) != B_OK)
+	if (event->HasBody() == false)
 		return;
 
-	if (msg->FindInt64("when", &timeInt) != B_OK)
-		timeInt = (int64)time(NULL);
+	BString user_name = event->UserName();
+	BString body = event->Body();
+	rgb_color userColor = ui_color(B_PANEL_TEXT_COLOR);
+	int64 timeInt = event->HasWhen() ? event->When() : (int64)time(NULL);
+	// Counted when trimmed, see message_record
+	bool logged = msg->GetBool("logged", false);
 
-	if (msg->FindString("user_id", &user_id) == B_OK) {
+	if (event->UserId().IsEmpty() == false) {
+		BString user_id = event->UserId().String();
 		User* user = NULL;
 		if (fConversation != NULL
 				&& (user = fConversation->UserById(user_id)) != NULL) {
@@ -446,8 +556,12 @@ ConversationView::_AppendMessage(BMessage* msg)
 			user_name = user_id;
 	}
 
+	TextRunBuilder line;
 	if (user_name.IsEmpty() == true) {
-		fReceiveView->AppendGeneric(body);
+		if (body.IsEmpty() == true)
+			return;
+		fReceiveView->AddGeneric(&line, body);
+		_Append(line, timeInt, logged);
 		return;
 	}
 
@@ -455,158 +569,153 @@ ConversationView::_AppendMessage(BMessage* msg)
 		BString meMsg = "** ";
 		meMsg << user_name.String() << " ";
 		meMsg << body.RemoveFirst("/me ");
-		fReceiveView->AppendGeneric(meMsg.String());
+		fReceiveView->AddGeneric(&line, meMsg.String());
+		_Append(line, timeInt, logged);
 		return;
 	}
 
-	fReceiveView->AppendTimestamp(timeInt);
-	fReceiveView->AppendUserstamp(user_name, userColor);
-
-	// And here we append the body…
-	uint16 face = 0;
-	UInt16IntMap face_indices;
-	rgb_color color = ui_color(B_PANEL_TEXT_COLOR);
-	int32 colorIndice = -1;
-	int32 next = body.CountChars();
-
-	BFont font;
-	for (int i = 0; i < body.CountChars(); i++) {
-		_DisableEndingFaces(msg, i, &face, &face_indices);
-		_EnableStartingFaces(msg, i, &face, &face_indices, &next);
-		_EnableStartingColor(msg, i, &color, &colorIndice, &next);
-
-		if (face == B_REGULAR_FACE) {
-			font = BFont();
-			face = 0;
-		}
-		else if (face > 0) {
-			font.SetFace(face);
-		}
+	// The whole line goes in at once, styled by the body's spans
+	fReceiveView->AddTimestamp(&line, timeInt);
+	fReceiveView->AddUserstamp(&line, user_name, userColor);
+	line.Add(body, event->Faces(), event->Colors(),
+		ui_color(B_PANEL_TEXT_COLOR));
+	line.Add("\n", ui_color(B_PANEL_TEXT_COLOR));
+	_Append(line, timeInt, logged);
+}
 
-		if (colorIndice > 0 && colorIndice <= i) {
-			color = ui_color(B_PANEL_TEXT_COLOR);
-			colorIndice == -1;
-		}
 
-		// If formatting doesn't change for a while, send text in bulk
-		if ((next - i) > 1) {
-			BString append;
-			body.CopyCharsInto(append, i, next - i);
-			fReceiveView->Append(append, color, &font);
-			i = next - 1;
-			next = body.CountChars();
-		}
-		// Otherwise, send only current character
-		else {
-			int32 bytes;
-			const char* curChar = body.CharAt(i, &bytes);
-			char append[bytes];
-
-			for (int i = 0; i < bytes; i++)
-				append[i] = curChar[i];
-			append[bytes] = '\0';
-			fReceiveView->Append(append, color, &font);
-		}
+void
+ConversationView::LogsRead(BMessage* logs, bool prepend)
+{
+	if (logs->HasMessage("message") == false) {
+		// Nothing older, no need to ask again
+		if (logs->GetBool("older", false) == true)
+			fReceiveView->StopBackfill();
+		return;
+	}
+	if (prepend == true)
+		_PrependLogs(logs);
+	else
+		MessageReceived(logs);
+}
 
-		if (next < i)
-			next = body.CountChars() - 1;
 
-	}
-	fReceiveView->Append("\n");
+void
+ConversationView::_PrependLogs(BMessage* logs)
+{
+	// What's pending is newer, and its day dividers already decided
+	_FlushAppends();
+
+	fPrepending = true;
+	fReceiveView->BeginPrepend();
+	BMessage text;
+	for (int32 i = 0; _LogAt(logs, i, &text) == B_OK; i++)
+		_AppendMessage(&text);
+	fReceiveView->EndPrepend();
+	fPrepending = false;
+}
+
+
+// Marked as logged if the page was read from the ChatLog
+status_t
+ConversationView::_LogAt(BMessage* logs, int32 index, BMessage* text)
+{
+	status_t ret = logs->FindMessage("message", index, text);
+	if (ret == B_OK && logs->GetBool("logged", false) == true)
+		text->AddBool("logged", true);
+	return ret;
 }
 
 
 void
-ConversationView::_EnableStartingFaces(BMessage* msg, int32 index, uint16* face,
-	UInt16IntMap* indices, int32* next)
+ConversationView::_Append(const TextRunBuilder& line, int64 when,
+	bool logged)
 {
-	int32 face_start;
-	int32 face_length;
-	uint16 newFace;
-
-	int32 i = 0;
-	while (msg->FindInt32("face_start", i, &face_start) == B_OK) {
-		// Change 'next' value for new fonts
-		if (face_start > index && face_start < *next)
-			*next = face_start;
-
-		// Set face normally
-		if (face_start == index) {
-			if (msg->FindInt32("face_length", i, &face_length) != B_OK)
-				continue;
-			if (msg->FindUInt16("face", i, &newFace) != B_OK)
-				continue;
-
-			*face |= newFace;
-			indices->AddItem(newFace, index + face_length);
-		}
-		i++;
+	if (fPrepending == true || Window() == NULL) {
+		fReceiveView->Append(line, when, logged);
+		return;
 	}
 
-	// Change 'next' for ending old fonts
-	for (int i = 0; i < indices->CountItems(); i++) {
-		int faceEnd = indices->ValueAt(i);
-		if (faceEnd > 0 && faceEnd > index && faceEnd < *next)
-			*next = faceEnd;
+	message_record record = { line.Length(), when, logged };
+	fPendingAppends.text.Add(line);
+	fPendingAppends.messages.AddItem(record);
+	fAppendStats.received++;
+
+	if (fAppendFlushQueued == false) {
+		BMessage flush(kFlushAppends);
+		fAppendFlushQueued = BMessageRunner::StartSending(BMessenger(this),
+			&flush, fAppendWindow, 1) == B_OK;
+		if (fAppendFlushQueued == false)
+			_FlushAppends();
 	}
 }
 
 
 void
-ConversationView::_DisableEndingFaces(BMessage* msg, int32 index, uint16* face,
-	UInt16IntMap* indices)
+ConversationView::_FlushAppends()
 {
-	for (int32 i = 0; i < indices->CountItems(); i++) {
-		uint16 key = indices->KeyAt(i);
-		int32 value = indices->ValueAt(i);
-
-		if (value <= index) {
-			indices->RemoveItemAt(i);
-			*face = *face & ~key;
-			if (indices->CountItems() == 0)
-				*face = B_REGULAR_FACE;
-		}
-	}
+	int32 count = fPendingAppends.messages.CountItems();
+	if (count == 0)
+		return;
+
+	fReceiveView->Append(fPendingAppends);
+	fPendingAppends.text.MakeEmpty();
+	fPendingAppends.messages.MakeEmpty();
+	fAppendStats.frames++;
+	if (fAppendScrollPending == true)
+		fReceiveView->ScrollToBottom();
+	fAppendScrollPending = false;
+
+	// Held for longer while flooded, and back to a frame once it's calm
+	bigtime_t now = system_time();
+	bigtime_t elapsed = std::max(now - fLastAppendFlush, fAppendWindow);
+	fLastAppendFlush = now;
+	bigtime_t window = fAppendWindow;
+	if (elapsed > kFloodInterval * 2)
+		window = kFrameInterval;
+	else if (count * 1000000LL > kFloodRate * elapsed)
+		window = std::min(fAppendWindow * 2, kFloodInterval);
+	else if (count * 2000000LL < kFloodRate * elapsed)
+		window = std::max(fAppendWindow / 2, kFrameInterval);
+
+	if ((window > kFrameInterval) != (fAppendWindow > kFrameInterval))
+		_ReportAppends(window);
+	fAppendWindow = window;
 }
 
 
 void
-ConversationView::_EnableStartingColor(BMessage* msg, int32 index,
-	rgb_color* color, int32* indice, int32* next)
+ConversationView::_ReportAppends(bigtime_t window)
 {
-	rgb_color newColor;
-	int32 color_start, color_length, i = 0;
-	while (msg->FindInt32("color_start", i, &color_start) == B_OK) {
-		if (color_start > index && color_start < *next)
-			*next = color_start - 1;
-
-		if (color_start == index
-				&& msg->FindInt32("color_length", i, &color_length) == B_OK
-				&& msg->FindColor("color", i, &newColor) == B_OK)
-		{
-			*indice = color_length + index;
-			*color = newColor;
-			if (*indice > index && (*indice < *next || *next < index))
-				*next = *indice;
-			break;
-		}
-		i++;
-	}
+	BString name = fConversation != NULL ? fConversation->GetId() : Name();
+	printf("%s: %" B_PRIu32 " messages received in %" B_PRIu32 " frames "
+		"(saved %" B_PRIu32 "), batching every %" B_PRId64 " ms\n",
+		name.String(), fAppendStats.received, fAppendStats.frames,
+		fAppendStats.received - fAppendStats.frames, (int64)(window / 1000));
 }
 
 
 void
-ConversationView::_UserMessage(const char* format, const char* bodyFormat,
-	BMessage* msg)
+ConversationView::_ScrollToBottom()
 {
-	BString user_id;
-	BString user_name = msg->FindString("user_name");
-	BString body = msg->FindString("body");
+	if (fPendingAppends.messages.CountItems() > 0)
+		fAppendScrollPending = true;
+	else
+		fReceiveView->ScrollToBottom();
+}
+
 
-	if (msg->FindString("user_id", &user_id) != B_OK)
+void
+ConversationView::_UserMessage(const char* format, const char* bodyFormat,
+	const ImEvent& event)
+{
+	if (event.UserId().IsEmpty() == true)
 		return;
+
+	BString user_name = event.UserName();
+	const BString& body = event.Body();
 	if (user_name.IsEmpty() == true)
-		user_name = user_id;
+		user_name = event.UserId().String();
 
 	BString newBody("** ");
 	if (body.IsEmpty() == true)
@@ -620,7 +729,7 @@ ConversationView::_UserMessage(const char* format, const char* bodyFormat,
 	BMessage newMsg;
 	newMsg.AddString("body", newBody);
 	_AppendOrEnqueueMessage(&newMsg);
-	fReceiveView->ScrollToBottom();
+	_ScrollToBottom();
 }
 
 
@@ -11,6 +11,8 @@
 
 #include "AppConstants.h"
 #include "Conversation.h"
+#include "ImEvent.h"
+#include "MessageRenderer.h"
 #include "Observer.h"
 
 class BStringView;
@@ -18,7 +20,7 @@ class BSplitView;
 
 class BitmapView;
 class EnterTextView;
-class RenderView;
+class MessageRenderer;
 class SendTextView;
 class User;
 class UserListView;
@@ -26,7 +28,12 @@ class UserListView;
 
 const uint32 kClearText = 'CVct';
 
-typedef KeyMap<uint16, int32> UInt16IntMap;
+
+// How well appended messages are being coalesced
+struct append_stats {
+	uint32	received;	// Messages appended while shown
+	uint32	frames;		// Batches they were drawn in
+};
 
 
 class ConversationView : public BGroupView, public Observer, public Notifier {
@@ -34,14 +41,23 @@ public:
 						ConversationView(Conversation* chat = NULL);
 
 	virtual void		AttachedToWindow();
+	virtual void		DetachedFromWindow();
 
 	virtual	void		MessageReceived(BMessage* message);
-			void		ImMessage(BMessage* msg);
+			void		ImMessage(BMessage* msg,
+							const ImEvent* event = NULL);
+
+			// A page of logs, as the first of them, or atop those shown
+			void		LogsRead(BMessage* logs, bool prepend);
 
 			Conversation* GetConversation();
 			void		SetConversation(Conversation* chat);
 
-			void		UpdateUserList(UserMap users);
+			// Brought in line with users all at once, as when joining
+			void		UpdateUserList(const UserMap& users);
+			void		AddUser(User* user);
+			void		RemoveUser(User* user);
+			void		UpdateUserRole(User* user);
 			void		InvalidateUserList();
 
 			void		ObserveString(int32 what, BString str);
@@ -55,19 +71,27 @@ public:
 private:
 			void		_InitInterface();
 
-			bool		_AppendOrEnqueueMessage(BMessage* msg);
-			void		_AppendMessage(BMessage* msg);
-
-			// Helper functions for _AppendFormattedMessage()
-			void		_EnableStartingFaces(BMessage* msg, int32 index,
-							uint16* face, UInt16IntMap* indices, int32* next);
-			void		_DisableEndingFaces(BMessage* msg, int32 index,
-							uint16* face, UInt16IntMap* indices);
-			void		_EnableStartingColor(BMessage* msg, int32 index,
-							rgb_color* color, int32* indice, int32* next);
+			bool		_AppendOrEnqueueMessage(BMessage* msg,
+							const ImEvent* event = NULL);
+			void		_AppendMessage(BMessage* msg,
+							const ImEvent* event = NULL);
+			// Older logs, atop everything else
+			void		_PrependLogs(BMessage* logs);
+			status_t	_LogAt(BMessage* logs, int32 index, BMessage* text);
+
+			// Lines are gathered and inserted once a frame (or less often
+			// in a flood) rather than one by one, each with its own
+			// re-layout and redraw
+			void		_Append(const TextRunBuilder& line, int64 when,
+							bool logged);
+			void		_FlushAppends();
+			// On standard output, as the flood mode changes and when the
+			// view's hidden
+			void		_ReportAppends(bigtime_t window);
+			void		_ScrollToBottom();
 
 			void		_UserMessage(const char* format, const char* bodyFormat,
-									 BMessage* msg);
+									 const ImEvent& event);
 
 			// When the user hasn't joined any real conversations
 			void		_FakeChat();
@@ -80,7 +104,14 @@ private:
 		BitmapView* fProtocolView;
 		BitmapView* fIcon;
 
-		RenderView* fReceiveView;
+		MessageRenderer* fReceiveView;
+		message_batch fPendingAppends;
+		bool fAppendFlushQueued;
+		bool fAppendScrollPending;
+		bool fPrepending;
+		bigtime_t fAppendWindow;
+		bigtime_t fLastAppendFlush;
+		append_stats fAppendStats;
 		UserListView* fUserList;
 		SendTextView* fSendView;
 		BSplitView* fHorizSplit;
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "MessageRenderer.h"
+
+#include <InterfaceDefs.h>
+#include <Message.h>
+#include <View.h>
+#include <Window.h>
+
+#include "TextRunBuilder.h"
+
+
+MessageRenderer::MessageRenderer()
+	:
+	fLastDay(364),
+	fLastYear(64),
+	fBackfillTarget(NULL),
+	fBackfillPending(false),
+	fBackfillStopped(false),
+	fTrimming(false),
+	fBackfillDeferred(false)
+{
+}
+
+
+MessageRenderer::~MessageRenderer()
+{
+}
+
+
+void
+MessageRenderer::AppendGeneric(const char* message, int64 when)
+{
+	if (BString(message).IsEmpty() == true)	return;
+	TextRunBuilder line;
+	AddGeneric(&line, message);
+	Append(line, when != 0 ? when : (int64)time(NULL), false);
+}
+
+
+void
+MessageRenderer::AddUserstamp(TextRunBuilder* line, const char* nick,
+	rgb_color nameColor)
+{
+	BString stamp("<");
+	stamp << nick << "> ";
+	line->Add(stamp.String(), nameColor, B_BOLD_FACE);
+}
+
+
+void
+MessageRenderer::AddTimestamp(TextRunBuilder* line, time_t time)
+{
+	tm* tm = localtime(&time);
+
+	// If day changed, print date divider
+	if (fLastDay < tm->tm_yday || fLastYear < tm->tm_year) {
+		char datestamp[11] = { '\0' };
+		strftime(datestamp, 10, "%Y-%m-%d", tm);
+		BString stamp("――― %date% ―――\n");
+		stamp.ReplaceAll("%date%", datestamp);
+
+		line->Add(stamp.String(), ui_color(B_PANEL_TEXT_COLOR),
+			B_ITALIC_FACE | B_BOLD_FACE);
+
+		fLastDay = tm->tm_yday;
+		fLastYear = tm->tm_year;
+	}
+
+	if (time == 0) {
+		line->Add("[xx:xx] ", ui_color(B_LINK_ACTIVE_COLOR), B_BOLD_FACE);
+		return;
+	}
+	char timestamp[9] = { '\0' };
+	strftime(timestamp, 8, "[%H:%M] ", tm);
+	line->Add(timestamp, ui_color(B_LINK_ACTIVE_COLOR), B_BOLD_FACE);
+}
+
+
+void
+MessageRenderer::AddGeneric(TextRunBuilder* line, const char* message)
+{
+	AddTimestamp(line, time(NULL));
+	line->Add(message, ui_color(B_PANEL_TEXT_COLOR), B_BOLD_FACE);
+	if (BString(message).EndsWith("\n") == false)
+		line->Add("\n", ui_color(B_PANEL_TEXT_COLOR));
+}
+
+
+void
+MessageRenderer::BeginPrepend()
+{
+	fPrependDay = fLastDay;
+	fPrependYear = fLastYear;
+	fLastDay = -1;
+	fLastYear = -1;
+}
+
+
+void
+MessageRenderer::EndPrepend()
+{
+	fLastDay = fPrependDay;
+	fLastYear = fPrependYear;
+	fBackfillPending = false;
+}
+
+
+void
+MessageRenderer::SetBackfillTarget(BHandler* target)
+{
+	fBackfillTarget = target;
+	fBackfillPending = false;
+	fBackfillStopped = false;
+}
+
+
+void
+MessageRenderer::_Backfill()
+{
+	if (fTrimming == true) {
+		fBackfillDeferred = true;
+		return;
+	}
+
+	BWindow* window = View()->Window();
+	if (fBackfillTarget == NULL || fBackfillPending == true
+		|| fBackfillStopped == true || window == NULL)
+		return;
+	fBackfillPending = true;
+	window->PostMessage(kBackfill, fBackfillTarget);
+}
+
+
+void
+MessageRenderer::_BeginTrim()
+{
+	fTrimming = true;
+	fBackfillDeferred = false;
+}
+
+
+void
+MessageRenderer::_Trimmed(int64 when, int32 sameTime)
+{
+	fTrimming = false;
+	fBackfillStopped = false;
+	BWindow* window = View()->Window();
+	if (fBackfillTarget != NULL && window != NULL) {
+		BMessage trimmed(kTrimmed);
+		trimmed.AddInt64("when", when);
+		trimmed.AddInt32("same_time", sameTime);
+		window->PostMessage(&trimmed, fBackfillTarget);
+	}
+
+	// Only now, so the backfill cursor's been moved past what was trimmed
+	if (fBackfillDeferred == true) {
+		fBackfillDeferred = false;
+		_Backfill();
+	}
+}
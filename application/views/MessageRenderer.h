@@ -0,0 +1,107 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _MESSAGE_RENDERER_H
+#define _MESSAGE_RENDERER_H
+
+#include <GraphicsDefs.h>
+#include <SupportDefs.h>
+
+#include <time.h>
+
+#include <libsupport/List.h>
+
+#include "TextRunBuilder.h"
+
+class BHandler;
+class BView;
+
+
+// Sent to the backfill target when scrolled up to the top
+const uint32 kBackfill = 'RVbf';
+// Sent to it once the oldest messages have been trimmed, with the int64
+// "when" of the first one left, and as int32 "same_time" how many of the
+// logged ones trimmed were from that same second
+const uint32 kTrimmed = 'RVtr';
+
+
+struct message_record {
+	int32	length;		// Of its text
+	int64	when;
+	bool	logged;		// In the ChatLog, rather than a notice only shown
+};
+
+
+// Messages gathered to be inserted at once, as one styled line
+struct message_batch {
+	TextRunBuilder			text;
+	List<message_record>	messages;
+};
+
+
+// What a conversation's messages are shown with: the stamps and backfill
+// are the same whichever view's behind it, see RenderView and
+// VirtualRenderView.
+class MessageRenderer {
+public:
+					MessageRenderer();
+	virtual			~MessageRenderer();
+
+	virtual	BView*	View() = 0;
+
+		// A message's when is kept in case it's trimmed, 0 is now
+		void		AppendGeneric(const char* message, int64 when = 0);
+		// Insert a message's line built with the below at once
+	virtual	void	Append(const TextRunBuilder& line, int64 when,
+						bool logged) = 0;
+	virtual	void	Append(const message_batch& batch) = 0;
+	virtual	void	Clear() = 0;
+
+	virtual	void	ScrollToBottom() = 0;
+
+		void		AddUserstamp(TextRunBuilder* line, const char* nick,
+						rgb_color nameColor);
+		// Along with the date, if it's another day than the last one's
+		void		AddTimestamp(TextRunBuilder* line, time_t time = 0);
+		// A bold notice, with the time it's shown at
+		void		AddGeneric(TextRunBuilder* line, const char* message);
+
+		// Older messages are appended between these, so they go at the top
+		// with what was shown left in place
+	virtual	void	BeginPrepend();
+	virtual	void	EndPrepend();
+
+		void		SetBackfillTarget(BHandler* target);
+		// Until messages are trimmed, there's nothing more to backfill
+		void		StopBackfill() { fBackfillStopped = true; }
+
+		// Most lines and bytes of text kept, or 0 for no limit. Past
+		// either, the oldest messages are deleted, a quarter of the
+		// limit's worth at a time so it's only done once in a while. Those
+		// in view are kept unless it's twice over.
+	virtual	void	SetScrollback(int32 lines, int32 bytes) = 0;
+
+protected:
+		// Ask the target for older messages, unless it's been asked already
+		void		_Backfill();
+		// Tell it the oldest messages are gone, from when on. Backfill asked
+		// for in between, as the trim scrolls, is only sent after.
+		void		_BeginTrim();
+		void		_Trimmed(int64 when, int32 sameTime);
+
+private:
+		int fLastDay;
+		int fLastYear;
+
+		int fPrependDay;
+		int fPrependYear;
+
+		BHandler* fBackfillTarget;
+		bool fBackfillPending;
+		bool fBackfillStopped;
+		bool fTrimming;
+		bool fBackfillDeferred;
+};
+
+#endif // _MESSAGE_RENDERER_H
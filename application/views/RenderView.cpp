@@ -5,61 +5,181 @@
 
 #include "RenderView.h"
 
-#include <InterfaceDefs.h>
+#include <algorithm>
+
+#include "TextRunBuilder.h"
 
 
 RenderView::RenderView(const char* name)
 	:
 	RunView(name),
-	fLastDay(364),
-	fLastYear(64)
+	fPrependLength(-1),
+	fMaxLines(0),
+	fMaxBytes(0),
+	fFirstMessage(0),
+	fPrependMessage(-1)
 {
 }
 
 
 void
-RenderView::AppendGeneric(const char* message)
+RenderView::ScrollTo(BPoint where)
 {
-	if (BString(message).IsEmpty() == true)	return;
-	AppendTimestamp(time(NULL));
-	Append(message, ui_color(B_PANEL_TEXT_COLOR), B_BOLD_FACE);
-	if (BString(message).EndsWith("\n") == false)	Append("\n");
+	RunView::ScrollTo(where);
+	if (where.y <= 0)
+		_Backfill();
 }
 
 
 void
-RenderView::AppendUserstamp(const char* nick, rgb_color nameColor)
+RenderView::Append(const TextRunBuilder& line, int64 when, bool logged)
 {
-	Append("<", nameColor, B_BOLD_FACE);
-	Append(nick, nameColor, B_BOLD_FACE);
-	Append("> ", nameColor, B_BOLD_FACE);
+	text_run_array* runs = line.RunArray();
+	if (runs == NULL)
+		return;
+	Append(line.Text(), runs);
+	FreeRunArray(runs);
+
+	message_record record = { line.Length(), when, logged };
+	if (fPrependMessage < 0) {
+		fMessages.AddItem(record);
+		_Trim();
+		return;
+	}
+	fMessages.AddItem(record);
+	std::rotate(fMessages.begin() + fPrependMessage, fMessages.end() - 1,
+		fMessages.end());
+	fPrependMessage++;
 }
 
 
 void
-RenderView::AppendTimestamp(time_t time)
+RenderView::Append(const message_batch& batch)
 {
-	tm* tm = localtime(&time);
+	int32 count = batch.messages.CountItems();
+	if (count == 0)
+		return;
+	text_run_array* runs = batch.text.RunArray();
+	if (runs == NULL)
+		return;
+	Append(batch.text.Text(), runs);
+	FreeRunArray(runs);
 
-	// If day changed, print date divider
-	if (fLastDay < tm->tm_yday || fLastYear < tm->tm_year) {
-		char datestamp[11] = { '\0' };
-		strftime(datestamp, 10, "%Y-%m-%d", tm);
-		BString stamp("――― %date% ―――\n");
-		stamp.ReplaceAll("%date%", datestamp);
+	fMessages.AddList(batch.messages);
+	if (fPrependMessage < 0) {
+		_Trim();
+		return;
+	}
+	std::rotate(fMessages.begin() + fPrependMessage, fMessages.end() - count,
+		fMessages.end());
+	fPrependMessage += count;
+}
 
-		Append(stamp.String(), ui_color(B_PANEL_TEXT_COLOR),
-			B_ITALIC_FACE | B_BOLD_FACE);
 
-		fLastDay = tm->tm_yday;
-		fLastYear = tm->tm_year;
-	}
+void
+RenderView::Clear()
+{
+	SetText("");
+	fMessages.MakeEmpty();
+	fFirstMessage = 0;
+}
+
+
+void
+RenderView::BeginPrepend()
+{
+	MessageRenderer::BeginPrepend();
+	fPrependLength = TextLength();
+	fPrependMessage = fFirstMessage;
+	SetInsertOffset(0);
+}
+
+
+void
+RenderView::EndPrepend()
+{
+	SetInsertOffset(-1);
+	fPrependMessage = -1;
+	MessageRenderer::EndPrepend();
 
-	if (time == 0) {
-		Append("[xx:xx] ", ui_color(B_LINK_ACTIVE_COLOR), B_BOLD_FACE);
+	// Keep the formerly-top line where it was
+	int32 added = TextLength() - fPrependLength;
+	if (added > 0)
+		ScrollTo(BPoint(Bounds().left, Bounds().top + PointAt(added).y));
+	fPrependLength = -1;
+}
+
+
+void
+RenderView::SetScrollback(int32 lines, int32 bytes)
+{
+	fMaxLines = std::max((int32)0, lines);
+	fMaxBytes = std::max((int32)0, bytes);
+	_Trim();
+}
+
+
+void
+RenderView::_Trim()
+{
+	int32 lines = fMaxLines > 0 ? CountLines() - fMaxLines : 0;
+	int32 bytes = fMaxBytes > 0 ? TextLength() - fMaxBytes : 0;
+	if (lines <= 0 && bytes <= 0)
 		return;
+
+	int32 cut = 0;
+	if (bytes > 0)
+		cut = bytes + fMaxBytes / 4;
+	if (lines > 0)
+		cut = std::max(cut, _CountBytes(lines + fMaxLines / 4));
+
+	// Only once it's all above the view, unless it's grown twice too large
+	// while the user's been reading back
+	bool overflow = (fMaxLines > 0 && lines >= fMaxLines)
+		|| (fMaxBytes > 0 && bytes >= fMaxBytes);
+	if (overflow == false && OffsetAt(BPoint(0, Bounds().top)) < cut)
+		return;
+
+	// Whole messages, never the last one
+	int32 length = 0;
+	int32 first = fFirstMessage;
+	int32 count = fMessages.CountItems();
+	while (first < count - 1 && length < cut) {
+		length += fMessages.ItemAt(first).length;
+		first++;
+	}
+	if (length == 0 || length > TextLength())
+		return;
+
+	_BeginTrim();
+	Trim(length);
+	// Notices aren't logged, so they're not counted past
+	int64 when = fMessages.ItemAt(first).when;
+	int32 sameTime = 0;
+	for (int32 i = first - 1; i >= fFirstMessage
+			&& fMessages.ItemAt(i).when == when; i--)
+		if (fMessages.ItemAt(i).logged == true)
+			sameTime++;
+	fFirstMessage = first;
+
+	// Dropped from the front in bulk, rather than shifting at every trim
+	if (fFirstMessage > count / 2) {
+		List<message_record> kept;
+		kept.Reserve(count - fFirstMessage);
+		for (int32 i = fFirstMessage; i < count; i++)
+			kept.AddItem(fMessages.ItemAt(i));
+		fMessages = std::move(kept);
+		fFirstMessage = 0;
 	}
-	char timestamp[9] = { '\0' };
-	strftime(timestamp, 8, "[%H:%M] ", tm);
-	Append(timestamp, ui_color(B_LINK_ACTIVE_COLOR), B_BOLD_FACE);
+
+	_Trimmed(when, sameTime);
+}
+
+
+int32
+RenderView::_CountBytes(int32 lines) const
+{
+	if (lines >= CountLines())
+		return TextLength();
+	return OffsetAt(lines);
 }
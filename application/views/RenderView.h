@@ -7,18 +7,45 @@
 
 #include <librunview/RunView.h>
 
+#include <libsupport/List.h>
 
-class RenderView : public RunView {
+#include "MessageRenderer.h"
+
+
+class RenderView : public RunView, public MessageRenderer {
 public:
 				RenderView(const char* name);
 
-		void	AppendGeneric(const char* message);
-		void	AppendUserstamp(const char* nick, rgb_color nameColor);
-		void	AppendTimestamp(time_t time = 0);
+	virtual	BView*	View() { return this; }
+
+	virtual	void	ScrollTo(BPoint where);
+
+	virtual	void	Append(const TextRunBuilder& line, int64 when,
+						bool logged);
+	virtual	void	Append(const message_batch& batch);
+		using	RunView::Append;
+	virtual	void	Clear();
+
+	virtual	void	ScrollToBottom() { RunView::ScrollToBottom(); }
+
+	virtual	void	BeginPrepend();
+	virtual	void	EndPrepend();
+
+		// Lines are as laid out
+	virtual	void	SetScrollback(int32 lines, int32 bytes);
 
 private:
-		int fLastDay;
-		int fLastYear;
+		void	_Trim();
+		int32	_CountBytes(int32 lines) const;
+
+		int32 fPrependLength;
+
+		int32 fMaxLines;
+		int32 fMaxBytes;
+		// Of the text shown, oldest first from fFirstMessage on
+		List<message_record> fMessages;
+		int32 fFirstMessage;
+		int32 fPrependMessage;
 };
 
 #endif // _RENDER_VIEW_H
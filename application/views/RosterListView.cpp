@@ -11,6 +11,8 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <unordered_set>
+
 #include <Catalog.h>
 #include <Looper.h>
 #include <MenuItem.h>
@@ -247,6 +249,30 @@ RosterListView::AddItem(BListItem* item)
 }
 
 
+bool
+RosterListView::AddList(BList* items)
+{
+	// HasItem() is a linear scan, so which are listed is looked up in a set
+	// instead, one that also leaves out those given twice
+	std::unordered_set<BListItem*> listed;
+	listed.reserve(CountItems() + items->CountItems());
+	for (int32 i = 0; i < CountItems(); i++)
+		listed.insert(ItemAt(i));
+
+	BList newItems(items->CountItems());
+	for (int32 i = 0; i < items->CountItems(); i++) {
+		BListItem* item = (BListItem*)items->ItemAtFast(i);
+		item->Deselect();
+		if (listed.insert(item).second == true)
+			newItems.AddItem(item);
+	}
+
+	bool ret = BListView::AddList(&newItems);
+	Sort();
+	return ret;
+}
+
+
 bool
 RosterListView::RemoveItem(BListItem* item)
 {
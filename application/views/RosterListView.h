@@ -24,6 +24,7 @@ public:
 	virtual void	AttachedToWindow();
 
 	virtual	bool	AddItem(BListItem* item);
+	virtual	bool	AddList(BList* items);
 	virtual	bool	RemoveItem(BListItem* item);
 		RosterItem*	RosterItemAt(int32 index);
 
@@ -112,73 +112,53 @@ RosterView::ImMessage(BMessage* msg)
 {
 	int32 im_what = msg->FindInt32("im_what");
 	switch (im_what) {
-		case IM_USER_STATUS_SET:
+		case IM_ROSTER:
 		{
-			int32 status;
 			int64 instance;
-			BString user_id = msg->FindString("user_id");
-			if (msg->FindInt32("status", &status) != B_OK
-				|| msg->FindInt64("instance", &instance) != B_OK
-				|| user_id.IsEmpty() == true)
-				return;
-
-			Contact* contact = fServer->ContactById(user_id, instance);
-			if (contact == NULL)
+			if (msg->FindInt64("instance", &instance) != B_OK
+				|| (fAccount >= 0 && instance != fAccount))
 				return;
 
-			RosterItem*	rosterItem = contact->GetRosterItem();
-
-			if (rosterItem) {
-				UpdateListItem(rosterItem);
-
-				// Add or remove item
-				switch (status) {
-					/*case STATUS_OFFLINE:
-						// By default offline contacts are hidden
-						if (!AppPreferences::Item()->HideOffline)
-							break;
-						if (HasItem(rosterItem))
-							RemoveItem(rosterItem);
-						return;*/
-					default:
-						// Add item because it has a non-offline status
-						fListView->AddItem(rosterItem);
-						break;
-				}
-
-				UpdateListItem(rosterItem);
-
-				// Check if the user want the notification
-				if (!AppPreferences::Get()->NotifyContactStatus)
-					break;
-
-				switch (status) {
-					case STATUS_ONLINE:
-					case STATUS_OFFLINE:
-						// Notify when contact is online or offline
-						if (status == STATUS_ONLINE) {
-							BString message;
-							message << rosterItem->GetContact()->GetName();
-
-							if (status == STATUS_ONLINE)
-								message.SetTo(B_TRANSLATE("%name% is available!"));
-							else
-								message.SetTo(B_TRANSLATE("%name% is offline!"));
-							message.ReplaceAll("%name%",
-								rosterItem->GetContact()->GetName());
-
-							BNotification notification(B_INFORMATION_NOTIFICATION);
-							notification.SetGroup(BString(APP_NAME));
-							notification.SetTitle(BString(B_TRANSLATE("Presence")));
-							notification.SetIcon(rosterItem->Bitmap());
-							notification.SetContent(message);
-							notification.Send();
-						}
-						break;
-					default:
-						break;
-				}
+			BList items;
+			const char* user_id = NULL;
+			for (int32 i = 0; msg->FindString("user_id", i, &user_id) == B_OK;
+					i++) {
+				Contact* contact = fServer->ContactById(user_id, instance);
+				if (contact != NULL && contact->GetRosterItem() != NULL)
+					items.AddItem(contact->GetRosterItem());
+			}
+			fListView->AddList(&items);
+			break;
+		}
+		case IM_USER_STATUS_SET:
+		{
+			// Server delivers them in batches, each user's fields at the same
+			// index; they're listed and sorted at once, then redrawn
+			BList items;
+			const char* user_id = NULL;
+			for (int32 i = 0; msg->FindString("user_id", i, &user_id) == B_OK;
+					i++) {
+				int32 status;
+				int64 instance;
+				if (msg->FindInt32("status", i, &status) != B_OK
+					|| msg->FindInt64("instance", i, &instance) != B_OK)
+					continue;
+
+				Contact* contact = fServer->ContactById(user_id, instance);
+				RosterItem* rosterItem
+					= contact != NULL ? contact->GetRosterItem() : NULL;
+				if (rosterItem == NULL)
+					continue;
+
+				// Add item because it has a non-offline status
+				items.AddItem(rosterItem);
+				_NotifyStatus(rosterItem, status);
 			}
+			if (items.IsEmpty() == true)
+				break;
+
+			fListView->AddList(&items);
+			fListView->Invalidate();
 			break;
 		}
 		case IM_ROSTER_CONTACT_REMOVED:
@@ -243,9 +223,48 @@ RosterView::SetAccount(bigtime_t instance_id)
 	fAccount = instance_id;
 	RosterMap contacts = _RosterMap();
 
-	fListView->MakeEmpty();
+	BList items(contacts.CountItems());
 	for (int i = 0; i < contacts.CountItems(); i++)
-		fListView->AddItem(contacts.ValueAt(i)->GetRosterItem());
+		items.AddItem(contacts.ValueAt(i)->GetRosterItem());
+
+	fListView->MakeEmpty();
+	fListView->AddList(&items);
+}
+
+
+void
+RosterView::_NotifyStatus(RosterItem* rosterItem, int32 status)
+{
+	// Check if the user want the notification
+	if (!AppPreferences::Get()->NotifyContactStatus)
+		return;
+
+	switch (status) {
+		case STATUS_ONLINE:
+		case STATUS_OFFLINE:
+			// Notify when contact is online or offline
+			if (status == STATUS_ONLINE) {
+				BString message;
+				message << rosterItem->GetContact()->GetName();
+
+				if (status == STATUS_ONLINE)
+					message.SetTo(B_TRANSLATE("%name% is available!"));
+				else
+					message.SetTo(B_TRANSLATE("%name% is offline!"));
+				message.ReplaceAll("%name%",
+					rosterItem->GetContact()->GetName());
+
+				BNotification notification(B_INFORMATION_NOTIFICATION);
+				notification.SetGroup(BString(APP_NAME));
+				notification.SetTitle(BString(B_TRANSLATE("Presence")));
+				notification.SetIcon(rosterItem->Bitmap());
+				notification.SetContent(message);
+				notification.Send();
+			}
+			break;
+		default:
+			break;
+	}
 }
 
 
@@ -45,6 +45,7 @@ public:
 
 private:
 			RosterMap	_RosterMap();
+			void		_NotifyStatus(RosterItem* item, int32 status);
 
 	Server*				fServer;
 	RosterListView*		fListView;
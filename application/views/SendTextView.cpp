@@ -142,12 +142,14 @@ SendTextView::_UserNames()
 {
 	if (fCurrentIndex == 0) {
 		BStringList nameAndId;
-		UserMap users = fChatView->GetConversation()->Users();
+		const UserMap& users = fChatView->GetConversation()->Users();
 
 		for (int i = 0; i < users.CountItems(); i++) {
-			nameAndId.Add(users.KeyAt(i));
+			nameAndId.Add(users.KeyAt(i).String());
 			nameAndId.Add(users.ValueAt(i)->GetName());
 		}
+		// Atom keys aren't in alphabetical order
+		nameAndId.Sort();
 		fCurrentList = nameAndId;
 	}
 	return fCurrentList;
@@ -11,14 +11,17 @@
 #include "AppConstants.h"
 #include "NotifyMessage.h"
 #include "User.h"
+#include "UserListView.h"
 #include "Utils.h"
 
 
-UserItem::UserItem(User* user)
+UserItem::UserItem(User* user, UserListView* list)
 	:
 	BStringItem(user->GetName()),
 	fUser(user),
-	fStatus(user->GetNotifyStatus())
+	fList(list),
+	fStatus(user->GetNotifyStatus()),
+	fPriority(0)
 {
 	user->RegisterObserver(this);
 }
@@ -47,7 +50,10 @@ UserItem::ObserveString(int32 what, BString str)
 {
 	switch (what) {
 		case STR_CONTACT_NAME:
-			SetText(str);
+			if (fList != NULL)
+				fList->RenameItem(this, str);
+			else
+				SetText(str);
 			break;
 	}
 }
@@ -11,11 +11,13 @@
 #include "Observer.h"
 
 class User;
+class UserListView;
 
 
 class UserItem : public BStringItem, public Observer {
 public:
-					UserItem(User* user);
+					// A list's items are moved into place as they're renamed
+					UserItem(User* user, UserListView* list = NULL);
 					~UserItem();
 
 	virtual void	DrawItem(BView* owner, BRect frame, bool complete);
@@ -25,12 +27,18 @@ public:
 
 			User*	GetUser();
 
+			// Of the user's role, the list's sorted by it and then by name
+			int32	Priority() const { return fPriority; }
+			void	SetPriority(int32 priority) { fPriority = priority; }
+
 protected:
 		rgb_color	_GetTextColor(rgb_color highColor);
 
 private:
 	User* fUser;
+	UserListView* fList;
 	int fStatus;
+	int32 fPriority;
 };
 
 #endif // USERITEM_H
@@ -5,6 +5,8 @@
 
 #include "UserListView.h"
 
+#include <strings.h>
+
 #include <Catalog.h>
 #include <PopUpMenu.h>
 #include <MenuItem.h>
@@ -28,12 +30,18 @@
 
 
 static int
-compare_by_name(const void* _item1, const void* _item2)
+compare_items(const UserItem* item1, const UserItem* item2)
 {
-	UserItem* item1 = *(UserItem**)_item1;
-	UserItem* item2 = *(UserItem**)_item2;
+	if (item1->Priority() != item2->Priority())
+		return item1->Priority() > item2->Priority() ? -1 : 1;
+	return strcasecmp(item1->Text(), item2->Text());
+}
+
 
-	return item1->GetUser()->GetName().ICompare(item2->GetUser()->GetName());
+static int
+compare_by_role(const void* _item1, const void* _item2)
+{
+	return compare_items(*(UserItem**)_item1, *(UserItem**)_item2);
 }
 
 
@@ -44,6 +52,12 @@ UserListView::UserListView(const char* name)
 }
 
 
+UserListView::~UserListView()
+{
+	MakeEmpty();
+}
+
+
 void
 UserListView::MouseDown(BPoint where)
 {
@@ -62,36 +76,166 @@ UserListView::MouseDown(BPoint where)
 }
 
 
+void
+UserListView::MakeEmpty()
+{
+	BListView::MakeEmpty();
+
+	std::unordered_map<User*, UserItem*>::iterator it = fItems.begin();
+	for (; it != fItems.end(); it++)
+		delete it->second;
+	fItems.clear();
+}
+
+
 void
 UserListView::Sort()
 {
-	SortItems(compare_by_name);
+	SortItems(compare_by_role);
 }
 
 
 bool
 UserListView::HasUser(User* user)
 {
-	for (int i = 0; i < CountItems(); i++)
-		if (user == ((UserItem*)ItemAt(i))->GetUser())
-			return true;
-	return false;
+	return fItems.find(user) != fItems.end();
 }
 
 
 void
 UserListView::AddUser(User* user)
 {
-	AddItem(new UserItem(user));
+	if (user == NULL || HasUser(user) == true)
+		return;
+
+	UserItem* item = new UserItem(user, this);
+	item->SetPriority(_Priority(user));
+	fItems[user] = item;
+	AddItem(item, _InsertionIndex(item));
+}
+
+
+void
+UserListView::AddUsers(const List<User*>& users)
+{
+	if (users.CountItems() == 1) {
+		AddUser(users.ItemAt(0));
+		return;
+	}
+
+	BList items(users.CountItems());
+	for (uint32 i = 0; i < users.CountItems(); i++) {
+		User* user = users.ItemAt(i);
+		if (user == NULL || HasUser(user) == true)
+			continue;
+
+		UserItem* item = new UserItem(user, this);
+		item->SetPriority(_Priority(user));
+		fItems[user] = item;
+		items.AddItem(item);
+	}
+	if (items.IsEmpty() == true)
+		return;
+
+	AddList(&items);
+	Sort();
 }
 
 
 void
 UserListView::RemoveUser(User* user)
 {
-	for (int i = 0; i < CountItems(); i++)
-		if (user == ((UserItem*)ItemAt(i))->GetUser())
-			RemoveItem(i);
+	std::unordered_map<User*, UserItem*>::iterator found = fItems.find(user);
+	if (found == fItems.end())
+		return;
+
+	UserItem* item = found->second;
+	fItems.erase(found);
+	RemoveItem(_IndexOf(item));
+	delete item;
+}
+
+
+void
+UserListView::UpdateRole(User* user)
+{
+	std::unordered_map<User*, UserItem*>::iterator found = fItems.find(user);
+	if (found == fItems.end())
+		return;
+
+	UserItem* item = found->second;
+	int32 priority = _Priority(user);
+	if (priority != item->Priority()) {
+		// SetText() frees the text it's replacing
+		BString name(item->Text());
+		_Move(item, name.String(), priority);
+	}
+}
+
+
+void
+UserListView::RenameItem(UserItem* item, const char* name)
+{
+	if (strcmp(item->Text(), name) == 0)
+		return;
+	_Move(item, name, item->Priority());
+}
+
+
+int32
+UserListView::_Priority(User* user)
+{
+	if (fChat == NULL)
+		return 0;
+	Role* role = fChat->GetRole(user->GetId());
+	return role != NULL ? role->fPriority : 0;
+}
+
+
+int32
+UserListView::_InsertionIndex(UserItem* item)
+{
+	int32 low = 0;
+	int32 high = CountItems();
+	while (low < high) {
+		int32 middle = low + (high - low) / 2;
+		if (compare_items((UserItem*)ItemAt(middle), item) <= 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+
+int32
+UserListView::_IndexOf(UserItem* item)
+{
+	// Those it sorts the same as come right before where it'd be inserted,
+	// and it's among them
+	for (int32 i = _InsertionIndex(item) - 1; i >= 0; i--) {
+		UserItem* other = (UserItem*)ItemAt(i);
+		if (other == item)
+			return i;
+		if (compare_items(other, item) != 0)
+			break;
+	}
+	return IndexOf(item);
+}
+
+
+void
+UserListView::_Move(UserItem* item, const char* name, int32 priority)
+{
+	int32 index = _IndexOf(item);
+	if (index < 0)
+		return;
+
+	// Taken out by its old name and role, and put back by the new ones
+	RemoveItem(index);
+	item->SetText(name);
+	item->SetPriority(priority);
+	AddItem(item, _InsertionIndex(item));
 }
 
 
@@ -5,14 +5,19 @@
 #ifndef CONVERSATIONLIST_H
 #define CONVERSATIONLIST_H
 
+#include <unordered_map>
+
 #include <ListView.h>
 
+#include <libsupport/List.h>
+
 #include "Role.h"
 
 class BPopUpMenu;
 
 class Conversation;
 class User;
+class UserItem;
 
 
 enum
@@ -27,17 +32,27 @@ enum
 };
 
 
+// Kept sorted by role and then name as users come and go, each one put in
+// place with a binary search rather than the whole list re-sorted.
 class UserListView : public BListView {
 public:
 					UserListView(const char* name);
+	virtual			~UserListView();
 
 	virtual void	MouseDown(BPoint where);
+	virtual void	MakeEmpty();
 
 			void	Sort();
 
 			bool	HasUser(User* user);
 			void	AddUser(User* user);
+			// Many at once, sorted together in one go
+			void	AddUsers(const List<User*>& users);
 			void	RemoveUser(User* user);
+			// Moved into place after the user's role changed
+			void	UpdateRole(User* user);
+			// Called by a user's item as they're renamed
+			void	RenameItem(UserItem* item, const char* name);
 
 			void	SetConversation(Conversation* chat) { fChat = chat; }
 
@@ -45,11 +60,18 @@ private:
 	 BPopUpMenu*	_UserPopUp();
 	 BPopUpMenu*	_BlankPopUp();
 
+			int32	_Priority(User* user);
+			// Where it goes, after those it doesn't come before
+			int32	_InsertionIndex(UserItem* item);
+			int32	_IndexOf(UserItem* item);
+			void	_Move(UserItem* item, const char* name, int32 priority);
+
 			void	_ModerationAction(int32 im_what);
 			void	_ProcessItem(BMessage* itemMsg, BPopUpMenu* menu,
 						Role* user, Role* target, BString target_id);
 
 	Conversation* fChat;
+	std::unordered_map<User*, UserItem*> fItems;
 };
 
 #endif // CONVERSATIONLIST_H
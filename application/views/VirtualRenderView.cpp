@@ -0,0 +1,174 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "VirtualRenderView.h"
+
+#include <algorithm>
+
+#include <TextView.h>
+
+#include "TextRunBuilder.h"
+
+
+VirtualRenderView::VirtualRenderView(const char* name)
+	:
+	VirtualRunView(name),
+	fPrependIndex(-1),
+	fMaxMessages(0),
+	fMaxBytes(0)
+{
+}
+
+
+void
+VirtualRenderView::ScrollTo(BPoint where)
+{
+	VirtualRunView::ScrollTo(where);
+	if (where.y <= 0)
+		_Backfill();
+}
+
+
+void
+VirtualRenderView::Append(const TextRunBuilder& line, int64 when,
+	bool logged)
+{
+	if (line.Length() == 0)
+		return;
+	text_run_array* runs = line.RunArray();
+	if (runs == NULL)
+		return;
+
+	message_record record = { line.Length(), when, logged };
+	if (fPrependIndex < 0) {
+		Append(line.Text(), runs);
+		fRecords.push_back(record);
+	} else {
+		Insert(fPrependIndex, line.Text(), runs);
+		fRecords.insert(fRecords.begin() + fPrependIndex, record);
+		fPrependIndex++;
+	}
+	BTextView::FreeRunArray(runs);
+
+	if (fPrependIndex < 0)
+		_Trim();
+}
+
+
+void
+VirtualRenderView::Append(const message_batch& batch)
+{
+	if (batch.messages.CountItems() == 0 || batch.text.Length() == 0)
+		return;
+	text_run_array* runs = batch.text.RunArray();
+	if (runs == NULL)
+		return;
+
+	List<int32> lengths;
+	lengths.Reserve(batch.messages.CountItems());
+	std::deque<message_record> records;
+	for (uint32 i = 0; i < batch.messages.CountItems(); i++) {
+		const message_record& record = batch.messages.ItemAt(i);
+		if (record.length <= 0)
+			continue;
+		lengths.AddItem(record.length);
+		records.push_back(record);
+	}
+
+	if (fPrependIndex < 0) {
+		Append(batch.text.Text(), runs, lengths);
+		fRecords.insert(fRecords.end(), records.begin(), records.end());
+	} else {
+		Insert(fPrependIndex, batch.text.Text(), runs, lengths);
+		fRecords.insert(fRecords.begin() + fPrependIndex, records.begin(),
+			records.end());
+		fPrependIndex += records.size();
+	}
+	BTextView::FreeRunArray(runs);
+
+	if (fPrependIndex < 0)
+		_Trim();
+}
+
+
+void
+VirtualRenderView::Clear()
+{
+	MakeEmpty();
+	fRecords.clear();
+}
+
+
+void
+VirtualRenderView::BeginPrepend()
+{
+	MessageRenderer::BeginPrepend();
+	fPrependIndex = 0;
+}
+
+
+void
+VirtualRenderView::EndPrepend()
+{
+	// What was shown is kept in view as they're inserted
+	fPrependIndex = -1;
+	MessageRenderer::EndPrepend();
+}
+
+
+void
+VirtualRenderView::SetScrollback(int32 lines, int32 bytes)
+{
+	fMaxMessages = std::max((int32)0, lines);
+	fMaxBytes = std::max((int32)0, bytes);
+	_Trim();
+}
+
+
+void
+VirtualRenderView::_Trim()
+{
+	int32 count = CountMessages();
+	int32 messages = fMaxMessages > 0 ? count - fMaxMessages : 0;
+	int64 bytes = fMaxBytes > 0 ? (int64)TextLength() - fMaxBytes : 0;
+	if (messages <= 0 && bytes <= 0)
+		return;
+
+	// Only once it's all above the view, unless it's grown twice too large
+	// while the user's been reading back
+	bool overflow = (fMaxMessages > 0 && messages >= fMaxMessages)
+		|| (fMaxBytes > 0 && bytes >= fMaxBytes);
+	int32 last = overflow == true ? count - 1 : TopMessage();
+
+	// Whole messages, a quarter of the limit past it, never the last one
+	int32 cut = 0;
+	if (messages > 0)
+		cut = messages + fMaxMessages / 4;
+	if (bytes > 0) {
+		int64 length = 0;
+		int64 wanted = bytes + fMaxBytes / 4;
+		int32 first = 0;
+		while (first < last && length < wanted)
+			length += MessageLength(first++);
+		if (length < wanted && first < count - 1)
+			return;
+		cut = std::max(cut, first);
+	}
+	cut = std::min(cut, count - 1);
+	if (cut <= 0 || cut > last)
+		return;
+
+	// Notices aren't logged, so they're not counted past
+	int64 when = fRecords[cut].when;
+	int32 sameTime = 0;
+	for (int32 i = cut - 1; i >= 0 && fRecords[i].when == when; i--)
+		if (fRecords[i].logged == true)
+			sameTime++;
+
+	_BeginTrim();
+	RemoveFirst(cut);
+	fRecords.erase(fRecords.begin(), fRecords.begin() + cut);
+	_Trimmed(when, sameTime);
+}
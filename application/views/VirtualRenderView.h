@@ -0,0 +1,50 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _VIRTUAL_RENDER_VIEW_H
+#define _VIRTUAL_RENDER_VIEW_H
+
+#include <deque>
+
+#include <librunview/VirtualRunView.h>
+
+#include "MessageRenderer.h"
+
+
+// RenderView's counterpart for very long conversations, see VirtualRunView
+class VirtualRenderView : public VirtualRunView, public MessageRenderer {
+public:
+				VirtualRenderView(const char* name);
+
+	virtual	BView*	View() { return this; }
+
+	virtual	void	ScrollTo(BPoint where);
+		using	VirtualRunView::ScrollTo;
+
+	virtual	void	Append(const TextRunBuilder& line, int64 when,
+						bool logged);
+	virtual	void	Append(const message_batch& batch);
+		using	VirtualRunView::Append;
+	virtual	void	Clear();
+
+	virtual	void	ScrollToBottom() { VirtualRunView::ScrollToBottom(); }
+
+	virtual	void	BeginPrepend();
+	virtual	void	EndPrepend();
+
+		// Lines are counted as messages, which needn't all be laid out
+	virtual	void	SetScrollback(int32 lines, int32 bytes);
+
+private:
+		void	_Trim();
+
+		// Of the messages shown, oldest first
+		std::deque<message_record> fRecords;
+		int32 fPrependIndex;
+
+		int32 fMaxMessages;
+		int32 fMaxBytes;
+};
+
+#endif // _VIRTUAL_RENDER_VIEW_H
@@ -305,6 +305,7 @@ MainWindow::ImMessage(BMessage* msg)
 			delete item->GetConversation();
 			break;
 		}
+		case IM_ROSTER:
 		case IM_USER_AVATAR_SET:
 		case IM_USER_STATUS_SET:
 		case IM_CONTACT_INFO:
@@ -605,8 +606,6 @@ MainWindow::_ToggleMenuItems()
 ConversationItem*
 MainWindow::_EnsureConversationItem(BMessage* msg)
 {
-	ChatMap chats = fServer->Conversations();
-
 	BString chat_id = msg->FindString("chat_id");
 	Conversation* chat = fServer->ConversationById(chat_id, msg->FindInt64("instance"));
 	ConversationItem* item = chat->GetListItem();
@@ -0,0 +1,967 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "ChatLog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <Directory.h>
+#include <Entry.h>
+#include <Message.h>
+
+#include "CompressedSegment.h"
+#include "FileUtils.h"
+
+
+// A segment is sealed, and the next one started, once it grows past this
+const off_t kSegmentSize = 4 * 1024 * 1024;
+// Largest dictionary zlib makes use of
+const size_t kDictionarySize = 32 * 1024;
+// Pending entries' data grows by this much at a time
+const size_t kPendingBlockSize = 64 * 1024;
+// A segment compressed aside, until it's adopted
+const char* kAsideSuffix = ".logz.new";
+
+
+// The "first" file of a pruned log: which segment it starts with, and the
+// number of that segment's first entry
+struct first_record {
+	uint32	segment;
+	uint32	reserved;
+	uint64	entry;
+};
+
+
+static off_t
+file_size(const BString& path)
+{
+	BFile file(path.String(), B_READ_ONLY);
+	off_t size = 0;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK)
+		return 0;
+	return size;
+}
+
+
+ChatLog::ChatLog(const char* path)
+	:
+	fPath(path),
+	fInitStatus(B_BAD_VALUE),
+	fEntries(0),
+	fDataSize(0),
+	fRotation(0),
+	fSegmentStart(0),
+	fCompress(false),
+	fDictionaryLoaded(false)
+{
+	memset(&fCompressionStats, 0, sizeof(log_compression_stats));
+	fPendingData.SetBlockSize(kPendingBlockSize);
+
+	if (path == NULL)
+		return;
+
+	fInitStatus = create_directory(path, 0755);
+	if (fInitStatus == B_OK)
+		fInitStatus = Refresh();
+}
+
+
+ChatLog::~ChatLog()
+{
+	Flush();
+	_UnmapSegments();
+}
+
+
+status_t
+ChatLog::Append(BMessage* message, int64 when, const char* sender,
+	uint32 flags)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	status_t ret = B_OK;
+	if (fData.InitCheck() != B_OK && (ret = _OpenForAppend()) != B_OK)
+		return ret;
+
+	ssize_t size = message->FlattenedSize();
+	if (size <= 0)
+		return B_BAD_VALUE;
+
+	off_t end = fDataSize + fPendingData.BufferLength();
+	if (end > 0 && (end + size > kSegmentSize
+			|| (fRotation > 0 && when - fSegmentStart >= fRotation))) {
+		if ((ret = Flush()) != B_OK)
+			return ret;
+		int32 sealed = fSegments.CountItems() - 1;
+		if ((ret = _StartSegment(fSegments.ItemAt(sealed).number + 1)) != B_OK)
+			return ret;
+		end = 0;
+
+		// A failure only leaves it uncompressed
+		if (fCompress == true)
+			_CompressSegment(fSegments.ItemAt(sealed));
+	}
+
+	// Flattened in place, rather than to a buffer that's then copied
+	size_t pending = end - fDataSize;
+	ret = fPendingData.SetSize(pending + size);
+	if (ret == B_OK)
+		ret = message->Flatten((char*)fPendingData.Buffer() + pending, size);
+	if (ret != B_OK) {
+		fPendingData.SetSize(pending);
+		fPendingData.Seek(0, SEEK_END);
+		return ret;
+	}
+	fPendingData.Seek(0, SEEK_END);
+
+	log_entry entry;
+	entry.when = when;
+	entry.offset = end;
+	entry.length = size;
+	entry.sender = _SenderFor(sender);
+	entry.flags = flags;
+	fPending.AddItem(entry);
+	if (end == 0)
+		fSegmentStart = when;
+	return B_OK;
+}
+
+
+status_t
+ChatLog::Flush(bool sync)
+{
+	if (fPending.IsEmpty() == true)
+		return B_OK;
+
+	// Data goes first, so an entry never points past what's been written
+	segment& last = fSegments.ItemAt(fSegments.CountItems() - 1);
+	uint32 count = fPending.CountItems();
+	status_t ret = write_fully(fData, fDataSize, fPendingData.Buffer(),
+		fPendingData.BufferLength());
+	if (ret == B_OK)
+		ret = write_fully(fIndex, last.count * sizeof(log_entry),
+			&fPending.ItemAt(0), count * sizeof(log_entry));
+	if (ret == B_OK && sync == true) {
+		fData.Sync();
+		fIndex.Sync();
+		fSendersFile.Sync();
+	}
+
+	// On failure the entries are kept, and written over what was of them
+	// by the next Flush(), so that their numbers aren't given to others
+	if (ret != B_OK)
+		return ret;
+
+	fDataSize += fPendingData.BufferLength();
+	last.count += count;
+	fEntries += count;
+	fPendingData.SetSize(0);
+	fPendingData.Seek(0, SEEK_SET);
+	fPending.MakeEmpty();
+	return B_OK;
+}
+
+
+status_t
+ChatLog::EntryAt(uint64 index, log_entry* entry)
+{
+	if (index >= fEntries || index < FirstEntry())
+		return B_BAD_INDEX;
+
+	segment& seg = fSegments.ItemAt(_SegmentFor(index));
+	uint32 local = index - seg.first;
+	status_t ret = _MapEntries(seg, local + 1);
+	if (ret == B_OK)
+		*entry = seg.entries[local];
+	return ret;
+}
+
+
+uint64
+ChatLog::IndexOf(int64 when)
+{
+	uint64 low = FirstEntry();
+	uint64 high = fEntries;
+	while (low < high) {
+		uint64 middle = low + (high - low) / 2;
+		log_entry entry;
+		if (EntryAt(middle, &entry) != B_OK)
+			return fEntries;
+		if (entry.when < when)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+
+uint64
+ChatLog::FirstEntry() const
+{
+	if (fSegments.IsEmpty() == true)
+		return fEntries;
+	return fSegments.ItemAt(0).first;
+}
+
+
+uint32
+ChatLog::SegmentOf(uint64 index) const
+{
+	if (fSegments.IsEmpty() == true)
+		return 0;
+	return fSegments.ItemAt(_SegmentFor(index)).number;
+}
+
+
+status_t
+ChatLog::ReadEntries(uint64 first, int32 count, BMessage* logs)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (count <= 0)
+		return B_OK;
+	if (first >= fEntries)
+		return B_BAD_INDEX;
+
+	// Whatever's been pruned is skipped
+	uint64 start = FirstEntry();
+	if (first < start) {
+		if (first + count <= start)
+			return B_OK;
+		count -= start - first;
+		first = start;
+	}
+
+	for (int32 i = _SegmentFor(first);
+			count > 0 && i < (int32)fSegments.CountItems(); i++) {
+		segment& seg = fSegments.ItemAt(i);
+		uint32 local = first - seg.first;
+		uint32 read = std::min((uint32)count, seg.count - local);
+		if (read == 0)
+			continue;
+
+		status_t ret = _ReadSegment(seg, local, read, logs);
+		if (ret != B_OK)
+			return ret;
+		first += read;
+		count -= read;
+	}
+	return B_OK;
+}
+
+
+status_t
+ChatLog::ReadLast(int32 count, BMessage* logs)
+{
+	if (count <= 0 || fEntries == 0)
+		return B_OK;
+
+	uint64 first = fEntries > (uint64)count ? fEntries - count : 0;
+	first = std::max(first, FirstEntry());
+	return ReadEntries(first, fEntries - first, logs);
+}
+
+
+status_t
+ChatLog::ReadMessage(uint64 index, BMessage* message)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (index >= fEntries || index < FirstEntry())
+		return B_BAD_INDEX;
+
+	segment& seg = fSegments.ItemAt(_SegmentFor(index));
+	uint32 local = index - seg.first;
+	status_t ret = _MapSegment(seg, local + 1);
+	if (ret != B_OK)
+		return ret;
+	const char* data = _EntryData(seg, local);
+	return data != NULL ? message->Unflatten(data) : B_IO_ERROR;
+}
+
+
+status_t
+ChatLog::CompressSealed(int32 count)
+{
+	// The last segment may still be appended to
+	for (int32 i = 0; i < (int32)fSegments.CountItems() - 1 && count != 0;
+			i++) {
+		uint64 compressed = fCompressionStats.rawBytes;
+		status_t ret = _CompressSegment(fSegments.ItemAt(i));
+		if (ret != B_OK)
+			return ret;
+		if (count > 0 && fCompressionStats.rawBytes > compressed)
+			count--;
+	}
+	return B_OK;
+}
+
+
+status_t
+ChatLog::CompressAside(compressed_segment* _segment)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	// The last segment may still be appended to
+	for (int32 i = 0; i < (int32)fSegments.CountItems() - 1; i++) {
+		segment& seg = fSegments.ItemAt(i);
+		if (seg.count == 0 || seg.compressed != NULL
+			|| BEntry(_SegmentPath(seg.number, ".log").String()).Exists()
+				== false)
+			continue;
+
+		_segment->number = seg.number;
+		_segment->rawBytes = 0;
+		_segment->compressedBytes = 0;
+		// Done before, but interrupted; adopting only drops the ".log"
+		if (BEntry(_SegmentPath(seg.number, ".logz").String()).Exists()
+				== true)
+			return B_OK;
+
+		size_t size = 0;
+		status_t ret = _WriteCompressed(seg, kAsideSuffix, &_segment->rawBytes,
+			&size);
+		// This ChatLog has no more use for it
+		_UnmapSegment(seg);
+		_segment->compressedBytes = size;
+		return ret;
+	}
+	return B_ENTRY_NOT_FOUND;
+}
+
+
+status_t
+ChatLog::AdoptCompressed(const compressed_segment& compressed)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	BString aside = _SegmentPath(compressed.number, kAsideSuffix);
+	int32 index = -1;
+	for (int32 i = 0; i < (int32)fSegments.CountItems() - 1; i++) {
+		if (fSegments.ItemAt(i).number == compressed.number) {
+			index = i;
+			break;
+		}
+	}
+	if (index < 0) {
+		// Pruned in the meantime
+		BEntry(aside.String()).Remove();
+		return B_ENTRY_NOT_FOUND;
+	}
+
+	segment& seg = fSegments.ItemAt(index);
+	BString target = _SegmentPath(seg.number, ".logz");
+	BEntry entry(aside.String());
+	if (entry.Exists() == true) {
+		status_t ret = entry.Rename(target.String(), true);
+		if (ret != B_OK) {
+			entry.Remove();
+			return ret;
+		}
+	} else if (BEntry(target.String()).Exists() == false)
+		return B_ENTRY_NOT_FOUND;
+	return _DropUncompressed(seg, compressed.rawBytes,
+		compressed.compressedBytes);
+}
+
+
+status_t
+ChatLog::Prune(const log_retention& retention, int64 now, uint64* _pruned,
+	off_t* _freed)
+{
+	if (_pruned != NULL)
+		*_pruned = 0;
+	if (_freed != NULL)
+		*_freed = 0;
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	List<off_t> sizes;
+	off_t total = 0;
+	off_t size = 0;
+	for (const segment& seg : fSegments) {
+		sizes.AddItem(_SegmentSize(seg));
+		size += sizes.ItemAt(sizes.CountItems() - 1);
+	}
+	total = size;
+
+	// Oldest first, and the last segment may still be appended to
+	uint64 kept = fEntries - FirstEntry();
+	int32 drop = 0;
+	for (; drop < (int32)fSegments.CountItems() - 1; drop++) {
+		segment& seg = fSegments.ItemAt(drop);
+		bool expired = (retention.maxSize > 0 && size > retention.maxSize)
+			|| (retention.keepLast > 0
+				&& kept - seg.count >= retention.keepLast);
+
+		log_entry last;
+		if (expired == false && retention.maxAge > 0)
+			expired = seg.count == 0
+				|| (EntryAt(seg.first + seg.count - 1, &last) == B_OK
+					&& last.when < now - retention.maxAge);
+		if (expired == false)
+			break;
+		size -= sizes.ItemAt(drop);
+		kept -= seg.count;
+	}
+	if (drop == 0)
+		return B_OK;
+
+	// Recorded before anything's removed, so that the segments an
+	// interruption leaves behind keep their numbers
+	status_t ret = _WriteFirst(fSegments.ItemAt(drop));
+	if (ret != B_OK)
+		return ret;
+
+	uint64 pruned = fSegments.ItemAt(drop).first - FirstEntry();
+	for (int32 i = 0; i < drop; i++) {
+		segment& seg = fSegments.ItemAt(0);
+		_UnmapSegment(seg);
+		BEntry(_SegmentPath(seg.number, ".log").String()).Remove();
+		BEntry(_SegmentPath(seg.number, ".logz").String()).Remove();
+		BEntry(_SegmentPath(seg.number, kAsideSuffix).String()).Remove();
+		// Last, as that's what segments are found by
+		BEntry(_SegmentPath(seg.number, ".idx").String()).Remove();
+		fSegments.RemoveItemAt(0);
+	}
+	if (_pruned != NULL)
+		*_pruned = pruned;
+	if (_freed != NULL)
+		*_freed = total - size;
+	return B_OK;
+}
+
+
+log_compression_stats
+ChatLog::CompressionStats() const
+{
+	log_compression_stats stats = fCompressionStats;
+	for (const segment& seg : fSegments) {
+		if (seg.compressed == NULL)
+			continue;
+		stats.decodedBytes += seg.compressed->DecodedBytes();
+		stats.decodeTime += seg.compressed->DecodeTime();
+	}
+	return stats;
+}
+
+
+const char*
+ChatLog::SenderAt(uint32 sender) const
+{
+	if (sender >= fSenders.CountItems())
+		return NULL;
+	return fSenders.ItemAt(sender).String();
+}
+
+
+status_t
+ChatLog::Refresh()
+{
+	BDirectory dir(fPath.String());
+	status_t ret = dir.InitCheck();
+	if (ret != B_OK)
+		return ret;
+
+	List<uint32> numbers;
+	BEntry entry;
+	char name[B_FILE_NAME_LENGTH];
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		if (entry.GetName(name) != B_OK)
+			continue;
+		size_t length = strlen(name);
+		if (length > 4 && strcmp(name + length - 4, ".idx") == 0)
+			numbers.AddItem(strtoul(name, NULL, 10));
+	}
+	std::sort(numbers.begin(), numbers.end());
+
+	first_record first;
+	BString firstPath(fPath);
+	firstPath << "/first";
+	BFile firstFile(firstPath.String(), B_READ_ONLY);
+	if (firstFile.InitCheck() != B_OK || firstFile.ReadAt(0, &first,
+			sizeof(first_record)) != sizeof(first_record))
+		memset(&first, 0, sizeof(first_record));
+
+	_UnmapSegments();
+	fSegments.MakeEmpty();
+	fEntries = 0;
+	for (uint32 number : numbers) {
+		BFile index(_SegmentPath(number, ".idx").String(), B_READ_ONLY);
+		off_t size = 0;
+		if (index.GetSize(&size) != B_OK)
+			continue;
+
+		segment seg;
+		seg.number = number;
+		seg.first = fEntries;
+		seg.count = size / sizeof(log_entry);
+		seg.entries = NULL;
+		seg.data = NULL;
+		seg.compressed = NULL;
+		fSegments.AddItem(seg);
+		fEntries += seg.count;
+	}
+
+	// A pruned log starts past 0, at the entry its "first" file gives;
+	// segments an interrupted Prune() left before it are counted back
+	uint64 base = first.entry;
+	for (const segment& seg : fSegments) {
+		if (seg.number >= first.segment) {
+			base = first.entry > seg.first ? first.entry - seg.first : 0;
+			break;
+		}
+	}
+	for (segment& seg : fSegments)
+		seg.first += base;
+	fEntries += base;
+	return _LoadSenders();
+}
+
+
+status_t
+ChatLog::_OpenForAppend()
+{
+	BString sendersPath(fPath);
+	sendersPath << "/senders";
+	status_t ret = fSendersFile.SetTo(sendersPath.String(),
+		B_WRITE_ONLY | B_CREATE_FILE | B_OPEN_AT_END);
+	if (ret != B_OK)
+		return ret;
+
+	if (fSegments.IsEmpty() == true)
+		return _StartSegment(0);
+
+	const segment& last = fSegments.ItemAt(fSegments.CountItems() - 1);
+	if ((ret = fIndex.SetTo(_SegmentPath(last.number, ".idx").String(),
+			B_READ_WRITE)) != B_OK
+		|| (ret = fData.SetTo(_SegmentPath(last.number, ".log").String(),
+			B_READ_WRITE | B_CREATE_FILE)) != B_OK)
+		return ret;
+
+	// Drop whatever an interrupted Append() left behind
+	fDataSize = 0;
+	if (last.count > 0) {
+		log_entry entry;
+		if (fIndex.ReadAt((last.count - 1) * sizeof(log_entry), &entry,
+				sizeof(log_entry)) == sizeof(log_entry))
+			fDataSize = (off_t)entry.offset + entry.length;
+		if (fIndex.ReadAt(0, &entry, sizeof(log_entry)) == sizeof(log_entry))
+			fSegmentStart = entry.when;
+	}
+	fIndex.SetSize(last.count * sizeof(log_entry));
+	fData.SetSize(fDataSize);
+	return B_OK;
+}
+
+
+status_t
+ChatLog::_StartSegment(uint32 number)
+{
+	const uint32 mode = B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE;
+	status_t ret;
+	if ((ret = fIndex.SetTo(_SegmentPath(number, ".idx").String(), mode))
+			!= B_OK
+		|| (ret = fData.SetTo(_SegmentPath(number, ".log").String(), mode))
+			!= B_OK) {
+		fData.Unset();
+		return ret;
+	}
+
+	segment seg;
+	seg.number = number;
+	seg.first = fEntries;
+	seg.count = 0;
+	seg.entries = NULL;
+	seg.data = NULL;
+	seg.compressed = NULL;
+	fSegments.AddItem(seg);
+	fDataSize = 0;
+	return B_OK;
+}
+
+
+off_t
+ChatLog::_SegmentSize(const segment& seg) const
+{
+	return file_size(_SegmentPath(seg.number, ".idx"))
+		+ file_size(_SegmentPath(seg.number, ".log"))
+		+ file_size(_SegmentPath(seg.number, ".logz"));
+}
+
+
+status_t
+ChatLog::_WriteFirst(const segment& seg)
+{
+	first_record first;
+	first.segment = seg.number;
+	first.reserved = 0;
+	first.entry = seg.first;
+
+	BString path(fPath);
+	path << "/first";
+	BString temp(path);
+	temp << ".tmp";
+	BFile file(temp.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	status_t ret = file.InitCheck();
+	if (ret == B_OK)
+		ret = write_fully(file, 0, &first, sizeof(first_record));
+	if (ret == B_OK)
+		ret = file.Sync();
+
+	BEntry entry(temp.String());
+	if (ret == B_OK)
+		ret = entry.Rename(path.String(), true);
+	if (ret != B_OK)
+		entry.Remove();
+	return ret;
+}
+
+
+int32
+ChatLog::_SegmentFor(uint64 index) const
+{
+	// Last segment starting at or before index
+	int32 low = 0;
+	int32 high = fSegments.CountItems() - 1;
+	while (low < high) {
+		int32 middle = (low + high + 1) / 2;
+		if (fSegments.ItemAt(middle).first <= index)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	return low;
+}
+
+
+BString
+ChatLog::_SegmentPath(uint32 number, const char* suffix) const
+{
+	BString path;
+	path.SetToFormat("%s/%08" B_PRIu32 "%s", fPath.String(), number, suffix);
+	return path;
+}
+
+
+status_t
+ChatLog::_MapEntries(segment& seg, uint32 end)
+{
+	if (end == 0 || end > seg.count)
+		return B_BAD_INDEX;
+	if (seg.entries != NULL && seg.entriesSize >= end * sizeof(log_entry))
+		return B_OK;
+
+	// Not mapped yet, or the segment grew since
+	unmap_file(seg.entries, seg.entriesSize);
+	seg.entries = (const log_entry*)map_file(
+		_SegmentPath(seg.number, ".idx").String(), &seg.entriesSize);
+	if (seg.entries == NULL || seg.entriesSize < end * sizeof(log_entry)) {
+		unmap_file(seg.entries, seg.entriesSize);
+		seg.entries = NULL;
+		return B_IO_ERROR;
+	}
+	return B_OK;
+}
+
+
+status_t
+ChatLog::_MapSegment(segment& seg, uint32 end)
+{
+	status_t ret = _MapEntries(seg, end);
+	if (ret != B_OK)
+		return ret;
+
+	// The data's written before the entries, so it's there if they are
+	const log_entry& last = seg.entries[end - 1];
+	if (_MappedSize(seg) >= (size_t)last.offset + last.length)
+		return B_OK;
+
+	_UnmapData(seg);
+	seg.data = (const char*)map_file(_SegmentPath(seg.number, ".log").String(),
+		&seg.dataSize);
+	if (seg.data == NULL) {
+		seg.compressed = new CompressedSegment(
+			_SegmentPath(seg.number, ".logz").String());
+		if (seg.compressed->InitCheck() != B_OK) {
+			delete seg.compressed;
+			seg.compressed = NULL;
+		}
+	}
+
+	if (_MappedSize(seg) < (size_t)last.offset + last.length) {
+		_UnmapData(seg);
+		return B_IO_ERROR;
+	}
+	return B_OK;
+}
+
+
+size_t
+ChatLog::_MappedSize(const segment& seg) const
+{
+	if (seg.compressed != NULL)
+		return seg.compressed->RawSize();
+	return seg.data != NULL ? seg.dataSize : 0;
+}
+
+
+const char*
+ChatLog::_EntryData(segment& seg, uint32 index)
+{
+	const log_entry& entry = seg.entries[index];
+	if (seg.compressed == NULL)
+		return seg.data + entry.offset;
+
+	_LoadDictionary();
+	const char* data = seg.compressed->DataAt(entry.offset, entry.length,
+		fDictionary.Buffer(), fDictionary.BufferLength());
+	if (data == NULL && fDictionary.BufferLength() == 0) {
+		// It may have been written since it was looked for
+		fDictionaryLoaded = false;
+		_LoadDictionary();
+		data = seg.compressed->DataAt(entry.offset, entry.length,
+			fDictionary.Buffer(), fDictionary.BufferLength());
+	}
+	return data;
+}
+
+
+void
+ChatLog::_UnmapSegment(segment& seg)
+{
+	_UnmapData(seg);
+	unmap_file(seg.entries, seg.entriesSize);
+	seg.entries = NULL;
+}
+
+
+void
+ChatLog::_UnmapData(segment& seg)
+{
+	if (seg.compressed != NULL) {
+		fCompressionStats.decodedBytes += seg.compressed->DecodedBytes();
+		fCompressionStats.decodeTime += seg.compressed->DecodeTime();
+		delete seg.compressed;
+	}
+	unmap_file(seg.data, seg.dataSize);
+	seg.data = NULL;
+	seg.compressed = NULL;
+}
+
+
+void
+ChatLog::_UnmapSegments()
+{
+	for (segment& seg : fSegments)
+		_UnmapSegment(seg);
+}
+
+
+status_t
+ChatLog::_ReadSegment(segment& seg, uint32 first, uint32 count,
+	BMessage* logs)
+{
+	status_t ret = _MapSegment(seg, first + count);
+	if (ret != B_OK)
+		return ret;
+
+	// Unflattened straight from the mapping, or the inflated block
+	for (uint32 i = first; i < first + count; i++) {
+		const char* data = _EntryData(seg, i);
+		BMessage message;
+		if (data != NULL && message.Unflatten(data) == B_OK)
+			logs->AddMessage("message", &message);
+	}
+	return B_OK;
+}
+
+
+status_t
+ChatLog::_CompressSegment(segment& seg)
+{
+	BEntry source(_SegmentPath(seg.number, ".log").String());
+	if (BEntry(_SegmentPath(seg.number, ".logz").String()).Exists() == true
+		|| seg.count == 0) {
+		// Done before, but interrupted
+		if (seg.count > 0 && source.Exists() == true)
+			return source.Remove();
+		return B_OK;
+	}
+
+	uint64 rawBytes = 0;
+	size_t size = 0;
+	status_t ret = _WriteCompressed(seg, ".logz", &rawBytes, &size);
+	if (ret != B_OK)
+		return ret;
+	return _DropUncompressed(seg, rawBytes, size);
+}
+
+
+status_t
+ChatLog::_WriteCompressed(segment& seg, const char* suffix,
+	uint64* _rawBytes, size_t* _size)
+{
+	status_t ret = _MapSegment(seg, seg.count);
+	if (ret == B_OK && seg.data == NULL)
+		ret = B_ENTRY_NOT_FOUND;
+	if (ret == B_OK)
+		ret = _LoadDictionary(&seg);
+	if (ret != B_OK)
+		return ret;
+
+	const log_entry& last = seg.entries[seg.count - 1];
+	*_rawBytes = (uint64)last.offset + last.length;
+	return CompressedSegment::Write(_SegmentPath(seg.number, suffix).String(),
+		seg.data, seg.entries, seg.count, fDictionary.Buffer(),
+		fDictionary.BufferLength(), _size);
+}
+
+
+status_t
+ChatLog::_DropUncompressed(segment& seg, uint64 rawBytes,
+	uint64 compressedBytes)
+{
+	fCompressionStats.rawBytes += rawBytes;
+	fCompressionStats.compressedBytes += compressedBytes;
+
+	// Other ChatLogs that have it mapped keep it until they let go
+	_UnmapSegment(seg);
+	status_t ret = BEntry(_SegmentPath(seg.number, ".log").String()).Remove();
+	return ret == B_ENTRY_NOT_FOUND ? B_OK : ret;
+}
+
+
+status_t
+ChatLog::_LoadDictionary(const segment* sample)
+{
+	if (fDictionaryLoaded == true
+		&& (fDictionary.BufferLength() > 0 || sample == NULL))
+		return B_OK;
+
+	BString path = _DictionaryPath();
+	BFile file(path.String(), B_READ_ONLY);
+	off_t size = 0;
+	if (file.InitCheck() == B_OK && file.GetSize(&size) == B_OK && size > 0) {
+		fDictionary.SetSize(size);
+		fDictionaryLoaded = true;
+		if (file.ReadAt(0, (void*)fDictionary.Buffer(), size) == size)
+			return B_OK;
+		fDictionary.SetSize(0);
+		return B_IO_ERROR;
+	}
+	fDictionaryLoaded = true;
+	if (sample == NULL)
+		return B_OK;
+
+	// Messages spread over the sample, which share most of their field
+	// names and a good deal of their text with the ones to come
+	const log_entry& last = sample->entries[sample->count - 1];
+	uint32 step = std::max((uint64)1,
+		(uint64)(((uint64)last.offset + last.length) / kDictionarySize));
+	BMallocIO dictionary;
+	for (uint32 i = 0; i < sample->count; i += step) {
+		const log_entry& entry = sample->entries[i];
+		size_t length = std::min((size_t)entry.length,
+			kDictionarySize - dictionary.BufferLength());
+		dictionary.Write(sample->data + entry.offset, length);
+		if (dictionary.BufferLength() >= kDictionarySize)
+			break;
+	}
+
+	// Whoever writes it first, it mustn't change after
+	BFile newFile(path.String(), B_WRITE_ONLY | B_CREATE_FILE
+		| B_FAIL_IF_EXISTS);
+	status_t ret = newFile.InitCheck();
+	if (ret == B_FILE_EXISTS) {
+		fDictionaryLoaded = false;
+		return _LoadDictionary();
+	}
+	if (ret == B_OK)
+		ret = write_fully(newFile, 0, dictionary.Buffer(),
+			dictionary.BufferLength());
+	if (ret == B_OK)
+		ret = newFile.Sync();
+	if (ret != B_OK)
+		return ret;
+
+	fDictionary.SetSize(0);
+	fDictionary.Seek(0, SEEK_SET);
+	fDictionary.Write(dictionary.Buffer(), dictionary.BufferLength());
+	return B_OK;
+}
+
+
+BString
+ChatLog::_DictionaryPath() const
+{
+	BString path(fPath);
+	int32 slash = path.FindLast('/');
+	if (slash > 0)
+		path.Truncate(slash);
+	path << "/dictionary";
+	return path;
+}
+
+
+status_t
+ChatLog::_LoadSenders()
+{
+	fSenders.MakeEmpty();
+	fSenderIds.MakeEmpty();
+
+	BString sendersPath(fPath);
+	sendersPath << "/senders";
+	BFile file(sendersPath.String(), B_READ_ONLY);
+	off_t size = 0;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK || size == 0)
+		return B_OK;
+
+	char* buffer = (char*)malloc(size);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	ssize_t read = file.ReadAt(0, buffer, size);
+	for (ssize_t start = 0, i = 0; i < read; i++) {
+		if (buffer[i] != '\0')
+			continue;
+		BString id(buffer + start, i - start);
+		fSenderIds.AddItem(id, fSenders.CountItems());
+		fSenders.AddItem(id);
+		start = i + 1;
+	}
+	free(buffer);
+	return B_OK;
+}
+
+
+uint32
+ChatLog::_SenderFor(const char* id)
+{
+	if (id == NULL || id[0] == '\0')
+		return LOG_NO_SENDER;
+
+	bool found = false;
+	uint32 sender = fSenderIds.ValueFor(id, &found);
+	if (found == true)
+		return sender;
+
+	size_t length = strlen(id) + 1;
+	if (fSendersFile.Write(id, length) != (ssize_t)length)
+		return LOG_NO_SENDER;
+
+	sender = fSenders.CountItems();
+	fSenderIds.AddItem(id, sender);
+	fSenders.AddItem(id);
+	return sender;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _CHAT_LOG_H
+#define _CHAT_LOG_H
+
+#include <DataIO.h>
+#include <File.h>
+#include <String.h>
+
+#include <libsupport/KeyMap.h>
+#include <libsupport/List.h>
+
+class BMessage;
+class CompressedSegment;
+
+
+// Flags of a log_entry
+enum {
+	LOG_OWN_MESSAGE	= 1 << 0,	// Sent by the user rather than received
+	LOG_ACTION		= 1 << 1	// A "/me" message
+};
+
+const uint32 LOG_NO_SENDER = 0xffffffff;
+
+
+// A record of a segment's index (".idx" file)
+struct log_entry {
+	int64	when;
+	uint32	offset;		// Of the flattened BMessage in the ".log" file
+	uint32	length;
+	uint32	sender;		// In the room's sender table, or LOG_NO_SENDER
+	uint32	flags;
+};
+
+
+struct log_compression_stats {
+	uint64		rawBytes;			// Of the segments compressed
+	uint64		compressedBytes;
+	uint64		decodedBytes;		// Inflated to be read
+	bigtime_t	decodeTime;
+};
+
+
+// A sealed segment compressed aside, for the appending ChatLog to adopt
+struct compressed_segment {
+	uint32		number;
+	uint64		rawBytes;
+	uint64		compressedBytes;
+};
+
+
+// Limits on how much of a log is kept, 0 for none; an entry past any of
+// them is dropped. Only whole sealed segments are, so somewhat more may be
+// kept than asked.
+struct log_retention {
+	int64		maxAge;			// Seconds since the entry was logged
+	off_t		maxSize;		// Of the segments' files
+	uint64		keepLast;		// Entries
+};
+
+
+// A room's message log: a directory of append-only segments, each made of
+// a ".log" file of flattened BMessages and an ".idx" file of log_entries
+// pointing into it, plus a "senders" table that interns user IDs.
+// Entries are numbered from the oldest on, and keep their numbers once
+// older ones are pruned. Appending is O(1), and reading k entries is O(k)
+// however long the history is.
+// Appended entries are buffered until Flush(), which writes them to each
+// file at once; they can't be read back before then, and are kept for the
+// next one if it fails.
+// Segments are read through memory mappings, kept until the ChatLog is
+// deleted, so paging back through them doesn't copy anything but the
+// resulting BMessages.
+// With compression on, each segment is block-compressed once it's sealed
+// (see CompressedSegment), with a dictionary sampled from the first one
+// and shared by the logs of the parent directory, i.e. of the account.
+// The segment being appended to is always left as it is, by compression
+// and by pruning.
+// Compressing takes a while, so it can be done aside by another ChatLog of
+// the same directory, on another thread, with CompressAside(); the one
+// appending then only swaps the result in with AdoptCompressed().
+// A ChatLog isn't thread-safe, but several can share a directory as long
+// as only one of them appends.
+class ChatLog {
+public:
+						ChatLog(const char* path);
+	// Flushes the pending entries
+						~ChatLog();
+
+			status_t	InitCheck() const { return fInitStatus; }
+			const char*	Path() const { return fPath.String(); }
+
+	// Compress segments as they're sealed
+			void		SetCompression(bool compress)
+							{ fCompress = compress; }
+	// Compress those sealed before, at most count of them unless it's -1
+			status_t	CompressSealed(int32 count = -1);
+			log_compression_stats CompressionStats() const;
+	// Compress the oldest sealed segment that isn't yet to a file beside
+	// it, or B_ENTRY_NOT_FOUND if there's none
+			status_t	CompressAside(compressed_segment* _segment);
+	// Swap in the file and drop the segment's uncompressed data
+			status_t	AdoptCompressed(const compressed_segment& segment);
+
+	// Also seal the segment once its first entry is this many seconds
+	// older than the one being appended, or 0 to only go by size
+			void		SetRotation(int64 seconds) { fRotation = seconds; }
+
+	// Drop the sealed segments past retention as of now (in seconds)
+			status_t	Prune(const log_retention& retention, int64 now,
+							uint64* _pruned = NULL, off_t* _freed = NULL);
+
+			status_t	Append(BMessage* message, int64 when,
+							const char* sender, uint32 flags = 0);
+	// Write the buffered entries, and if sync, wait for them to hit the disk
+			status_t	Flush(bool sync = false);
+			uint32		CountPending() const { return fPending.CountItems(); }
+
+	// Entries [FirstEntry(), CountEntries()) are in the log
+			uint64		FirstEntry() const;
+			uint64		CountEntries() const { return fEntries; }
+			status_t	EntryAt(uint64 index, log_entry* entry);
+	// Index of the first entry from when on, or CountEntries()
+			uint64		IndexOf(int64 when);
+	// Number of the segment holding the entry, as in its files' names
+			uint32		SegmentOf(uint64 index) const;
+
+	// Add count entries from first on to logs as "message"s, oldest first
+			status_t	ReadEntries(uint64 first, int32 count, BMessage* logs);
+			status_t	ReadLast(int32 count, BMessage* logs);
+	// Just the one entry's message, without adding it anywhere
+			status_t	ReadMessage(uint64 index, BMessage* message);
+
+			const char*	SenderAt(uint32 sender) const;
+
+	// Pick up segments and entries appended by another ChatLog
+			status_t	Refresh();
+
+private:
+	struct segment {
+		uint32	number;
+		uint64	first;
+		uint32	count;
+
+		const log_entry* entries;	// Mapped, or NULL
+		size_t	entriesSize;
+		const char* data;
+		size_t	dataSize;
+		CompressedSegment* compressed;	// Used instead of data, if sealed
+	};
+
+			status_t	_OpenForAppend();
+			status_t	_StartSegment(uint32 number);
+			int32		_SegmentFor(uint64 index) const;
+			BString		_SegmentPath(uint32 number, const char* suffix) const;
+			off_t		_SegmentSize(const segment& seg) const;
+			status_t	_WriteFirst(const segment& seg);
+
+	// Its entries, or those and their data, up to end
+			status_t	_MapEntries(segment& seg, uint32 end);
+			status_t	_MapSegment(segment& seg, uint32 end);
+			size_t		_MappedSize(const segment& seg) const;
+			const char*	_EntryData(segment& seg, uint32 index);
+			void		_UnmapSegment(segment& seg);
+			void		_UnmapData(segment& seg);
+			void		_UnmapSegments();
+			status_t	_ReadSegment(segment& seg, uint32 first,
+							uint32 count, BMessage* logs);
+
+			status_t	_CompressSegment(segment& seg);
+			status_t	_WriteCompressed(segment& seg, const char* suffix,
+							uint64* _rawBytes, size_t* _size);
+			status_t	_DropUncompressed(segment& seg, uint64 rawBytes,
+							uint64 compressedBytes);
+			status_t	_LoadDictionary(const segment* sample = NULL);
+			BString		_DictionaryPath() const;
+
+			status_t	_LoadSenders();
+			uint32		_SenderFor(const char* id);
+
+			BString		fPath;
+			status_t	fInitStatus;
+
+			List<segment> fSegments;
+			uint64		fEntries;
+
+			BFile		fData;
+			BFile		fIndex;
+			off_t		fDataSize;
+			int64		fRotation;
+			int64		fSegmentStart;	// When of its first entry
+
+			BMallocIO	fPendingData;
+			List<log_entry> fPending;
+
+			bool		fCompress;
+			BMallocIO	fDictionary;
+			bool		fDictionaryLoaded;
+			log_compression_stats fCompressionStats;
+
+			BFile		fSendersFile;
+			List<BString> fSenders;
+			KeyMap<BString, uint32> fSenderIds;
+};
+
+
+#endif // _CHAT_LOG_H
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "CompressedSegment.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <DataIO.h>
+#include <Entry.h>
+#include <File.h>
+#include <OS.h>
+#include <String.h>
+
+#include <zlib.h>
+
+#include "ChatLog.h"
+#include "FileUtils.h"
+
+
+const uint32 kCompressedMagic = 'CLgz';
+
+// Blocks are cut at the first entry boundary past this, so entries
+// never straddle two of them
+const uint32 kBlockSize = 64 * 1024;
+
+
+// A ".logz" file: header, block table, then the blocks
+struct CompressedSegment::header {
+	uint32	magic;
+	uint32	blocks;
+	uint32	dictionary;	// Adler-32 of the dictionary, or 0 for none
+	uint32	maxBlock;	// Largest block, uncompressed
+};
+
+
+// One more than there are blocks, the last one marking where they end
+struct CompressedSegment::block {
+	uint32	rawOffset;	// In the original ".log"
+	uint32	offset;		// In this file
+};
+
+
+CompressedSegment::CompressedSegment(const char* path)
+	:
+	fInitStatus(B_BAD_DATA),
+	fMap(NULL),
+	fSize(0),
+	fHeader(NULL),
+	fBlocks(NULL),
+	fStream(NULL),
+	fCached(-1),
+	fBuffer(NULL),
+	fDecoded(0),
+	fDecodeTime(0)
+{
+	fMap = (const char*)map_file(path, &fSize);
+	if (fMap == NULL) {
+		fInitStatus = B_ENTRY_NOT_FOUND;
+		return;
+	}
+	if (fSize < sizeof(header))
+		return;
+
+	fHeader = (const header*)fMap;
+	fBlocks = (const block*)(fMap + sizeof(header));
+	size_t tableEnd = sizeof(header) + sizeof(block) * (fHeader->blocks + 1);
+	if (fHeader->magic != kCompressedMagic || tableEnd > fSize
+		|| fBlocks[fHeader->blocks].offset > fSize)
+		return;
+
+	fBuffer = (char*)malloc(fHeader->maxBlock);
+	fStream = new z_stream;
+	memset(fStream, 0, sizeof(z_stream));
+	if (fBuffer == NULL || inflateInit(fStream) != Z_OK) {
+		delete fStream;
+		fStream = NULL;
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+	fInitStatus = B_OK;
+}
+
+
+CompressedSegment::~CompressedSegment()
+{
+	if (fStream != NULL)
+		inflateEnd(fStream);
+	delete fStream;
+	free(fBuffer);
+	unmap_file(fMap, fSize);
+}
+
+
+size_t
+CompressedSegment::RawSize() const
+{
+	if (fInitStatus != B_OK)
+		return 0;
+	return fBlocks[fHeader->blocks].rawOffset;
+}
+
+
+const char*
+CompressedSegment::DataAt(uint32 offset, uint32 length,
+	const void* dictionary, size_t dictionarySize)
+{
+	if (fInitStatus != B_OK)
+		return NULL;
+
+	int32 index = _BlockFor(offset);
+	if (index < 0 || offset + length > fBlocks[index + 1].rawOffset)
+		return NULL;
+	if (index != fCached
+		&& _Inflate(index, dictionary, dictionarySize) != B_OK)
+		return NULL;
+	return fBuffer + (offset - fBlocks[index].rawOffset);
+}
+
+
+status_t
+CompressedSegment::Write(const char* path, const char* data,
+	const log_entry* entries, uint32 count, const void* dictionary,
+	size_t dictionarySize, size_t* _size)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(z_stream));
+	if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return B_NO_MEMORY;
+
+	List<block> blocks;
+	BMallocIO compressed;
+	header head;
+	head.magic = kCompressedMagic;
+	head.dictionary = 0;
+	head.maxBlock = 0;
+	if (dictionarySize > 0)
+		head.dictionary = adler32(adler32(0, NULL, 0),
+			(const Bytef*)dictionary, dictionarySize);
+
+	status_t ret = B_OK;
+	uint32 i = 0;
+	while (ret == B_OK && i < count) {
+		uint32 start = entries[i].offset;
+		uint32 end = start;
+		while (i < count && (end == start || end - start < kBlockSize)) {
+			end = entries[i].offset + entries[i].length;
+			i++;
+		}
+
+		block item;
+		item.rawOffset = start;
+		item.offset = compressed.BufferLength();
+		blocks.AddItem(item);
+		if (end - start > head.maxBlock)
+			head.maxBlock = end - start;
+
+		deflateReset(&stream);
+		if (dictionarySize > 0)
+			deflateSetDictionary(&stream, (const Bytef*)dictionary,
+				dictionarySize);
+
+		uLong bound = deflateBound(&stream, end - start);
+		compressed.SetSize(item.offset + bound);
+		stream.next_in = (Bytef*)(data + start);
+		stream.avail_in = end - start;
+		stream.next_out = (Bytef*)compressed.Buffer() + item.offset;
+		stream.avail_out = bound;
+		if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+			ret = B_ERROR;
+		compressed.SetSize(item.offset + bound - stream.avail_out);
+	}
+	deflateEnd(&stream);
+	if (ret != B_OK)
+		return ret;
+
+	block last;
+	last.rawOffset = count > 0
+		? entries[count - 1].offset + entries[count - 1].length : 0;
+	last.offset = compressed.BufferLength();
+	blocks.AddItem(last);
+
+	head.blocks = blocks.CountItems() - 1;
+	uint32 blocksStart = sizeof(header) + sizeof(block) * blocks.CountItems();
+	for (block& item : blocks)
+		item.offset += blocksStart;
+
+	// Written aside, so it's either all there or not at all; the log writer
+	// and the compactor may both be at it
+	BString temp(path);
+	temp << ".tmp" << find_thread(NULL);
+	BFile file(temp.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	ret = file.InitCheck();
+	if (ret == B_OK)
+		ret = write_fully(file, 0, &head, sizeof(header));
+	if (ret == B_OK)
+		ret = write_fully(file, sizeof(header), &blocks.ItemAt(0),
+			sizeof(block) * blocks.CountItems());
+	if (ret == B_OK)
+		ret = write_fully(file, blocksStart, compressed.Buffer(),
+			compressed.BufferLength());
+	if (ret == B_OK)
+		ret = file.Sync();
+
+	BEntry entry(temp.String());
+	if (ret == B_OK)
+		ret = entry.Rename(path, true);
+	if (ret != B_OK)
+		entry.Remove();
+	else if (_size != NULL)
+		*_size = blocksStart + compressed.BufferLength();
+	return ret;
+}
+
+
+int32
+CompressedSegment::_BlockFor(uint32 offset) const
+{
+	// Last block starting at or before offset
+	int32 low = 0;
+	int32 high = fHeader->blocks;
+	while (low < high) {
+		int32 middle = (low + high) / 2;
+		if (fBlocks[middle + 1].rawOffset <= offset)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low < (int32)fHeader->blocks ? low : -1;
+}
+
+
+status_t
+CompressedSegment::_Inflate(int32 index, const void* dictionary,
+	size_t dictionarySize)
+{
+	bigtime_t start = system_time();
+	const block& item = fBlocks[index];
+	const block& next = fBlocks[index + 1];
+	uint32 rawSize = next.rawOffset - item.rawOffset;
+	if (next.offset < item.offset || next.offset > fSize
+		|| rawSize > fHeader->maxBlock)
+		return B_BAD_DATA;
+
+	fCached = -1;
+	inflateReset(fStream);
+	fStream->next_in = (Bytef*)(fMap + item.offset);
+	fStream->avail_in = next.offset - item.offset;
+	fStream->next_out = (Bytef*)fBuffer;
+	fStream->avail_out = rawSize;
+
+	int result = inflate(fStream, Z_FINISH);
+	if (result == Z_NEED_DICT) {
+		if (dictionarySize == 0 || fStream->adler != fHeader->dictionary
+			|| inflateSetDictionary(fStream, (const Bytef*)dictionary,
+				dictionarySize) != Z_OK)
+			return B_BAD_DATA;
+		result = inflate(fStream, Z_FINISH);
+	}
+	if (result != Z_STREAM_END || fStream->avail_out != 0)
+		return B_BAD_DATA;
+
+	fCached = index;
+	fDecoded += rawSize;
+	fDecodeTime += system_time() - start;
+	return B_OK;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPRESSED_SEGMENT_H
+#define _COMPRESSED_SEGMENT_H
+
+#include <SupportDefs.h>
+
+struct log_entry;
+struct z_stream_s;
+
+
+// A sealed segment's ".log" file, compressed into a ".logz": independent
+// zlib blocks of whole entries, behind a table of where each block starts
+// in the original. Reading an entry only inflates the block holding it,
+// and the last block inflated is kept for the entries next to it.
+// Blocks can be compressed with a preset dictionary, which makes up for
+// how little text each of them has; the file keeps its checksum, and
+// can't be read without the same dictionary.
+class CompressedSegment {
+public:
+						CompressedSegment(const char* path);
+						~CompressedSegment();
+
+			status_t	InitCheck() const { return fInitStatus; }
+
+	// Of the original file, and of this one
+			size_t		RawSize() const;
+			size_t		Size() const { return fSize; }
+
+	// The original bytes [offset, offset + length), or NULL; valid until
+	// the next call
+			const char*	DataAt(uint32 offset, uint32 length,
+							const void* dictionary, size_t dictionarySize);
+
+			uint64		DecodedBytes() const { return fDecoded; }
+			bigtime_t	DecodeTime() const { return fDecodeTime; }
+
+	// Compress the data of count entries to a ".logz" at path
+	static	status_t	Write(const char* path, const char* data,
+							const log_entry* entries, uint32 count,
+							const void* dictionary, size_t dictionarySize,
+							size_t* _size);
+
+private:
+	struct header;
+	struct block;
+
+			int32		_BlockFor(uint32 offset) const;
+			status_t	_Inflate(int32 index, const void* dictionary,
+							size_t dictionarySize);
+
+			status_t	fInitStatus;
+			const char*	fMap;
+			size_t		fSize;
+			const header* fHeader;
+			const block* fBlocks;
+
+			z_stream_s*	fStream;
+			int32		fCached;
+			char*		fBuffer;
+
+			uint64		fDecoded;
+			bigtime_t	fDecodeTime;
+};
+
+
+#endif // _COMPRESSED_SEGMENT_H
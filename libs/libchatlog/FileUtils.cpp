@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "FileUtils.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <Directory.h>
+#include <Entry.h>
+
+
+// Logs are looked for this deep below the directory given
+const int32 kMaxDepth = 4;
+
+
+static void
+find_logs(const BString& path, int32 depth, List<BString>* logs)
+{
+	BString senders(path);
+	senders << "/senders";
+	if (BEntry(senders.String()).Exists() == true) {
+		logs->AddItem(path);
+		return;
+	}
+	if (depth >= kMaxDepth)
+		return;
+
+	BDirectory dir(path.String());
+	BEntry entry;
+	char name[B_FILE_NAME_LENGTH];
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		if (entry.IsDirectory() == false || entry.GetName(name) != B_OK)
+			continue;
+		BString child(path);
+		child << "/" << name;
+		find_logs(child, depth + 1, logs);
+	}
+}
+
+
+status_t
+write_fully(BFile& file, off_t position, const void* buffer, size_t size)
+{
+	ssize_t written = file.WriteAt(position, buffer, size);
+	if (written < 0)
+		return written;
+	return (size_t)written == size ? B_OK : B_IO_ERROR;
+}
+
+
+const void*
+map_file(const char* path, size_t* _size)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	void* address = NULL;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		address = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+			address = NULL;
+		else
+			*_size = st.st_size;
+	}
+	close(fd);
+	return address;
+}
+
+
+void
+unmap_file(const void* address, size_t size)
+{
+	if (address != NULL)
+		munmap((void*)address, size);
+}
+
+
+void
+find_logs(const BString& path, List<BString>* logs)
+{
+	find_logs(path, 0, logs);
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _CHAT_LOG_FILE_UTILS_H
+#define _CHAT_LOG_FILE_UTILS_H
+
+#include <File.h>
+#include <String.h>
+
+#include <libsupport/List.h>
+
+
+status_t	write_fully(BFile& file, off_t position, const void* buffer,
+				size_t size);
+
+// Read-only mapping of the whole file, or NULL if it's empty
+const void*	map_file(const char* path, size_t* _size);
+void		unmap_file(const void* address, size_t size);
+
+// The ChatLogs' directories under path, which may be one itself
+void		find_logs(const BString& path, List<BString>* logs);
+
+
+#endif // _CHAT_LOG_FILE_UTILS_H
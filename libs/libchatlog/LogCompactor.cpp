@@ -0,0 +1,277 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogCompactor.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <Autolock.h>
+#include <File.h>
+#include <Message.h>
+
+#include "FileUtils.h"
+#include "LogWriter.h"
+
+
+// Longest it sleeps at once when throttled, so it quits quickly
+const bigtime_t kMaxThrottle = 100000;
+
+
+LogCompactor::LogCompactor(const char* path, const log_retention& defaults,
+	bigtime_t interval, LogWriter* writer)
+	:
+	fPath(path),
+	fDefaults(defaults),
+	fInterval(interval),
+	fRate(0),
+	fCompress(false),
+	fWriter(writer),
+	fOwnWriter(writer == NULL),
+	fQuitting(false),
+	fProgressLock("Log compactor progress"),
+	fPassAsked(false)
+{
+	memset(&fProgress, 0, sizeof(log_compactor_progress));
+
+	if (fOwnWriter == true) {
+		// Only flushed when it's asked to prune or compress
+		log_policy policy = { B_INFINITE_TIMEOUT, 0, 0, false, 0, 0 };
+		fWriter = new LogWriter(policy);
+	}
+
+	fWakeUp = create_sem(0, "Log compactor wake-up");
+	fThread = fWakeUp;
+	if (fWakeUp >= 0 && fWriter->InitCheck() != B_OK)
+		fThread = fWriter->InitCheck();
+	else if (fWakeUp >= 0)
+		fThread = spawn_thread(_CompactorThread, "Log compactor",
+			B_LOWEST_ACTIVE_PRIORITY, this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+	if (fThread >= 0 && fOwnWriter == false)
+		fWriter->SetCompactor(this);
+}
+
+
+LogCompactor::~LogCompactor()
+{
+	if (fThread >= 0 && fOwnWriter == false)
+		fWriter->SetCompactor(NULL);
+	fQuitting = true;
+	if (fThread >= 0) {
+		release_sem(fWakeUp);
+		status_t result;
+		wait_for_thread(fThread, &result);
+	}
+	if (fWakeUp >= 0)
+		delete_sem(fWakeUp);
+	if (fOwnWriter == true)
+		delete fWriter;
+}
+
+
+void
+LogCompactor::Compact()
+{
+	if (fThread < 0)
+		return;
+	{
+		BAutolock _(fProgressLock);
+		fPassAsked = true;
+	}
+	release_sem(fWakeUp);
+}
+
+
+void
+LogCompactor::Sealed(const char* logPath)
+{
+	if (fThread < 0 || fCompress == false)
+		return;
+	{
+		BAutolock _(fProgressLock);
+		BString path(logPath);
+		if (fSealed.IndexOf(path) >= 0)
+			return;
+		fSealed.AddItem(path);
+	}
+	release_sem_etc(fWakeUp, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+log_compactor_progress
+LogCompactor::Progress()
+{
+	BAutolock _(fProgressLock);
+	return fProgress;
+}
+
+
+status_t
+LogCompactor::ReadRetention(const char* path, log_retention* retention)
+{
+	BString filePath(path);
+	filePath << "/retention";
+	BFile file(filePath.String(), B_READ_ONLY);
+	BMessage settings;
+	status_t ret = file.InitCheck();
+	if (ret == B_OK)
+		ret = settings.Unflatten(&file);
+	if (ret != B_OK)
+		return ret;
+
+	retention->maxAge = settings.GetInt64("max_age", retention->maxAge);
+	retention->maxSize = settings.GetInt64("max_size", retention->maxSize);
+	retention->keepLast = settings.GetInt64("keep_last",
+		retention->keepLast);
+	return B_OK;
+}
+
+
+status_t
+LogCompactor::_CompactorThread(void* data)
+{
+	LogCompactor* compactor = (LogCompactor*)data;
+	bigtime_t interval = compactor->fInterval;
+	bigtime_t nextPass = interval == B_INFINITE_TIMEOUT
+		? B_INFINITE_TIMEOUT : system_time() + interval;
+	while (compactor->fQuitting == false) {
+		// Sealed segments wake it up too, without putting off the pass
+		bigtime_t timeout = nextPass == B_INFINITE_TIMEOUT
+			? B_INFINITE_TIMEOUT : std::max((bigtime_t)0,
+				nextPass - system_time());
+		status_t ret = acquire_sem_etc(compactor->fWakeUp, 1,
+			B_RELATIVE_TIMEOUT, timeout);
+		if (ret != B_OK && ret != B_TIMED_OUT && ret != B_INTERRUPTED)
+			break;
+		if (compactor->fQuitting == true)
+			break;
+
+		List<BString> sealed;
+		bool pass = nextPass != B_INFINITE_TIMEOUT
+			&& system_time() >= nextPass;
+		{
+			BAutolock _(compactor->fProgressLock);
+			sealed.AddList(std::move(compactor->fSealed));
+			compactor->fSealed.MakeEmpty();
+			pass = pass || compactor->fPassAsked;
+			compactor->fPassAsked = false;
+		}
+
+		// A pass compresses whatever's sealed anyway
+		if (pass == true) {
+			compactor->_Pass();
+			if (interval != B_INFINITE_TIMEOUT)
+				nextPass = system_time() + interval;
+			continue;
+		}
+		for (const BString& path : sealed) {
+			if (compactor->fQuitting == true)
+				break;
+			if (compactor->_CompressSealed(path) != B_OK) {
+				BAutolock _(compactor->fProgressLock);
+				compactor->fProgress.errors++;
+			}
+		}
+	}
+	return B_OK;
+}
+
+
+void
+LogCompactor::_Pass()
+{
+	List<BString> logs;
+	find_logs(fPath, &logs);
+	{
+		BAutolock _(fProgressLock);
+		fProgress.running = true;
+		fProgress.logsDone = 0;
+		fProgress.logsTotal = logs.CountItems();
+	}
+
+	for (const BString& path : logs) {
+		if (fQuitting == true)
+			break;
+		status_t ret = _Compact(path);
+
+		BAutolock _(fProgressLock);
+		fProgress.logsDone++;
+		if (ret != B_OK)
+			fProgress.errors++;
+	}
+
+	BAutolock _(fProgressLock);
+	fProgress.running = false;
+	if (fQuitting == false)
+		fProgress.passes++;
+}
+
+
+status_t
+LogCompactor::_Compact(const BString& path)
+{
+	log_retention retention = fDefaults;
+	BString parent(path);
+	parent.Truncate(std::max((int32)0, parent.FindLast('/')));
+	ReadRetention(parent.String(), &retention);
+	ReadRetention(path.String(), &retention);
+
+	uint64 pruned = 0;
+	off_t freed = 0;
+	status_t ret = fWriter->Prune(path.String(), retention, time(NULL),
+		&pruned, &freed);
+	{
+		BAutolock _(fProgressLock);
+		fProgress.entriesPruned += pruned;
+		fProgress.bytesFreed += freed;
+	}
+	if (ret != B_OK)
+		return ret;
+	return _CompressSealed(path);
+}
+
+
+status_t
+LogCompactor::_CompressSealed(const BString& path)
+{
+	// A segment at a time, each followed by as long a rest as the rate
+	// asks for
+	status_t ret = B_OK;
+	while (ret == B_OK && fCompress == true && fQuitting == false) {
+		uint64 read = 0;
+		uint64 written = 0;
+		ret = fWriter->CompressSealed(path.String(), 1, &read, &written);
+		if (read == 0)
+			break;
+
+		{
+			BAutolock _(fProgressLock);
+			fProgress.bytesRead += read;
+			fProgress.bytesWritten += written;
+		}
+		_Throttle(read + written);
+	}
+	return ret;
+}
+
+
+void
+LogCompactor::_Throttle(uint64 bytes)
+{
+	size_t rate = fRate;
+	if (rate == 0)
+		return;
+
+	bigtime_t rest = bytes * 1000000 / rate;
+	while (rest > 0 && fQuitting == false) {
+		bigtime_t nap = std::min(rest, kMaxThrottle);
+		snooze(nap);
+		rest -= nap;
+	}
+}
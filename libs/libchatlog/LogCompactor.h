@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_COMPACTOR_H
+#define _LOG_COMPACTOR_H
+
+#include <atomic>
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <libsupport/List.h>
+
+#include "ChatLog.h"
+
+class LogWriter;
+
+
+struct log_compactor_progress {
+	bool		running;		// In the middle of a pass
+	uint32		logsDone;		// Of the pass
+	uint32		logsTotal;
+	uint32		passes;			// Finished since it was started
+	uint64		entriesPruned;
+	uint64		bytesFreed;		// By pruning
+	uint64		bytesRead;		// To be compressed, and written
+	uint64		bytesWritten;
+	uint32		errors;			// Logs that couldn't be compacted
+};
+
+
+// Applies the retention policies to every ChatLog under a directory, and
+// compresses their sealed segments, on a thread of its own.
+// It makes a pass over the logs now and then, and wakes up for nothing
+// else; compression, which is most of its I/O, is throttled to a number of
+// bytes per second, so that it never competes with the live logs.
+// A log's retention is its directory's "retention" file, or else that of
+// the directory it's in (i.e. the account's), or else the default. The
+// files are flattened BMessages of the int64s "max_age", "max_size" and
+// "keep_last" (as in log_retention), each optional, taking the value of
+// the next in line when missing.
+// Entries are dropped with the segments holding them, see
+// ChatLog::Prune(), and their index runs with them.
+// Logs are pruned by the LogWriter writing them, so that it's the only
+// one writing them; without one, the compactor has its own, and nothing
+// else may be writing them. Sealed segments are compressed on the
+// compactor's thread, as soon as the writer tells it they're sealed, and
+// only swapped in by the writer (see LogWriter::CompressSealed()).
+class LogCompactor {
+public:
+	// Passes are made every interval, and whenever Compact() is called
+						LogCompactor(const char* path,
+							const log_retention& defaults,
+							bigtime_t interval, LogWriter* writer = NULL);
+	// Waits for the segment being compressed, if any
+						~LogCompactor();
+
+			status_t	InitCheck() const { return fThread < 0 ? fThread : B_OK; }
+
+	// Bytes per second, or 0 for no limit
+			void		SetRateLimit(size_t rate) { fRate = rate; }
+			void		SetCompression(bool compress)
+							{ fCompress = compress; }
+
+	// Make a pass now, rather than at the next interval
+			void		Compact();
+	// Compress the log's sealed segments, without waiting for a pass
+			void		Sealed(const char* logPath);
+
+			log_compactor_progress Progress();
+
+	// Override retention with the retention file of a log or account
+	// directory, if it has one
+	static	status_t	ReadRetention(const char* path,
+							log_retention* retention);
+
+private:
+	static	status_t	_CompactorThread(void* data);
+			void		_Pass();
+			status_t	_Compact(const BString& path);
+			status_t	_CompressSealed(const BString& path);
+			void		_Throttle(uint64 bytes);
+
+			BString		fPath;
+			log_retention fDefaults;
+			bigtime_t	fInterval;
+			std::atomic<size_t> fRate;
+			std::atomic<bool> fCompress;
+			LogWriter*	fWriter;
+			bool		fOwnWriter;
+
+			std::atomic<bool> fQuitting;
+			sem_id		fWakeUp;
+			thread_id	fThread;
+
+			BLocker		fProgressLock;
+			log_compactor_progress fProgress;
+			List<BString> fSealed;		// Both under the progress lock
+			bool		fPassAsked;
+};
+
+
+#endif // _LOG_COMPACTOR_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogExporter.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <Message.h>
+
+
+// Entries read from the log at once
+const int32 kExportPage = 256;
+
+
+LogExporter::LogExporter(BDataIO* output, export_format format)
+	:
+	LogFormatter(format),
+	fOutput(output)
+{
+}
+
+
+status_t
+LogExporter::Export(ChatLog& log, uint64 first, uint64 end)
+{
+	if (log.InitCheck() != B_OK)
+		return log.InitCheck();
+
+	first = std::max(first, log.FirstEntry());
+	end = std::min(end, log.CountEntries());
+	while (first < end) {
+		int32 count = std::min(end - first, (uint64)kExportPage);
+		BMessage logs;
+		status_t ret = log.ReadEntries(first, count, &logs);
+		if (ret != B_OK)
+			return ret;
+
+		BMessage message;
+		for (int32 i = 0; logs.FindMessage("message", i, &message) == B_OK;
+				i++) {
+			log_entry entry;
+			if (log.EntryAt(first + i, &entry) != B_OK)
+				break;
+
+			const char* body = message.GetString("body", "");
+			bool action = (entry.flags & LOG_ACTION) != 0;
+			if (action == true && strncmp(body, "/me ", 4) == 0)
+				body += 4;
+			ret = Add(entry.when, log.SenderAt(entry.sender),
+				message.GetString("user_name", NULL), body,
+				(entry.flags & LOG_OWN_MESSAGE) != 0, action);
+			if (ret != B_OK)
+				return ret;
+		}
+		first += count;
+	}
+	return B_OK;
+}
+
+
+int
+LogExporter::Write(const char* data, size_t length)
+{
+	ssize_t written = fOutput->Write(data, length);
+	if (written < 0)
+		return written;
+	return (size_t)written == length ? B_OK : B_IO_ERROR;
+}
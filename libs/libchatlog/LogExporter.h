@@ -0,0 +1,35 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_EXPORTER_H
+#define _LOG_EXPORTER_H
+
+#include <DataIO.h>
+
+#include "ChatLog.h"
+#include "LogFormatter.h"
+
+
+// Writes ChatLog entries out a page at a time, through LogFormatter's
+// buffer, so however long the log there's never more than a page of it in
+// memory.
+class LogExporter : public LogFormatter {
+public:
+						LogExporter(BDataIO* output, export_format format);
+
+	// Write entries [first, end) of log; can be called with several logs
+			status_t	Export(ChatLog& log, uint64 first = 0,
+							uint64 end = (uint64)-1);
+
+			uint64		CountExported() const { return CountFormatted(); }
+
+protected:
+	virtual	int			Write(const char* data, size_t length);
+
+private:
+			BDataIO*	fOutput;
+};
+
+
+#endif // _LOG_EXPORTER_H
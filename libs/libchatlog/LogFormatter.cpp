@@ -0,0 +1,212 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogFormatter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+// Output is written once there's this much of it
+const size_t kBufferSize = 64 * 1024;
+
+const char* kHtmlHead =
+	"<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>";
+const char* kHtmlStyle =
+	"</title>\n<style>\n"
+	"body { font-family: sans-serif; }\n"
+	"time { color: #888; }\n"
+	".own b { color: #36c; }\n"
+	".action { font-style: italic; }\n"
+	"</style>\n</head>\n<body>\n";
+const char* kHtmlFooter = "</body>\n</html>\n";
+
+
+LogFormatter::LogFormatter(export_format format)
+	:
+	fFormat(format),
+	fBegun(false),
+	fFormatted(0),
+	fMinute(-1)
+{
+	fBuffer.reserve(kBufferSize * 2);
+}
+
+
+LogFormatter::~LogFormatter()
+{
+}
+
+
+int
+LogFormatter::Add(int64_t when, const char* sender, const char* name,
+	const char* body, bool own, bool action)
+{
+	_Begin();
+	if (sender == NULL)
+		sender = "";
+	if (name == NULL || name[0] == '\0')
+		name = sender;
+
+	switch (fFormat) {
+		case LOG_EXPORT_TEXT:
+			fBuffer += '[';
+			_AddTime(when, "%Y-%m-%d %H:%M:%S");
+			if (action == true)
+				fBuffer.append("] * ").append(name).append(" ");
+			else
+				fBuffer.append("] <").append(name).append("> ");
+			fBuffer.append(body).append("\n");
+			break;
+
+		case LOG_EXPORT_JSONL:
+		{
+			char number[32];
+			snprintf(number, sizeof(number), "%lld", (long long)when);
+			fBuffer.append("{\"when\":").append(number);
+			fBuffer.append(",\"sender\":");
+			_AddJsonString(sender);
+			fBuffer.append(",\"name\":");
+			_AddJsonString(name);
+			fBuffer.append(",\"body\":");
+			_AddJsonString(body);
+			if (own == true)
+				fBuffer.append(",\"own\":true");
+			if (action == true)
+				fBuffer.append(",\"action\":true");
+			fBuffer.append("}\n");
+			break;
+		}
+
+		case LOG_EXPORT_HTML:
+			fBuffer.append("<p class=\"message");
+			if (own == true)
+				fBuffer.append(" own");
+			if (action == true)
+				fBuffer.append(" action");
+			fBuffer.append("\"><time datetime=\"");
+			_AddTime(when, "%Y-%m-%dT%H:%M:%S");
+			fBuffer.append("\">");
+			_AddTime(when, "%Y-%m-%d %H:%M");
+			fBuffer.append("</time> <b>");
+			if (action == true)
+				fBuffer.append("* ");
+			_AddHtml(name);
+			fBuffer.append("</b> ");
+			_AddHtml(body);
+			fBuffer.append("</p>\n");
+			break;
+	}
+	fFormatted++;
+	return _Write(false);
+}
+
+
+int
+LogFormatter::Finish()
+{
+	_Begin();
+	if (fFormat == LOG_EXPORT_HTML)
+		fBuffer.append(kHtmlFooter);
+	return _Write(true);
+}
+
+
+void
+LogFormatter::_Begin()
+{
+	if (fBegun == true)
+		return;
+	fBegun = true;
+
+	if (fFormat == LOG_EXPORT_HTML) {
+		fBuffer.append(kHtmlHead);
+		_AddHtml(fTitle.c_str());
+		fBuffer.append(kHtmlStyle);
+	}
+}
+
+
+void
+LogFormatter::_AddTime(int64_t when, const char* format)
+{
+	time_t time = when;
+	time_t minute = time - (time % 60 + 60) % 60;
+	if (minute != fMinute) {
+		if (localtime_r(&minute, &fLocal) == NULL)
+			return;
+		fMinute = minute;
+	}
+	struct tm local = fLocal;
+	local.tm_sec = time - minute;
+
+	char buffer[64];
+	size_t length = strftime(buffer, sizeof(buffer), format, &local);
+	fBuffer.append(buffer, length);
+}
+
+
+void
+LogFormatter::_AddJsonString(const char* text)
+{
+	fBuffer += '"';
+	const char* start = text;
+	for (const char* c = text; *c != '\0'; c++) {
+		if ((uint8_t)*c >= 0x20 && *c != '"' && *c != '\\')
+			continue;
+
+		fBuffer.append(start, c - start);
+		switch (*c) {
+			case '"':	fBuffer.append("\\\"");	break;
+			case '\\':	fBuffer.append("\\\\");	break;
+			case '\n':	fBuffer.append("\\n");	break;
+			case '\r':	fBuffer.append("\\r");	break;
+			case '\t':	fBuffer.append("\\t");	break;
+			default:
+			{
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", (uint8_t)*c);
+				fBuffer.append(escape);
+			}
+		}
+		start = c + 1;
+	}
+	fBuffer.append(start).append("\"");
+}
+
+
+void
+LogFormatter::_AddHtml(const char* text)
+{
+	const char* start = text;
+	for (const char* c = text; *c != '\0'; c++) {
+		const char* entity = NULL;
+		switch (*c) {
+			case '&':	entity = "&amp;";	break;
+			case '<':	entity = "&lt;";	break;
+			case '>':	entity = "&gt;";	break;
+			case '"':	entity = "&quot;";	break;
+			case '\n':	entity = "<br>";	break;
+			default:	continue;
+		}
+		fBuffer.append(start, c - start);
+		fBuffer.append(entity);
+		start = c + 1;
+	}
+	fBuffer.append(start);
+}
+
+
+int
+LogFormatter::_Write(bool all)
+{
+	if (fBuffer.empty() == true
+		|| (all == false && fBuffer.size() < kBufferSize))
+		return 0;
+
+	int ret = Write(fBuffer.data(), fBuffer.size());
+	fBuffer.clear();
+	return ret;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_FORMATTER_H
+#define _LOG_FORMATTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+
+enum export_format {
+	LOG_EXPORT_TEXT,	// "[date] <sender> body", as the plain-text logs
+	LOG_EXPORT_JSONL,	// A JSON object per line
+	LOG_EXPORT_HTML
+};
+
+
+// Formats messages as text, JSON lines or an HTML page, for Write() to
+// write out; it's plain C++, as LogParser, so it can be built anywhere.
+// Output is buffered, and written out once there's enough of it.
+class LogFormatter {
+public:
+						LogFormatter(export_format format);
+	virtual				~LogFormatter();
+
+	// Of the HTML page
+			void		SetTitle(const char* title) { fTitle = title; }
+
+	// Returns 0, or what Write() failed with
+			int			Add(int64_t when, const char* sender,
+							const char* name, const char* body, bool own,
+							bool action);
+	// Close the HTML page, and write out what's still buffered
+			int			Finish();
+
+			uint64_t	CountFormatted() const { return fFormatted; }
+
+protected:
+	// Returns 0, or an errno
+	virtual	int			Write(const char* data, size_t length) = 0;
+
+private:
+			void		_Begin();
+			void		_AddTime(int64_t when, const char* format);
+			void		_AddJsonString(const char* text);
+			void		_AddHtml(const char* text);
+			int			_Write(bool all);
+
+			export_format fFormat;
+			std::string	fTitle;
+			std::string	fBuffer;
+			bool		fBegun;
+			uint64_t	fFormatted;
+
+			// localtime_r() is slow, and most messages share a minute
+			time_t		fMinute;
+			struct tm	fLocal;
+};
+
+
+#endif // _LOG_FORMATTER_H
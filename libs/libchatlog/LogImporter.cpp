@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogImporter.h"
+
+#include "ChatLog.h"
+
+
+// Entries appended before they're flushed
+const uint32 kImportBatch = 4096;
+
+
+LogImporter::LogImporter(ChatLog* log, const BMessage& base)
+	:
+	fLog(log),
+	fMessage(base),
+	fImported(0)
+{
+	// Only ever replaced after
+	const char* kFields[] = {"body", "user_id", "user_name"};
+	for (const char* field : kFields) {
+		fMessage.RemoveName(field);
+		fMessage.AddString(field, "");
+	}
+	fMessage.RemoveName("when");
+	fMessage.AddInt64("when", 0);
+}
+
+
+LogImporter::~LogImporter()
+{
+	Flush();
+}
+
+
+status_t
+LogImporter::ImportFile(const char* path, import_format format)
+{
+	// errno values are status_t's
+	status_t ret = ParseFile(path, format);
+	if (ret == B_OK)
+		ret = Flush();
+	return ret;
+}
+
+
+status_t
+LogImporter::Add(BMessage* message, int64 when, const char* sender,
+	uint32 flags)
+{
+	status_t ret = fLog->Append(message, when, sender, flags);
+	if (ret != B_OK)
+		return ret;
+
+	fImported++;
+	if (fLog->CountPending() >= kImportBatch)
+		return fLog->Flush();
+	return B_OK;
+}
+
+
+status_t
+LogImporter::Flush()
+{
+	return fLog->Flush();
+}
+
+
+int
+LogImporter::MessageParsed(const parsed_message& message)
+{
+	fNick.SetTo(message.nick, message.nickLength);
+	if (message.action == true) {
+		fBody = "/me ";
+		fBody.Append(message.body, message.bodyLength);
+	} else
+		fBody.SetTo(message.body, message.bodyLength);
+
+	uint32 flags = 0;
+	if (message.action == true)
+		flags |= LOG_ACTION;
+	if (fNick == fOwnNick)
+		flags |= LOG_OWN_MESSAGE;
+
+	fMessage.ReplaceString("body", fBody.String());
+	fMessage.ReplaceString("user_id", fNick.String());
+	fMessage.ReplaceString("user_name", fNick.String());
+	fMessage.ReplaceInt64("when", message.when);
+	return Add(&fMessage, message.when, fNick.String(), flags);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_IMPORTER_H
+#define _LOG_IMPORTER_H
+
+#include <Message.h>
+#include <String.h>
+
+#include "LogParser.h"
+
+class ChatLog;
+
+
+// Appends the messages LogParser parses to a ChatLog.
+// Entries are flushed in batches, so memory use doesn't depend on the
+// logs' size. Entries are appended, so logs have to be imported oldest
+// first, and before anything newer's been logged.
+class LogImporter : public LogParser {
+public:
+	// Entries are made of a copy of base, with the "body", "user_id",
+	// "user_name" and "when" of each message
+						LogImporter(ChatLog* log, const BMessage& base);
+	// Flushes what's left
+	virtual				~LogImporter();
+
+	// Messages from nick are marked as the user's own
+			void		SetOwnNick(const char* nick) { fOwnNick = nick; }
+
+			status_t	ImportFile(const char* path,
+							import_format format = LOG_IMPORT_AUTO);
+	// A message already in the ChatLog's format
+			status_t	Add(BMessage* message, int64 when, const char* sender,
+							uint32 flags);
+			status_t	Flush();
+
+			uint64		CountImported() const { return fImported; }
+
+	virtual	int			MessageParsed(const parsed_message& message);
+
+private:
+			ChatLog*	fLog;
+			BMessage	fMessage;
+			BString		fOwnNick;
+			BString		fNick;
+			BString		fBody;
+
+			uint64		fImported;
+};
+
+
+#endif // _LOG_IMPORTER_H
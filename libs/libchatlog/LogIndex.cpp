@@ -0,0 +1,1003 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogIndex.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <DataIO.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <Message.h>
+#include <UnicodeChar.h>
+
+#include "ChatLog.h"
+#include "FileUtils.h"
+
+
+const uint32 kRunMagic = 'CLix';
+
+// Entries buffered before they're written as a run
+const uint64 kRunEntries = 4096;
+// Runs of a size merged into one of the next
+const uint32 kMergeRuns = 4;
+// Longer words are truncated
+const int32 kMaxTermLength = 64;
+// Senders are indexed as terms, which can't contain this
+const char kSenderPrefix = '@';
+// Entries of a term's postings per block
+const uint32 kBlockEntries = 128;
+
+// Of a run_header
+enum {
+	kRunPositions	= 1 << 0,	// Its entries have their terms' positions
+	kRunBlocks		= 1 << 1	// Its terms in more than kBlockEntries
+								// have a block table
+};
+
+
+// A run file: header, term table, term strings, then postings
+struct run_header {
+	uint32	magic;
+	uint32	level;		// How many times its entries have been merged
+	uint64	first;		// Entries covered, [first, end)
+	uint64	end;
+	uint32	terms;
+	uint32	flags;
+};
+
+
+struct run_term {
+	uint32	offset;		// Of the term's string, from the start of the file
+	uint32	length;
+	uint32	postings;	// Of the term's postings
+	uint32	size;
+	uint32	count;
+};
+
+
+// A term's block table comes first in its postings, if it has one; each
+// block's deltas are from the last entry of the one before it. Entries
+// aren't aligned, and are read with memcpy().
+struct run_block {
+	uint64	last;		// Its last entry
+	uint32	offset;		// Of its postings, from the end of the table
+	uint32	size;
+};
+
+
+struct LogIndex::run {
+	uint32				number;
+	const char*			address;
+	size_t				size;
+	const run_header*	header;
+	const run_term*		terms;
+};
+
+
+static int
+compare_term(const char* a, uint32 aLength, const char* b, uint32 bLength)
+{
+	int result = memcmp(a, b, std::min(aLength, bLength));
+	if (result != 0)
+		return result;
+	return (int)aLength - (int)bLength;
+}
+
+
+// Little-endian base-128
+static inline uint64
+read_varint(const uint8*& position, const uint8* end)
+{
+	uint64 value = 0;
+	for (int shift = 0; position < end; shift += 7) {
+		uint8 byte = *position++;
+		value |= (uint64)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			break;
+	}
+	return value;
+}
+
+
+static inline void
+write_varint(BMallocIO& output, uint64 value)
+{
+	uint8 bytes[10];
+	int32 count = 0;
+	do {
+		bytes[count] = value & 0x7f;
+		value >>= 7;
+		if (value != 0)
+			bytes[count] |= 0x80;
+		count++;
+	} while (value != 0);
+	output.Write(bytes, count);
+}
+
+
+static inline uint32
+table_size(uint32 count, uint32 flags)
+{
+	if ((flags & kRunBlocks) == 0 || count <= kBlockEntries)
+		return 0;
+	return (count + kBlockEntries - 1) / kBlockEntries * sizeof(run_block);
+}
+
+
+// Postings are the deltas between a term's entries, as varints; in runs
+// with positions, each is followed by the count of its positions and the
+// deltas between them. Those are only kept if asked for. Blocks follow
+// each other, so past the table they're decoded as one.
+static void
+decode_postings(const char* address, const run_term& term, uint32 flags,
+	List<uint64>* entries, List<uint32>* starts = NULL,
+	List<uint32>* positions = NULL)
+{
+	const uint8* position = (const uint8*)address + term.postings;
+	const uint8* end = position + term.size;
+	position += std::min(table_size(term.count, flags), term.size);
+	bool positioned = (flags & kRunPositions) != 0;
+	if (starts != NULL && starts->IsEmpty() == true)
+		starts->AddItem(positions->CountItems());
+
+	uint64 entry = 0;
+	while (position < end) {
+		entry += read_varint(position, end);
+		entries->AddItem(entry);
+		if (positioned == true) {
+			uint64 count = read_varint(position, end);
+			uint32 word = 0;
+			for (uint64 i = 0; i < count; i++) {
+				word += read_varint(position, end);
+				if (positions != NULL)
+					positions->AddItem(word);
+			}
+		}
+		if (starts != NULL)
+			starts->AddItem(positions->CountItems());
+	}
+}
+
+
+static inline bool
+term_fits(const run_term& term, size_t size)
+{
+	return (size_t)term.offset + term.length <= size
+		&& (size_t)term.postings + term.size <= size;
+}
+
+
+// The term's entry in the run's table, if it's there and within the file
+static const run_term*
+find_term(const char* address, size_t size, const run_term* terms,
+	uint32 count, const BString& key)
+{
+	int32 low = 0;
+	int32 high = count - 1;
+	while (low <= high) {
+		int32 middle = low + (high - low) / 2;
+		const run_term& term = terms[middle];
+		if (term_fits(term, size) == false)
+			return NULL;
+		int result = compare_term(address + term.offset, term.length,
+			key.String(), key.Length());
+		if (result == 0)
+			return &term;
+		if (result < 0)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return NULL;
+}
+
+
+// Writes a run, given its terms in order, each term's entries in order,
+// and each entry's positions in order
+class RunBuilder {
+public:
+	RunBuilder(bool positions)
+		:
+		fFlags(kRunBlocks | (positions == true ? kRunPositions : 0)),
+		fBlockStart(0),
+		fBlockEntries(0),
+		fLast(0),
+		fEntry(0),
+		fHasEntry(false)
+	{
+	}
+
+	void StartTerm(const char* term, uint32 length)
+	{
+		_EndTerm();
+
+		run_term entry;
+		entry.offset = fStrings.BufferLength();
+		entry.length = length;
+		entry.postings = fPostings.BufferLength();
+		entry.size = 0;
+		entry.count = 0;
+		fTerms.AddItem(entry);
+		fStrings.Write(term, length);
+		fLast = 0;
+	}
+
+	// An entry's written once all its positions are in
+	void AddEntry(uint64 entry, uint32 position)
+	{
+		if (fHasEntry == true && entry == fEntry) {
+			if (fPositions.ItemAt(fPositions.CountItems() - 1) != position)
+				fPositions.AddItem(position);
+			return;
+		}
+
+		_EndEntry();
+		fEntry = entry;
+		fHasEntry = true;
+		fPositions.MakeEmpty();
+		fPositions.AddItem(position);
+		fTerms.ItemAt(fTerms.CountItems() - 1).count++;
+	}
+
+	status_t Write(const char* path, uint64 first, uint64 end, uint32 level)
+	{
+		_EndTerm();
+
+		run_header header;
+		header.magic = kRunMagic;
+		header.level = level;
+		header.first = first;
+		header.end = end;
+		header.terms = fTerms.CountItems();
+		header.flags = fFlags;
+
+		uint32 strings = sizeof(run_header) + sizeof(run_term) * header.terms;
+		uint32 postings = strings + fStrings.BufferLength();
+		for (run_term& term : fTerms) {
+			term.offset += strings;
+			term.postings += postings;
+		}
+
+		// Written aside, so a run is either all there or not at all
+		BString temp(path);
+		temp << ".tmp";
+		BFile file(temp.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+		status_t ret = file.InitCheck();
+		off_t position = 0;
+		if (ret == B_OK)
+			ret = write_fully(file, position, &header, sizeof(run_header));
+		position += sizeof(run_header);
+		if (ret == B_OK && header.terms > 0)
+			ret = write_fully(file, position, &fTerms.ItemAt(0),
+				sizeof(run_term) * header.terms);
+		position += sizeof(run_term) * header.terms;
+		if (ret == B_OK)
+			ret = write_fully(file, position, fStrings.Buffer(),
+				fStrings.BufferLength());
+		position += fStrings.BufferLength();
+		if (ret == B_OK)
+			ret = write_fully(file, position, fPostings.Buffer(),
+				fPostings.BufferLength());
+		if (ret == B_OK)
+			ret = file.Sync();
+
+		BEntry entry(temp.String());
+		if (ret == B_OK)
+			ret = entry.Rename(path, true);
+		if (ret != B_OK)
+			entry.Remove();
+		return ret;
+	}
+
+private:
+	void _EndEntry()
+	{
+		if (fHasEntry == false)
+			return;
+		write_varint(fTermPostings, fEntry - fLast);
+		fLast = fEntry;
+		fHasEntry = false;
+		if ((fFlags & kRunPositions) != 0) {
+			write_varint(fTermPostings, fPositions.CountItems());
+			uint32 last = 0;
+			for (uint32 position : fPositions) {
+				write_varint(fTermPostings, position - last);
+				last = position;
+			}
+		}
+
+		if (++fBlockEntries == kBlockEntries)
+			_EndBlock();
+	}
+
+	void _EndBlock()
+	{
+		if (fBlockEntries == 0)
+			return;
+		run_block block;
+		block.last = fLast;
+		block.offset = fBlockStart;
+		block.size = fTermPostings.BufferLength() - fBlockStart;
+		fBlocks.AddItem(block);
+		fBlockStart = fTermPostings.BufferLength();
+		fBlockEntries = 0;
+	}
+
+	// The term's postings are kept aside until its block table's known
+	void _EndTerm()
+	{
+		_EndEntry();
+		if (fTerms.IsEmpty() == true)
+			return;
+		_EndBlock();
+
+		run_term& term = fTerms.ItemAt(fTerms.CountItems() - 1);
+		if (table_size(term.count, fFlags) > 0) {
+			for (const run_block& block : fBlocks)
+				fPostings.Write(&block, sizeof(run_block));
+		}
+		fPostings.Write(fTermPostings.Buffer(), fTermPostings.BufferLength());
+		term.size = fPostings.BufferLength() - term.postings;
+
+		fTermPostings.SetSize(0);
+		fTermPostings.Seek(0, SEEK_SET);
+		fBlocks.MakeEmpty();
+		fBlockStart = 0;
+	}
+
+	uint32			fFlags;
+	List<run_term>	fTerms;
+	BMallocIO		fStrings;
+	BMallocIO		fPostings;
+	BMallocIO		fTermPostings;	// Of the term being added
+	List<run_block>	fBlocks;
+	uint32			fBlockStart;
+	uint32			fBlockEntries;
+	uint64			fLast;		// Written
+	uint64			fEntry;		// Being added
+	bool			fHasEntry;
+	List<uint32>	fPositions;
+};
+
+
+LogPostings::LogPostings()
+	:
+	fCount(0),
+	fRun(-1),
+	fBlock(0),
+	fBlockStart(NULL),
+	fBlockEnd(NULL),
+	fCurrent(0)
+{
+}
+
+
+bool
+LogPostings::Seek(uint64 entry)
+{
+	// Back within the block, as lookups going newest first mostly are
+	if (fEntries.IsEmpty() == false && entry >= fEntries.ItemAt(0)
+		&& entry <= fEntries.ItemAt(fCurrent)) {
+		while (fEntries.ItemAt(fCurrent) > entry)
+			fCurrent--;
+		return true;
+	}
+
+	// Runs are in the order of their entries
+	int32 run = fRuns.CountItems() - 1;
+	while (run >= 0 && fRuns.ItemAt(run).first > entry)
+		run--;
+	for (; run >= 0; run--) {
+		if (_SeekIn(run, entry) == true)
+			return true;
+	}
+	return false;
+}
+
+
+uint32
+LogPostings::CountPositions() const
+{
+	if (fPositions.IsEmpty() == true)
+		return 0;
+	const uint8* position = fBlockStart + fPositions.ItemAt(fCurrent);
+	return read_varint(position, fBlockEnd);
+}
+
+
+void
+LogPostings::GetPositions(List<uint32>* words) const
+{
+	if (fPositions.IsEmpty() == true)
+		return;
+	const uint8* position = fBlockStart + fPositions.ItemAt(fCurrent);
+	uint64 count = read_varint(position, fBlockEnd);
+	uint32 word = 0;
+	for (uint64 i = 0; i < count; i++) {
+		word += read_varint(position, fBlockEnd);
+		words->AddItem(word);
+	}
+}
+
+
+bool
+LogPostings::HasPosition(uint32 word) const
+{
+	if (fPositions.IsEmpty() == true)
+		return false;
+	const uint8* position = fBlockStart + fPositions.ItemAt(fCurrent);
+	uint64 count = read_varint(position, fBlockEnd);
+	uint32 at = 0;
+	for (uint64 i = 0; i < count && at <= word; i++) {
+		at += read_varint(position, fBlockEnd);
+		if (at == word)
+			return true;
+	}
+	return false;
+}
+
+
+void
+LogPostings::_AddRun(const char* postings, uint32 size, uint32 count,
+	uint32 flags, uint64 first)
+{
+	run_postings item;
+	uint32 table = table_size(count, flags);
+	if (table > size)
+		return;
+	item.table = table > 0 ? (const uint8*)postings : NULL;
+	item.data = (const uint8*)postings + table;
+	item.size = size - table;
+	item.count = count;
+	item.flags = flags;
+	item.first = first;
+	fRuns.AddItem(item);
+	fCount += count;
+}
+
+
+bool
+LogPostings::_SeekIn(int32 run, uint64 entry)
+{
+	const run_postings& item = fRuns.ItemAt(run);
+	uint32 blocks = item.table == NULL
+		? 1 : (item.count + kBlockEntries - 1) / kBlockEntries;
+
+	// The first block that ends at or past the entry, or the last one
+	uint32 block = blocks - 1;
+	if (item.table != NULL) {
+		uint32 low = 0;
+		uint32 high = blocks - 1;
+		while (low < high) {
+			uint32 middle = low + (high - low) / 2;
+			uint64 last;
+			memcpy(&last, item.table + middle * sizeof(run_block)
+				+ offsetof(run_block, last), sizeof(uint64));
+			if (last < entry)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		block = low;
+	}
+
+	// It only starts past the entry if the one before ends before it
+	for (uint32 tries = 0; tries < 2 && tries <= block; tries++) {
+		uint32 i = block - tries;
+		if (fRun != run || fBlock != i || fEntries.IsEmpty() == true)
+			_Decode(run, i);
+		List<uint64>::const_iterator at = std::upper_bound(fEntries.begin(),
+			fEntries.end(), entry);
+		if (at != fEntries.begin()) {
+			fCurrent = at - fEntries.begin() - 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void
+LogPostings::_Decode(int32 run, uint32 block)
+{
+	const run_postings& item = fRuns.ItemAt(run);
+	fRun = run;
+	fBlock = block;
+	fEntries.MakeEmpty();
+	fPositions.MakeEmpty();
+	fCurrent = 0;
+
+	const uint8* position = item.data;
+	const uint8* end = item.data + item.size;
+	uint64 base = 0;
+	if (item.table != NULL) {
+		run_block entry;
+		memcpy(&entry, item.table + block * sizeof(run_block),
+			sizeof(run_block));
+		if (block > 0)
+			memcpy(&base, item.table + (block - 1) * sizeof(run_block)
+				+ offsetof(run_block, last), sizeof(uint64));
+		if (entry.offset > item.size || entry.size > item.size - entry.offset)
+			return;
+		position = item.data + entry.offset;
+		end = position + entry.size;
+	}
+
+	// Positions are only decoded if they're asked for
+	bool positioned = (item.flags & kRunPositions) != 0;
+	fBlockStart = position;
+	fBlockEnd = end;
+	uint64 entry = base;
+	while (position < end) {
+		entry += read_varint(position, end);
+		fEntries.AddItem(entry);
+		if (positioned == false)
+			continue;
+
+		fPositions.AddItem(position - fBlockStart);
+		uint64 count = read_varint(position, end);
+		for (uint64 i = 0; i < count && position < end; i++) {
+			while (position < end && (*position++ & 0x80) != 0)
+				;
+		}
+	}
+	if (fEntries.IsEmpty() == false)
+		fCurrent = fEntries.CountItems() - 1;
+}
+
+
+LogIndex::LogIndex(const char* path)
+	:
+	fPath(path),
+	fInitStatus(B_BAD_VALUE),
+	fNextRun(0),
+	fIndexed(0),
+	fPendingEnd(0)
+{
+	if (path == NULL)
+		return;
+
+	fInitStatus = create_directory(path, 0755);
+	if (fInitStatus == B_OK)
+		fInitStatus = _Load();
+	fPendingEnd = fIndexed;
+}
+
+
+LogIndex::~LogIndex()
+{
+	Flush();
+	for (run* item : fRuns)
+		_CloseRun(item);
+}
+
+
+status_t
+LogIndex::Add(uint64 entry, const char* text, const char* sender)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+	if (entry < fPendingEnd)
+		return B_OK;
+
+	List<BString> tokens;
+	Tokenize(text, &tokens);
+	for (uint32 i = 0; i < tokens.CountItems(); i++) {
+		posting item;
+		item.term = tokens.ItemAt(i);
+		item.entry = entry;
+		item.position = i;
+		fPending.AddItem(item);
+	}
+
+	if (sender != NULL && sender[0] != '\0') {
+		posting item;
+		item.term << kSenderPrefix << sender;
+		item.entry = entry;
+		item.position = 0;
+		fPending.AddItem(item);
+	}
+
+	fPendingEnd = entry + 1;
+	if (fPendingEnd - fIndexed >= kRunEntries)
+		return Flush();
+	return B_OK;
+}
+
+
+status_t
+LogIndex::CatchUp(ChatLog* log, uint64 count)
+{
+	const int32 kPage = 1024;
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	// Whatever was pruned before it was indexed is gone
+	fPendingEnd = std::max(fPendingEnd, log->FirstEntry());
+	uint64 end = log->CountEntries();
+	if (count > 0)
+		end = std::min(end, fPendingEnd + count);
+	while (fPendingEnd < end) {
+		uint64 first = fPendingEnd;
+		int32 page = std::min(end - first, (uint64)kPage);
+
+		BMessage logs;
+		status_t ret = log->ReadEntries(first, page, &logs);
+		if (ret != B_OK)
+			return ret;
+
+		BMessage message;
+		for (int32 i = 0; i < page; i++) {
+			log_entry entry;
+			if (logs.FindMessage("message", i, &message) != B_OK
+				|| log->EntryAt(first + i, &entry) != B_OK)
+				return B_BAD_DATA;
+			Add(first + i, message.FindString("body"),
+				log->SenderAt(entry.sender));
+		}
+	}
+	return B_OK;
+}
+
+
+status_t
+LogIndex::Flush()
+{
+	if (fInitStatus != B_OK || fPendingEnd <= fIndexed)
+		return B_OK;
+
+	std::sort(fPending.begin(), fPending.end(),
+		[](const posting& a, const posting& b) {
+			int result = compare_term(a.term.String(), a.term.Length(),
+				b.term.String(), b.term.Length());
+			if (result != 0)
+				return result < 0;
+			return a.entry != b.entry
+				? a.entry < b.entry : a.position < b.position;
+		});
+
+	RunBuilder builder(true);
+	const BString* last = NULL;
+	for (const posting& item : fPending) {
+		if (last == NULL || *last != item.term) {
+			builder.StartTerm(item.term.String(), item.term.Length());
+			last = &item.term;
+		}
+		builder.AddEntry(item.entry, item.position);
+	}
+
+	uint32 number = fNextRun++;
+	status_t ret = builder.Write(_RunPath(number).String(), fIndexed,
+		fPendingEnd, 0);
+	if (ret == B_OK)
+		ret = _AddRun(number);
+
+	// On failure they're dropped, and can be indexed again by CatchUp()
+	if (ret == B_OK)
+		fIndexed = fPendingEnd;
+	else
+		fPendingEnd = fIndexed;
+	fPending.MakeEmpty();
+	return ret;
+}
+
+
+status_t
+LogIndex::Merge()
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	status_t ret = B_OK;
+	while ((ret = _MergeRuns()) == B_OK)
+		;
+	return ret == B_ENTRY_NOT_FOUND ? B_OK : ret;
+}
+
+
+status_t
+LogIndex::Prune(uint64 first)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	// Runs are in the order of their entries
+	while (fRuns.IsEmpty() == false && fRuns.ItemAt(0)->header->end <= first) {
+		status_t ret = BEntry(_RunPath(fRuns.ItemAt(0)->number).String())
+			.Remove();
+		if (ret != B_OK && ret != B_ENTRY_NOT_FOUND)
+			return ret;
+		_CloseRun(fRuns.ItemAt(0));
+		fRuns.RemoveItemAt(0);
+	}
+	return B_OK;
+}
+
+
+status_t
+LogIndex::FindTerm(const char* term, List<uint64>* entries)
+{
+	List<BString> tokens;
+	Tokenize(term, &tokens);
+	if (tokens.CountItems() != 1)
+		return B_BAD_VALUE;
+	return _Find(tokens.ItemAt(0), entries);
+}
+
+
+status_t
+LogIndex::FindSender(const char* sender, List<uint64>* entries)
+{
+	BString key;
+	key << kSenderPrefix << sender;
+	return _Find(key, entries);
+}
+
+
+status_t
+LogIndex::FindTerm(const char* term, LogPostings* postings)
+{
+	List<BString> tokens;
+	Tokenize(term, &tokens);
+	if (tokens.CountItems() != 1)
+		return B_BAD_VALUE;
+	return _Find(tokens.ItemAt(0), NULL, postings);
+}
+
+
+status_t
+LogIndex::FindSender(const char* sender, LogPostings* postings)
+{
+	BString key;
+	key << kSenderPrefix << sender;
+	return _Find(key, NULL, postings);
+}
+
+
+void
+LogIndex::Tokenize(const char* text, List<BString>* tokens)
+{
+	if (text == NULL)
+		return;
+
+	BString token;
+	const char* position = text;
+	while (*position != '\0') {
+		uint32 c = BUnicodeChar::FromUTF8(&position);
+		if (BUnicodeChar::IsAlNum(c) == false) {
+			if (token.IsEmpty() == false)
+				tokens->AddItem(token);
+			token = "";
+			continue;
+		}
+
+		char buffer[8];
+		char* end = buffer;
+		BUnicodeChar::ToUTF8(BUnicodeChar::ToLower(c), &end);
+		if (token.Length() + (end - buffer) <= kMaxTermLength)
+			token.Append(buffer, end - buffer);
+	}
+	if (token.IsEmpty() == false)
+		tokens->AddItem(token);
+}
+
+
+status_t
+LogIndex::_Load()
+{
+	BDirectory dir(fPath.String());
+	status_t ret = dir.InitCheck();
+	if (ret != B_OK)
+		return ret;
+
+	List<uint32> numbers;
+	BEntry entry;
+	char name[B_FILE_NAME_LENGTH];
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		if (entry.GetName(name) != B_OK)
+			continue;
+		size_t length = strlen(name);
+		if (length > 6 && strcmp(name + length - 6, ".terms") == 0)
+			numbers.AddItem(strtoul(name, NULL, 10));
+	}
+	std::sort(numbers.begin(), numbers.end());
+
+	for (uint32 number : numbers) {
+		fNextRun = number + 1;
+		_AddRun(number);
+	}
+
+	// A merge interrupted before its runs were removed leaves them behind,
+	// covered by the merged run
+	for (int32 i = fRuns.CountItems() - 1; i >= 0; i--) {
+		const run_header* header = fRuns.ItemAt(i)->header;
+		for (run* other : fRuns) {
+			if (other->header->first > header->first
+				|| other->header->end < header->end
+				|| other->header->end - other->header->first
+					<= header->end - header->first)
+				continue;
+			BEntry(_RunPath(fRuns.ItemAt(i)->number).String()).Remove();
+			_CloseRun(fRuns.ItemAt(i));
+			fRuns.RemoveItemAt(i);
+			break;
+		}
+	}
+
+	for (run* item : fRuns)
+		fIndexed = std::max(fIndexed, item->header->end);
+	return B_OK;
+}
+
+
+status_t
+LogIndex::_Find(const BString& key, List<uint64>* entries,
+	LogPostings* postings)
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	for (run* item : fRuns) {
+		const run_term* term = find_term(item->address, item->size,
+			item->terms, item->header->terms, key);
+		if (term == NULL)
+			continue;
+		if (entries != NULL)
+			decode_postings(item->address, *term, item->header->flags,
+				entries);
+		if (postings != NULL)
+			postings->_AddRun(item->address + term->postings, term->size,
+				term->count, item->header->flags, item->header->first);
+	}
+	return B_OK;
+}
+
+
+status_t
+LogIndex::_AddRun(uint32 number)
+{
+	run* item = new run;
+	item->number = number;
+	item->size = 0;
+	item->address = (const char*)map_file(_RunPath(number).String(),
+		&item->size);
+	item->header = (const run_header*)item->address;
+	item->terms = (const run_term*)(item->address + sizeof(run_header));
+
+	if (item->address == NULL || item->size < sizeof(run_header)
+		|| item->header->magic != kRunMagic
+		|| item->size < sizeof(run_header)
+			+ (size_t)item->header->terms * sizeof(run_term)) {
+		_CloseRun(item);
+		return B_BAD_DATA;
+	}
+
+	// Runs are kept in the order of their entries
+	int32 index = fRuns.CountItems();
+	while (index > 0 && fRuns.ItemAt(index - 1)->header->first
+			> item->header->first)
+		index--;
+	fRuns.AddItem(item);
+	std::rotate(fRuns.begin() + index, fRuns.end() - 1, fRuns.end());
+	return B_OK;
+}
+
+
+status_t
+LogIndex::_MergeRuns()
+{
+	// Newer runs are smaller, so runs of a level are all at the end
+	int32 count = fRuns.CountItems();
+	if (count < (int32)kMergeRuns)
+		return B_ENTRY_NOT_FOUND;
+	uint32 level = fRuns.ItemAt(count - 1)->header->level;
+	int32 first = count - 1;
+	while (first > 0 && fRuns.ItemAt(first - 1)->header->level == level)
+		first--;
+	if (count - first < (int32)kMergeRuns)
+		return B_ENTRY_NOT_FOUND;
+
+	// Merge the term tables, they're each in order. Positions are only
+	// kept if all of the runs have them. Lookups only check the terms
+	// they come across, but a merge reads all of them.
+	List<uint32> cursors;
+	bool positioned = true;
+	for (int32 i = first; i < count; i++) {
+		run* item = fRuns.ItemAt(i);
+		for (uint32 j = 0; j < item->header->terms; j++) {
+			if (term_fits(item->terms[j], item->size) == false)
+				return B_BAD_DATA;
+		}
+		cursors.AddItem(0);
+		if ((item->header->flags & kRunPositions) == 0)
+			positioned = false;
+	}
+
+	RunBuilder builder(positioned);
+	List<uint64> entries;
+	List<uint32> starts;
+	List<uint32> positions;
+	for (;;) {
+		const char* smallest = NULL;
+		uint32 smallestLength = 0;
+		for (int32 i = first; i < count; i++) {
+			run* item = fRuns.ItemAt(i);
+			uint32 cursor = cursors.ItemAt(i - first);
+			if (cursor >= item->header->terms)
+				continue;
+			const run_term& term = item->terms[cursor];
+			const char* string = item->address + term.offset;
+			if (smallest == NULL || compare_term(string, term.length,
+					smallest, smallestLength) < 0) {
+				smallest = string;
+				smallestLength = term.length;
+			}
+		}
+		if (smallest == NULL)
+			break;
+
+		builder.StartTerm(smallest, smallestLength);
+		for (int32 i = first; i < count; i++) {
+			run* item = fRuns.ItemAt(i);
+			uint32& cursor = cursors.ItemAt(i - first);
+			if (cursor >= item->header->terms)
+				continue;
+			const run_term& term = item->terms[cursor];
+			if (compare_term(item->address + term.offset, term.length,
+					smallest, smallestLength) != 0)
+				continue;
+
+			entries.MakeEmpty();
+			starts.MakeEmpty();
+			positions.MakeEmpty();
+			decode_postings(item->address, term, item->header->flags,
+				&entries, &starts, &positions);
+			for (uint32 j = 0; j < entries.CountItems(); j++) {
+				if (positioned == false)
+					builder.AddEntry(entries.ItemAt(j), 0);
+				for (uint32 k = starts.ItemAt(j); k < starts.ItemAt(j + 1); k++)
+					builder.AddEntry(entries.ItemAt(j), positions.ItemAt(k));
+			}
+			cursor++;
+		}
+	}
+
+	uint32 number = fNextRun++;
+	status_t ret = builder.Write(_RunPath(number).String(),
+		fRuns.ItemAt(first)->header->first,
+		fRuns.ItemAt(count - 1)->header->end, level + 1);
+	if (ret != B_OK)
+		return ret;
+
+	for (int32 i = count - 1; i >= first; i--) {
+		BEntry(_RunPath(fRuns.ItemAt(i)->number).String()).Remove();
+		_CloseRun(fRuns.ItemAt(i));
+		fRuns.RemoveItemAt(i);
+	}
+	return _AddRun(number);
+}
+
+
+BString
+LogIndex::_RunPath(uint32 number) const
+{
+	BString path;
+	path.SetToFormat("%s/%08" B_PRIu32 ".terms", fPath.String(), number);
+	return path;
+}
+
+
+void
+LogIndex::_CloseRun(run* item)
+{
+	unmap_file(item->address, item->size);
+	delete item;
+}
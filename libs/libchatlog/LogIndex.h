@@ -0,0 +1,147 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_INDEX_H
+#define _LOG_INDEX_H
+
+#include <String.h>
+
+#include <libsupport/List.h>
+
+class ChatLog;
+
+
+// A cursor over the entries a term is in, and where it is in each one's
+// words (as Tokenize() splits them). It seeks through the runs' block
+// tables, decoding only the block it lands in, so a lookup that stops
+// early never reads the rest. Runs written before positions were kept
+// give none, for an entry the term's in but at no known position.
+// It points into its LogIndex's runs, so it mustn't outlive it.
+class LogPostings {
+public:
+						LogPostings();
+
+			uint64		CountEntries() const { return fCount; }
+
+	// Move to the newest entry at or before entry, false if there's none
+			bool		Seek(uint64 entry);
+			uint64		Entry() const { return fEntries.ItemAt(fCurrent); }
+
+	// Of the entry sought, in order
+			uint32		CountPositions() const;
+			void		GetPositions(List<uint32>* words) const;
+			bool		HasPosition(uint32 word) const;
+
+private:
+	friend class LogIndex;
+
+	struct run_postings {
+		const uint8*	table;		// Of its blocks, NULL if it's one
+		const uint8*	data;
+		uint32			size;
+		uint32			count;
+		uint32			flags;
+		uint64			first;		// Of the entries the run covers
+	};
+
+			void		_AddRun(const char* postings, uint32 size,
+							uint32 count, uint32 flags, uint64 first);
+			bool		_SeekIn(int32 run, uint64 entry);
+			void		_Decode(int32 run, uint32 block);
+
+			List<run_postings> fRuns;
+			uint64		fCount;
+
+	// The decoded block
+			int32		fRun;
+			uint32		fBlock;
+			const uint8* fBlockStart;
+			const uint8* fBlockEnd;
+			List<uint64> fEntries;
+			List<uint32> fPositions;	// Where each entry's are in it
+			uint32		fCurrent;
+};
+
+
+// Inverted index of a ChatLog's message bodies and senders, kept in the
+// log's directory.
+// Entries are added once they're logged (see LogIndexer), and buffered
+// until there's enough of them to be written as a "run": a sorted term
+// table, each term with the delta- and varint-encoded list of the entries
+// it's in, and the words of each it's at, so phrases can be matched in the
+// index. Longer lists are cut in blocks, with a table of each one's last
+// entry to seek through. Runs are immutable and memory-mapped for
+// lookups; Merge() makes one larger run of a few of the same size, so
+// there's only ever a handful.
+// Entries that haven't been written yet can't be found; CountIndexed()
+// tells where the index stops.
+class LogIndex {
+public:
+						LogIndex(const char* path);
+	// Writes the buffered entries
+						~LogIndex();
+
+			status_t	InitCheck() const { return fInitStatus; }
+
+	// Entries must be added in order
+			status_t	Add(uint64 entry, const char* text,
+							const char* sender);
+	// Index the entries of log that haven't been yet, at most count of
+	// them unless it's 0
+			status_t	CatchUp(ChatLog* log, uint64 count = 0);
+			status_t	Flush();
+	// Merge runs of the same size for as long as there's enough of them
+			status_t	Merge();
+	// Remove the runs that only cover entries before first, as those
+	// pruned from the log; others are left to be searched past them
+			status_t	Prune(uint64 first);
+
+	// Entries [0, CountIndexed()) are searchable, and those up to
+	// CountAdded() will be once they're written
+			uint64		CountIndexed() const { return fIndexed; }
+			uint64		CountAdded() const { return fPendingEnd; }
+
+	// Add the entries containing term, or sent by sender, to entries, in
+	// order; the term is case-folded like the indexed text
+			status_t	FindTerm(const char* term, List<uint64>* entries);
+			status_t	FindSender(const char* sender, List<uint64>* entries);
+	// Or set postings to them, to be sought through
+			status_t	FindTerm(const char* term, LogPostings* postings);
+			status_t	FindSender(const char* sender,
+							LogPostings* postings);
+
+	// Case-folded words of text, as they're indexed
+	static	void		Tokenize(const char* text, List<BString>* tokens);
+
+private:
+	struct run;
+	struct posting {
+		BString	term;
+		uint64	entry;
+		uint32	position;
+	};
+
+			status_t	_Load();
+			status_t	_Find(const BString& key, List<uint64>* entries,
+							LogPostings* postings = NULL);
+
+			status_t	_AddRun(uint32 number);
+	// B_ENTRY_NOT_FOUND if there's nothing to merge
+			status_t	_MergeRuns();
+			BString		_RunPath(uint32 number) const;
+	static	void		_CloseRun(run* item);
+
+			BString		fPath;
+			status_t	fInitStatus;
+
+			List<run*>	fRuns;
+			uint32		fNextRun;
+			uint64		fIndexed;
+
+			List<posting> fPending;
+			uint64		fPendingEnd;
+};
+
+
+#endif // _LOG_INDEX_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogIndexer.h"
+
+#include <string.h>
+
+#include <Autolock.h>
+
+#include "ChatLog.h"
+#include "FileUtils.h"
+#include "LogIndex.h"
+#include "LogWriter.h"
+
+
+// Entries caught up on at once, between which it checks for quitting and
+// merges runs
+const uint64 kCatchUpEntries = 64 * 1024;
+// Indexes kept open at once, each with its log's mappings too
+const int32 kMaxOpenIndexes = 16;
+
+
+LogIndexer::LogIndexer(const char* path, LogWriter* writer)
+	:
+	fPath(path),
+	fWriter(writer),
+	fQuitting(false),
+	fQueueLock("Log indexer queue"),
+	fSyncing(0),
+	fStatsLock("Log indexer stats")
+{
+	memset(&fStats, 0, sizeof(log_indexer_stats));
+
+	// For what was logged while there was no indexer
+	find_logs(fPath, &fQueued);
+
+	fWakeUp = create_sem(fQueued.IsEmpty() == true ? 0 : 1,
+		"Log indexer wake-up");
+	fSynced = create_sem(0, "Log indexer synced");
+	fThread = fWakeUp < 0 ? fWakeUp : fSynced;
+	if (fThread >= 0)
+		fThread = spawn_thread(_IndexerThread, "Log indexer",
+			B_LOWEST_ACTIVE_PRIORITY, this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+	if (fThread >= 0 && fWriter != NULL)
+		fWriter->SetIndexer(this);
+}
+
+
+LogIndexer::~LogIndexer()
+{
+	if (fThread >= 0 && fWriter != NULL)
+		fWriter->SetIndexer(NULL);
+	fQuitting = true;
+	if (fThread >= 0) {
+		release_sem(fWakeUp);
+		status_t result;
+		wait_for_thread(fThread, &result);
+	}
+	if (fWakeUp >= 0)
+		delete_sem(fWakeUp);
+	if (fSynced >= 0)
+		delete_sem(fSynced);
+
+	for (uint32 i = 0; i < fIndexes.CountItems(); i++) {
+		open_index* item = fIndexes.ValueAt(i);
+		delete item->index;
+		delete item->log;
+		delete item;
+	}
+}
+
+
+void
+LogIndexer::Written(const char* logPath)
+{
+	if (fThread < 0)
+		return;
+	{
+		BAutolock _(fQueueLock);
+		BString path(logPath);
+		if (fQueued.IndexOf(path) >= 0)
+			return;
+		fQueued.AddItem(path);
+	}
+	release_sem_etc(fWakeUp, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+status_t
+LogIndexer::Sync()
+{
+	if (fThread < 0 || fQuitting == true)
+		return B_NO_INIT;
+	{
+		BAutolock _(fQueueLock);
+		fSyncing++;
+	}
+	release_sem(fWakeUp);
+
+	status_t ret;
+	while ((ret = acquire_sem(fSynced)) == B_INTERRUPTED)
+		;
+	return ret;
+}
+
+
+log_indexer_stats
+LogIndexer::Stats()
+{
+	BAutolock _(fStatsLock);
+	return fStats;
+}
+
+
+status_t
+LogIndexer::_IndexerThread(void* data)
+{
+	LogIndexer* indexer = (LogIndexer*)data;
+	while (indexer->fQuitting == false) {
+		status_t ret = acquire_sem(indexer->fWakeUp);
+		if (ret != B_OK && ret != B_INTERRUPTED)
+			break;
+
+		List<BString> queued;
+		int32 syncing = 0;
+		{
+			BAutolock _(indexer->fQueueLock);
+			queued.AddList(std::move(indexer->fQueued));
+			indexer->fQueued.MakeEmpty();
+			syncing = indexer->fSyncing;
+			indexer->fSyncing = 0;
+		}
+
+		for (const BString& path : queued) {
+			if (indexer->fQuitting == true)
+				break;
+			if (indexer->_CatchUp(path) != B_OK) {
+				BAutolock _(indexer->fStatsLock);
+				indexer->fStats.errors++;
+			}
+		}
+		indexer->_CloseIdle();
+
+		// Buffered entries too, so that they can all be found
+		if (syncing > 0) {
+			for (uint32 i = 0; i < indexer->fIndexes.CountItems(); i++) {
+				LogIndex* index = indexer->fIndexes.ValueAt(i)->index;
+				index->Flush();
+				index->Merge();
+			}
+			release_sem_etc(indexer->fSynced, syncing, 0);
+		}
+	}
+
+	// Anyone still waiting is let go
+	BAutolock _(indexer->fQueueLock);
+	if (indexer->fSyncing > 0)
+		release_sem_etc(indexer->fSynced, indexer->fSyncing, 0);
+	indexer->fSyncing = 0;
+	return B_OK;
+}
+
+
+status_t
+LogIndexer::_CatchUp(const BString& path)
+{
+	bigtime_t start = system_time();
+	open_index* item = _IndexFor(path);
+	ChatLog* log = item->log;
+	LogIndex* index = item->index;
+
+	// What the writer's appended or pruned since
+	status_t ret = log->InitCheck();
+	if (ret == B_OK)
+		ret = index->InitCheck();
+	if (ret == B_OK)
+		ret = log->Refresh();
+	if (ret == B_OK)
+		ret = index->Prune(log->FirstEntry());
+
+	uint64 indexed = 0;
+	while (ret == B_OK && index->CountAdded() < log->CountEntries()
+		&& fQuitting == false) {
+		uint64 before = index->CountAdded();
+		ret = index->CatchUp(log, kCatchUpEntries);
+		if (ret == B_OK)
+			ret = index->Merge();
+		indexed += index->CountAdded() - before;
+	}
+
+	BAutolock _(fStatsLock);
+	fStats.indexed += indexed;
+	fStats.catchUps++;
+	fStats.busyTime += system_time() - start;
+	return ret;
+}
+
+
+LogIndexer::open_index*
+LogIndexer::_IndexFor(const BString& path)
+{
+	open_index* item = fIndexes.ValueFor(path);
+	if (item == NULL) {
+		item = new open_index;
+		item->log = new ChatLog(path.String());
+		item->index = new LogIndex(path.String());
+		fIndexes.AddItem(path, item);
+	}
+	item->used = system_time();
+	return item;
+}
+
+
+void
+LogIndexer::_CloseIdle()
+{
+	// Their buffered entries are written as they're closed
+	while (fIndexes.CountItems() > (uint32)kMaxOpenIndexes) {
+		int32 oldest = 0;
+		for (uint32 i = 1; i < fIndexes.CountItems(); i++) {
+			if (fIndexes.ValueAt(i)->used < fIndexes.ValueAt(oldest)->used)
+				oldest = i;
+		}
+
+		open_index* item = fIndexes.RemoveItemAt(oldest);
+		delete item->index;
+		delete item->log;
+		delete item;
+	}
+}
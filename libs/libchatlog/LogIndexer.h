@@ -0,0 +1,87 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_INDEXER_H
+#define _LOG_INDEXER_H
+
+#include <atomic>
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <libsupport/KeyMap.h>
+#include <libsupport/List.h>
+
+class ChatLog;
+class LogIndex;
+class LogWriter;
+
+
+struct log_indexer_stats {
+	uint64		indexed;		// Entries added to the indexes
+	uint32		catchUps;		// Times a log was caught up on
+	bigtime_t	busyTime;		// Spent catching up
+	uint32		errors;			// Logs that couldn't be indexed
+};
+
+
+// Keeps the LogIndexes of the ChatLogs under a directory up with them, on
+// a low-priority thread of its own, so that indexing never holds up the
+// LogWriter. The writer only tells it which logs it's written to (or
+// pruned), and it catches up on each from where its index stops, see
+// LogIndex::CountIndexed(); a run's only ever merged here.
+// Every log is caught up on once it starts, for what was logged while it
+// wasn't running; what's still queued when it's deleted is left for then.
+// Only so many LogIndexes are kept open, as the LogWriter does its logs;
+// nothing else may be writing them.
+class LogIndexer {
+public:
+						LogIndexer(const char* path,
+							LogWriter* writer = NULL);
+	// Writes the entries its LogIndexes have buffered
+						~LogIndexer();
+
+			status_t	InitCheck() const { return fThread < 0 ? fThread : B_OK; }
+
+	// Catch up on the log at logPath
+			void		Written(const char* logPath);
+	// Wait for what's been queued to be indexed and written
+			status_t	Sync();
+
+			log_indexer_stats Stats();
+
+private:
+	struct open_index {
+		ChatLog*	log;		// Read only
+		LogIndex*	index;
+		bigtime_t	used;
+	};
+
+	static	status_t	_IndexerThread(void* data);
+			status_t	_CatchUp(const BString& path);
+			open_index*	_IndexFor(const BString& path);
+			void		_CloseIdle();
+
+			BString		fPath;
+			LogWriter*	fWriter;
+
+			std::atomic<bool> fQuitting;
+			sem_id		fWakeUp;
+			sem_id		fSynced;
+			thread_id	fThread;
+
+			BLocker		fQueueLock;
+			List<BString> fQueued;		// Both under the queue lock
+			int32		fSyncing;
+
+	// Only touched by the indexer thread
+			KeyMap<BString, open_index*> fIndexes;
+
+			BLocker		fStatsLock;
+			log_indexer_stats fStats;
+};
+
+
+#endif // _LOG_INDEXER_H
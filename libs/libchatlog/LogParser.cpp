@@ -0,0 +1,518 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogParser.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+
+// Read from the files at once
+const size_t kChunkSize = 1024 * 1024;
+// Lines looked at to guess a file's format
+const int32_t kGuessLines = 32;
+
+// Mode prefixes of IRC nicks, as the op's "@"
+const char* kNickModes = "~&@%+ ";
+
+
+// Whether text starts like pattern, where 'd' is any digit
+static bool
+matches(const char* c, const char* end, const char* pattern)
+{
+	for (; *pattern != '\0'; c++, pattern++) {
+		if (c >= end)
+			return false;
+		if (*pattern == 'd' ? (*c < '0' || *c > '9') : *c != *pattern)
+			return false;
+	}
+	return true;
+}
+
+
+static bool
+skip(const char*& c, const char* end, const char* text)
+{
+	size_t length = strlen(text);
+	if ((size_t)(end - c) < length || memcmp(c, text, length) != 0)
+		return false;
+	c += length;
+	return true;
+}
+
+
+static bool
+parse_digits(const char*& c, const char* end, int32_t digits, int32_t* _value)
+{
+	if (end - c < digits)
+		return false;
+
+	int32_t value = 0;
+	for (int32_t i = 0; i < digits; i++) {
+		if (c[i] < '0' || c[i] > '9')
+			return false;
+		value = value * 10 + c[i] - '0';
+	}
+	*_value = value;
+	c += digits;
+	return true;
+}
+
+
+// "HH:MM", or "HH:MM:SS"
+static bool
+parse_time(const char*& c, const char* end, int32_t* hours,
+	int32_t* minutes, int32_t* seconds)
+{
+	*seconds = 0;
+	if (parse_digits(c, end, 2, hours) == false || skip(c, end, ":") == false
+		|| parse_digits(c, end, 2, minutes) == false)
+		return false;
+
+	const char* rest = c;
+	if (skip(rest, end, ":") == true
+		&& parse_digits(rest, end, 2, seconds) == true)
+		c = rest;
+	return true;
+}
+
+
+static int32_t
+parse_month(const char*& c, const char* end)
+{
+	const char* kMonths = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	if (end - c < 3)
+		return 0;
+	for (int32_t i = 0; i < 12; i++)
+		if (memcmp(c, kMonths + i * 3, 3) == 0) {
+			c += 3;
+			return i + 1;
+		}
+	return 0;
+}
+
+
+static const char*
+find(const char* c, const char* end, char character)
+{
+	const char* found = (const char*)memchr(c, character, end - c);
+	return found != NULL ? found : end;
+}
+
+
+static void
+skip_modes(const char*& c, const char* end)
+{
+	while (c < end && *c != '\0' && strchr(kNickModes, *c) != NULL)
+		c++;
+}
+
+
+LogParser::LogParser()
+	:
+	fFormat(LOG_IMPORT_AUTO),
+	fDayStart(0),
+	fDayKey(0),
+	fWhen(0),
+	fParsed(0),
+	fSkipped(0)
+{
+}
+
+
+LogParser::~LogParser()
+{
+}
+
+
+int
+LogParser::ParseFile(const char* path, import_format format)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return errno;
+
+	struct stat st;
+	char* buffer = (char*)malloc(kChunkSize);
+	int ret = buffer == NULL ? ENOMEM : 0;
+	if (ret == 0 && fstat(fd, &st) != 0)
+		ret = errno;
+	if (ret != 0) {
+		free(buffer);
+		close(fd);
+		return ret;
+	}
+
+	fFormat = format;
+	_SetDate(path, st.st_mtime);
+
+	// Lines are parsed in place, and what's left of the last one is moved
+	// to the start for the next chunk
+	parsed_message message;
+	size_t length = 0;
+	while (ret == 0) {
+		ssize_t bytes = read(fd, buffer + length, kChunkSize - length);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = errno;
+			break;
+		}
+		length += bytes;
+		if (fFormat == LOG_IMPORT_AUTO)
+			fFormat = GuessFormat(buffer, length);
+
+		const char* line = buffer;
+		const char* end = buffer + length;
+		for (const char* newline = find(line, end, '\n');
+				ret == 0 && newline < end;
+				newline = find(line, end, '\n')) {
+			if (_ParseLine(line, newline, &message) == true)
+				ret = MessageParsed(message);
+			line = newline + 1;
+		}
+		if (ret != 0)
+			break;
+
+		length = end - line;
+		if (bytes == 0 || length == kChunkSize) {
+			// The end of the file, or a line that doesn't fit: it's cut
+			if (length > 0 && _ParseLine(line, end, &message) == true)
+				ret = MessageParsed(message);
+			if (bytes == 0)
+				break;
+			length = 0;
+		} else
+			memmove(buffer, line, length);
+	}
+
+	free(buffer);
+	close(fd);
+	return ret;
+}
+
+
+import_format
+LogParser::GuessFormat(const char* text, int32_t length)
+{
+	const char* end = text + length;
+	const char* line = text;
+	for (int32_t i = 0; i < kGuessLines && line < end; i++) {
+		if (matches(line, end, "dddd-dd-dd dd:dd:dd\t") == true)
+			return LOG_IMPORT_WEECHAT;
+		if (matches(line, end, "--- Log opened ") == true
+			|| matches(line, end, "dd:dd <") == true
+			|| matches(line, end, "dd:dd:dd <") == true)
+			return LOG_IMPORT_IRSSI;
+		if (matches(line, end, "[dd:dd:dd] ") == true)
+			return LOG_IMPORT_ZNC;
+		if (matches(line, end, "[") == true)
+			return LOG_IMPORT_TEXT;
+		line = find(line, end, '\n') + 1;
+	}
+	return LOG_IMPORT_TEXT;
+}
+
+
+bool
+LogParser::_ParseLine(const char* c, const char* end, parsed_message* message)
+{
+	if (end > c && end[-1] == '\r')
+		end--;
+
+	bool parsed;
+	switch (fFormat) {
+		case LOG_IMPORT_IRSSI:
+			parsed = _ParseIrssi(c, end, message);
+			break;
+		case LOG_IMPORT_WEECHAT:
+			parsed = _ParseWeeChat(c, end, message);
+			break;
+		case LOG_IMPORT_ZNC:
+			parsed = _ParseZnc(c, end, message);
+			break;
+		default:
+			parsed = _ParseText(c, end, message);
+	}
+
+	if (parsed == true)
+		fParsed++;
+	else
+		fSkipped++;
+	return parsed;
+}
+
+
+// "[date time] <name> body", the date and time as the locale has them
+bool
+LogParser::_ParseText(const char* c, const char* end,
+	parsed_message* message)
+{
+	if (skip(c, end, "[") == false)
+		return false;
+	const char* close = find(c, end, ']');
+
+	int32_t numbers[6];
+	int32_t count = 0;
+	bool am = false;
+	bool pm = false;
+	for (; c < close; c++) {
+		if (*c >= '0' && *c <= '9' && count < 6) {
+			int32_t value = 0;
+			while (c < close && *c >= '0' && *c <= '9')
+				value = value * 10 + *c++ - '0';
+			numbers[count++] = value;
+		}
+		if (c + 1 < close && (c[1] == 'M' || c[1] == 'm')) {
+			am |= (*c == 'A' || *c == 'a');
+			pm |= (*c == 'P' || *c == 'p');
+		}
+	}
+	if (count < 5)
+		return false;
+
+	// Year first, else day or month first (as en_US's), by what fits
+	int32_t year = numbers[2];
+	int32_t month = numbers[0];
+	int32_t day = numbers[1];
+	if (numbers[0] > 31) {
+		year = numbers[0];
+		month = numbers[1];
+		day = numbers[2];
+	} else if (numbers[0] > 12) {
+		month = numbers[1];
+		day = numbers[0];
+	}
+	if (year < 100)
+		year += 2000;
+
+	int32_t hours = numbers[3];
+	if (pm == true && hours < 12)
+		hours += 12;
+	else if (am == true && hours == 12)
+		hours = 0;
+	_SetDate(year, month, day);
+	_SetTime(hours, numbers[4], count > 5 ? numbers[5] : 0);
+
+	c = close;
+	if (skip(c, end, "] <") == false)
+		return false;
+	const char* nick = c;
+	const char* nickEnd = find(c, end, '>');
+	c = nickEnd;
+	if (skip(c, end, "> ") == false)
+		return false;
+	return _SetMessage(nick, nickEnd, c, end, false, message);
+}
+
+
+bool
+LogParser::_ParseIrssi(const char* c, const char* end,
+	parsed_message* message)
+{
+	// "--- Log opened Mon Jan 04 12:00:00 2021",
+	// "--- Day changed Tue Jan 05 2021"
+	if (skip(c, end, "--- Log opened ") == true
+		|| skip(c, end, "--- Day changed ") == true) {
+		int32_t year = 0;
+		int32_t month = 0;
+		int32_t day = 0;
+		int32_t hours, minutes, seconds;
+		c += 4;
+		if (c < end && (month = parse_month(c, end)) != 0
+			&& skip(c, end, " ") == true
+			&& parse_digits(c, end, 2, &day) == true
+			&& skip(c, end, " ") == true) {
+			// Day changes have no time, but parse_time() might have read
+			// the year's first digits
+			const char* rest = c;
+			if (parse_time(rest, end, &hours, &minutes, &seconds) == true) {
+				c = rest;
+				skip(c, end, " ");
+			}
+			if (parse_digits(c, end, 4, &year) == true)
+				_SetDate(year, month, day);
+		}
+		return false;
+	}
+
+	int32_t hours, minutes, seconds;
+	if (parse_time(c, end, &hours, &minutes, &seconds) == false
+		|| skip(c, end, " ") == false)
+		return false;
+	_SetTime(hours, minutes, seconds);
+
+	// "<@nick> body", where the mode might be a space
+	if (skip(c, end, "<") == true) {
+		skip_modes(c, end);
+		const char* nick = c;
+		const char* nickEnd = find(c, end, '>');
+		c = nickEnd;
+		if (skip(c, end, "> ") == false)
+			return false;
+		return _SetMessage(nick, nickEnd, c, end, false, message);
+	}
+
+	// " * nick does"
+	if (skip(c, end, " * ") == true) {
+		const char* nickEnd = find(c, end, ' ');
+		return _SetMessage(c, nickEnd, std::min(nickEnd + 1, end), end, true,
+			message);
+	}
+	return false;
+}
+
+
+// "2021-01-04 12:00:00\t@nick\tbody", or " *\tnick does" for actions
+bool
+LogParser::_ParseWeeChat(const char* c, const char* end,
+	parsed_message* message)
+{
+	int32_t year, month, day, hours, minutes, seconds;
+	if (parse_digits(c, end, 4, &year) == false || skip(c, end, "-") == false
+		|| parse_digits(c, end, 2, &month) == false
+		|| skip(c, end, "-") == false
+		|| parse_digits(c, end, 2, &day) == false
+		|| skip(c, end, " ") == false
+		|| parse_time(c, end, &hours, &minutes, &seconds) == false
+		|| skip(c, end, "\t") == false)
+		return false;
+	_SetDate(year, month, day);
+	_SetTime(hours, minutes, seconds);
+
+	if (skip(c, end, " *\t") == true) {
+		const char* nickEnd = find(c, end, ' ');
+		return _SetMessage(c, nickEnd, std::min(nickEnd + 1, end), end, true,
+			message);
+	}
+
+	// Joins, parts, etc. have arrows or dashes as their prefix
+	skip_modes(c, end);
+	const char* nick = c;
+	const char* nickEnd = find(c, end, '\t');
+	if (nick == nickEnd || nickEnd == end || strchr("-<=", *nick) != NULL)
+		return false;
+	return _SetMessage(nick, nickEnd, nickEnd + 1, end, false, message);
+}
+
+
+// "[12:00:00] <nick> body", or "[12:00:00] * nick does"
+bool
+LogParser::_ParseZnc(const char* c, const char* end,
+	parsed_message* message)
+{
+	int32_t hours, minutes, seconds;
+	if (skip(c, end, "[") == false
+		|| parse_time(c, end, &hours, &minutes, &seconds) == false
+		|| skip(c, end, "] ") == false)
+		return false;
+	_SetTime(hours, minutes, seconds);
+
+	if (skip(c, end, "<") == true) {
+		const char* nick = c;
+		const char* nickEnd = find(c, end, '>');
+		c = nickEnd;
+		if (skip(c, end, "> ") == false)
+			return false;
+		return _SetMessage(nick, nickEnd, c, end, false, message);
+	}
+
+	if (matches(c, end, "*** ") == false && skip(c, end, "* ") == true) {
+		const char* nickEnd = find(c, end, ' ');
+		return _SetMessage(c, nickEnd, std::min(nickEnd + 1, end), end, true,
+			message);
+	}
+	return false;
+}
+
+
+bool
+LogParser::_SetMessage(const char* nick, const char* nickEnd,
+	const char* body, const char* bodyEnd, bool action,
+	parsed_message* message)
+{
+	if (nick >= nickEnd)
+		return false;
+
+	// As the plain-text logs have them
+	if (action == false && bodyEnd - body >= 4
+		&& memcmp(body, "/me ", 4) == 0) {
+		body += 4;
+		action = true;
+	}
+
+	message->when = fWhen;
+	message->nick = nick;
+	message->nickLength = nickEnd - nick;
+	message->body = body;
+	message->bodyLength = bodyEnd - body;
+	message->action = action;
+	return true;
+}
+
+
+void
+LogParser::_SetDate(int32_t year, int32_t month, int32_t day)
+{
+	// mktime() is slow, so it's only used on the first line of each day
+	int32_t key = year * 10000 + month * 100 + day;
+	if (key == fDayKey)
+		return;
+
+	struct tm date;
+	memset(&date, 0, sizeof(struct tm));
+	date.tm_year = year - 1900;
+	date.tm_mon = month - 1;
+	date.tm_mday = day;
+	date.tm_isdst = -1;
+	fDayStart = mktime(&date);
+	fDayKey = key;
+	fWhen = fDayStart;
+}
+
+
+void
+LogParser::_SetDate(const char* path, time_t modified)
+{
+	// ZNC's are named by date, as "2021-01-04.log" or "#room_20210104.log"
+	const char* name = strrchr(path, '/');
+	name = name != NULL ? name + 1 : path;
+	const char* end = name + strlen(name);
+	for (const char* c = name; c < end; c++) {
+		int32_t year, month, day;
+		const char* date = c;
+		if (matches(date, end, "dddd-dd-dd") == true
+			&& parse_digits(date, end, 4, &year) && skip(date, end, "-")
+			&& parse_digits(date, end, 2, &month) && skip(date, end, "-")
+			&& parse_digits(date, end, 2, &day)) {
+			_SetDate(year, month, day);
+			return;
+		}
+		if (matches(date, end, "dddddddd") == true
+			&& parse_digits(date, end, 4, &year)
+			&& parse_digits(date, end, 2, &month)
+			&& parse_digits(date, end, 2, &day)) {
+			_SetDate(year, month, day);
+			return;
+		}
+	}
+
+	struct tm date;
+	if (localtime_r(&modified, &date) != NULL)
+		_SetDate(date.tm_year + 1900, date.tm_mon + 1, date.tm_mday);
+}
+
+
+void
+LogParser::_SetTime(int32_t hours, int32_t minutes, int32_t seconds)
+{
+	fWhen = fDayStart + hours * 3600 + minutes * 60 + seconds;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_PARSER_H
+#define _LOG_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+
+enum import_format {
+	LOG_IMPORT_AUTO,	// Guessed from the first lines
+	LOG_IMPORT_TEXT,	// Chat-O-Matic's plain-text logs
+	LOG_IMPORT_IRSSI,
+	LOG_IMPORT_WEECHAT,
+	LOG_IMPORT_ZNC
+};
+
+
+// A message as it was logged, pointing into its line
+struct parsed_message {
+	int64_t		when;
+	const char*	nick;
+	size_t		nickLength;
+	const char*	body;		// Of actions, what follows the nick
+	size_t		bodyLength;
+	bool		action;		// "* nick does", or "/me does"
+};
+
+
+// Parses the messages of IRC clients' and bouncers' logs, and of the
+// plain-text logs, for MessageParsed() to make something of.
+// It's plain C++ and POSIX, so that it can be built, and measured, on
+// any system; LogImporter makes ChatLog entries of what it parses.
+// Files are read a chunk at a time and parsed in place, so memory use
+// doesn't depend on their size. Lines that aren't messages (joins,
+// topics, etc.) are skipped.
+class LogParser {
+public:
+						LogParser();
+	virtual				~LogParser();
+
+	// Formats that only log the time of day take the date from the log's
+	// "day changed" lines, or else from the file name (as ZNC's), or else
+	// its modification time. Returns 0, or an errno.
+			int			ParseFile(const char* path,
+							import_format format = LOG_IMPORT_AUTO);
+
+	// Parsing stops at the first message this doesn't return 0 for
+	virtual	int			MessageParsed(const parsed_message& message) = 0;
+
+			uint64_t	CountParsed() const { return fParsed; }
+			uint64_t	CountSkipped() const { return fSkipped; }
+
+	static	import_format GuessFormat(const char* text, int32_t length);
+
+private:
+	// False for lines that aren't messages
+			bool		_ParseLine(const char* c, const char* end,
+							parsed_message* message);
+			bool		_ParseText(const char* c, const char* end,
+							parsed_message* message);
+			bool		_ParseIrssi(const char* c, const char* end,
+							parsed_message* message);
+			bool		_ParseWeeChat(const char* c, const char* end,
+							parsed_message* message);
+			bool		_ParseZnc(const char* c, const char* end,
+							parsed_message* message);
+
+			bool		_SetMessage(const char* nick, const char* nickEnd,
+							const char* body, const char* bodyEnd,
+							bool action, parsed_message* message);
+			void		_SetDate(int32_t year, int32_t month, int32_t day);
+			void		_SetDate(const char* path, time_t modified);
+			void		_SetTime(int32_t hours, int32_t minutes,
+							int32_t seconds);
+
+			import_format fFormat;
+
+			// Of the line being parsed
+			int64_t		fDayStart;
+			int32_t		fDayKey;
+			int64_t		fWhen;
+
+			uint64_t	fParsed;
+			uint64_t	fSkipped;
+};
+
+
+#endif // _LOG_PARSER_H
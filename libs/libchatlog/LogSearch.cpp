@@ -0,0 +1,334 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogSearch.h"
+
+#include <algorithm>
+
+#include <Directory.h>
+#include <Entry.h>
+#include <Message.h>
+
+#include "LogIndex.h"
+
+
+// How deep SearchAll() goes looking for ChatLogs
+const int32 kMaxDepth = 4;
+
+
+// Newest first, and of the same time, the latest logged
+static bool
+newer_hit(const log_hit& a, const log_hit& b)
+{
+	if (a.entry.when != b.entry.when)
+		return a.entry.when > b.entry.when;
+	return a.index > b.index;
+}
+
+
+LogSearch::LogSearch(const log_query& query)
+	:
+	fQuery(query)
+{
+	// Every other part of the text is quoted
+	const BString& text = fQuery.text;
+	bool quoted = false;
+	int32 start = 0;
+	for (int32 i = 0; i <= text.Length(); i++) {
+		if (i < text.Length() && text[i] != '"')
+			continue;
+
+		BString part;
+		text.CopyInto(part, start, i - start);
+		List<BString> words;
+		LogIndex::Tokenize(part.String(), &words);
+		if (quoted == true && words.CountItems() > 1) {
+			List<uint32> terms;
+			for (uint32 j = 0; j < words.CountItems(); j++)
+				terms.AddItem(fTerms.CountItems() + j);
+			fPhrases.AddItem(words);
+			fPhraseTerms.AddItem(terms);
+		}
+		fTerms.AddList(words);
+
+		quoted = !quoted;
+		start = i + 1;
+	}
+}
+
+
+status_t
+LogSearch::SearchLog(const char* path, List<log_hit>* hits)
+{
+	status_t ret = _SearchLog(path);
+	_TakeHits(hits);
+	return ret;
+}
+
+
+status_t
+LogSearch::SearchAll(const char* path, List<log_hit>* hits)
+{
+	status_t ret = _SearchAll(path, 0);
+	_TakeHits(hits);
+	return ret;
+}
+
+
+status_t
+LogSearch::_SearchLog(const char* path)
+{
+	ChatLog log(path);
+	if (log.InitCheck() != B_OK)
+		return log.InitCheck();
+	if (fQuery.limit <= 0)
+		fLogHits.AddItem(fHits.CountItems());
+
+	uint64 start = fQuery.since > 0
+		? log.IndexOf(fQuery.since) : log.FirstEntry();
+	uint64 end = log.CountEntries();
+	if (fQuery.until > 0)
+		end = log.IndexOf(fQuery.until + 1);
+	if (start >= end)
+		return B_OK;
+
+	// Nothing to look up, just the span
+	if (fTerms.IsEmpty() == true && fQuery.sender.IsEmpty() == true) {
+		for (uint64 i = end; i-- > start;)
+			if (_AddHit(log, i) == false)
+				break;
+		return B_OK;
+	}
+
+	// Past the index, entries are matched one by one; they're the newest
+	LogIndex index(path);
+	uint64 indexed = std::min(std::max(index.CountIndexed(), start), end);
+	for (uint64 i = end; i-- > indexed;)
+		if (_Matches(log, i, false) == true && _AddHit(log, i) == false)
+			return B_OK;
+
+	if (start < indexed)
+		_SearchIndexed(log, index, start, indexed);
+	return B_OK;
+}
+
+
+status_t
+LogSearch::_SearchAll(const char* path, int32 depth)
+{
+	BString senders(path);
+	senders << "/senders";
+	if (BEntry(senders.String()).Exists() == true)
+		return _SearchLog(path);
+	if (depth >= kMaxDepth)
+		return B_OK;
+
+	BDirectory dir(path);
+	status_t ret = dir.InitCheck();
+	if (ret != B_OK)
+		return ret;
+
+	BEntry entry;
+	char name[B_FILE_NAME_LENGTH];
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		if (entry.IsDirectory() == false || entry.GetName(name) != B_OK)
+			continue;
+		BString child(path);
+		child << "/" << name;
+		_SearchAll(child.String(), depth + 1);
+	}
+	return B_OK;
+}
+
+
+void
+LogSearch::_SearchIndexed(ChatLog& log, LogIndex& index, uint64 start,
+	uint64 end)
+{
+	// The terms' postings, in the order of fTerms, then the sender's
+	List<LogPostings> postings;
+	for (const BString& term : fTerms) {
+		LogPostings termPostings;
+		index.FindTerm(term.String(), &termPostings);
+		postings.AddItem(std::move(termPostings));
+	}
+	if (fQuery.sender.IsEmpty() == false) {
+		LogPostings senderPostings;
+		index.FindSender(fQuery.sender.String(), &senderPostings);
+		postings.AddItem(std::move(senderPostings));
+	}
+
+	// The rarest term leads, as it skips the most
+	List<uint32> order;
+	for (uint32 i = 0; i < postings.CountItems(); i++)
+		order.AddItem(i);
+	std::sort(order.begin(), order.end(),
+		[&postings](uint32 a, uint32 b) {
+			return postings.ItemAt(a).CountEntries()
+				< postings.ItemAt(b).CountEntries();
+		});
+
+	LogPostings& rarest = postings.ItemAt(order.ItemAt(0));
+	uint64 target = end - 1;
+	while (rarest.Seek(target) == true && rarest.Entry() >= start) {
+		uint64 entry = rarest.Entry();
+		bool matches = true;
+		for (uint32 i = 1; i < order.CountItems() && matches == true; i++) {
+			LogPostings& other = postings.ItemAt(order.ItemAt(i));
+			if (other.Seek(entry) == false)
+				return;
+			// It has none of those in between, so they're skipped
+			if (other.Entry() != entry) {
+				target = other.Entry();
+				matches = false;
+			}
+		}
+		if (matches == false)
+			continue;
+
+		if (fPhrases.IsEmpty() == false) {
+			int32 phrases = _HasPhrases(postings);
+			if (phrases == 0 || (phrases < 0 && _Matches(log, entry, true)
+					== false)) {
+				if (entry == 0)
+					return;
+				target = entry - 1;
+				continue;
+			}
+		}
+		if (_AddHit(log, entry) == false || entry == 0)
+			return;
+		target = entry - 1;
+	}
+}
+
+
+// 1 if the entry the postings are on has all the phrases, 0 if it hasn't,
+// and -1 if its positions weren't indexed
+int32
+LogSearch::_HasPhrases(const List<LogPostings>& postings)
+{
+	List<uint32> words;
+	for (const List<uint32>& phrase : fPhraseTerms) {
+		words.MakeEmpty();
+		postings.ItemAt(phrase.ItemAt(0)).GetPositions(&words);
+		if (words.IsEmpty() == true)
+			return -1;
+
+		bool hasPhrase = false;
+		for (uint32 i = 0; i < words.CountItems() && hasPhrase == false; i++) {
+			uint32 word = words.ItemAt(i);
+			hasPhrase = true;
+			for (uint32 j = 1; j < phrase.CountItems() && hasPhrase; j++) {
+				const LogPostings& next = postings.ItemAt(phrase.ItemAt(j));
+				if (next.CountPositions() == 0)
+					return -1;
+				hasPhrase = next.HasPosition(word + j);
+			}
+		}
+		if (hasPhrase == false)
+			return 0;
+	}
+	return 1;
+}
+
+
+bool
+LogSearch::_Matches(ChatLog& log, uint64 index, bool indexed)
+{
+	// Indexed entries have all the terms, but phrases need checking
+	if (indexed == false && fQuery.sender.IsEmpty() == false) {
+		log_entry entry;
+		if (log.EntryAt(index, &entry) != B_OK)
+			return false;
+		const char* sender = log.SenderAt(entry.sender);
+		if (sender == NULL || fQuery.sender != sender)
+			return false;
+	}
+	if (indexed == false && fTerms.IsEmpty() == true)
+		return true;
+
+	BMessage message;
+	if (log.ReadMessage(index, &message) != B_OK)
+		return false;
+
+	List<BString> words;
+	LogIndex::Tokenize(message.FindString("body"), &words);
+
+	if (indexed == false)
+		for (const BString& term : fTerms)
+			if (words.IndexOf(term) < 0)
+				return false;
+
+	for (const List<BString>& phrase : fPhrases) {
+		uint32 length = phrase.CountItems();
+		bool found = false;
+		for (uint32 i = 0; i + length <= words.CountItems() && !found; i++) {
+			uint32 j = 0;
+			while (j < length && words.ItemAt(i + j) == phrase.ItemAt(j))
+				j++;
+			found = (j == length);
+		}
+		if (found == false)
+			return false;
+	}
+	return true;
+}
+
+
+bool
+LogSearch::_AddHit(ChatLog& log, uint64 index)
+{
+	log_hit hit;
+	if (log.EntryAt(index, &hit.entry) != B_OK)
+		return true;
+	hit.index = index;
+
+	// The heap's first is the oldest kept; the log's entries only get older
+	bool full = fQuery.limit > 0 && fHits.CountItems() >= (uint32)fQuery.limit;
+	if (full == true && newer_hit(hit, fHits.ItemAt(0)) == false)
+		return false;
+
+	hit.path = log.Path();
+	hit.segment = log.SegmentOf(index);
+	fHits.AddItem(hit);
+	if (fQuery.limit <= 0)
+		return true;
+
+	std::push_heap(fHits.begin(), fHits.end(), newer_hit);
+	if (full == true) {
+		std::pop_heap(fHits.begin(), fHits.end(), newer_hit);
+		fHits.RemoveItemAt(fHits.CountItems() - 1);
+	}
+	return true;
+}
+
+
+void
+LogSearch::_TakeHits(List<log_hit>* hits)
+{
+	if (fQuery.limit > 0)
+		std::sort(fHits.begin(), fHits.end(), newer_hit);
+	else {
+		// Merged in pairs, each pass halving how many there are
+		fLogHits.AddItem(fHits.CountItems());
+		while (fLogHits.CountItems() > 2) {
+			List<uint32> merged;
+			uint32 i = 0;
+			for (; i + 2 < fLogHits.CountItems(); i += 2) {
+				std::inplace_merge(fHits.begin() + fLogHits.ItemAt(i),
+					fHits.begin() + fLogHits.ItemAt(i + 1),
+					fHits.begin() + fLogHits.ItemAt(i + 2), newer_hit);
+				merged.AddItem(fLogHits.ItemAt(i));
+			}
+			for (; i < fLogHits.CountItems(); i++)
+				merged.AddItem(fLogHits.ItemAt(i));
+			fLogHits = std::move(merged);
+		}
+		fLogHits.MakeEmpty();
+	}
+	hits->AddList(std::move(fHits));
+	fHits.MakeEmpty();
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_SEARCH_H
+#define _LOG_SEARCH_H
+
+#include <String.h>
+
+#include <libsupport/List.h>
+
+#include "ChatLog.h"
+
+class LogIndex;
+class LogPostings;
+
+
+struct log_query {
+	BString	text;		// Words all to be found, "quoted" ones in a row
+	BString	sender;		// User ID, or empty for anyone
+	int64	since;		// Span of the messages' "when"s, inclusive, or 0
+	int64	until;
+	int32	limit;		// Most hits returned, the newest first, or 0
+};
+
+
+struct log_hit {
+	BString		path;		// Of the room's ChatLog
+	uint64		index;		// Of the entry in the ChatLog
+	uint32		segment;	// Holding the entry, its offset is in there
+	log_entry	entry;
+};
+
+
+// Looks up a log_query in the LogIndexes of ChatLogs. Entries past the
+// end of a log's index are searched through directly.
+// Each log is gone through newest first, the rarest term's postings
+// seeking the others' to its entries and they its own past theirs, so
+// only the blocks they land in are read. With a limit, a log's only gone
+// through until its entries are older than the oldest of the hits kept
+// so far; those are kept in a heap of at most that many. Without one,
+// each log's hits are already in order, and only need merging.
+// Phrases are matched on the words' positions in the index, and only read
+// from the log if it didn't have them.
+class LogSearch {
+public:
+						LogSearch(const log_query& query);
+
+			status_t	SearchLog(const char* path, List<log_hit>* hits);
+	// Every ChatLog in the directory, or further down
+			status_t	SearchAll(const char* path, List<log_hit>* hits);
+
+private:
+			status_t	_SearchLog(const char* path);
+			status_t	_SearchAll(const char* path, int32 depth);
+
+			void		_SearchIndexed(ChatLog& log, LogIndex& index,
+							uint64 start, uint64 end);
+			int32		_HasPhrases(const List<LogPostings>& postings);
+			bool		_Matches(ChatLog& log, uint64 index, bool indexed);
+
+	// False once the log's entries are too old to be hits
+			bool		_AddHit(ChatLog& log, uint64 index);
+			void		_TakeHits(List<log_hit>* hits);
+
+			log_query	fQuery;
+			List<BString> fTerms;
+			List<List<BString> > fPhrases;
+			List<List<uint32> > fPhraseTerms;	// Of each phrase's words
+
+			List<log_hit> fHits;		// A heap of the newest, with a limit
+			List<uint32> fLogHits;		// Where each log's hits start, if
+										// there's no limit
+};
+
+
+#endif // _LOG_SEARCH_H
@@ -0,0 +1,500 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "LogWriter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Autolock.h>
+#include <File.h>
+
+#include <libsupport/List.h>
+
+#include "ChatLog.h"
+#include "FileUtils.h"
+#include "LogCompactor.h"
+#include "LogIndexer.h"
+
+
+enum {
+	kPruneTask,
+	kAdoptTask
+};
+
+// Logs kept open at once, each with three files and their mappings
+const int32 kMaxOpenLogs = 16;
+
+
+// Keep the newest half of a plain-text log, from its first whole line on,
+// so that it's trimmed once in a while rather than at every write. It's
+// the room's cache file too, so it's rewritten in place to keep the
+// attributes.
+static status_t
+trim_text(BFile& file, off_t size, off_t maxSize)
+{
+	size_t keep = maxSize / 2;
+	char* buffer = (char*)malloc(keep);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	status_t ret = file.ReadAt(size - keep, buffer, keep) == (ssize_t)keep
+		? B_OK : B_IO_ERROR;
+	const char* start = (const char*)memchr(buffer, '\n', keep);
+	start = start != NULL ? start + 1 : buffer + keep;
+	size_t length = buffer + keep - start;
+	if (ret == B_OK)
+		ret = write_fully(file, 0, start, length);
+	if (ret == B_OK)
+		ret = file.SetSize(length);
+	free(buffer);
+	return ret;
+}
+
+
+LogWriter::LogWriter(const log_policy& policy)
+	:
+	fPolicy(policy),
+	fQueue(NULL),
+	fTasks(NULL),
+	fQueued(0),
+	fPeakQueued(0),
+	fWaiting(0),
+	fWoken(false),
+	fQuitting(false),
+	fStatsLock("Log writer stats"),
+	fListenersLock("Log writer listeners"),
+	fCompactor(NULL),
+	fIndexer(NULL)
+{
+	memset(&fStats, 0, sizeof(log_writer_stats));
+	memset(&fClosed, 0, sizeof(log_compression_stats));
+
+	fWakeUp = create_sem(0, "Log writer wake-up");
+	fRoom = create_sem(0, "Log writer room");
+	fThread = fWakeUp < 0 ? fWakeUp : fRoom;
+	if (fThread >= 0)
+		fThread = spawn_thread(_WriterThread, "Log writer", B_LOW_PRIORITY,
+			this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+}
+
+
+LogWriter::~LogWriter()
+{
+	fQuitting = true;
+	if (fThread >= 0) {
+		release_sem(fWakeUp);
+		status_t result;
+		wait_for_thread(fThread, &result);
+	}
+	if (fWakeUp >= 0)
+		delete_sem(fWakeUp);
+	if (fRoom >= 0)
+		delete_sem(fRoom);
+
+	// Whatever came in while quitting, and anything a failed thread left
+	_Write(fQueue.exchange(NULL), true);
+	_RunTasks(fTasks.exchange(NULL));
+
+	for (uint32 i = 0; i < fLogs.CountItems(); i++) {
+		open_log* item = fLogs.ValueAt(i);
+		delete item->log;
+		delete item;
+	}
+}
+
+
+void
+LogWriter::Log(const char* logPath, const char* textPath, BMessage* message,
+	int64 when, const char* sender, uint32 flags, const char* line)
+{
+	log_record* record = new log_record;
+	record->logPath = logPath;
+	record->textPath = textPath;
+	record->message = *message;
+	record->when = when;
+	record->sender = sender;
+	record->flags = flags;
+	record->line = line;
+
+	if (fPolicy.maxQueued > 0 && fQueued >= fPolicy.maxQueued)
+		_WaitForRoom();
+
+	record->next = fQueue.load(std::memory_order_relaxed);
+	while (fQueue.compare_exchange_weak(record->next, record,
+			std::memory_order_release, std::memory_order_relaxed) == false)
+		;
+
+	uint32 queued = fQueued.fetch_add(1) + 1;
+	uint32 peak = fPeakQueued;
+	while (queued > peak
+		&& fPeakQueued.compare_exchange_weak(peak, queued) == false)
+		;
+
+	// Once until the writer's taken them, however many more come first
+	bool full = (fPolicy.flushRecords > 0 && queued >= fPolicy.flushRecords)
+		|| (fPolicy.maxQueued > 0 && queued >= fPolicy.maxQueued / 2);
+	if (full == true && fThread >= 0 && fWoken.exchange(true) == false)
+		release_sem_etc(fWakeUp, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+void
+LogWriter::Flush()
+{
+	if (fThread >= 0)
+		release_sem_etc(fWakeUp, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+status_t
+LogWriter::Prune(const char* logPath, const log_retention& retention,
+	int64 now, uint64* _pruned, off_t* _freed)
+{
+	log_task task;
+	task.what = kPruneTask;
+	task.logPath = logPath;
+	task.retention = retention;
+	task.now = now;
+	task.done = 0;
+	task.bytes = 0;
+	status_t ret = _Run(&task);
+	if (_pruned != NULL)
+		*_pruned = task.done;
+	if (_freed != NULL)
+		*_freed = task.bytes;
+	return ret;
+}
+
+
+status_t
+LogWriter::CompressSealed(const char* logPath, int32 count, uint64* _read,
+	uint64* _written)
+{
+	uint64 read = 0;
+	uint64 written = 0;
+
+	// Only read by this one, so it can't get in the writer's way
+	ChatLog log(logPath);
+	status_t ret = log.InitCheck();
+	while (ret == B_OK && count != 0) {
+		log_task task;
+		ret = log.CompressAside(&task.compressed);
+		if (ret == B_ENTRY_NOT_FOUND) {
+			ret = B_OK;
+			break;
+		}
+		if (ret != B_OK)
+			break;
+
+		task.what = kAdoptTask;
+		task.logPath = logPath;
+		ret = _Run(&task);
+		if (ret == B_ENTRY_NOT_FOUND) {
+			// Pruned in the meantime; the next pass catches up
+			ret = B_OK;
+			break;
+		}
+		if (ret == B_OK) {
+			read += task.compressed.rawBytes;
+			written += task.compressed.compressedBytes;
+		}
+		if (count > 0)
+			count--;
+	}
+
+	if (_read != NULL)
+		*_read = read;
+	if (_written != NULL)
+		*_written = written;
+	return ret;
+}
+
+
+void
+LogWriter::SetCompactor(LogCompactor* compactor)
+{
+	BAutolock _(fListenersLock);
+	fCompactor = compactor;
+}
+
+
+void
+LogWriter::SetIndexer(LogIndexer* indexer)
+{
+	BAutolock _(fListenersLock);
+	fIndexer = indexer;
+}
+
+
+log_writer_stats
+LogWriter::Stats()
+{
+	BAutolock _(fStatsLock);
+	log_writer_stats stats = fStats;
+	stats.queued = fQueued;
+	stats.peakQueued = fPeakQueued;
+	return stats;
+}
+
+
+status_t
+LogWriter::_WriterThread(void* data)
+{
+	LogWriter* writer = (LogWriter*)data;
+	while (writer->fQuitting == false) {
+		status_t ret = acquire_sem_etc(writer->fWakeUp, 1, B_RELATIVE_TIMEOUT,
+			writer->fPolicy.flushInterval);
+		if (ret != B_OK && ret != B_TIMED_OUT && ret != B_INTERRUPTED)
+			break;
+		writer->fWoken = false;
+		writer->_Write(writer->fQueue.exchange(NULL, std::memory_order_acquire),
+			writer->fPolicy.sync);
+		writer->_RunTasks(writer->fTasks.exchange(NULL,
+			std::memory_order_acquire));
+	}
+	return B_OK;
+}
+
+
+// Until the writer's brought the queue back under the limit. There's no
+// waiting for it without it, or on it, or once it's quitting.
+void
+LogWriter::_WaitForRoom()
+{
+	if (fThread < 0 || find_thread(NULL) == fThread)
+		return;
+
+	bigtime_t start = system_time();
+	fWaiting++;
+	while (fQueued >= fPolicy.maxQueued && fQuitting == false) {
+		if (fWoken.exchange(true) == false)
+			release_sem_etc(fWakeUp, 1, B_DO_NOT_RESCHEDULE);
+		// In case a release came before this waited
+		acquire_sem_etc(fRoom, 1, B_RELATIVE_TIMEOUT, 100000);
+	}
+	fWaiting--;
+
+	BAutolock _(fStatsLock);
+	fStats.stalls++;
+	fStats.stallTime += system_time() - start;
+}
+
+
+void
+LogWriter::_Write(log_record* records, bool sync)
+{
+	if (records == NULL)
+		return;
+	bigtime_t start = system_time();
+
+	// The queue is a stack, newest first
+	log_record* first = NULL;
+	uint32 count = 0;
+	while (records != NULL) {
+		log_record* next = records->next;
+		records->next = first;
+		first = records;
+		records = next;
+		count++;
+	}
+
+	// ChatLogs buffer their entries, lines are gathered per file
+	KeyMap<BString, BString*> lines;
+	List<BString> sealed;
+	uint32 errors = 0;
+	for (log_record* record = first; record != NULL; record = record->next) {
+		if (record->logPath.IsEmpty() == false) {
+			open_log* item = _LogFor(record->logPath);
+			ChatLog* log = item->log;
+			if (log->Append(&record->message, record->when,
+					record->sender.String(), record->flags) != B_OK)
+				errors++;
+			else {
+				uint32 segment = log->SegmentOf(log->CountEntries()
+					+ log->CountPending() - 1);
+				if (segment != item->segment) {
+					item->segment = segment;
+					sealed.AddItem(record->logPath);
+				}
+			}
+		}
+		if (record->line.IsEmpty() == true || record->textPath.IsEmpty() == true)
+			continue;
+
+		BString* text = lines.ValueFor(record->textPath);
+		if (text == NULL) {
+			text = new BString();
+			lines.AddItem(record->textPath, text);
+		}
+		text->Append(record->line);
+	}
+
+	uint64 sealedBytes = fClosed.rawBytes;
+	uint64 compressed = fClosed.compressedBytes;
+	List<BString> written;
+	for (uint32 i = 0; i < fLogs.CountItems(); i++) {
+		ChatLog* log = fLogs.ValueAt(i)->log;
+		if (log->CountPending() > 0) {
+			if (log->Flush(sync) == B_OK)
+				written.AddItem(fLogs.KeyAt(i));
+			else
+				errors++;
+		}
+		log_compression_stats compression = log->CompressionStats();
+		sealedBytes += compression.rawBytes;
+		compressed += compression.compressedBytes;
+	}
+
+	// Compressed and indexed on their own threads, not this one; only what
+	// was written is indexed, those a failed flush kept are once they are
+	if (sealed.IsEmpty() == false || written.IsEmpty() == false) {
+		BAutolock _(fListenersLock);
+		for (const BString& path : sealed) {
+			if (fCompactor != NULL)
+				fCompactor->Sealed(path.String());
+		}
+		for (const BString& path : written) {
+			if (fIndexer != NULL)
+				fIndexer->Written(path.String());
+		}
+	}
+
+	for (uint32 i = 0; i < lines.CountItems(); i++) {
+		BString* text = lines.ValueAt(i);
+		// Written at the end, but not opened at it, as trimming rewrites it
+		BFile file(lines.KeyAt(i).String(), B_READ_WRITE | B_CREATE_FILE);
+		off_t size = 0;
+		if (file.GetSize(&size) != B_OK
+			|| write_fully(file, size, text->String(), text->Length())
+				!= B_OK)
+			errors++;
+		else if (fPolicy.textSize > 0
+			&& (size += text->Length()) > fPolicy.textSize
+			&& trim_text(file, size, fPolicy.textSize) != B_OK)
+			errors++;
+		else if (sync == true)
+			file.Sync();
+		delete text;
+	}
+
+	while (first != NULL) {
+		log_record* next = first->next;
+		delete first;
+		first = next;
+	}
+	fQueued -= count;
+	int32 waiting = fWaiting;
+	if (waiting > 0)
+		release_sem_etc(fRoom, waiting, 0);
+	_CloseIdle();
+
+	bigtime_t took = system_time() - start;
+	BAutolock _(fStatsLock);
+	fStats.written += count;
+	fStats.errors += errors;
+	fStats.flushes++;
+	fStats.lastFlush = took;
+	fStats.totalFlush += took;
+	if (took > fStats.maxFlush)
+		fStats.maxFlush = took;
+	fStats.sealedBytes = sealedBytes;
+	fStats.compressedBytes = compressed;
+}
+
+
+status_t
+LogWriter::_Run(log_task* task)
+{
+	if (fThread < 0 || fQuitting == true)
+		return B_NO_INIT;
+	task->result = B_ERROR;
+	task->finished = create_sem(0, "Log writer task");
+	if (task->finished < 0)
+		return task->finished;
+
+	task->next = fTasks.load(std::memory_order_relaxed);
+	while (fTasks.compare_exchange_weak(task->next, task,
+			std::memory_order_release, std::memory_order_relaxed) == false)
+		;
+	release_sem(fWakeUp);
+
+	while (acquire_sem(task->finished) == B_INTERRUPTED)
+		;
+	delete_sem(task->finished);
+	return task->result;
+}
+
+
+void
+LogWriter::_RunTasks(log_task* tasks)
+{
+	while (tasks != NULL) {
+		// The task's gone once it's finished
+		log_task* next = tasks->next;
+		open_log* item = _LogFor(tasks->logPath);
+		ChatLog* log = item->log;
+		tasks->result = log->InitCheck();
+		if (tasks->result == B_OK && tasks->what == kPruneTask) {
+			off_t freed = 0;
+			tasks->result = log->Prune(tasks->retention, tasks->now,
+				&tasks->done, &freed);
+			tasks->bytes = freed;
+			// Its index drops them as it catches up
+			if (tasks->result == B_OK && tasks->done > 0) {
+				BAutolock _(fListenersLock);
+				if (fIndexer != NULL)
+					fIndexer->Written(tasks->logPath.String());
+			}
+		} else if (tasks->result == B_OK)
+			tasks->result = log->AdoptCompressed(tasks->compressed);
+		release_sem(tasks->finished);
+		tasks = next;
+	}
+	_CloseIdle();
+}
+
+
+LogWriter::open_log*
+LogWriter::_LogFor(const BString& path)
+{
+	open_log* item = fLogs.ValueFor(path);
+	if (item == NULL) {
+		item = new open_log;
+		item->log = new ChatLog(path.String());
+		item->log->SetRotation(fPolicy.rotation);
+		item->segment = item->log->SegmentOf(item->log->CountEntries());
+		fLogs.AddItem(path, item);
+	}
+	item->used = system_time();
+	return item;
+}
+
+
+void
+LogWriter::_CloseIdle()
+{
+	// Not those with entries left to write
+	while (fLogs.CountItems() > (uint32)kMaxOpenLogs) {
+		int32 oldest = -1;
+		for (uint32 i = 0; i < fLogs.CountItems(); i++) {
+			open_log* item = fLogs.ValueAt(i);
+			if (item->log->CountPending() == 0 && (oldest < 0
+					|| item->used < fLogs.ValueAt(oldest)->used))
+				oldest = i;
+		}
+		if (oldest < 0)
+			break;
+
+		open_log* item = fLogs.RemoveItemAt(oldest);
+		log_compression_stats compression = item->log->CompressionStats();
+		fClosed.rawBytes += compression.rawBytes;
+		fClosed.compressedBytes += compression.compressedBytes;
+		delete item->log;
+		delete item;
+	}
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _LOG_WRITER_H
+#define _LOG_WRITER_H
+
+#include <atomic>
+
+#include <Locker.h>
+#include <Message.h>
+#include <OS.h>
+#include <String.h>
+
+#include <libsupport/KeyMap.h>
+
+#include "ChatLog.h"
+
+class LogCompactor;
+class LogIndexer;
+
+
+// When the LogWriter writes what's been queued; whatever's left is always
+// written, and synced, when it's deleted.
+struct log_policy {
+	bigtime_t	flushInterval;	// Oldest a queued record gets, or
+								// B_INFINITE_TIMEOUT
+	uint32		flushRecords;	// Most records queued at once, or 0
+	uint32		maxQueued;		// Records queued before Log() waits for
+								// the writer, or 0 for no limit
+	bool		sync;			// Wait for each flush to hit the disk
+	int64		rotation;		// Seconds a segment spans at most, or 0
+	off_t		textSize;		// Largest a plain-text log gets, or 0
+};
+
+
+struct log_writer_stats {
+	uint32		queued;			// Records waiting to be written
+	uint32		peakQueued;		// Most that ever were at once
+	uint32		stalls;			// Times Log() waited for room
+	bigtime_t	stallTime;		// How long it waited in all
+	uint64		written;
+	uint32		errors;			// Records or files that couldn't be written
+	uint32		flushes;
+	bigtime_t	lastFlush;		// How long flushes took
+	bigtime_t	maxFlush;
+	bigtime_t	totalFlush;
+	uint64		sealedBytes;	// Compressed from, and to
+	uint64		compressedBytes;
+};
+
+
+// Writes ChatLogs and plain-text logs on its own thread.
+// Log() only pushes the record on a lock-free queue, so it can be called
+// from any thread; the writer then takes everything queued at once, and
+// makes one write per log file out of it. The writer's woken early once
+// half the policy's maxQueued are waiting, and past it Log() waits for it
+// to catch up, so a flood of messages can't outgrow memory.
+// Plain-text logs that grow past the policy's size lose their older half.
+// Only so many ChatLogs are kept open, the least recently written being
+// closed once there's more. They're indexed by the LogIndexer, which is
+// only told what's been written, so that indexing never holds it up.
+// Whatever else is done to a log it may have open is done by it too, on
+// its thread and with the ChatLog it writes, so that no other one ever
+// writes a live log. Compression is the exception, as it'd hold
+// up the records behind it: sealed segments are compressed aside on the
+// caller's thread, and the writer only swaps them in.
+class LogWriter {
+public:
+						LogWriter(const log_policy& policy);
+						~LogWriter();
+
+			status_t	InitCheck() const { return fThread < 0 ? fThread : B_OK; }
+
+	// Queue message for the ChatLog at logPath, and line (if any) for the
+	// plain-text log at textPath
+			void		Log(const char* logPath, const char* textPath,
+							BMessage* message, int64 when, const char* sender,
+							uint32 flags, const char* line = NULL);
+
+	// Write what's queued now rather than per the policy
+			void		Flush();
+
+	// Apply retention to the ChatLog at logPath, see ChatLog::Prune();
+	// waits for the writer to do it
+			status_t	Prune(const char* logPath,
+							const log_retention& retention, int64 now,
+							uint64* _pruned = NULL, off_t* _freed = NULL);
+	// Compress up to count of its sealed segments, or all if it's -1, on
+	// this thread, giving the bytes compressed and what they came to
+			status_t	CompressSealed(const char* logPath, int32 count,
+							uint64* _read = NULL, uint64* _written = NULL);
+
+	// Tell compactor of each log that seals a segment, or no one if NULL
+			void		SetCompactor(LogCompactor* compactor);
+	// Tell indexer of each log that's written or pruned, or no one if NULL
+			void		SetIndexer(LogIndexer* indexer);
+
+			log_writer_stats Stats();
+
+private:
+	struct log_record {
+		log_record*	next;
+		BString		logPath;
+		BString		textPath;
+		BMessage	message;
+		int64		when;
+		BString		sender;
+		uint32		flags;
+		BString		line;
+	};
+
+	struct open_log {
+		ChatLog*	log;
+		bigtime_t	used;
+		uint32		segment;	// Last appended to
+	};
+
+	// Waited for by whoever queued it
+	struct log_task {
+		log_task*	next;
+		uint32		what;
+		BString		logPath;
+		log_retention retention;
+		int64		now;
+		compressed_segment compressed;	// To adopt
+		uint64		done;		// Entries pruned
+		uint64		bytes;		// Bytes freed
+		status_t	result;
+		sem_id		finished;
+	};
+
+	static	status_t	_WriterThread(void* data);
+			void		_WaitForRoom();
+			void		_Write(log_record* records, bool sync);
+			status_t	_Run(log_task* task);
+			void		_RunTasks(log_task* tasks);
+			open_log*	_LogFor(const BString& path);
+			void		_CloseIdle();
+
+			log_policy	fPolicy;
+
+			std::atomic<log_record*> fQueue;
+			std::atomic<log_task*> fTasks;
+			std::atomic<uint32> fQueued;
+			std::atomic<uint32> fPeakQueued;
+			std::atomic<int32> fWaiting;
+			std::atomic<bool> fWoken;
+			std::atomic<bool> fQuitting;
+			sem_id		fWakeUp;
+			sem_id		fRoom;		// Released for those waiting, as
+									// records are written
+			thread_id	fThread;
+
+	// Only touched by the writer thread
+			KeyMap<BString, open_log*> fLogs;
+			log_compression_stats fClosed;
+
+			BLocker		fStatsLock;
+			log_writer_stats fStats;
+
+			BLocker		fListenersLock;
+			LogCompactor* fCompactor;
+			LogIndexer*	fIndexer;
+};
+
+
+#endif // _LOG_WRITER_H
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "UrlScanner.h"
+
+#include <string.h>
+
+
+enum {
+	kInvalid = 0,
+	kChar,
+	kColon,
+	kSlash
+};
+
+enum {
+	kOutside = 0,	// Not in a run of URL characters
+	kScheme,		// In one, no "://" yet
+	kAfterColon,
+	kAfterSlash,
+	kUrl			// Past its "://"
+};
+
+
+// Of every byte; URL characters are those allowed by rfc3986, and no
+// non-ASCII ones
+static const uint8 kClasses[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 0, 1, 0, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+
+static const uint8 kNextState[5][4] = {
+	// kInvalid	kChar		kColon		kSlash
+	{ kOutside,	kScheme,	kAfterColon,	kScheme },		// kOutside
+	{ kOutside,	kScheme,	kAfterColon,	kScheme },		// kScheme
+	{ kOutside,	kScheme,	kAfterColon,	kAfterSlash },	// kAfterColon
+	{ kOutside,	kScheme,	kAfterColon,	kUrl },			// kAfterSlash
+	{ kOutside,	kUrl,		kUrl,			kUrl }			// kUrl
+};
+
+
+UrlScanner::UrlScanner()
+{
+	Reset();
+}
+
+
+void
+UrlScanner::Reset()
+{
+	fText = NULL;
+	fLength = 0;
+	fPosition = 0;
+	fBase = 0;
+	fState = kOutside;
+	fRunStart = 0;
+	fSchemeEnd = 0;
+	fOpenGiven = false;
+}
+
+
+void
+UrlScanner::Feed(const char* text, int32 length)
+{
+	fBase += fLength;
+	fText = text;
+	fLength = text != NULL ? length : 0;
+	fPosition = 0;
+	fOpenGiven = false;
+}
+
+
+bool
+UrlScanner::Next(int32* start, int32* end)
+{
+	while (fPosition < fLength) {
+		if (fState == kOutside || fState == kScheme) {
+			_SkipToColon();
+			continue;
+		}
+
+		uint8 state = fState;
+		fState = kNextState[state][kClasses[(uint8)fText[fPosition]]];
+		int32 offset = fBase + fPosition++;
+
+		if (state == kAfterSlash && fState == kUrl)
+			fSchemeEnd = offset - 2;
+		else if (state == kUrl && fState == kOutside
+			&& _Span(offset, start, end) == true)
+			return true;
+	}
+
+	if (fState == kUrl && fOpenGiven == false) {
+		fOpenGiven = true;
+		return _Span(fBase + fLength, start, end);
+	}
+	return false;
+}
+
+
+void
+UrlScanner::_SkipToColon()
+{
+	// Outside a URL, only a colon can start one: everything up to it is
+	// skipped at once, and the run of URL characters before it is found
+	// going back from it, as that's where the scheme would be.
+	const char* colon = (const char*)memchr(fText + fPosition, ':',
+		fLength - fPosition);
+	int32 stop = colon != NULL ? colon - fText : fLength;
+	int32 runStart = stop;
+	while (runStart > fPosition
+		&& kClasses[(uint8)fText[runStart - 1]] != kInvalid)
+		runStart--;
+
+	// A run going on from the last piece keeps its start
+	if (runStart > fPosition || fState == kOutside)
+		fRunStart = fBase + runStart;
+
+	if (colon != NULL) {
+		fState = kAfterColon;
+		fPosition = stop + 1;
+		return;
+	}
+	if (runStart < stop)
+		fState = kScheme;
+	else if (runStart > fPosition)
+		fState = kOutside;
+	fPosition = stop;
+}
+
+
+bool
+UrlScanner::_Span(int32 end, int32* _start, int32* _end) const
+{
+	// Neither the scheme nor what follows it can be empty
+	if (fSchemeEnd <= fRunStart || end <= fSchemeEnd + 3)
+		return false;
+	*_start = fRunStart;
+	*_end = end;
+	return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _URL_SCANNER_H
+#define _URL_SCANNER_H
+
+#include <SupportDefs.h>
+
+
+/*! Finds URLs (a scheme, "://" and anything else allowed by rfc3986) in one
+  * pass over text, a byte at a time through a table of states.
+  * Text can be given a piece at a time, the state's kept between them, so
+  * a URL split over pieces is still found whole. */
+class UrlScanner {
+public:
+					UrlScanner();
+
+			// Forget what was scanned, the next text's offsets start at 0
+			void	Reset();
+
+			// More text, following what was given before; it isn't copied,
+			// so it's to be kept until Next() returns false
+			void	Feed(const char* text, int32 length);
+
+			// The next URL in what's been fed, as offsets from the first text
+			// after Reset(): it may have started in an earlier piece, and one
+			// still going on at the end of this piece is given as ending
+			// there, and again once it ends in a later piece.
+			bool	Next(int32* start, int32* end);
+
+private:
+			void	_SkipToColon();
+			bool	_Span(int32 end, int32* _start, int32* _end) const;
+
+	const char*		fText;
+	int32			fLength;
+	int32			fPosition;
+	int32			fBase;
+
+	uint8			fState;
+	int32			fRunStart;
+	int32			fSchemeEnd;
+	bool			fOpenGiven;
+};
+
+#endif // _URL_SCANNER_H
@@ -5,7 +5,9 @@
 
 #include "UrlTextView.h"
 
-#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <Cursor.h>
 #include <Locale.h>
@@ -32,7 +34,11 @@ UrlTextView::UrlTextView(const char* name, const BFont* initialFont,
 	BTextView(name, initialFont, initialColor, flags),
 	fUrlCursor(new BCursor(B_CURSOR_ID_FOLLOW_LINK)),
 	fMouseDown(false),
-	fSelecting(false)
+	fSelecting(false),
+	fOverUrl(false),
+	fInsertOffset(-1),
+	fScanStart(0),
+	fScanEnd(-1)
 {
 	MakeEditable(false);
 	SetStylable(true);
@@ -140,11 +146,17 @@ UrlTextView::MouseMoved(BPoint where, uint32 code, const BMessage* drag)
 	if (fSelecting == true)
 		return;
 
-	if (code == B_INSIDE_VIEW)
-		if (OverUrl(where) == true)
+	// Only changed on crossing into or out of a URL
+	if (code == B_INSIDE_VIEW) {
+		bool overUrl = OverUrl(where);
+		if (overUrl == fOverUrl)
+			return;
+		fOverUrl = overUrl;
+		if (overUrl == true)
 			SetViewCursor(fUrlCursor);
 		else
 			SetViewCursor(B_CURSOR_SYSTEM_DEFAULT);
+	}
 }
 
 
@@ -161,36 +173,43 @@ UrlTextView::Select(int32 startOffset, int32 endOffset)
 void
 UrlTextView::Insert(const char* text, const text_run_array* runs)
 {
-	BString buf(text);
-
-	int32 specStart = 0;
-	int32 specEnd = 0;
-	int32 lastEnd = 0;
-	int32 length = buf.CountChars();
-
+	if (text == NULL)
+		return;
 	if (runs == NULL)
 		runs = &fNormalRun;
 
-	while (_FindUrlString(buf, &specStart, &specEnd, lastEnd) == true) {
-		if (lastEnd < specStart) {
-			BString normie;
-			buf.CopyCharsInto(normie, lastEnd, specStart - lastEnd);
-			BTextView::Insert(TextLength(), normie.String(), normie.Length(),
-				runs);
-		}
-		BString special;
-		buf.CopyCharsInto(special, specStart, specEnd - specStart);
-		BTextView::Insert(TextLength(), special.String(), special.Length(),
-			&fUrlRun);
-
-		lastEnd = specEnd;
+	int32 length = strlen(text);
+	int32 base = fInsertOffset < 0 ? TextLength() : fInsertOffset;
+	if (base != fScanEnd) {
+		fUrlScanner.Reset();
+		fScanStart = base;
 	}
-	if (lastEnd < length) {
-		BString remaining;
-		buf.CopyCharsInto(remaining, lastEnd, length - lastEnd);
-		BTextView::Insert(TextLength(), remaining.String(), remaining.Length(),
-			runs);
+	fUrlScanner.Feed(text, length);
+
+	// Offsets are in bytes, the text's inserted a piece at a time
+	int32 start = 0;
+	int32 end = 0;
+	int32 lastEnd = 0;
+	while (fUrlScanner.Next(&start, &end) == true) {
+		start += fScanStart - base;
+		end += fScanStart - base;
+		int32 urlStart = base + start;
+
+		// Begun in text already inserted, which becomes part of it
+		if (start < 0) {
+			SetRunArray(base + start, base, &fUrlRun);
+			start = 0;
+		}
+		if (lastEnd < start)
+			_Insert(text + lastEnd, start - lastEnd, runs, lastEnd);
+		if (start < end)
+			_Insert(text + start, end - start, &fUrlRun);
+		_AddUrl(urlStart, base + end);
+		lastEnd = end;
 	}
+	if (lastEnd < length)
+		_Insert(text + lastEnd, length - lastEnd, runs, lastEnd);
+	fScanEnd = base + length;
 }
 
 
@@ -198,6 +217,9 @@ void
 UrlTextView::SetText(const char* text, const text_run_array* runs)
 {
 	BTextView::SetText("");
+	fInsertOffset = -1;
+	fScanEnd = -1;
+	fUrls.clear();
 	Insert(text, runs);
 }
 
@@ -256,22 +278,17 @@ UrlTextView::GetLine(int32 line)
 BUrl
 UrlTextView::UrlAt(BPoint where)
 {
-	int32 lineNo = LineAt(where);
-	BString urlStr, line = GetLine(lineNo);
-	BUrl url;
-
-	int32 clickedOffset = OffsetAt(where) - OffsetAt(lineNo);
-	int32 offset = line.FindLast(" ", clickedOffset);
-	if (offset == B_ERROR)
-		offset = 0;
-
-	int32 start;
-	int32 end;
-	if (_FindUrlString(line, &start, &end, offset) == true) {
-		line.CopyCharsInto(urlStr, start, end - start);
-		url.SetUrlString(urlStr);
-	}
-	return url;
+	int32 offset = OffsetAt(where);
+	url_iterator span = _UrlAfter(offset);
+	if (span == fUrls.end() || span->start > offset)
+		return BUrl();
+
+	BString urlString;
+	int32 length = span->end - span->start;
+	char* buffer = urlString.LockBuffer(length + 1);
+	GetText(span->start, length, buffer);
+	urlString.UnlockBuffer(length);
+	return BUrl(urlString.String());
 }
 
 
@@ -293,14 +310,43 @@ UrlTextView::OverUrl(BPoint where)
 		return false;
 
 	int32 offset = OffsetAt(where);
-	text_run_array* rArray = RunArray(offset, offset + 1);
-	text_run run = rArray->runs[0];
-	text_run urlRun = fUrlRun.runs[0];
-
-	if (run.font.Face() == urlRun.font.Face()
-			&& (run.color == urlRun.color))
-		return true;
-	return false;
+	url_iterator span = _UrlAfter(offset);
+	return span != fUrls.end() && span->start <= offset;
+}
+
+
+void
+UrlTextView::InsertText(const char* text, int32 length, int32 offset,
+	const text_run_array* runs)
+{
+	BTextView::InsertText(text, length, offset, runs);
+
+	// Those after it move along, one it's put into grows
+	for (url_iterator i = _UrlAfter(offset); i != fUrls.end(); i++) {
+		if (i->start >= offset)
+			i->start += length;
+		i->end += length;
+	}
+}
+
+
+void
+UrlTextView::DeleteText(int32 fromOffset, int32 toOffset)
+{
+	BTextView::DeleteText(fromOffset, toOffset);
+
+	// Those after it move back, any within it go with it
+	int32 length = toOffset - fromOffset;
+	url_iterator kept = _UrlAfter(fromOffset);
+	for (url_iterator i = kept; i != fUrls.end(); i++) {
+		url_span span = *i;
+		if (span.start >= fromOffset)
+			span.start = std::max(fromOffset, span.start - length);
+		span.end = std::max(fromOffset, span.end - length);
+		if (span.start < span.end)
+			*kept++ = span;
+	}
+	fUrls.erase(kept, fUrls.end());
 }
 
 
@@ -342,45 +388,84 @@ UrlTextView::_RightClickPopUp(BPoint where)
 }
 
 
-bool
-UrlTextView::_FindUrlString(BString text, int32* start, int32* end, int32 offset)
+void
+UrlTextView::_Insert(const char* text, int32 length,
+	const text_run_array* runs, int32 runsOffset)
 {
-	int32 urlOffset = text.FindFirst("://", offset);
-	int32 urlStart = text.FindLast(" ", urlOffset) + 1;
-	int32 urlEnd = text.FindFirst(" ", urlOffset);
+	// Only the runs over this piece, from its start on
+	text_run_array* slice = NULL;
+	if (runs->count > 1) {
+		int32 first = 0;
+		while (first + 1 < runs->count
+			&& runs->runs[first + 1].offset <= runsOffset)
+			first++;
+		int32 end = first + 1;
+		while (end < runs->count
+			&& runs->runs[end].offset < runsOffset + length)
+			end++;
+
+		slice = AllocRunArray(end - first);
+		if (slice != NULL) {
+			for (int32 i = first; i < end; i++) {
+				slice->runs[i - first] = runs->runs[i];
+				slice->runs[i - first].offset
+					= std::max((int32)0, runs->runs[i].offset - runsOffset);
+			}
+			runs = slice;
+		}
+	}
 
-	if (urlOffset == B_ERROR)
-		return false;
+	if (fInsertOffset < 0)
+		BTextView::Insert(TextLength(), text, length, runs);
+	else {
+		BTextView::Insert(fInsertOffset, text, length, runs);
+		fInsertOffset += length;
+	}
+	if (slice != NULL)
+		FreeRunArray(slice);
+}
 
-	if (urlStart == B_ERROR)	urlStart = 0;
-	if (urlEnd == B_ERROR)		urlEnd = text.CountChars();
 
-	// Find first char of protocol
-	for (int32 i = urlStart; i < urlOffset; i++)
-		if (_IsValidUrlChar(text.ByteAt(i)) == true) {
-			urlStart = i;
-			break;
-		}
+UrlTextView::url_iterator
+UrlTextView::_UrlAfter(int32 offset)
+{
+	url_span key = { offset, offset };
+	return std::upper_bound(fUrls.begin(), fUrls.end(), key,
+		[](const url_span& a, const url_span& b) { return a.end < b.end; });
+}
 
-	// Find last char of URL
-	for (int32 i = urlOffset; i < urlEnd; i++)
-		if (_IsValidUrlChar(text.ByteAt(i)) == false) {
-			urlEnd = i;
-			break;
-		}
 
-	*start = urlStart;
-	*end = urlEnd;
-	return true;
+void
+UrlTextView::_AddUrl(int32 start, int32 end)
+{
+	if (start >= end)
+		return;
+	url_iterator first = _UrlAfter(start);
+	url_iterator last = first;
+	url_span added = { start, end };
+	for (; last != fUrls.end() && last->start < end; last++) {
+		added.start = std::min(added.start, last->start);
+		added.end = std::max(added.end, last->end);
+	}
+	if (first != last) {
+		*first = added;
+		fUrls.erase(first + 1, last);
+	} else
+		fUrls.insert(first, added);
 }
 
 
 bool
-UrlTextView::_IsValidUrlChar(char c)
+UrlTextView::FindUrlString(const BString& text, int32* start, int32* end,
+	int32 offset)
 {
-	return (isalpha(c) || isdigit(c) || c == ':' || c == '%' || c == ':'
-		|| c == '/' || c == '?' || c == '#' || c == '[' || c == ']' || c == '@'
-		|| c == '!' || c == '$' || c == '&' || c == '(' || c == ')' || c == '*'
-		|| c == '*' || c == '+' || c == ',' || c == ';' || c == '=' || c == '-'
-		|| c == '.' || c == '_' || c == '~' || c == '\'');
+	if (offset < 0 || offset >= text.Length())
+		return false;
+	UrlScanner scanner;
+	scanner.Feed(text.String() + offset, text.Length() - offset);
+	if (scanner.Next(start, end) == false)
+		return false;
+	*start += offset;
+	*end += offset;
+	return true;
 }
@@ -5,9 +5,13 @@
 #ifndef _URL_TEXT_VIEW_H
 #define _URL_TEXT_VIEW_H
 
+#include <vector>
+
 #include <TextView.h>
 #include <Url.h>
 
+#include "UrlScanner.h"
+
 class BPopUpMenu;
 
 
@@ -28,10 +32,16 @@ public:
 
 	virtual void	Select(int32 startOffset, int32 endOffset);
 
-			// Only differs in that it changes font face and color of any URLs
+			// Only differs in that it changes font face and color of any URLs,
+			// including those split between this and the last Insert()
 			void	Insert(const char* text, const text_run_array* runs = NULL);
 			void	SetText(const char* text, const text_run_array* runs = NULL);
 
+			// Where Insert() puts text from now on, moving along as it does;
+			// -1 (the default) is the end of the text
+			void	SetInsertOffset(int32 offset) { fInsertOffset = offset; }
+			int32	InsertOffset() const { return fInsertOffset; }
+
 		 BString	WordAt(BPoint point);
 			void	FindWordAround(int32 offset, int32* start, int32* end,
 						BString* _word = NULL);
@@ -42,14 +52,34 @@ public:
 			bool	OverText(BPoint where);
 			bool	OverUrl(BPoint where);
 
+			// The first URL in text from offset on, in bytes
+	static	bool	FindUrlString(const BString& text, int32* start,
+						int32* end, int32 offset);
+
+protected:
+	// Kept up-to-date with the URLs' offsets
+	virtual	void	InsertText(const char* text, int32 length, int32 offset,
+						const text_run_array* runs);
+	virtual	void	DeleteText(int32 fromOffset, int32 toOffset);
+
 private:
+	struct url_span {
+		int32	start;
+		int32	end;
+	};
+	typedef std::vector<url_span>::iterator url_iterator;
+
 	 BPopUpMenu*	_RightClickPopUp(BPoint where);
 
-			bool	_FindUrlString(BString text, int32* start, int32* end,
-						int32 offset);
+			// The runs may be of a larger text, that this one's part of
+			// from runsOffset on
+			void	_Insert(const char* text, int32 length,
+						const text_run_array* runs, int32 runsOffset = 0);
 
-			// Checks if char is allowed in a url, as per rfc3986
-			bool	_IsValidUrlChar(char c);
+			// The first URL ending after offset, by binary search
+			url_iterator _UrlAfter(int32 offset);
+			// Merged with any it overlaps
+			void	_AddUrl(int32 start, int32 end);
 
 	// For safe-keeping
 	text_run_array fNormalRun;
@@ -60,6 +90,18 @@ private:
 	BUrl fLastClicked;
 	bool fMouseDown;
 	bool fSelecting;
+	// Whether the cursor's been set for one
+	bool fOverUrl;
+
+	// Of all URLs in the text, in order
+	std::vector<url_span> fUrls;
+
+	int32 fInsertOffset;
+
+	// Scanned on from the last insert, if it ended where the next one starts
+	UrlScanner fUrlScanner;
+	int32 fScanStart;
+	int32 fScanEnd;
 };
 
 #endif // _URL_TEXT_VIEW_H
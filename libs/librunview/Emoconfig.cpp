@@ -3,10 +3,8 @@
 #include <File.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <Bitmap.h>
 #include <String.h>
 #include <Path.h>
-#include <TranslationUtils.h>
 
 //tmp
 BMessage*	faces = NULL;
@@ -36,7 +34,7 @@ Emoconfig::Emoconfig(const char* xmlfile): BMessage()
 
 	// loading the config file..
 	BFile* settings = new BFile(xmlfile, B_READ_ONLY);
-	off_t size;
+	off_t size = 0;
 	settings->GetSize(&size);
 	if (size) {
 		void* buffer = malloc((size_t)size);
@@ -102,29 +100,24 @@ Emoconfig::EndElement(void* pUserData, const char* pName)
 		//compose the filename
 		BPath p(path);
 		p.Append(filename.String());
-		BBitmap* icons = NULL;
 
-		if ( !svg ) {
-			//
-			icons = BTranslationUtils::GetBitmap(p.Path());
-		}
-
-		//assign to faces;
+		//assign to faces; the bitmap's only loaded once it's shown, see
+		//Emoticor::GetBitmap()
 		fname = false;
 
 		//		printf("Filename %s [%s]\n",p.Path(),path.Path());
-		if (!icons) return;
+		if (svg) return;
 
 		int 		i = 0;
 		BString s;
 		while (faces->FindString("face", i, &s) == B_OK) {
 
 			if (i == 0) {
-				((Emoconfig*)pUserData)->menu.AddPointer(s.String(), (const void*)icons);
+				((Emoconfig*)pUserData)->menu.AddString(s.String(), p.Path());
 				((Emoconfig*)pUserData)->menu.AddString("face", s.String());
 			}
-			((BMessage*)pUserData)->AddPointer(s.String(), (const void*)icons);
 			((BMessage*)pUserData)->AddString("face", s.String());
+			((BMessage*)pUserData)->AddString("file", p.Path());
 			((Emoconfig*)pUserData)->numfaces++;
 			i++;
 
@@ -1,12 +1,42 @@
+
 #include "Emoticor.h"
-#include <Resources.h>
-#include <Directory.h>
-#include <Path.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <TranslationUtils.h>
+
+#include "Emoconfig.h"
 #include "string.h"
 
 
 static Emoticor*	fInstance = NULL;
 
+// Icons per row of the atlas
+const int32 kAtlasColumns = 16;
+
+
+static uint8
+lower_byte(uint8 c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 'a';
+	return c;
+}
+
+
+// Letters, digits, and any of a UTF-8 character's bytes
+static bool
+is_word_byte(char c)
+{
+	uint8 byte = (uint8)c;
+	return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')
+		|| (byte >= '0' && byte <= '9') || byte >= 0x80;
+}
+
 
 Emoticor*
 Emoticor::Get()
@@ -19,16 +49,21 @@ Emoticor::Get()
 
 
 Emoticor::Emoticor()
+	:
+	fConfig(NULL),
+	fClassCount(1),
+	fAtlas(NULL),
+	fCellSize(16),
+	fAtlasLock("emoticon atlas")
 {
-	fInstance = NULL;
-	fConfig = NULL;
+	memset(fClasses, 0, sizeof(fClasses));
 }
 
 
 Emoticor::~Emoticor()
 {
-	if (fConfig)
-		delete fConfig;
+	delete fConfig;
+	delete fAtlas;
 }
 
 
@@ -42,83 +77,208 @@ Emoticor::Config()
 void
 Emoticor::LoadConfig(const char* txt)
 {
+	BAutolock _(fAtlasLock);
+	delete fConfig;
+	delete fAtlas;
+	fAtlas = NULL;
 	fConfig = new Emoconfig(txt);
+	_Compile();
 }
 
 
 void
-Emoticor::_findTokens(RunView* fTextView, BString text, int tokenstart,
-					  rgb_color cols, rgb_color font, rgb_color cols2,
-					  rgb_color font2)
+Emoticor::FindFaces(const char* text, int32 length,
+	List<emoticon_span>* spans) const
 {
-	//******************************************
-	// "Iteration is human, recursion is divine"
-	//******************************************
-
-	int32	newindex = 0;
-	BString	cur;
-	int	i = tokenstart;
-
-	if (fConfig != NULL) {
-		while (fConfig->FindString("face", i, &cur) == B_OK)
-			//for(int i=tokenstart;i<config->numfaces;i++)
-		{
-			i++;
-			//if(config->FindString("face",i,&cur)!=B_OK) return;
-
-			newindex = 0;
-
-			while (true) {
-				newindex = text.IFindFirst(cur.String(), 0);
-				//printf("Try %d %s  -- match %d\n",i,cur->original.String(),newindex);
-
-				if (newindex != B_ERROR) {
-					//take a walk on the left side ;)
-
-					//printf("Found at %ld \n",newindex);
+	spans->MakeEmpty();
+	if (fStates.empty() == true)
+		return;
+
+	int32 current = 0;
+	for (int32 i = 0; i < length; i++) {
+		current = fNext[current * fClassCount + fClasses[(uint8)text[i]]];
+		int32 end = i + 1;
+
+		// The longest face ending here that isn't part of a word
+		int32 match = fStates[current].length > 0
+			? current : fStates[current].output;
+		for (; match != 0; match = fStates[match].output) {
+			int32 start = end - fStates[match].length;
+			if ((start > 0 && is_word_byte(text[start - 1]) == true)
+				|| (end < length && is_word_byte(text[end]) == true))
+				continue;
+
+			// It replaces those it overlaps that don't start before it; if
+			// one does, a shorter face ending here might still fit
+			uint32 keep = spans->CountItems();
+			while (keep > 0 && spans->ItemAt(keep - 1).end > start
+				&& spans->ItemAt(keep - 1).start >= start)
+				keep--;
+			if (keep > 0 && spans->ItemAt(keep - 1).end > start)
+				continue;
+
+			while (spans->CountItems() > keep)
+				spans->RemoveItemAt(spans->CountItems() - 1);
+			emoticon_span span = { start, end, fStates[match].icon };
+			spans->AddItem(span);
+			break;
+		}
+	}
+}
 
-					if (newindex - 1 >= 0) {
-						BString left;
-						text.CopyInto(left, 0, newindex);
-						//printf("ready to recourse! [%s]\n",left.String());
-						_findTokens(fTextView, left, tokenstart + 1, cols, font, cols2, font2);
-					}
 
+bool
+Emoticor::GetBitmap(int32 icon, BBitmap** _atlas, BRect* _frame)
+{
+	BAutolock _(fAtlasLock);
+	if (icon < 0 || icon >= (int32)fIcons.size())
+		return false;
+	if (fIcons[icon].loaded == 0)
+		_Load(icon);
+	if (fIcons[icon].loaded < 0)
+		return false;
+
+	*_atlas = fAtlas;
+	*_frame = fIcons[icon].frame;
+	return true;
+}
 
-					text.Remove(0, newindex + cur.Length());
 
-					//printf("remaning [%s] printed  [%s]\n",text.String(),cur->original.String());
+float
+Emoticor::EmoticonSize() const
+{
+	return fCellSize;
+}
 
-//					fTextView->Append(cur.String(), cols2, cols2, font2);
-//					TODO
 
-					if (text.Length() == 0) return; //useless stack
-				} else
-					break;
+void
+Emoticor::_Compile()
+{
+	memset(fClasses, 0, sizeof(fClasses));
+	fClassCount = 1;
+	fNext.clear();
+	fStates.clear();
+	fIcons.clear();
+	fCellSize = std::max((int32)1, (int32)fConfig->GetEmoticonSize());
+
+	// Each face's icon, one per file, and the bytes they're made of
+	std::map<BString, int32> files;
+	List<BString> faces;
+	List<int32> faceIcons;
+	BString face;
+	BString file;
+	for (int32 i = 0; fConfig->FindString("face", i, &face) == B_OK
+		&& fConfig->FindString("file", i, &file) == B_OK; i++) {
+		if (face.IsEmpty() == true)
+			continue;
+
+		std::map<BString, int32>::iterator found = files.find(file);
+		int32 icon = 0;
+		if (found == files.end()) {
+			icon = fIcons.size();
+			files[file] = icon;
+			Emoticor::icon item = { file, 0, BRect() };
+			fIcons.push_back(item);
+		} else
+			icon = found->second;
+
+		for (int32 j = 0; j < face.Length(); j++) {
+			uint8 byte = lower_byte(face.ByteAt(j));
+			if (fClasses[byte] != 0)
+				continue;
+			fClasses[byte] = fClassCount++;
+			if (byte >= 'a' && byte <= 'z')
+				fClasses[byte - 'a' + 'A'] = fClasses[byte];
+		}
+		faces.AddItem(face);
+		faceIcons.AddItem(icon);
+	}
 
+	// The trie of faces, a state per prefix
+	state root = { 0, -1, 0 };
+	fStates.push_back(root);
+	fNext.assign(fClassCount, -1);
+	for (uint32 i = 0; i < faces.CountItems(); i++) {
+		const BString& text = faces.ItemAt(i);
+		int32 current = 0;
+		for (int32 j = 0; j < text.Length(); j++) {
+			int32 at = current * fClassCount + fClasses[(uint8)text.ByteAt(j)];
+			if (fNext[at] < 0) {
+				fNext[at] = fStates.size();
+				fStates.push_back(root);
+				fNext.resize(fNext.size() + fClassCount, -1);
 			}
+			current = fNext[at];
+		}
+		// The first of the same face is kept
+		if (fStates[current].length == 0) {
+			fStates[current].length = text.Length();
+			fStates[current].icon = faceIcons.ItemAt(i);
 		}
 	}
 
-//	fTextView->Append(text.String(), cols, cols, font);
-//	TODO
+	// Breadth-first, each state's missing moves are those of the longest
+	// suffix it has that's also a prefix, so no byte's ever gone back over
+	std::vector<int32> failures(fStates.size(), 0);
+	std::deque<int32> queue;
+	for (int32 k = 0; k < fClassCount; k++) {
+		if (fNext[k] < 0)
+			fNext[k] = 0;
+		else
+			queue.push_back(fNext[k]);
+	}
+	while (queue.empty() == false) {
+		int32 current = queue.front();
+		queue.pop_front();
+
+		int32 failure = failures[current];
+		fStates[current].output = fStates[failure].length > 0
+			? failure : fStates[failure].output;
+		for (int32 k = 0; k < fClassCount; k++) {
+			int32 at = current * fClassCount + k;
+			int32 fallback = fNext[failure * fClassCount + k];
+			if (fNext[at] < 0)
+				fNext[at] = fallback;
+			else {
+				failures[fNext[at]] = fallback;
+				queue.push_back(fNext[at]);
+			}
+		}
+	}
 }
 
 
 void
-Emoticor::AddText(RunView* fTextView, const char* txt, rgb_color cols,
-				  rgb_color font, rgb_color cols2, rgb_color font2)
+Emoticor::_Load(int32 index)
 {
+	icon& item = fIcons[index];
+	item.loaded = -1;
+
+	if (fAtlas == NULL) {
+		int32 rows = (fIcons.size() + kAtlasColumns - 1) / kAtlasColumns;
+		fAtlas = new BBitmap(BRect(0, 0, kAtlasColumns * fCellSize - 1,
+			rows * fCellSize - 1), B_RGBA32);
+		if (fAtlas->InitCheck() != B_OK) {
+			delete fAtlas;
+			fAtlas = NULL;
+			return;
+		}
+		memset(fAtlas->Bits(), 0, fAtlas->BitsLength());
+	}
 
-	BString left(txt);
-
-	//	if(!fConfig)
-	//		fTextView->Append(txt,cols,cols,font);
-
-	_findTokens(fTextView, left, 0, cols, font, cols2, font2);
-
-	return;
-
+	BBitmap* bitmap = BTranslationUtils::GetBitmap(item.path.String());
+	if (bitmap == NULL)
+		return;
+
+	// Cropped to its cell if it's larger
+	BRect bounds = bitmap->Bounds();
+	int32 width = std::min(fCellSize, bounds.IntegerWidth() + 1);
+	int32 height = std::min(fCellSize, bounds.IntegerHeight() + 1);
+	BPoint at((index % kAtlasColumns) * fCellSize,
+		(index / kAtlasColumns) * fCellSize);
+	if (fAtlas->ImportBits(bitmap, B_ORIGIN, at, width, height) == B_OK) {
+		item.frame = BRect(at.x, at.y, at.x + width - 1, at.y + height - 1);
+		item.loaded = 1;
+	}
+	delete bitmap;
 }
-
-
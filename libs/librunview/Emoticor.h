@@ -1,34 +1,82 @@
 #ifndef _Emoticor_h_
 #define _Emoticor_h_
 
+#include <vector>
+
+#include <Locker.h>
+#include <Rect.h>
 #include <String.h>
-#include <librunview/RunView.h>
-#include <librunview/Emoconfig.h>
+
+#include <libsupport/List.h>
+
+class BBitmap;
+class Emoconfig;
+
+
+struct emoticon_span {
+	int32	start;
+	int32	end;
+	int32	icon;		// For Emoticor::GetBitmap()
+};
 
 
+// Finds the config's faces in text, all in one pass through an Aho-Corasick
+// automaton compiled from them as it's loaded; each byte's a lookup in its
+// table of states, however many faces there are.
+// Their pictures are only loaded once first drawn, into one bitmap shared
+// by all views.
 class Emoticor
 {
 public:
 
 	static Emoticor*	Get(); //singleton
 
-
-	void		AddText(RunView* fTextView, const char* text,  rgb_color cols,
-						rgb_color font, rgb_color cols2, rgb_color font2);
 	void		LoadConfig(const char*);
 
 	Emoconfig* Config();
 
+	// Ignoring case, leftmost and then longest first, and only those not
+	// part of a word
+	void		FindFaces(const char* text, int32 length,
+					List<emoticon_span>* spans) const;
+
+	// Where an icon is in the atlas, false if it couldn't be loaded
+	bool		GetBitmap(int32 icon, BBitmap** _atlas, BRect* _frame);
+	float		EmoticonSize() const;
+
 	~Emoticor();
 
 private:
 	Emoticor();
+
+	struct state {
+		int32	length;		// Of the face ending here, or 0
+		int32	icon;
+		int32	output;		// The next state with a face, along failures
+	};
+
+	struct icon {
+		BString	path;
+		int8	loaded;		// 0 not yet, 1 loaded, -1 failed
+		BRect	frame;
+	};
+
+	void		_Compile();
+	void		_Load(int32 index);
+
 	Emoconfig*	fConfig;
-	void		_findTokens(RunView* fTextView, BString text, int tokenstart,
-							rgb_color cols, rgb_color font, rgb_color cols2,
-							rgb_color font2);
 
+	// Bytes are classed by the faces they're in; an upper-case letter's the
+	// same as its lower-case one, and those in none are class 0
+	uint16		fClasses[256];
+	int32		fClassCount;
+	std::vector<int32> fNext;	// Of each state and class
+	std::vector<state> fStates;
+
+	std::vector<icon> fIcons;
+	BBitmap*	fAtlas;
+	int32		fCellSize;
+	BLocker		fAtlasLock;
 };
 
 #endif
-
@@ -5,6 +5,8 @@
 
 #include "RunView.h"
 
+#include <algorithm>
+
 #include <Cursor.h>
 #include <Locale.h>
 #include <MenuItem.h>
@@ -27,14 +29,20 @@ RunView::RunView(const char* name)
 }
 
 
+void
+RunView::Append(const char* text, const text_run_array* runs)
+{
+	Insert(text, runs);
+	fLastStyled = true;
+}
+
+
 void
 RunView::Append(const char* text, rgb_color color, BFont font)
 {
 	text_run run = { 0, font, color };
 	text_run_array array = { 1, {run} };
-
-	Insert(text, &array);
-	fLastStyled = true;
+	Append(text, &array);
 }
 
 
@@ -70,3 +78,23 @@ RunView::ScrollToBottom()
 {
 	ScrollToOffset(TextLength());
 }
+
+
+void
+RunView::Trim(int32 length)
+{
+	length = std::min(length, TextLength());
+	if (length <= 0)
+		return;
+
+	int32 selectionStart, selectionEnd;
+	GetSelection(&selectionStart, &selectionEnd);
+	float height = PointAt(length).y - PointAt(0).y;
+
+	Delete(0, length);
+
+	Select(std::max((int32)0, selectionStart - length),
+		std::max((int32)0, selectionEnd - length));
+	BRect bounds = Bounds();
+	ScrollTo(BPoint(bounds.left, std::max(0.0f, bounds.top - height)));
+}
@@ -16,6 +16,8 @@ class RunView : public UrlTextView {
 public:
 	RunView(const char* name);
 
+			// With runs spanning text, as passed to BTextView::Insert()
+			void	Append(const char* text, const text_run_array* runs);
 			void	Append(const char* text, rgb_color color, BFont font);
 			void	Append(const char* text, rgb_color color, uint16 fontFace);
 			void	Append(const char* text, rgb_color color);
@@ -23,6 +25,10 @@ public:
 
 			void	ScrollToBottom();
 
+			// Delete the first length bytes of text, keeping the selection
+			// and what's in view where they were
+			void	Trim(int32 length);
+
 private:
 	// For safe-keeping
 	text_run_array fDefaultRun;
@@ -0,0 +1,1230 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "VirtualRunView.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include <Catalog.h>
+#include <Clipboard.h>
+#include <Cursor.h>
+#include <MenuItem.h>
+#include <PopUpMenu.h>
+#include <ScrollBar.h>
+#include <TextView.h>
+#include <Window.h>
+
+#include <libinterface/UrlScanner.h>
+
+#include "Emoticor.h"
+
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "VirtualRunView"
+
+
+const float kInset = 3.0;
+// Messages laid out past those in view, either way
+const int32 kLayoutMargin = 8;
+
+
+static bool
+is_before(const VirtualRunView::position& a, const VirtualRunView::position& b)
+{
+	return a.message < b.message
+		|| (a.message == b.message && a.offset < b.offset);
+}
+
+
+static int32
+next_char(const char* text, int32 offset, int32 end)
+{
+	offset++;
+	while (offset < end && (text[offset] & 0xc0) == 0x80)
+		offset++;
+	return offset;
+}
+
+
+VirtualRunView::VirtualRunView(const char* name)
+	:
+	BView(name, B_WILL_DRAW | B_FRAME_EVENTS | B_FULL_UPDATE_ON_RESIZE),
+	fDeadText(0),
+	fDeadRuns(0),
+	fTextLength(0),
+	fLayoutFirst(0),
+	fEdgesText(0),
+	fEdgesStart(0),
+	fEdgesGeneration(0),
+	fFont(be_plain_font),
+	fEmoticons(true),
+	fWidth(0),
+	fGeneration(1),
+	fTop(0),
+	fTopOffset(0),
+	fFollowing(true),
+	fBottomValid(false),
+	fBottom(0),
+	fBottomOffset(0),
+	fSyncing(false),
+	fSelectionStart({0, 0}),
+	fSelectionEnd({0, 0}),
+	fMouseDown(false),
+	fSelecting(false),
+	fOverUrl(false),
+	fUrlCursor(new BCursor(B_CURSOR_ID_FOLLOW_LINK))
+{
+	font_height height;
+	fFont.GetHeight(&height);
+	fAscent = ceilf(height.ascent);
+	fLineHeight = ceilf(height.ascent + height.descent + height.leading);
+}
+
+
+VirtualRunView::~VirtualRunView()
+{
+	delete fUrlCursor;
+}
+
+
+void
+VirtualRunView::AttachedToWindow()
+{
+	BView::AttachedToWindow();
+	SetViewUIColor(B_PANEL_BACKGROUND_COLOR);
+	SetLowUIColor(B_PANEL_BACKGROUND_COLOR);
+	SetHighUIColor(B_PANEL_TEXT_COLOR);
+	FrameResized(Bounds().Width(), Bounds().Height());
+}
+
+
+void
+VirtualRunView::Draw(BRect updateRect)
+{
+	BRect bounds = Bounds();
+	position from, to;
+	_Ordered(&from, &to);
+
+	float y = bounds.top - fTopOffset;
+	int32 index = fTop;
+	int32 count = CountMessages();
+	for (; index < count && y <= bounds.bottom; index++) {
+		const List<line>& lines = _Lines(index);
+		for (int32 i = 0; i < (int32)lines.CountItems(); i++) {
+			if (y + fLineHeight >= updateRect.top && y <= updateRect.bottom)
+				_DrawLine(index, lines.ItemAt(i), y, from, to);
+			y += fLineHeight;
+		}
+	}
+	_TrimLayouts(index - 1);
+}
+
+
+void
+VirtualRunView::FrameResized(float width, float height)
+{
+	BView::FrameResized(width, height);
+
+	float textWidth = std::max(0.0f, width - kInset * 2);
+	float offset = fTopOffset;
+	if (textWidth != fWidth) {
+		// As far into the top message as it was
+		float fraction = 0;
+		if (fTop < CountMessages())
+			fraction = fTopOffset / _Height(fTop);
+
+		fWidth = textWidth;
+		if (++fGeneration == 0)
+			fGeneration = 1;
+		fLayouts.clear();
+		if (fTop < CountMessages())
+			offset = fraction * _Height(fTop);
+	}
+
+	fBottomValid = false;
+	if (fFollowing == true)
+		ScrollToBottom();
+	else
+		_SetTop(fTop, offset);
+}
+
+
+void
+VirtualRunView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case B_COPY:
+			Copy();
+			break;
+		case B_SELECT_ALL:
+			SelectAll();
+			break;
+		case B_MOUSE_WHEEL_CHANGED:
+		{
+			float delta = 0;
+			if (message->FindFloat("be:wheel_delta_y", &delta) == B_OK)
+				_ScrollBy(delta * fLineHeight * 3);
+			break;
+		}
+		default:
+			BView::MessageReceived(message);
+	}
+}
+
+
+void
+VirtualRunView::KeyDown(const char* bytes, int32 numBytes)
+{
+	float page = std::max(fLineHeight, Bounds().Height() - fLineHeight);
+	switch (bytes[0]) {
+		case B_UP_ARROW:
+			_ScrollBy(-fLineHeight);
+			break;
+		case B_DOWN_ARROW:
+			_ScrollBy(fLineHeight);
+			break;
+		case B_PAGE_UP:
+			_ScrollBy(-page);
+			break;
+		case B_PAGE_DOWN:
+			_ScrollBy(page);
+			break;
+		case B_HOME:
+			_SetTop(0, 0);
+			break;
+		case B_END:
+			ScrollToBottom();
+			break;
+		default:
+			BView::KeyDown(bytes, numBytes);
+	}
+}
+
+
+void
+VirtualRunView::MouseDown(BPoint where)
+{
+	MakeFocus(true);
+
+	uint32 buttons = 0;
+	int32 clicks = 1;
+	BMessage* current = Window()->CurrentMessage();
+	if (current != NULL) {
+		current->FindInt32("buttons", (int32*)&buttons);
+		current->FindInt32("clicks", &clicks);
+	}
+
+	if (buttons & B_SECONDARY_MOUSE_BUTTON) {
+		_RightClickPopUp(where)->Go(ConvertToScreen(where), true, false,
+			true);
+		return;
+	}
+
+	position at;
+	bool overText = _Find(where, &at, true);
+	fLastClicked = BUrl();
+	if (overText == true && OverUrl(where) == true)
+		fLastClicked = UrlAt(where);
+
+	if (clicks == 2) {
+		_FindWordAround(at, &fSelectionStart, &fSelectionEnd);
+		fSelecting = true;
+	} else {
+		if ((modifiers() & B_SHIFT_KEY) == 0)
+			fSelectionStart = at;
+		fSelectionEnd = at;
+		fSelecting = false;
+	}
+	fMouseDown = true;
+	SetMouseEventMask(B_POINTER_EVENTS, B_LOCK_WINDOW_FOCUS);
+	Invalidate();
+}
+
+
+void
+VirtualRunView::MouseUp(BPoint where)
+{
+	if (fMouseDown == true && fSelecting == false
+		&& fLastClicked.IsValid() == true)
+		fLastClicked.OpenWithPreferredApplication(true);
+
+	fLastClicked = BUrl();
+	fMouseDown = false;
+	fSelecting = false;
+}
+
+
+void
+VirtualRunView::MouseMoved(BPoint where, uint32 code, const BMessage* drag)
+{
+	if (fMouseDown == false) {
+		// Only changed on crossing into or out of a URL
+		if (code == B_INSIDE_VIEW || code == B_ENTERED_VIEW) {
+			bool overUrl = OverUrl(where);
+			if (overUrl == fOverUrl)
+				return;
+			fOverUrl = overUrl;
+			if (overUrl == true)
+				SetViewCursor(fUrlCursor);
+			else
+				SetViewCursor(B_CURSOR_SYSTEM_DEFAULT);
+		}
+		return;
+	}
+
+	// Dragged past the top or bottom, it's scrolled along
+	BRect bounds = Bounds();
+	float y = where.y - bounds.top;
+	if (y < 0)
+		_ScrollBy(y);
+	else if (y > bounds.Height())
+		_ScrollBy(y - bounds.Height());
+	where.y = Bounds().top + y;
+
+	position at;
+	_Find(where, &at, true);
+	if (at.message != fSelectionEnd.message
+		|| at.offset != fSelectionEnd.offset) {
+		fSelectionEnd = at;
+		fSelecting = true;
+		Invalidate();
+	}
+}
+
+
+void
+VirtualRunView::ScrollTo(BPoint where)
+{
+	// The bounds follow the scroll bar, which only scrolls them if they
+	// aren't at its value already
+	BView::ScrollTo(BPoint(0, where.y));
+	if (fSyncing == true || CountMessages() == 0)
+		return;
+
+	int32 index = std::max((int32)0,
+		std::min((int32)where.y, CountMessages() - 1));
+	float fraction = std::max(0.0f, where.y - index);
+	_SetTop(index, fraction * _Height(index));
+}
+
+
+void
+VirtualRunView::Append(const char* text, const text_run_array* runs)
+{
+	Insert(CountMessages(), text, runs);
+}
+
+
+void
+VirtualRunView::Append(const char* text, const text_run_array* runs,
+	const List<int32>& lengths)
+{
+	Insert(CountMessages(), text, runs, lengths);
+}
+
+
+void
+VirtualRunView::Insert(int32 index, const char* text,
+	const text_run_array* runs)
+{
+	if (text == NULL || text[0] == '\0')
+		return;
+	_Insert(index, text, strlen(text), runs, 0);
+	_Inserted();
+}
+
+
+void
+VirtualRunView::Insert(int32 index, const char* text,
+	const text_run_array* runs, const List<int32>& lengths)
+{
+	if (text == NULL)
+		return;
+	index = std::max((int32)0, std::min(index, CountMessages()));
+
+	int32 offset = 0;
+	for (uint32 i = 0; i < lengths.CountItems(); i++) {
+		int32 length = lengths.ItemAt(i);
+		if (length <= 0)
+			continue;
+		_Insert(index++, text + offset, length, runs, offset);
+		offset += length;
+	}
+	if (offset > 0)
+		_Inserted();
+}
+
+
+void
+VirtualRunView::RemoveFirst(int32 count)
+{
+	count = std::min(count, CountMessages());
+	if (count <= 0)
+		return;
+
+	for (int32 i = 0; i < count; i++) {
+		const message& item = fMessages.front();
+		fDeadText += item.length;
+		fDeadRuns += item.runCount;
+		fTextLength -= item.length;
+		fMessages.pop_front();
+	}
+
+	int32 dropped = std::min(count - fLayoutFirst, (int32)fLayouts.size());
+	if (dropped > 0)
+		fLayouts.erase(fLayouts.begin(), fLayouts.begin() + dropped);
+	fLayoutFirst = std::max((int32)0, fLayoutFirst - count);
+
+	fSelectionStart.message -= count;
+	fSelectionEnd.message -= count;
+	if (fSelectionStart.message < 0)
+		fSelectionStart = { 0, 0 };
+	if (fSelectionEnd.message < 0)
+		fSelectionEnd = { 0, 0 };
+
+	fTop -= count;
+	if (fTop < 0) {
+		fTop = 0;
+		fTopOffset = 0;
+	}
+
+	// Copied off only once there's as much gone as left
+	if (fDeadText > fText.size() / 2)
+		_Compact();
+
+	fBottomValid = false;
+	if (fFollowing == true)
+		ScrollToBottom();
+	else
+		_SetTop(fTop, fTopOffset);
+}
+
+
+void
+VirtualRunView::MakeEmpty()
+{
+	fMessages.clear();
+	fText.clear();
+	fRuns.clear();
+	fDeadText = 0;
+	fDeadRuns = 0;
+	fTextLength = 0;
+	fLayouts.clear();
+	fLayoutFirst = 0;
+	fEdgesGeneration = 0;
+	fSelectionStart = { 0, 0 };
+	fSelectionEnd = { 0, 0 };
+	fBottomValid = false;
+	ScrollToBottom();
+}
+
+
+void
+VirtualRunView::SetEmoticons(bool emoticons)
+{
+	if (emoticons == fEmoticons)
+		return;
+	fEmoticons = emoticons;
+
+	// Faces already split out are laid out again, as text or as icons;
+	// those of messages added while off stay text
+	if (++fGeneration == 0)
+		fGeneration = 1;
+	fLayouts.clear();
+	fBottomValid = false;
+	if (fFollowing == true)
+		ScrollToBottom();
+	else
+		_SetTop(fTop, fTopOffset);
+}
+
+
+int32
+VirtualRunView::MessageLength(int32 index) const
+{
+	if (index < 0 || index >= CountMessages())
+		return 0;
+	return fMessages[index].length;
+}
+
+
+void
+VirtualRunView::ScrollToBottom()
+{
+	int32 bottom;
+	float offset;
+	_Bottom(&bottom, &offset);
+	_SetTop(bottom, offset);
+}
+
+
+void
+VirtualRunView::Select(position start, position end)
+{
+	fSelectionStart = start;
+	fSelectionEnd = end;
+	Invalidate();
+}
+
+
+void
+VirtualRunView::GetSelection(position* _start, position* _end) const
+{
+	_Ordered(_start, _end);
+}
+
+
+void
+VirtualRunView::SelectAll()
+{
+	if (fMessages.empty() == true)
+		return;
+	position start = { 0, 0 };
+	position end = { CountMessages() - 1, (int32)fMessages.back().length };
+	Select(start, end);
+}
+
+
+BString
+VirtualRunView::SelectedText() const
+{
+	position from, to;
+	_Ordered(&from, &to);
+
+	BString text;
+	for (int32 i = from.message; i <= to.message && i < CountMessages(); i++) {
+		const message& item = fMessages[i];
+		int32 start = i == from.message ? from.offset : 0;
+		int32 end = i == to.message ? to.offset : item.length;
+		if (start < end)
+			text.Append(_Text(item) + start, end - start);
+	}
+	return text;
+}
+
+
+void
+VirtualRunView::Copy()
+{
+	BString text = SelectedText();
+	if (text.IsEmpty() == true || be_clipboard->Lock() == false)
+		return;
+
+	be_clipboard->Clear();
+	BMessage* clip = be_clipboard->Data();
+	if (clip != NULL) {
+		clip->AddData("text/plain", B_MIME_TYPE, text.String(),
+			text.Length());
+		be_clipboard->Commit();
+	}
+	be_clipboard->Unlock();
+}
+
+
+VirtualRunView::position
+VirtualRunView::PositionAt(BPoint where)
+{
+	position at;
+	_Find(where, &at, true);
+	return at;
+}
+
+
+BUrl
+VirtualRunView::UrlAt(BPoint where)
+{
+	BUrl url;
+	position at;
+	if (_Find(where, &at, false) == false)
+		return url;
+
+	// A URL has a run of its own
+	const message& item = fMessages[at.message];
+	int32 run = _RunAt(item, at.offset);
+	if (fRuns[run].url == false)
+		return url;
+	int32 start = fRuns[run].offset;
+	int32 end = item.length;
+	if (run + 1 < (int32)(item.runs + item.runCount))
+		end = fRuns[run + 1].offset;
+
+	url.SetUrlString(BString(_Text(item) + start, end - start));
+	return url;
+}
+
+
+bool
+VirtualRunView::OverUrl(BPoint where)
+{
+	position at;
+	if (_Find(where, &at, false) == false)
+		return false;
+	return fRuns[_RunAt(fMessages[at.message], at.offset)].url;
+}
+
+
+void
+VirtualRunView::_Insert(int32 index, const char* text, int32 length,
+	const text_run_array* runs, int32 base)
+{
+	index = std::max((int32)0, std::min(index, CountMessages()));
+
+	message item;
+	_MakeMessage(text, length, runs, base, &item);
+	fMessages.insert(fMessages.begin() + index, item);
+
+	// What was after it moves along
+	if (index <= fLayoutFirst)
+		fLayoutFirst++;
+	else if (index < fLayoutFirst + (int32)fLayouts.size())
+		fLayouts.clear();
+	if (index <= fSelectionStart.message)
+		fSelectionStart.message++;
+	if (index <= fSelectionEnd.message)
+		fSelectionEnd.message++;
+	if (index <= fTop && CountMessages() > 1)
+		fTop++;
+}
+
+
+void
+VirtualRunView::_Inserted()
+{
+	fBottomValid = false;
+	if (fFollowing == true)
+		ScrollToBottom();
+	else
+		_SetTop(fTop, fTopOffset);
+}
+
+
+void
+VirtualRunView::_MakeMessage(const char* text, int32 length,
+	const text_run_array* runs, int32 base, message* item)
+{
+	item->text = fText.size();
+	item->length = length;
+	item->runs = fRuns.size();
+	item->height = 0;
+	item->generation = 0;
+	fText.insert(fText.end(), text, text + length);
+	fTextLength += length;
+
+	// URLs in a run of their own, as UrlTextView has them, and so is each
+	// emoticon outside of them
+	UrlScanner scanner;
+	scanner.Feed(text, length);
+	int32 urlStart = 0;
+	int32 urlEnd = 0;
+	bool hasUrl = scanner.Next(&urlStart, &urlEnd);
+	List<emoticon_span> emoticons;
+	if (fEmoticons == true)
+		Emoticor::Get()->FindFaces(text, length, &emoticons);
+	uint32 emoticon = 0;
+
+	// The runs' offsets are from base before the text; the last one
+	// starting at or before it is found first
+	int32 count = runs != NULL ? runs->count : 0;
+	int32 run = 0;
+	int32 high = count - 1;
+	while (run < high) {
+		int32 middle = (run + high + 1) / 2;
+		if (runs->runs[middle].offset <= base)
+			run = middle;
+		else
+			high = middle - 1;
+	}
+	int32 offset = 0;
+	while (offset < length) {
+		while (run + 1 < count && runs->runs[run + 1].offset - base <= offset)
+			run++;
+		int32 end = length;
+		if (run + 1 < count)
+			end = std::min(end, runs->runs[run + 1].offset - base);
+
+		if (hasUrl == true && offset >= urlEnd)
+			hasUrl = scanner.Next(&urlStart, &urlEnd);
+		bool inUrl = hasUrl == true && offset >= urlStart;
+		if (hasUrl == true)
+			end = std::min(end, inUrl == true ? urlEnd : urlStart);
+
+		// Those passed, or that overlap a URL, are left as text
+		while (emoticon < emoticons.CountItems()) {
+			const emoticon_span& span = emoticons.ItemAt(emoticon);
+			if (span.start >= offset && (hasUrl == false
+				|| span.start >= urlEnd || span.end <= urlStart))
+				break;
+			emoticon++;
+		}
+		int32 icon = -1;
+		if (inUrl == false && emoticon < emoticons.CountItems()) {
+			const emoticon_span& span = emoticons.ItemAt(emoticon);
+			if (span.start == offset) {
+				// Whole, even if its style changes within it
+				icon = span.icon;
+				end = span.end;
+			} else
+				end = std::min(end, span.start);
+		}
+
+		message_run item = { (uint32)offset, ui_color(B_PANEL_TEXT_COLOR),
+			B_REGULAR_FACE, false, (int16)icon };
+		if (inUrl == true) {
+			item.color = ui_color(B_LINK_TEXT_COLOR);
+			item.face = B_REGULAR_FACE | B_UNDERSCORE_FACE;
+			item.url = true;
+		} else if (count > 0) {
+			item.color = runs->runs[run].color;
+			item.face = runs->runs[run].font.Face();
+		}
+		fRuns.push_back(item);
+		offset = end;
+	}
+	item->runCount = fRuns.size() - item->runs;
+}
+
+
+void
+VirtualRunView::_Compact()
+{
+	std::vector<char> text;
+	std::vector<message_run> runs;
+	text.reserve(fText.size() - fDeadText);
+	runs.reserve(fRuns.size() - fDeadRuns);
+
+	for (message& item : fMessages) {
+		uint32 at = text.size();
+		text.insert(text.end(), fText.begin() + item.text,
+			fText.begin() + item.text + item.length);
+		item.text = at;
+
+		at = runs.size();
+		runs.insert(runs.end(), fRuns.begin() + item.runs,
+			fRuns.begin() + item.runs + item.runCount);
+		item.runs = at;
+	}
+	fText.swap(text);
+	fRuns.swap(runs);
+	fEdgesGeneration = 0;
+	fDeadText = 0;
+	fDeadRuns = 0;
+}
+
+
+int32
+VirtualRunView::_RunAt(const message& item, int32 offset) const
+{
+	std::vector<message_run>::const_iterator first = fRuns.begin() + item.runs;
+	std::vector<message_run>::const_iterator run = std::upper_bound(first,
+		first + item.runCount, (uint32)offset,
+		[](uint32 offset, const message_run& run) {
+			return offset < run.offset;
+		});
+	if (run != first)
+		run--;
+	return run - fRuns.begin();
+}
+
+
+float
+VirtualRunView::_Width(const message& item, int32 start, int32 end) const
+{
+	const char* text = _Text(item);
+	int32 last = item.runs + item.runCount;
+	float width = 0;
+	for (int32 run = _RunAt(item, start); start < end; run++) {
+		int32 runEnd = end;
+		if (run + 1 < last)
+			runEnd = std::min(end, (int32)fRuns[run + 1].offset);
+
+		// An icon's width is all its first character's
+		BBitmap* atlas = NULL;
+		BRect frame;
+		if (_Icon(fRuns[run], &atlas, &frame) == true) {
+			if (start == (int32)fRuns[run].offset)
+				width += _IconSize();
+			start = runEnd;
+			continue;
+		}
+
+		BFont font(fFont);
+		font.SetFace(fRuns[run].face);
+		width += font.StringWidth(text + start, runEnd - start);
+		start = runEnd;
+	}
+	return width;
+}
+
+
+int32
+VirtualRunView::_Fit(const message& item, int32 start, int32 end,
+	float width) const
+{
+	// At least a character, however narrow the view
+	const char* text = _Text(item);
+	int32 offset = next_char(text, start, end);
+	float used = _Width(item, start, offset);
+	while (offset < end) {
+		int32 next = next_char(text, offset, end);
+		used += _Width(item, offset, next);
+		if (used > width)
+			break;
+		offset = next;
+	}
+	return offset;
+}
+
+
+const std::vector<float>&
+VirtualRunView::_Edges(const message& item, const line& textLine)
+{
+	if (fEdgesGeneration == fGeneration && fEdgesText == item.text
+		&& fEdgesStart == textLine.start)
+		return fEdges;
+
+	// A width per run, spread over its characters by their escapements,
+	// rather than one per character
+	const char* text = _Text(item);
+	int32 last = item.runs + item.runCount;
+	std::vector<float> escapements;
+	float x = kInset;
+	fEdges.clear();
+	fEdges.push_back(x);
+	int32 start = textLine.start;
+	for (int32 run = _RunAt(item, start); start < textLine.end; run++) {
+		int32 end = textLine.end;
+		if (run + 1 < last)
+			end = std::min(end, (int32)fRuns[run + 1].offset);
+		int32 count = 0;
+		for (int32 offset = start; offset < end;
+				offset = next_char(text, offset, end))
+			count++;
+		escapements.assign(count, 0);
+
+		// An icon's width is all its first character's
+		float width = 0;
+		BBitmap* atlas = NULL;
+		BRect frame;
+		if (_Icon(fRuns[run], &atlas, &frame) == true) {
+			width = _IconSize();
+			if (start == (int32)fRuns[run].offset)
+				escapements[0] = 1;
+		} else {
+			BFont font(fFont);
+			font.SetFace(fRuns[run].face);
+			font.GetEscapements(text + start, count, &escapements[0]);
+			width = font.StringWidth(text + start, end - start);
+		}
+
+		float total = 0;
+		for (float escapement : escapements)
+			total += escapement;
+		for (float escapement : escapements) {
+			if (total > 0)
+				x += width * escapement / total;
+			fEdges.push_back(x);
+		}
+		start = end;
+	}
+
+	fEdgesText = item.text;
+	fEdgesStart = textLine.start;
+	fEdgesGeneration = fGeneration;
+	return fEdges;
+}
+
+
+void
+VirtualRunView::_LayOut(const message& item, List<line>* lines) const
+{
+	lines->MakeEmpty();
+	const char* text = _Text(item);
+	int32 length = item.length;
+
+	// Line by line, each wrapped at its spaces, or anywhere in a word too
+	// long for one
+	int32 start = 0;
+	do {
+		int32 end = start;
+		while (end < length && text[end] != '\n')
+			end++;
+
+		int32 lineStart = start;
+		int32 offset = start;
+		float x = 0;
+		while (offset < end) {
+			int32 wordEnd = offset;
+			while (wordEnd < end && text[wordEnd] != ' ')
+				wordEnd++;
+			int32 spaceEnd = wordEnd;
+			while (spaceEnd < end && text[spaceEnd] == ' ')
+				spaceEnd++;
+
+			float width = _Width(item, offset, wordEnd);
+			if (offset > lineStart && x + width > fWidth) {
+				line wrapped = { lineStart, offset };
+				lines->AddItem(wrapped);
+				lineStart = offset;
+				x = 0;
+			}
+			if (offset == lineStart && width > fWidth) {
+				int32 cut = _Fit(item, offset, wordEnd, fWidth);
+				if (cut < wordEnd) {
+					line broken = { lineStart, cut };
+					lines->AddItem(broken);
+					lineStart = offset = cut;
+					continue;
+				}
+			}
+			x += width + _Width(item, wordEnd, spaceEnd);
+			offset = spaceEnd;
+		}
+
+		line last = { lineStart, end };
+		lines->AddItem(last);
+		start = end + 1;
+	} while (start < length);
+}
+
+
+bool
+VirtualRunView::_Icon(const message_run& run, BBitmap** _atlas,
+	BRect* _frame) const
+{
+	if (fEmoticons == false || run.emoticon < 0)
+		return false;
+	return Emoticor::Get()->GetBitmap(run.emoticon, _atlas, _frame);
+}
+
+
+float
+VirtualRunView::_IconSize() const
+{
+	return std::min(Emoticor::Get()->EmoticonSize(), fLineHeight);
+}
+
+
+float
+VirtualRunView::_Height(int32 index)
+{
+	message& item = fMessages[index];
+	if (item.generation != fGeneration) {
+		List<line> lines;
+		_LayOut(item, &lines);
+		item.height = lines.CountItems() * fLineHeight;
+		item.generation = fGeneration;
+	}
+	return item.height;
+}
+
+
+const List<VirtualRunView::line>&
+VirtualRunView::_Lines(int32 index)
+{
+	int32 count = fLayouts.size();
+	if (count == 0 || index < fLayoutFirst - 1 || index > fLayoutFirst + count) {
+		fLayouts.clear();
+		fLayoutFirst = index;
+		count = 0;
+	}
+
+	message& item = fMessages[index];
+	if (index == fLayoutFirst + count) {
+		fLayouts.emplace_back();
+		_LayOut(item, &fLayouts.back());
+	} else if (index == fLayoutFirst - 1) {
+		fLayouts.emplace_front();
+		fLayoutFirst--;
+		_LayOut(item, &fLayouts.front());
+	}
+
+	const List<line>& lines = fLayouts[index - fLayoutFirst];
+	item.height = lines.CountItems() * fLineHeight;
+	item.generation = fGeneration;
+	return lines;
+}
+
+
+void
+VirtualRunView::_TrimLayouts(int32 last)
+{
+	while (fLayouts.empty() == false && fLayoutFirst < fTop - kLayoutMargin) {
+		fLayouts.pop_front();
+		fLayoutFirst++;
+	}
+	while (fLayouts.empty() == false
+		&& fLayoutFirst + (int32)fLayouts.size() - 1 > last + kLayoutMargin)
+		fLayouts.pop_back();
+}
+
+
+void
+VirtualRunView::_DrawLine(int32 index, const line& textLine, float y,
+	position from, position to)
+{
+	const message& item = fMessages[index];
+	const char* text = _Text(item);
+	int32 last = item.runs + item.runCount;
+
+	float x = kInset;
+	int32 start = textLine.start;
+	for (int32 run = _RunAt(item, start); start < textLine.end; run++) {
+		int32 end = textLine.end;
+		if (run + 1 < last)
+			end = std::min(end, (int32)fRuns[run + 1].offset);
+
+		BBitmap* atlas = NULL;
+		BRect frame;
+		if (_Icon(fRuns[run], &atlas, &frame) == true) {
+			if (start == (int32)fRuns[run].offset) {
+				float size = _IconSize();
+				float top = y + floorf((fLineHeight - size) / 2);
+				SetDrawingMode(B_OP_ALPHA);
+				SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+				DrawBitmapAsync(atlas, frame,
+					BRect(x, top, x + size - 1, top + size - 1));
+				SetDrawingMode(B_OP_COPY);
+				x += size;
+			}
+			start = end;
+			continue;
+		}
+
+		BFont font(fFont);
+		font.SetFace(fRuns[run].face);
+		SetFont(&font);
+		SetHighColor(fRuns[run].color);
+		DrawString(text + start, end - start, BPoint(x, y + fAscent));
+		x += font.StringWidth(text + start, end - start);
+		start = end;
+	}
+
+	// The selection's inverted over what's drawn, to the edge if it goes
+	// on past the line
+	if (is_before(from, to) == false || from.message > index
+		|| to.message < index)
+		return;
+	int32 selectionStart = from.message < index ? 0 : from.offset;
+	bool pastEnd = to.message > index || to.offset > textLine.end;
+	int32 selectionEnd = pastEnd ? textLine.end : to.offset;
+	if (selectionStart > textLine.end
+		|| (selectionEnd <= textLine.start && pastEnd == false))
+		return;
+
+	selectionStart = std::max(selectionStart, textLine.start);
+	float left = kInset + _Width(item, textLine.start, selectionStart);
+	float right = Bounds().right;
+	if (pastEnd == false)
+		right = kInset + _Width(item, textLine.start, selectionEnd);
+	if (left < right)
+		InvertRect(BRect(left, y, right, y + fLineHeight - 1));
+}
+
+
+bool
+VirtualRunView::_Find(BPoint where, position* _position, bool caret)
+{
+	int32 count = CountMessages();
+	if (count == 0) {
+		*_position = { 0, 0 };
+		return false;
+	}
+
+	// Only what's in view is looked through
+	BRect bounds = Bounds();
+	where.y = std::max(bounds.top, std::min(bounds.bottom, where.y));
+
+	float y = bounds.top - fTopOffset;
+	for (int32 index = fTop; index < count; index++) {
+		const List<line>& lines = _Lines(index);
+		for (int32 i = 0; i < (int32)lines.CountItems(); i++) {
+			y += fLineHeight;
+			if (where.y >= y)
+				continue;
+
+			const line& textLine = lines.ItemAt(i);
+			const message& item = fMessages[index];
+			const char* text = _Text(item);
+			const std::vector<float>& edges = _Edges(item, textLine);
+			int32 offset = textLine.start;
+			for (int32 j = 0; offset < textLine.end; j++) {
+				float width = edges[j + 1] - edges[j];
+				if (where.x < edges[j] + (caret == true ? width / 2 : width))
+					break;
+				offset = next_char(text, offset, textLine.end);
+			}
+			*_position = { index, offset };
+			return where.x >= kInset && offset < textLine.end;
+		}
+	}
+
+	*_position = { count - 1, (int32)fMessages.back().length };
+	return false;
+}
+
+
+void
+VirtualRunView::_FindWordAround(position at, position* _start,
+	position* _end)
+{
+	*_start = at;
+	*_end = at;
+	if (at.message >= CountMessages())
+		return;
+
+	const message& item = fMessages[at.message];
+	const char* text = _Text(item);
+	while (_start->offset > 0 && text[_start->offset - 1] != ' '
+		&& text[_start->offset - 1] != '\n')
+		_start->offset--;
+	while (_end->offset < (int32)item.length && text[_end->offset] != ' '
+		&& text[_end->offset] != '\n')
+		_end->offset++;
+}
+
+
+void
+VirtualRunView::_Ordered(position* _from, position* _to) const
+{
+	if (is_before(fSelectionEnd, fSelectionStart) == true) {
+		*_from = fSelectionEnd;
+		*_to = fSelectionStart;
+	} else {
+		*_from = fSelectionStart;
+		*_to = fSelectionEnd;
+	}
+}
+
+
+void
+VirtualRunView::_ScrollBy(float delta)
+{
+	_SetTop(fTop, fTopOffset + delta);
+}
+
+
+void
+VirtualRunView::_SetTop(int32 index, float offset)
+{
+	int32 count = CountMessages();
+	if (count == 0) {
+		fTop = 0;
+		fTopOffset = 0;
+		fFollowing = true;
+		_UpdateScrollBar();
+		Invalidate();
+		return;
+	}
+
+	// Only the messages scrolled past are measured
+	index = std::max((int32)0, std::min(index, count - 1));
+	while (offset < 0 && index > 0) {
+		index--;
+		offset += _Height(index);
+	}
+	offset = std::max(0.0f, offset);
+	while (index < count - 1 && offset >= _Height(index)) {
+		offset -= _Height(index);
+		index++;
+	}
+
+	int32 bottom;
+	float bottomOffset;
+	_Bottom(&bottom, &bottomOffset);
+	fFollowing = index > bottom
+		|| (index == bottom && offset >= bottomOffset);
+	if (fFollowing == true) {
+		index = bottom;
+		offset = bottomOffset;
+	}
+
+	fTop = index;
+	fTopOffset = offset;
+	_UpdateScrollBar();
+	Invalidate();
+}
+
+
+void
+VirtualRunView::_Bottom(int32* _index, float* _offset)
+{
+	if (fBottomValid == false) {
+		// Back from the last message, until there's enough to fill the view
+		float height = Bounds().Height() + 1;
+		float total = 0;
+		fBottom = 0;
+		fBottomOffset = 0;
+		for (int32 index = CountMessages() - 1; index >= 0; index--) {
+			float messageHeight = _Height(index);
+			if (total + messageHeight >= height) {
+				fBottom = index;
+				fBottomOffset = total + messageHeight - height;
+				break;
+			}
+			total += messageHeight;
+		}
+		fBottomValid = true;
+	}
+	*_index = fBottom;
+	*_offset = fBottomOffset;
+}
+
+
+void
+VirtualRunView::_UpdateScrollBar()
+{
+	BScrollBar* scrollBar = ScrollBar(B_VERTICAL);
+	if (scrollBar == NULL)
+		return;
+
+	int32 count = CountMessages();
+	float max = 0;
+	float value = 0;
+	float page = 1;
+	if (count > 0) {
+		int32 bottom;
+		float bottomOffset;
+		_Bottom(&bottom, &bottomOffset);
+		max = bottom + bottomOffset / _Height(bottom);
+		value = fTop + fTopOffset / _Height(fTop);
+		page = std::max(1.0f, (float)(count - bottom));
+	}
+
+	fSyncing = true;
+	scrollBar->SetRange(0, max);
+	scrollBar->SetProportion(count > 0 ? std::min(1.0f, page / count) : 1);
+	scrollBar->SetSteps(1, page);
+	scrollBar->SetValue(value);
+	fSyncing = false;
+}
+
+
+BPopUpMenu*
+VirtualRunView::_RightClickPopUp(BPoint where)
+{
+	BPopUpMenu* menu = new BPopUpMenu("rightClickPopUp");
+	menu->SetAsyncAutoDestruct(true);
+	BMenuItem* copy = new BMenuItem(B_TRANSLATE("Copy"),
+		new BMessage(B_COPY), 'C', B_COMMAND_KEY);
+	BMenuItem* selectAll = new BMenuItem(B_TRANSLATE("Select all"),
+		new BMessage(B_SELECT_ALL), 'A', B_COMMAND_KEY);
+
+	// Try and ensure we have something selected
+	position from, to;
+	_Ordered(&from, &to);
+	position at;
+	if (is_before(from, to) == false && _Find(where, &at, false) == true) {
+		_FindWordAround(at, &fSelectionStart, &fSelectionEnd);
+		_Ordered(&from, &to);
+		Invalidate();
+	}
+	copy->SetEnabled(is_before(from, to));
+
+	menu->AddItem(copy);
+	menu->AddItem(selectAll);
+	menu->SetTargetForItems(this);
+	return menu;
+}
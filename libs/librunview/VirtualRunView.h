@@ -0,0 +1,209 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _VIRTUAL_RUN_VIEW_H
+#define _VIRTUAL_RUN_VIEW_H
+
+#include <deque>
+#include <vector>
+
+#include <Font.h>
+#include <Url.h>
+#include <View.h>
+
+#include <libsupport/List.h>
+
+class BBitmap;
+class BCursor;
+class BPopUpMenu;
+struct text_run_array;
+
+
+// A read-only view of messages like RunView's, for more than a BTextView
+// could lay out as a whole.
+// Messages are kept as compact records, their text and runs in shared
+// buffers, and only those in view (and a few around) are laid out.
+// Emoticons are drawn as their icons, see Emoticor, and copied as text. Each
+// one's height is cached for the width it was laid out at, so a resize
+// only re-flows what's shown, and the rest as it's scrolled to.
+// The view's kept at a message and pixels into it, rather than at a point
+// of the whole text, so scrolling costs the same however much it holds;
+// its scroll bar's value is the index of the top message, and how much of
+// it is scrolled past.
+class VirtualRunView : public BView {
+public:
+	struct position {
+		int32	message;
+		int32	offset;		// In bytes of its text
+	};
+
+						VirtualRunView(const char* name);
+	virtual				~VirtualRunView();
+
+	virtual	void		AttachedToWindow();
+	virtual	void		Draw(BRect updateRect);
+	virtual	void		FrameResized(float width, float height);
+	virtual	void		MessageReceived(BMessage* message);
+	virtual	void		KeyDown(const char* bytes, int32 numBytes);
+	virtual	void		MouseDown(BPoint where);
+	virtual	void		MouseUp(BPoint where);
+	virtual	void		MouseMoved(BPoint where, uint32 code,
+							const BMessage* drag);
+	virtual	void		ScrollTo(BPoint where);
+			using		BView::ScrollTo;
+
+			// A message, with runs as passed to BTextView::Insert()
+			void		Append(const char* text, const text_run_array* runs);
+			// Before the message at index
+			void		Insert(int32 index, const char* text,
+							const text_run_array* runs);
+			// Several messages at once, one after another in text and of the
+			// given lengths, with the view updated only once
+			void		Append(const char* text, const text_run_array* runs,
+							const List<int32>& lengths);
+			void		Insert(int32 index, const char* text,
+							const text_run_array* runs,
+							const List<int32>& lengths);
+			// Delete the oldest messages, keeping the selection and what's
+			// in view where they were
+			void		RemoveFirst(int32 count);
+			void		MakeEmpty();
+
+			// Whether emoticons are drawn as icons, or left as text
+			void		SetEmoticons(bool emoticons);
+			bool		Emoticons() const { return fEmoticons; }
+
+			int32		CountMessages() const { return fMessages.size(); }
+			int32		MessageLength(int32 index) const;
+			// Of all messages
+			size_t		TextLength() const { return fTextLength; }
+			// The first one at least partly in view
+			int32		TopMessage() const { return fTop; }
+
+			void		ScrollToBottom();
+
+			void		Select(position start, position end);
+			void		GetSelection(position* _start, position* _end) const;
+			void		SelectAll();
+			BString		SelectedText() const;
+			void		Copy();
+
+			position	PositionAt(BPoint where);
+			BUrl		UrlAt(BPoint where);
+			bool		OverUrl(BPoint where);
+
+private:
+	struct message {
+		uint32		text;		// In fText
+		uint32		length;
+		uint32		runs;		// In fRuns
+		uint32		runCount;
+		float		height;		// Laid out as of generation
+		uint32		generation;
+	};
+
+	struct message_run {
+		uint32		offset;		// Into its message
+		rgb_color	color;
+		uint16		face;
+		bool		url;
+		int16		emoticon;	// Its icon, drawn in its place, or -1
+	};
+
+	// Of a message's text, any line break left out
+	struct line {
+		int32		start;
+		int32		end;
+	};
+
+			void		_Insert(int32 index, const char* text, int32 length,
+							const text_run_array* runs, int32 base);
+			// Scrolled as it was, or to the new bottom if it was there
+			void		_Inserted();
+			void		_MakeMessage(const char* text, int32 length,
+							const text_run_array* runs, int32 base,
+							message* item);
+			void		_Compact();
+
+			const char*	_Text(const message& item) const
+							{ return &fText[item.text]; }
+			int32		_RunAt(const message& item, int32 offset) const;
+			float		_Width(const message& item, int32 start,
+							int32 end) const;
+			int32		_Fit(const message& item, int32 start, int32 end,
+							float width) const;
+			// The x of each of the line's characters and of its end, kept
+			// for the line last asked for
+			const std::vector<float>& _Edges(const message& item,
+							const line& textLine);
+			void		_LayOut(const message& item, List<line>* lines) const;
+			// Its emoticon's icon, if it has one that could be loaded
+			bool		_Icon(const message_run& run, BBitmap** _atlas,
+							BRect* _frame) const;
+			float		_IconSize() const;
+
+			float		_Height(int32 index);
+			const List<line>& _Lines(int32 index);
+			void		_TrimLayouts(int32 last);
+
+			void		_DrawLine(int32 index, const line& textLine, float y,
+							position from, position to);
+
+			// Whether it's over text; the position's the nearest between
+			// characters for a caret, or else of the one it's over
+			bool		_Find(BPoint where, position* _position, bool caret);
+			void		_FindWordAround(position at, position* _start,
+							position* _end);
+			void		_Ordered(position* _from, position* _to) const;
+
+			void		_ScrollBy(float delta);
+			void		_SetTop(int32 index, float offset);
+			void		_Bottom(int32* _index, float* _offset);
+			void		_UpdateScrollBar();
+
+			BPopUpMenu*	_RightClickPopUp(BPoint where);
+
+	std::deque<message>	fMessages;
+	std::vector<char>	fText;
+	std::vector<message_run> fRuns;
+	// Left behind in the above by deleted messages
+	size_t				fDeadText;
+	size_t				fDeadRuns;
+	size_t				fTextLength;
+
+	// Of those from fLayoutFirst on, kept around those in view
+	std::deque<List<line> > fLayouts;
+	int32				fLayoutFirst;
+
+	std::vector<float>	fEdges;
+	uint32				fEdgesText;		// Of their message, in fText
+	int32				fEdgesStart;
+	uint32				fEdgesGeneration;	// 0 once they're out of date
+
+	BFont				fFont;
+	bool				fEmoticons;
+	float				fAscent;
+	float				fLineHeight;
+	float				fWidth;
+	uint32				fGeneration;
+
+	int32				fTop;
+	float				fTopOffset;
+	bool				fFollowing;
+	bool				fBottomValid;
+	int32				fBottom;
+	float				fBottomOffset;
+	bool				fSyncing;
+
+	position			fSelectionStart;
+	position			fSelectionEnd;
+	bool				fMouseDown;
+	bool				fSelecting;
+	bool				fOverUrl;
+	BUrl				fLastClicked;
+	BCursor*			fUrlCursor;
+};
+
+
+#endif // _VIRTUAL_RUN_VIEW_H
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "Atom.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Autolock.h>
+#include <Locker.h>
+
+
+struct atom_entry {
+	uint32	hash;
+	int32	length;
+	char	string[1];
+};
+
+
+// The empty string's, outside the table so it needs no lock. Its hash is
+// FNV-1a's offset basis, as _Hash() gives for no bytes.
+static const atom_entry kEmptyEntry = { 2166136261u, 0, "" };
+
+
+// Entries are bump-allocated from large chunks, since they live as long as
+// the application does.
+static const size_t kChunkSize = 64 * 1024;
+
+
+class AtomTable {
+public:
+							AtomTable();
+
+			const atom_entry* Intern(const char* string, int32 length);
+			const atom_entry* Find(const char* string, int32 length);
+
+private:
+	static	uint32			_Hash(const char* string, int32 length);
+
+			int32			_Slot(const char* string, int32 length,
+								uint32 hash) const;
+			void			_Grow();
+			atom_entry*		_Allocate(int32 length);
+
+			BLocker			fLock;
+			atom_entry**	fSlots;
+			uint32			fSlotCount;
+			uint32			fCount;
+
+			char*			fChunk;
+			size_t			fChunkUsed;
+};
+
+
+static AtomTable&
+atom_table()
+{
+	static AtomTable table;
+	return table;
+}
+
+
+AtomTable::AtomTable()
+	:
+	fLock("atom table"),
+	fSlots(NULL),
+	fSlotCount(0),
+	fCount(0),
+	fChunk(NULL),
+	fChunkUsed(kChunkSize)
+{
+}
+
+
+const atom_entry*
+AtomTable::Intern(const char* string, int32 length)
+{
+	BAutolock _(fLock);
+	uint32 hash = _Hash(string, length);
+
+	if (fSlotCount > 0) {
+		int32 slot = _Slot(string, length, hash);
+		if (fSlots[slot] != NULL)
+			return fSlots[slot];
+	}
+
+	if ((fCount + 1) * 2 > fSlotCount)
+		_Grow();
+
+	atom_entry* entry = _Allocate(length);
+	if (entry == NULL)
+		return NULL;
+	entry->hash = hash;
+	entry->length = length;
+	memcpy(entry->string, string, length);
+	entry->string[length] = '\0';
+
+	fSlots[_Slot(string, length, hash)] = entry;
+	fCount++;
+	return entry;
+}
+
+
+const atom_entry*
+AtomTable::Find(const char* string, int32 length)
+{
+	BAutolock _(fLock);
+	if (fSlotCount == 0)
+		return NULL;
+	return fSlots[_Slot(string, length, _Hash(string, length))];
+}
+
+
+uint32
+AtomTable::_Hash(const char* string, int32 length)
+{
+	// FNV-1a
+	uint32 hash = 2166136261u;
+	for (int32 i = 0; i < length; i++) {
+		hash ^= (uint8)string[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+
+int32
+AtomTable::_Slot(const char* string, int32 length, uint32 hash) const
+{
+	uint32 mask = fSlotCount - 1;
+	uint32 slot = hash & mask;
+	while (fSlots[slot] != NULL) {
+		const atom_entry* entry = fSlots[slot];
+		if (entry->hash == hash && entry->length == length
+				&& memcmp(entry->string, string, length) == 0)
+			break;
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+
+void
+AtomTable::_Grow()
+{
+	uint32 oldCount = fSlotCount;
+	atom_entry** oldSlots = fSlots;
+
+	fSlotCount = (oldCount == 0) ? 1024 : oldCount * 2;
+	fSlots = (atom_entry**)calloc(fSlotCount, sizeof(atom_entry*));
+
+	for (uint32 i = 0; i < oldCount; i++) {
+		atom_entry* entry = oldSlots[i];
+		if (entry != NULL)
+			fSlots[_Slot(entry->string, entry->length, entry->hash)] = entry;
+	}
+	free(oldSlots);
+}
+
+
+atom_entry*
+AtomTable::_Allocate(int32 length)
+{
+	size_t size = sizeof(atom_entry) + length;
+	size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+	if (size > kChunkSize / 4)
+		return (atom_entry*)malloc(size);
+
+	if (fChunkUsed + size > kChunkSize) {
+		fChunk = (char*)malloc(kChunkSize);
+		if (fChunk == NULL)
+			return NULL;
+		fChunkUsed = 0;
+	}
+	atom_entry* entry = (atom_entry*)(fChunk + fChunkUsed);
+	fChunkUsed += size;
+	return entry;
+}
+
+
+Atom::Atom()
+	:
+	fEntry(&kEmptyEntry)
+{
+}
+
+
+Atom::Atom(const char* string)
+	:
+	fEntry(&kEmptyEntry)
+{
+	if (string != NULL && string[0] != '\0')
+		fEntry = atom_table().Intern(string, strlen(string));
+}
+
+
+Atom::Atom(const BString& string)
+	:
+	fEntry(&kEmptyEntry)
+{
+	if (string.IsEmpty() == false)
+		fEntry = atom_table().Intern(string.String(), string.Length());
+}
+
+
+/* static */ Atom
+Atom::Find(const char* string)
+{
+	Atom atom;
+	if (string != NULL && string[0] != '\0')
+		atom.fEntry = atom_table().Find(string, strlen(string));
+	return atom;
+}
+
+
+const char*
+Atom::String() const
+{
+	return fEntry != NULL ? fEntry->string : "";
+}
+
+
+int32
+Atom::Length() const
+{
+	return fEntry != NULL ? fEntry->length : 0;
+}
+
+
+uint32
+Atom::Hash() const
+{
+	return fEntry != NULL ? fEntry->hash : 0;
+}
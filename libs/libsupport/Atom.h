@@ -0,0 +1,57 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _ATOM_H
+#define _ATOM_H
+
+#include <String.h>
+
+#include "KeyMap.h"
+
+
+struct atom_entry;
+
+
+// An interned string: every Atom made from equal text points to the same
+// entry in the global AtomTable, so comparison is a pointer compare and
+// the hash is computed once. Atoms are never freed.
+// The empty string is an entry like any other, so an empty Atom is only
+// ever equal to another empty one.
+class Atom {
+public:
+						Atom();
+						Atom(const char* string);
+						Atom(const BString& string);
+
+	// Returns the existing atom for string, or else a null one, equal to no
+	// other; unlike the constructors, this never grows the table.
+	static	Atom		Find(const char* string);
+
+			const char*	String() const;
+			int32		Length() const;
+			uint32		Hash() const;
+			bool		IsEmpty() const { return Length() == 0; }
+
+			bool		operator==(const Atom& other) const
+							{ return fEntry == other.fEntry; }
+			bool		operator!=(const Atom& other) const
+							{ return fEntry != other.fEntry; }
+			bool		operator<(const Atom& other) const
+							{ return fEntry < other.fEntry; }
+
+private:
+			const atom_entry* fEntry;
+};
+
+
+// Look C-string keys up without interning them; see KeyMap::ValueFor().
+template<>
+struct KeyMapLookup<Atom> {
+	typedef Atom Type;
+	static	Atom		FromString(const char* string)
+							{ return Atom::Find(string); }
+};
+
+
+#endif	// _ATOM_H
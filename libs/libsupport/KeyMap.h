@@ -5,31 +5,63 @@
 #ifndef _KEY_MAP_H
 #define _KEY_MAP_H
 
-#include <map>
+#include <algorithm>
+#include <vector>
 
 #include "List.h"
 
+
+// How ValueFor()/IndexOf() compare a C string against KEY; by default the
+// string is compared as-is, so BString keys need no temporary BString.
+template<class KEY>
+struct KeyMapLookup {
+	typedef const char* Type;
+	static	const char*	FromString(const char* string)
+							{ return string != NULL ? string : ""; }
+};
+
+
+// Sorted map with contiguous storage: lookups are binary searches, and
+// KeyAt()/ValueAt() are O(1), so index-based loops over a KeyMap stay linear.
 template<class KEY, class TYPE>
 class KeyMap {
 public:
 	uint32 		CountItems() const;
+	void		MakeEmpty();
+	void		Reserve(uint32 count);
 
 	void  		AddItem(KEY k, TYPE t);
 
-	TYPE		ValueFor(KEY, bool* found = NULL) const;
+	TYPE		ValueFor(const KEY& k, bool* found = NULL) const;
+	TYPE		ValueFor(const char* k, bool* found = NULL) const;
+
+	int32		IndexOf(const KEY& k) const;
+	int32		IndexOf(const char* k) const;
+	bool		HasKey(const KEY& k) const;
 
 	TYPE		RemoveItemAt(int32 position);
-	TYPE		RemoveItemFor(KEY);
+	TYPE		RemoveItemFor(const KEY& k);
 
 	KEY			KeyAt(uint32 position) const;
 	TYPE		ValueAt(uint32 position) const;
 
-	void		AddList(KeyMap<KEY, TYPE> appendList);
+	void		AddList(const KeyMap<KEY, TYPE>& appendList);
 
 private:
-	std::map<KEY, TYPE> fMap;
-	typedef typename std::map<KEY, TYPE>::iterator fIter;
-	typedef typename std::map<KEY, TYPE>::const_iterator fConstIter;
+	typedef std::pair<KEY, TYPE> fItem;
+	typedef typename std::vector<fItem>::iterator fIter;
+	typedef typename std::vector<fItem>::const_iterator fConstIter;
+
+	template<class K>
+	struct _KeyLess {
+		bool operator()(const fItem& item, const K& k) const
+			{ return item.first < k; }
+	};
+
+	template<class K>
+	int32		_Find(const K& k) const;
+
+	std::vector<fItem> fItems;
 };
 
 
@@ -37,7 +69,23 @@ template<class KEY, class TYPE>
 inline uint32
 KeyMap<KEY, TYPE>::CountItems() const
 {
-	return fMap.size();
+	return fItems.size();
+}
+
+
+template<class KEY, class TYPE>
+inline void
+KeyMap<KEY, TYPE>::MakeEmpty()
+{
+	fItems.clear();
+}
+
+
+template<class KEY, class TYPE>
+inline void
+KeyMap<KEY, TYPE>::Reserve(uint32 count)
+{
+	fItems.reserve(count);
 }
 
 
@@ -45,26 +93,67 @@ template<class KEY, class TYPE>
 inline void
 KeyMap<KEY, TYPE>::AddItem(KEY k, TYPE t)
 {
-	fMap[k] = t;
+	fIter i = std::lower_bound(fItems.begin(), fItems.end(), k,
+		_KeyLess<KEY>());
+
+	if (i != fItems.end() && !(k < i->first))
+		i->second = t;
+	else
+		fItems.insert(i, fItem(k, t));
 }
 
 
 template<class KEY, class TYPE>
 inline TYPE
-KeyMap<KEY, TYPE>::ValueFor(KEY k, bool* found) const
+KeyMap<KEY, TYPE>::ValueFor(const KEY& k, bool* found) const
 {
-	fConstIter i = fMap.find(k);
+	int32 index = _Find(k);
 
-	if (found) {
-		if (i == fMap.end())
-			*found = false;
-		else
-			*found = true;
-	}
+	if (found)
+		*found = (index >= 0);
 
-	if (i == fMap.end())
+	if (index < 0)
 		return NULL;
-	return i->second;
+	return fItems[index].second;
+}
+
+
+template<class KEY, class TYPE>
+inline TYPE
+KeyMap<KEY, TYPE>::ValueFor(const char* k, bool* found) const
+{
+	int32 index = _Find(KeyMapLookup<KEY>::FromString(k));
+
+	if (found)
+		*found = (index >= 0);
+
+	if (index < 0)
+		return NULL;
+	return fItems[index].second;
+}
+
+
+template<class KEY, class TYPE>
+inline int32
+KeyMap<KEY, TYPE>::IndexOf(const KEY& k) const
+{
+	return _Find(k);
+}
+
+
+template<class KEY, class TYPE>
+inline int32
+KeyMap<KEY, TYPE>::IndexOf(const char* k) const
+{
+	return _Find(KeyMapLookup<KEY>::FromString(k));
+}
+
+
+template<class KEY, class TYPE>
+inline bool
+KeyMap<KEY, TYPE>::HasKey(const KEY& k) const
+{
+	return _Find(k) >= 0;
 }
 
 
@@ -72,21 +161,20 @@ template<class KEY, class TYPE>
 inline TYPE
 KeyMap<KEY, TYPE>::RemoveItemAt(int32 position)
 {
-	TYPE value = ValueAt(position);
-	fIter i = fMap.begin();
-	std::advance(i, position);
-	fMap.erase(i->first);
+	if (position < 0 || (uint32)position >= fItems.size())
+		return NULL;
+
+	TYPE value = fItems[position].second;
+	fItems.erase(fItems.begin() + position);
 	return value;
 }
 
 
 template<class KEY, class TYPE>
 inline TYPE
-KeyMap<KEY, TYPE>::RemoveItemFor(KEY k)
+KeyMap<KEY, TYPE>::RemoveItemFor(const KEY& k)
 {
-	TYPE value = ValueFor(k);
-	fMap.erase(k);
-	return value;
+	return RemoveItemAt(_Find(k));
 }
 
 
@@ -94,11 +182,9 @@ template<class KEY, class TYPE>
 inline KEY
 KeyMap<KEY, TYPE>::KeyAt(uint32 position) const
 {
-	fConstIter i = fMap.begin();
-	std::advance(i, position); 	
-	if (i == fMap.end())
+	if (position >= fItems.size())
 		return NULL;
-	return i->first;
+	return fItems[position].first;
 }
 
 
@@ -106,22 +192,57 @@ template<class KEY, class TYPE>
 inline TYPE
 KeyMap<KEY, TYPE>::ValueAt(uint32 position) const
 {
-	fConstIter i = fMap.begin();
-	std::advance(i, position); 	
-	if (i == fMap.end())
+	if (position >= fItems.size())
 		return NULL;
-	return i->second;
+	return fItems[position].second;
 }
 
 
 template<class KEY, class TYPE>
 inline void
-KeyMap<KEY, TYPE>::AddList(KeyMap<KEY, TYPE> appendList)
+KeyMap<KEY, TYPE>::AddList(const KeyMap<KEY, TYPE>& appendList)
 {
 	if (appendList.CountItems() == 0)
 		return;
-	for (int i = 0; i < appendList.CountItems(); i++)
-		AddItem(appendList.KeyAt(i), appendList.ValueAt(i));
+	if (fItems.empty() == true) {
+		fItems = appendList.fItems;
+		return;
+	}
+
+	// Both sides are sorted, so merge them in one pass; on duplicate keys
+	// the appended value wins, as with AddItem().
+	std::vector<fItem> merged;
+	merged.reserve(fItems.size() + appendList.fItems.size());
+
+	fConstIter a = fItems.begin();
+	fConstIter b = appendList.fItems.begin();
+	while (a != fItems.end() && b != appendList.fItems.end()) {
+		if (a->first < b->first)
+			merged.push_back(*a++);
+		else if (b->first < a->first)
+			merged.push_back(*b++);
+		else {
+			merged.push_back(*b++);
+			a++;
+		}
+	}
+	merged.insert(merged.end(), a, fConstIter(fItems.end()));
+	merged.insert(merged.end(), b, appendList.fItems.end());
+	fItems.swap(merged);
+}
+
+
+template<class KEY, class TYPE>
+template<class K>
+inline int32
+KeyMap<KEY, TYPE>::_Find(const K& k) const
+{
+	fConstIter i = std::lower_bound(fItems.begin(), fItems.end(), k,
+		_KeyLess<K>());
+
+	if (i == fItems.end() || k < i->first)
+		return -1;
+	return i - fItems.begin();
 }
 
 
@@ -5,68 +5,163 @@
 #ifndef _LIST_H
 #define _LIST_H
 
-#include <list>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <SupportDefs.h>
 
+
+// Vector-backed list: ItemAt() is O(1) and items are iterable with
+// range-for. Removals keep the order of the remaining items.
 template<class T>
 class List {
 public:
+	typedef typename std::vector<T>::iterator iterator;
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
 	uint32 	CountItems() const;
+	bool	IsEmpty() const;
+	void	MakeEmpty();
+	void	Reserve(uint32 count);
 
-	void  	AddItem(T type);
+	void  	AddItem(const T& type);
+	void  	AddItem(T&& type);
 
 	void	RemoveItemAt(uint32 position);
+	uint32	RemoveItem(const T& type);
+	template<class Predicate>
+	uint32	RemoveItemsIf(Predicate predicate);
+
+	T&		ItemAt(uint32 position);
+	const T& ItemAt(uint32 position) const;
+	int32	IndexOf(const T& type) const;
 
-	T		ItemAt(uint32 position);
+	void	AddList(const List<T>& appendList);
+	void	AddList(List<T>&& appendList);
 
-	void	AddList(List<T> appendList);
+	iterator		begin()			{ return fList.begin(); }
+	iterator		end()			{ return fList.end(); }
+	const_iterator	begin() const	{ return fList.begin(); }
+	const_iterator	end() const		{ return fList.end(); }
 
 private:
-	std::list<T> fList;
-	typedef typename std::list<T>::iterator fIter;
+	std::vector<T> fList;
 };
 
 
 template<class T>
-uint32 List<T>::CountItems() const
+inline uint32 List<T>::CountItems() const
 {
 	return fList.size();
 }
 
 
 template<class T>
-void List<T>::AddItem(T type)
+inline bool List<T>::IsEmpty() const
+{
+	return fList.empty();
+}
+
+
+template<class T>
+inline void List<T>::MakeEmpty()
+{
+	fList.clear();
+}
+
+
+template<class T>
+inline void List<T>::Reserve(uint32 count)
+{
+	fList.reserve(count);
+}
+
+
+template<class T>
+inline void List<T>::AddItem(const T& type)
 {
 	fList.push_back(type);
 }
 
 
 template<class T>
-void List<T>::RemoveItemAt(uint32 position)
+inline void List<T>::AddItem(T&& type)
+{
+	fList.push_back(std::move(type));
+}
+
+
+template<class T>
+inline void List<T>::RemoveItemAt(uint32 position)
+{
+	if (position < fList.size())
+		fList.erase(fList.begin() + position);
+}
+
+
+template<class T>
+inline uint32 List<T>::RemoveItem(const T& type)
+{
+	uint32 count = fList.size();
+	fList.erase(std::remove(fList.begin(), fList.end(), type), fList.end());
+	return count - fList.size();
+}
+
+
+template<class T>
+template<class Predicate>
+inline uint32 List<T>::RemoveItemsIf(Predicate predicate)
+{
+	uint32 count = fList.size();
+	fList.erase(std::remove_if(fList.begin(), fList.end(), predicate),
+		fList.end());
+	return count - fList.size();
+}
+
+
+template<class T>
+inline T& List<T>::ItemAt(uint32 position)
+{
+	return fList[position];
+}
+
+
+template<class T>
+inline const T& List<T>::ItemAt(uint32 position) const
+{
+	return fList[position];
+}
+
+
+template<class T>
+inline int32 List<T>::IndexOf(const T& type) const
 {
-	fIter i = fList.begin();
-	std::advance(i, position);
-	fList.erase(i);
+	const_iterator i = std::find(fList.begin(), fList.end(), type);
+	if (i == fList.end())
+		return -1;
+	return i - fList.begin();
 }
 
 
 template<class T>
-T List<T>::ItemAt(uint32 position)
+inline void List<T>::AddList(const List<T>& appendList)
 {
-	fIter i = fList.begin();
-	std::advance(i, position); 	
-	return *i;
+	fList.insert(fList.end(), appendList.fList.begin(),
+		appendList.fList.end());
 }
 
 
 template<class T>
-void List<T>::AddList(List<T> appendList)
+inline void List<T>::AddList(List<T>&& appendList)
 {
-	if (appendList.CountItems() == 0)
+	if (fList.empty() == true) {
+		fList.swap(appendList.fList);
 		return;
-	for (int i = 0; i < appendList.CountItems(); i++)
-		AddItem(appendList.ItemAt(i));
+	}
+	fList.insert(fList.end(), std::make_move_iterator(appendList.fList.begin()),
+		std::make_move_iterator(appendList.fList.end()));
+	appendList.fList.clear();
 }
 
 
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#include "IdentNickMap.h"
+
+#include <Autolock.h>
+
+
+IdentNickMap::IdentNickMap(int32 maxLoose)
+	:
+	fLock("ident nicks"),
+	fMaxLoose(maxLoose)
+{
+}
+
+
+void
+IdentNickMap::SetNick(const BString& ident, const BString& nick,
+	BStringList* orphans)
+{
+	BAutolock _(fLock);
+	ident_entry& entry = fNicks[ident];
+
+	// In no chat, it's now the most recently seen of those
+	if (entry.channels <= 0) {
+		_Unloose(entry);
+		entry.loose = fLoose.insert(fLoose.end(), ident);
+		entry.isLoose = true;
+
+		while ((int32)fLoose.size() > fMaxLoose) {
+			auto oldest = fNicks.find(fLoose.front());
+			if (orphans != NULL)
+				orphans->Add(fLoose.front());
+			_Unloose(oldest->second);
+		}
+	}
+
+	if (entry.nick == nick && entry.nick.IsEmpty() == false)
+		return;
+
+	// Drop the old nick's reverse mapping, unless it's been re-used
+	if (entry.nick.IsEmpty() == false) {
+		auto old = fIdents.find(entry.nick);
+		if (old != fIdents.end() && old->second == ident)
+			fIdents.erase(old);
+	}
+
+	entry.nick = nick;
+	fIdents[nick] = ident;
+}
+
+
+bool
+IdentNickMap::NickFor(const BString& ident, BString* nick)
+{
+	BAutolock _(fLock);
+	auto found = fNicks.find(ident);
+	if (found == fNicks.end())
+		return false;
+	*nick = found->second.nick;
+	return true;
+}
+
+
+bool
+IdentNickMap::IdentFor(const BString& nick, BString* ident)
+{
+	BAutolock _(fLock);
+	auto found = fIdents.find(nick);
+	if (found == fIdents.end())
+		return false;
+	*ident = found->second;
+	return true;
+}
+
+
+void
+IdentNickMap::RemoveIdent(const BString& ident)
+{
+	BAutolock _(fLock);
+	auto found = fNicks.find(ident);
+	if (found == fNicks.end() || found->second.channels > 0)
+		return;
+
+	auto reverse = fIdents.find(found->second.nick);
+	if (reverse != fIdents.end() && reverse->second == ident)
+		fIdents.erase(reverse);
+	_Unloose(found->second);
+	fNicks.erase(found);
+}
+
+
+void
+IdentNickMap::AddMember(const BString& channel, const BString& ident)
+{
+	BAutolock _(fLock);
+	auto entry = fNicks.find(ident);
+	if (entry == fNicks.end())
+		return;
+	if (fMembers[channel].insert(ident).second == true) {
+		entry->second.channels++;
+		_Unloose(entry->second);
+	}
+}
+
+
+void
+IdentNickMap::RemoveMember(const BString& channel, const BString& ident,
+	BStringList* orphans)
+{
+	BAutolock _(fLock);
+	auto members = fMembers.find(channel);
+	if (members == fMembers.end() || members->second.erase(ident) == 0)
+		return;
+	_Leave(ident, orphans);
+}
+
+
+void
+IdentNickMap::RemoveChannel(const BString& channel, BStringList* orphans)
+{
+	BAutolock _(fLock);
+	auto members = fMembers.find(channel);
+	if (members == fMembers.end())
+		return;
+
+	for (const BString& ident : members->second)
+		_Leave(ident, orphans);
+	fMembers.erase(members);
+}
+
+
+int32
+IdentNickMap::CountIdents()
+{
+	BAutolock _(fLock);
+	return fNicks.size();
+}
+
+
+int32
+IdentNickMap::CountLoose()
+{
+	BAutolock _(fLock);
+	return fLoose.size();
+}
+
+
+void
+IdentNickMap::_Leave(const BString& ident, BStringList* orphans)
+{
+	auto entry = fNicks.find(ident);
+	if (entry == fNicks.end())
+		return;
+	if (--entry->second.channels <= 0 && orphans != NULL)
+		orphans->Add(ident);
+}
+
+
+// Those spared as orphans aren't counted as loose; they're checked again
+// when what spared them goes
+void
+IdentNickMap::_Unloose(ident_entry& entry)
+{
+	if (entry.isLoose == false)
+		return;
+	fLoose.erase(entry.loose);
+	entry.isLoose = false;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _IDENT_NICK_MAP_H
+#define _IDENT_NICK_MAP_H
+
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <Locker.h>
+#include <String.h>
+#include <StringList.h>
+
+
+struct BStringHash {
+	size_t operator()(const BString& string) const
+	{
+		// FNV-1a
+		size_t hash = 2166136261u;
+		for (const char* c = string.String(); *c != '\0'; c++) {
+			hash ^= (uint8)*c;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+};
+
+
+// Two-way ident ↔ nick index, with hashed lookups in both directions.
+// Also tracks which chats each ident shares with us, channels and
+// one-on-one chats alike, so idents that no longer share any are reported
+// as orphans and can be evicted. Idents in no chat at all (as those only
+// learned through WHOIS) are kept least-recently-set first, and the oldest
+// are reported as orphans past a cap.
+class IdentNickMap {
+public:
+							IdentNickMap(int32 maxLoose = 1024);
+
+			// Adds the ident, or renames it if already known; idents in no
+			// chat beyond the cap are added to orphans
+			void			SetNick(const BString& ident, const BString& nick,
+								BStringList* orphans = NULL);
+			bool			NickFor(const BString& ident, BString* nick);
+			bool			IdentFor(const BString& nick, BString* ident);
+			void			RemoveIdent(const BString& ident);
+
+			// Membership; idents left without channels are added to orphans
+			void			AddMember(const BString& channel,
+								const BString& ident);
+			void			RemoveMember(const BString& channel,
+								const BString& ident, BStringList* orphans);
+			void			RemoveChannel(const BString& channel,
+								BStringList* orphans);
+
+			int32			CountIdents();
+			int32			CountLoose();
+
+private:
+	typedef std::unordered_set<BString, BStringHash> IdentSet;
+
+	typedef std::list<BString> LooseList;
+
+	struct ident_entry {
+				ident_entry() : channels(0), isLoose(false) {}
+
+		BString	nick;
+		int32	channels;
+		bool	isLoose;
+		LooseList::iterator loose;	// Its place in fLoose, if isLoose
+	};
+
+			void			_Leave(const BString& ident, BStringList* orphans);
+			void			_Unloose(ident_entry& entry);
+
+			BLocker			fLock;
+			int32			fMaxLoose;
+			LooseList		fLoose;
+			std::unordered_map<BString, ident_entry, BStringHash> fNicks;
+			std::unordered_map<BString, BString, BStringHash> fIdents;
+			std::unordered_map<BString, IdentSet, BStringHash> fMembers;
+};
+
+
+#endif // _IDENT_NICK_MAP_H
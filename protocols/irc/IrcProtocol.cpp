@@ -183,6 +183,7 @@ IrcProtocol::Process(BMessage* msg)
 				created.AddString("user_id", user_id);
 				_SendMsg(&created);
 				fChannels.Add(user_name);
+				fIdentNicks.AddMember(user_name, user_id);
 				break;
 			}
 			// If it's not a known user, we need to get their ID/nick somehow
@@ -221,6 +222,10 @@ IrcProtocol::Process(BMessage* msg)
 					left.AddString("chat_id", chat_id);
 					_SendMsg(&left);
 					fChannels.Remove(chat_id);
+
+					BStringList orphans;
+					fIdentNicks.RemoveChannel(chat_id, &orphans);
+					_EvictIdents(orphans);
 				}
 			}
 			break;
@@ -327,8 +332,15 @@ IrcProtocol::Process(BMessage* msg)
 		case IM_ROSTER_REMOVE_CONTACT:
 		{
 			BString user_id;
-			if (msg->FindString("user_id", &user_id) == B_OK)
-				_RemoveContact(_NickIdent(user_id));
+			if (msg->FindString("user_id", &user_id) != B_OK)
+				break;
+			BString ident = _NickIdent(user_id);
+			_RemoveContact(ident);
+
+			// It might only have been kept as a contact
+			BStringList orphans;
+			orphans.Add(ident);
+			_EvictIdents(orphans);
 			break;
 		}
 		case IM_GET_CONTACT_INFO:
@@ -495,8 +507,9 @@ IrcProtocol::_ProcessNumeric(int32 numeric, BString sender, BStringList params,
 			BString ident = user;
 			ident << "@" << host;
 
-			fIdentNicks.RemoveItemFor(ident);
-			fIdentNicks.AddItem(ident, nick);
+			BStringList orphans;
+			fIdentNicks.SetNick(ident, nick, &orphans);
+			_EvictIdents(orphans);
 
 			// If is a contact, let's go!
 			_UpdateContact(nick, ident, true);
@@ -515,6 +528,7 @@ IrcProtocol::_ProcessNumeric(int32 numeric, BString sender, BStringList params,
 				created.AddString("user_id", ident);
 				_SendMsg(&created);
 				fChannels.Add(nick);
+				fIdentNicks.AddMember(nick, ident);
 			}
 			// Used to populate a one-on-one chat's userlist… lol, I know.
 			else if (fWhoIsRequested == false && fChannels.HasString(nick)) {
@@ -537,8 +551,11 @@ IrcProtocol::_ProcessNumeric(int32 numeric, BString sender, BStringList params,
 			BString ident = user;
 			ident << "@" << host;
 
-			fIdentNicks.RemoveItemFor(ident);
-			fIdentNicks.AddItem(ident, nick);
+			BStringList orphans;
+			fIdentNicks.SetNick(ident, nick, &orphans);
+			if (_IsChannelName(channel) == true)
+				fIdentNicks.AddMember(channel, ident);
+			_EvictIdents(orphans);
 
 			// Used to populate a room's userlist (one-by-one… :p)
 			if (fWhoRequested == false && _IsChannelName(channel)) {
@@ -693,8 +710,10 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 		BString user_id = _SenderIdent(sender);
 		BString user_name = _SenderNick(sender);
 		BString body = params.Last();
-		if (_IsChannelName(chat_id) == false)
+		if (_IsChannelName(chat_id) == false) {
 			chat_id = _SenderNick(sender);
+			_AddQueryMember(chat_id, user_id);
+		}
 		if (fChannels.HasString(chat_id) == false)
 			fChannels.Add(chat_id);
 
@@ -714,8 +733,11 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 		BMessage send(IM_MESSAGE);
 		send.AddInt32("im_what", IM_MESSAGE_RECEIVED);
 
-		if (_IsChannelName(chat_id) == false)
+		if (_IsChannelName(chat_id) == false) {
 			chat_id = _SenderNick(sender);
+			if (sender.IsEmpty() == false)
+				_AddQueryMember(chat_id, _SenderIdent(sender));
+		}
 		if (fChannels.HasString(chat_id) == false)
 			fChannels.Add(chat_id);
 
@@ -757,7 +779,10 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 			joined.AddInt32("im_what", IM_ROOM_PARTICIPANT_JOINED);
 			joined.AddString("user_id", user_id);
 			joined.AddString("user_name", user_name);
-			fIdentNicks.AddItem(user_id, user_name);
+			BStringList orphans;
+			fIdentNicks.SetNick(user_id, user_name, &orphans);
+			fIdentNicks.AddMember(chat_id, user_id);
+			_EvictIdents(orphans);
 		}
 		_SendMsg(&joined);
 
@@ -773,33 +798,45 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 		BString body = B_TRANSLATE("left: ");
 		body << params.Last();
 
+		BStringList orphans;
 		BMessage left(IM_MESSAGE);
 		left.AddString("chat_id", chat_id);
 		left.AddString("body", body);
 		if (_SenderIdent(sender) == fIdent) {
 			left.AddInt32("im_what", IM_ROOM_LEFT);
 			fChannels.Remove(chat_id);
+			fIdentNicks.RemoveChannel(chat_id, &orphans);
 		}
 		else {
 			left.AddInt32("im_what", IM_ROOM_PARTICIPANT_LEFT);
 			left.AddString("user_id", _SenderIdent(sender));
 			left.AddString("user_name", _SenderNick(sender));
+			fIdentNicks.RemoveMember(chat_id, _SenderIdent(sender), &orphans);
 		}
 		_SendMsg(&left);
+		_EvictIdents(orphans);
 	}
 	else if (command == "KICK")
 	{
 		BString chat_id = params.First();
-		BString user_id = params.StringAt(1);
+		BString nick = params.StringAt(1);
+		BString user_id = _NickIdent(nick);
 
 		BMessage foot(IM_MESSAGE);
 		foot.AddInt32("im_what", IM_ROOM_PARTICIPANT_KICKED);
 		foot.AddString("chat_id", chat_id);
-		foot.AddString("user_name", _IdentNick(user_id));
-		foot.AddString("user_id", _NickIdent(user_id));
+		foot.AddString("user_name", nick);
+		foot.AddString("user_id", user_id);
 		if (params.CountStrings() == 3)
 			foot.AddString("body", params.StringAt(2));
 		_SendMsg(&foot);
+
+		BStringList orphans;
+		if (nick == fNick)
+			fIdentNicks.RemoveChannel(chat_id, &orphans);
+		else
+			fIdentNicks.RemoveMember(chat_id, user_id, &orphans);
+		_EvictIdents(orphans);
 	}
 	else if (command == "QUIT")
 	{
@@ -826,6 +863,14 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 		status.AddString("user_id", user_id);
 		status.AddInt32("status", STATUS_OFFLINE);
 		_SendMsg(&status);
+
+		// Their one-on-one chats stay open, and keep them known
+		BStringList orphans;
+		for (int i = 0; i < fChannels.CountStrings(); i++)
+			if (_IsChannelName(fChannels.StringAt(i)) == true)
+				fIdentNicks.RemoveMember(fChannels.StringAt(i), user_id,
+					&orphans);
+		_EvictIdents(orphans);
 	}
 	else if (command == "INVITE")
 	{
@@ -851,8 +896,9 @@ IrcProtocol::_ProcessCommand(BString command, BString sender,
 			nick.AddString("user_id", ident);
 
 			_RenameContact(ident, user_name);
-			fIdentNicks.RemoveItemFor(ident);
-			fIdentNicks.AddItem(ident, user_name);
+			BStringList orphans;
+			fIdentNicks.SetNick(ident, user_name, &orphans);
+			_EvictIdents(orphans);
 		}
 		_SendMsg(&nick);
 	}
@@ -979,9 +1025,8 @@ IrcProtocol::_SenderIdent(BString sender)
 BString
 IrcProtocol::_IdentNick(BString ident)
 {
-	bool found = false;
-	BString nick = fIdentNicks.ValueFor(ident, &found);
-	if (found == true)
+	BString nick;
+	if (fIdentNicks.NickFor(ident, &nick) == true)
 		return nick;
 	return ident;
 }
@@ -990,13 +1035,37 @@ IrcProtocol::_IdentNick(BString ident)
 BString
 IrcProtocol::_NickIdent(BString nick)
 {
-	for (int i = 0; i < fIdentNicks.CountItems(); i++)
-		if (fIdentNicks.ValueAt(i) == nick)
-			return fIdentNicks.KeyAt(i);
+	BString ident;
+	if (fIdentNicks.IdentFor(nick, &ident) == true)
+		return ident;
 	return nick;
 }
 
 
+void
+IrcProtocol::_EvictIdents(const BStringList& idents)
+{
+	// Keep contacts and ourselves resolvable; open one-on-one chats are
+	// memberships, and never leave orphans. A spared contact's checked
+	// again once it's removed.
+	for (int32 i = 0; i < idents.CountStrings(); i++) {
+		BString ident = idents.StringAt(i);
+		if (ident != fIdent && fContacts.HasString(_IdentNick(ident)) == false)
+			fIdentNicks.RemoveIdent(ident);
+	}
+}
+
+
+void
+IrcProtocol::_AddQueryMember(BString chat_id, BString ident)
+{
+	BStringList orphans;
+	fIdentNicks.SetNick(ident, chat_id, &orphans);
+	fIdentNicks.AddMember(chat_id, ident);
+	_EvictIdents(orphans);
+}
+
+
 bool
 IrcProtocol::_IsChannelName(BString name)
 {
@@ -9,16 +9,12 @@
 #include <String.h>
 #include <StringList.h>
 
-#include <libsupport/KeyMap.h>
-
 #include <ChatProtocol.h>
 
+#include "IdentNickMap.h"
 #include "IrcConstants.h"
 
 
-typedef KeyMap<BString, BString> StringMap;
-
-
 class BSocket;
 class BDataIO;
 
@@ -84,6 +80,9 @@ private:
 
 			BString		_IdentNick(BString ident);
 			BString		_NickIdent(BString nick);
+			void		_EvictIdents(const BStringList& idents);
+			// One-on-one chats are kept as the ident's memberships too
+			void		_AddQueryMember(BString chat_id, BString ident);
 
 			bool		_IsChannelName(BString name);
 
@@ -142,7 +141,7 @@ private:
 
 	bool fWriteLocked;
 
-	StringMap fIdentNicks; // User ident → nick
+	IdentNickMap fIdentNicks;
 
 	BStringList fChannels;
 
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+
+// Monotonic time, in seconds
+static inline double
+bench_now()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+
+// Keeps the compiler from optimizing away what's only computed to be timed
+static volatile uint64_t gBenchSink;
+
+static inline void
+bench_keep(uint64_t value)
+{
+	gBenchSink += value;
+}
+
+
+#endif // _BENCH_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Appends messages straight to one ChatLog, with no LogWriter or index in
+// the way, and times the appends as the log grows, reopening it, and
+// reading the newest and the oldest entries back.
+//	chatlogbench [messages] [directory]
+// The default is 1M messages. Entries are flushed 4096 at a time, as the
+// LogWriter does by default; the directory's emptied first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <Message.h>
+#include <String.h>
+
+#include <libchatlog/ChatLog.h>
+
+#include "Bench.h"
+
+
+const int32 kFlushRecords = 4096;
+const int32 kSteps = 10;
+
+// Each read is repeated for at least this long, in seconds
+const double kMinTime = 0.3;
+
+
+struct read_result {
+	double		micros;		// Per read
+	int32		read;
+};
+
+
+static read_result
+time_reads(ChatLog& log, uint64 first, int32 count)
+{
+	double took;
+	uint64 reads = 0;
+	int32 read = 0;
+	double start = bench_now();
+	do {
+		BMessage logs;
+		if (first == (uint64)-1)
+			log.ReadLast(count, &logs);
+		else
+			log.ReadEntries(first, count, &logs);
+		type_code type;
+		if (logs.GetInfo("message", &type, &read) != B_OK)
+			read = 0;
+		reads++;
+	} while ((took = bench_now() - start) < kMinTime);
+	read_result result = { took / reads * 1e6, read };
+	return result;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	uint64 count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+	const char* directory = argc > 2 ? argv[2] : "/tmp/chatlogbench";
+	if (count < kSteps) {
+		fprintf(stderr, "Usage: %s [messages] [directory]\n", argv[0]);
+		return 1;
+	}
+
+	BString remove;
+	remove << "rm -rf '" << directory << "'";
+	if (system(remove.String()) != 0)
+		return 1;
+	BString path;
+	path << directory << "/account/room";
+
+	const char* kWords[] = { "well", "I", "think", "the", "build", "is",
+		"broken", "again", "see", "you", "later", "tonight" };
+	uint64 state = 1;
+	int64 when = 1600000000;
+
+	printf("%-24s %12s %14s %10s\n", "appended", "messages/s", "us/append",
+		"MB");
+	{
+		ChatLog log(path.String());
+		if (log.InitCheck() != B_OK) {
+			fprintf(stderr, "%s: %s\n", path.String(),
+				strerror(log.InitCheck()));
+			return 1;
+		}
+
+		BMessage message('IMms');
+		message.AddString("body", "");
+		message.AddString("user_id", "");
+		message.AddInt64("when", 0);
+		uint64 appended = 0;
+		off_t bytes = 0;
+		for (int32 step = 1; step <= kSteps; step++) {
+			uint64 end = count * step / kSteps;
+			double start = bench_now();
+			for (; appended < end; appended++) {
+				state = state * 6364136223846793005ULL
+					+ 1442695040888963407ULL;
+				BString body;
+				int32 length = 3 + (state >> 33) % 12;
+				for (int32 j = 0; j < length; j++) {
+					if (j > 0)
+						body << " ";
+					body << kWords[(state >> (j * 4 % 32)) % 12];
+				}
+				BString sender;
+				sender << "nick" << (int32)((state >> 40) % 200);
+				when += 1 + (state >> 50) % 3;
+
+				message.ReplaceString("body", body.String());
+				message.ReplaceString("user_id", sender.String());
+				message.ReplaceInt64("when", when);
+				bytes += message.FlattenedSize();
+				if (log.Append(&message, when, sender.String()) != B_OK
+					|| (log.CountPending() >= kFlushRecords
+						&& log.Flush() != B_OK)) {
+					fprintf(stderr, "Appending failed\n");
+					return 1;
+				}
+			}
+			log.Flush();
+			double took = bench_now() - start;
+			uint64 stepCount = end - count * (step - 1) / kSteps;
+
+			BString name;
+			name << "to " << end;
+			printf("%-24s %12.0f %14.3f %10.1f\n", name.String(),
+				stepCount / took, took / stepCount * 1e6, bytes / 1e6);
+		}
+	}
+
+	// As a room's opened, then read back from
+	double start = bench_now();
+	ChatLog log(path.String());
+	double opened = bench_now() - start;
+	printf("\nReopened with %" B_PRIu64 " entries in %.3f ms\n\n",
+		log.CountEntries(), opened * 1000);
+
+	printf("%-24s %14s %10s\n", "read", "us/read", "entries");
+	const int32 kCounts[] = { 1, 50, 500, 5000 };
+	for (int32 i = 0; i < 4; i++) {
+		BString name;
+		name << "ReadLast(" << kCounts[i] << ")";
+		read_result result = time_reads(log, (uint64)-1, kCounts[i]);
+		printf("%-24s %14.2f %10" B_PRId32 "\n", name.String(),
+			result.micros, result.read);
+	}
+	for (int32 i = 1; i < 3; i++) {
+		BString name;
+		name << "oldest " << kCounts[i];
+		read_result result = time_reads(log, log.FirstEntry(), kCounts[i]);
+		printf("%-24s %14.2f %10" B_PRId32 "\n", name.String(),
+			result.micros, result.read);
+	}
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Times Emoticor::FindFaces() over chat messages, against the recursion
+// it replaced (see OldEmoticor.h), with the faces of a smileys config.
+//	emoticonbench [settings.xml] [log file]
+// The log's lines are taken as messages; without one, IRC-style lines
+// are made up, one in five with faces.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "Emoconfig.h"
+#include "Emoticor.h"
+#include "OldEmoticor.h"
+
+
+// Each measurement is repeated for at least this long, in seconds
+const double kMinTime = 0.5;
+
+const int32 kMadeUpLines = 100000;
+
+
+static void
+show_faces(const char* text)
+{
+	List<emoticon_span> spans;
+	Emoticor::Get()->FindFaces(text, strlen(text), &spans);
+
+	old_emoticon_output old = { "", 0 };
+	old_find_tokens(Emoticor::Get()->Config(), text, 0, &old);
+
+	printf("\"%s\"\n\t%" B_PRIu32 " faces:", text, spans.CountItems());
+	for (uint32 i = 0; i < spans.CountItems(); i++) {
+		const emoticon_span& span = spans.ItemAt(i);
+		printf(" %.*s", (int)(span.end - span.start), text + span.start);
+	}
+	printf("\n\t%" B_PRId32 " faces by the old recursion\n", old.faces);
+}
+
+
+static bool
+read_lines(const char* path, std::vector<std::string>* lines)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+	char line[4096];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strlen(line);
+		if (length > 0 && line[length - 1] == '\n')
+			line[--length] = '\0';
+		lines->push_back(std::string(line, length));
+	}
+	fclose(file);
+	return true;
+}
+
+
+static void
+make_lines(std::vector<std::string>* lines)
+{
+	for (int32 i = 0; i < kMadeUpLines; i++) {
+		char line[256];
+		snprintf(line, sizeof(line), "[12:%02d] <nick%d> %s", i % 60, i % 50,
+			i % 5 == 0
+				? "haha :) that build is broken again :-( see (y) later"
+				: "well, I think the whole thing needs a rebuild before "
+					"the release tomorrow");
+		lines->push_back(line);
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* settings = argc > 1 ? argv[1] : "smileys/settings.xml";
+	Emoticor::Get()->LoadConfig(settings);
+	Emoconfig* config = Emoticor::Get()->Config();
+	if (config->numfaces == 0) {
+		fprintf(stderr, "%s: No faces\n", settings);
+		return 1;
+	}
+
+	std::vector<std::string> lines;
+	if (argc > 2) {
+		if (read_lines(argv[2], &lines) == false) {
+			fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+			return 1;
+		}
+	} else
+		make_lines(&lines);
+
+	size_t bytes = 0;
+	for (const std::string& line : lines)
+		bytes += line.size();
+	printf("%d faces, %zu messages of %.1f bytes\n\n", config->numfaces,
+		lines.size(), (double)bytes / lines.size());
+
+	show_faces("hi :) there :-) ;) :D and :-D, :P xD :p");
+	show_faces("thanks:) and (A) but not x(A) http://x/ :):(");
+	printf("\n%-12s %10s %14s %10s\n", "search", "MB/s", "us/message",
+		"faces");
+
+	List<emoticon_span> spans;
+	uint64 faces = 0;
+	size_t messages = 0;
+	double took;
+	double start = bench_now();
+	do {
+		for (const std::string& line : lines) {
+			Emoticor::Get()->FindFaces(line.data(), line.size(), &spans);
+			faces += spans.CountItems();
+		}
+		messages += lines.size();
+	} while ((took = bench_now() - start) < kMinTime);
+	printf("%-12s %10.1f %14.2f %10" B_PRIu64 "\n", "automaton",
+		(double)bytes * messages / lines.size() / took / 1e6,
+		took / messages * 1e6, faces * lines.size() / messages);
+
+	// Too slow to go through all of them in time; its faces are only
+	// counted the first time round, over the messages it got to
+	uint64 oldFaces = 0;
+	size_t oldBytes = 0;
+	messages = 0;
+	start = bench_now();
+	do {
+		const std::string& line = lines[messages % lines.size()];
+		old_emoticon_output old = { "", 0 };
+		old_find_tokens(config, line.c_str(), 0, &old);
+		bench_keep(old.text.size());
+		if (messages < lines.size())
+			oldFaces += old.faces;
+		oldBytes += line.size();
+		messages++;
+	} while ((took = bench_now() - start) < kMinTime);
+	printf("%-12s %10.1f %14.2f %10" B_PRIu64 " (of %zu messages)\n",
+		"recursion", oldBytes / took / 1e6, took / messages * 1e6, oldFaces,
+		std::min(messages, lines.size()));
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Imports a made-up irssi log into a ChatLog with LogImporter, as the
+// chatlog tool does, and times it against only parsing it. The parser's
+// timestamps are checked on a few known lines first.
+//	importbench [lines] [directory]
+// The default is 1M lines; the directory's emptied first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Message.h>
+#include <String.h>
+
+#include <libchatlog/ChatLog.h>
+#include <libchatlog/LogImporter.h>
+
+#include "Bench.h"
+
+
+struct expected_message {
+	const char*	line;
+	int64		when;		// In UTC
+	const char*	nick;
+	bool		action;
+};
+
+
+// Day changes have the date, but no time; the lines that aren't messages
+// are NULL
+const expected_message kExpected[] = {
+	{ "--- Log opened Mon Jan 04 12:00:00 2021", 0, NULL, false },
+	{ "12:01 <@alice> hi", 1609761660, "alice", false },
+	{ "12:02  * bob waves", 1609761720, "bob", true },
+	{ "12:03 -!- carol [c@host] has joined #haiku", 0, NULL, false },
+	{ "--- Day changed Tue Jan 05 2021", 0, NULL, false },
+	{ "00:01 < dave> morning", 1609804860, "dave", false },
+	{ "23:59:30 <+erin> night", 1609891170, "erin", false },
+	{ "--- Day changed Sun Feb 28 2021", 0, NULL, false },
+	{ "09:00 <frank> hello", 1614502800, "frank", false }
+};
+const int32 kExpectedCount = sizeof(kExpected) / sizeof(kExpected[0]);
+
+
+class CheckParser : public LogParser {
+public:
+	CheckParser()
+		:
+		fNext(0),
+		fFailed(false)
+	{
+	}
+
+	virtual int MessageParsed(const parsed_message& message)
+	{
+		while (fNext < kExpectedCount && kExpected[fNext].nick == NULL)
+			fNext++;
+		if (fNext >= kExpectedCount) {
+			printf("Parsed a message past the last one\n");
+			fFailed = true;
+			return 0;
+		}
+
+		const expected_message& expected = kExpected[fNext++];
+		BString nick(message.nick, message.nickLength);
+		if (message.when != expected.when || nick != expected.nick
+			|| message.action != expected.action) {
+			printf("\"%s\": parsed as %s at %" B_PRId64 ", not %" B_PRId64
+				"\n", expected.line, nick.String(), message.when,
+				expected.when);
+			fFailed = true;
+		}
+		return 0;
+	}
+
+	bool Passed()
+	{
+		while (fNext < kExpectedCount && kExpected[fNext].nick == NULL)
+			fNext++;
+		if (fNext < kExpectedCount)
+			printf("\"%s\" wasn't parsed\n", kExpected[fNext].line);
+		return fFailed == false && fNext == kExpectedCount;
+	}
+
+private:
+	int32		fNext;
+	bool		fFailed;
+};
+
+
+// Only parses, to tell what's the ChatLog's share of an import
+class CountParser : public LogParser {
+public:
+	virtual int MessageParsed(const parsed_message& message)
+	{
+		bench_keep(message.when + message.bodyLength);
+		return 0;
+	}
+};
+
+
+static bool
+check_parser(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+	for (int32 i = 0; i < kExpectedCount; i++)
+		fprintf(file, "%s\n", kExpected[i].line);
+	fclose(file);
+
+	CheckParser parser;
+	int ret = parser.ParseFile(path, LOG_IMPORT_IRSSI);
+	if (ret != 0 || parser.Passed() == false) {
+		if (ret != 0)
+			printf("%s: %s\n", path, strerror(ret));
+		return false;
+	}
+	printf("%" B_PRId32 " irssi lines parsed to the expected times\n\n",
+		kExpectedCount);
+	return true;
+}
+
+
+static bool
+make_log(const char* path, uint64 count, off_t* _size)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+
+	const char* kWords[] = { "well", "I", "think", "the", "build", "is",
+		"broken", "again", "see", "you", "later", "tonight" };
+	uint64 state = 1;
+	int32 day = 4;
+	int32 minute = 0;
+	fprintf(file, "--- Log opened Mon Jan %02d 00:00:00 2021\n", day);
+	for (uint64 i = 0; i < count; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		minute += (state >> 50) % 2;
+		if (minute >= 24 * 60) {
+			minute = 0;
+			day++;
+			// The month's made up, but it's only ever the date
+			fprintf(file, "--- Day changed Tue Jan %02d 2021\n",
+				day % 28 + 1);
+		}
+
+		fprintf(file, "%02d:%02d ", minute / 60, minute % 60);
+		if ((state >> 20) % 16 == 0)
+			fprintf(file, " * nick%d", (int)((state >> 40) % 200));
+		else
+			fprintf(file, "<%cnick%d>", (state >> 30) % 8 == 0 ? '@' : ' ',
+				(int)((state >> 40) % 200));
+		int32 length = 3 + (state >> 33) % 12;
+		for (int32 j = 0; j < length; j++)
+			fprintf(file, " %s", kWords[(state >> (j * 4 % 32)) % 12]);
+		fputc('\n', file);
+	}
+	*_size = ftell(file);
+	return fclose(file) == 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	uint64 count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+	const char* directory = argc > 2 ? argv[2] : "/tmp/importbench";
+	if (count == 0) {
+		fprintf(stderr, "Usage: %s [lines] [directory]\n", argv[0]);
+		return 1;
+	}
+
+	// The expected times are UTC's
+	setenv("TZ", "UTC", 1);
+	tzset();
+
+	BString remove;
+	remove << "rm -rf '" << directory << "' && mkdir -p '" << directory
+		<< "'";
+	if (system(remove.String()) != 0)
+		return 1;
+
+	BString path;
+	path << directory << "/check.log";
+	if (check_parser(path.String()) == false)
+		return 1;
+
+	path.SetTo(directory);
+	path << "/irssi.log";
+	off_t size = 0;
+	if (make_log(path.String(), count, &size) == false) {
+		fprintf(stderr, "%s: couldn't be written\n", path.String());
+		return 1;
+	}
+	printf("%" B_PRIu64 " lines, %.1f MB\n\n", count, size / 1e6);
+	printf("%-24s %12s %10s\n", "", "lines/s", "MB/s");
+
+	CountParser parser;
+	double start = bench_now();
+	if (parser.ParseFile(path.String(), LOG_IMPORT_IRSSI) != 0
+		|| parser.CountParsed() != count) {
+		fprintf(stderr, "Parsing failed\n");
+		return 1;
+	}
+	double took = bench_now() - start;
+	printf("%-24s %12.0f %10.1f\n", "parsed", count / took,
+		size / took / 1e6);
+
+	BString logPath;
+	logPath << directory << "/account/room";
+	ChatLog log(logPath.String());
+	if (log.InitCheck() != B_OK) {
+		fprintf(stderr, "%s: %s\n", logPath.String(),
+			strerror(log.InitCheck()));
+		return 1;
+	}
+
+	// As the chatlog tool's
+	BMessage base('IMms');
+	base.AddInt32("im_what", 'IMmr');
+	base.AddString("chat_id", "#haiku");
+	start = bench_now();
+	{
+		LogImporter importer(&log, base);
+		importer.SetOwnNick("nick0");
+		status_t ret = importer.ImportFile(path.String(), LOG_IMPORT_IRSSI);
+		if (ret != B_OK || importer.CountImported() != count) {
+			fprintf(stderr, "Importing failed: %s\n", strerror(ret));
+			return 1;
+		}
+	}
+	took = bench_now() - start;
+	printf("%-24s %12.0f %10.1f\n", "imported to a ChatLog", count / took,
+		size / took / 1e6);
+
+	if (log.CountEntries() != count) {
+		fprintf(stderr, "%" B_PRIu64 " entries logged, not %" B_PRIu64 "\n",
+			log.CountEntries(), count);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Compares libsupport's vector-backed List with the std::list one it
+// replaced, at 10, 1k and 100k items, in nanoseconds per item (or per
+// call, of ItemAt() and RemoveItemAt()).
+// The old ItemAt() and RemoveItemAt() walk from the head, so indexed
+// loops over it are quadratic; at 100k they're timed over a sample of
+// positions spread over the list rather than all of them. Its AddList()
+// is indexed too, and takes seconds to copy 100k items.
+
+#include <stdio.h>
+
+#include <libsupport/List.h>
+
+#include "Bench.h"
+#include "OldList.h"
+
+
+// Each measurement is repeated for at least this long, in seconds
+const double kMinTime = 0.2;
+// Positions sampled by the quadratic measurements
+const uint32 kSamples = 2000;
+
+
+struct bench_result {
+	double	add;
+	double	indexed;
+	double	addList;
+	double	remove;
+};
+
+
+template<class L>
+static bench_result
+run(uint32 count)
+{
+	bench_result result;
+
+	// AddItem() of count items
+	uint64 items = 0;
+	double start = bench_now();
+	double took;
+	do {
+		L list;
+		for (uint32 i = 0; i < count; i++)
+			list.AddItem(i);
+		bench_keep(list.CountItems());
+		items += count;
+	} while ((took = bench_now() - start) < kMinTime);
+	result.add = took * 1e9 / items;
+
+	L list;
+	for (uint32 i = 0; i < count; i++)
+		list.AddItem(i);
+
+	// "for (i < CountItems()) ItemAt(i)", as ChatCommand's and the rest
+	uint32 step = count > kSamples ? count / kSamples : 1;
+	items = 0;
+	start = bench_now();
+	for (uint32 round = 0; (took = bench_now() - start) < kMinTime;
+			round++) {
+		uint64 sum = 0;
+		for (uint32 i = round % step; i < list.CountItems(); i += step) {
+			sum += list.ItemAt(i);
+			items++;
+		}
+		bench_keep(sum);
+	}
+	result.indexed = took * 1e9 / items;
+
+	// AddList() of a list of count items
+	items = 0;
+	start = bench_now();
+	do {
+		L copy;
+		copy.AddList(list);
+		bench_keep(copy.CountItems());
+		items += count;
+	} while ((took = bench_now() - start) < kMinTime);
+	result.addList = took * 1e9 / items;
+
+	// RemoveItemAt() from the middle, of up to kSamples items
+	uint32 removals = count < kSamples ? count : kSamples;
+	items = 0;
+	took = 0;
+	do {
+		// Not with AddList(), which is quadratic for the old one
+		L copy;
+		for (uint32 i = 0; i < count; i++)
+			copy.AddItem(i);
+		start = bench_now();
+		for (uint32 i = 0; i < removals; i++)
+			copy.RemoveItemAt(copy.CountItems() / 2);
+		took += bench_now() - start;
+		bench_keep(copy.CountItems());
+		items += removals;
+	} while (took < kMinTime);
+	result.remove = took * 1e9 / items;
+	return result;
+}
+
+
+int
+main()
+{
+	const uint32 kCounts[] = {10, 1000, 100000};
+
+	printf("%8s %-8s %12s %12s %12s %12s\n", "items", "list", "AddItem",
+		"ItemAt", "AddList", "RemoveItemAt");
+	for (uint32 count : kCounts) {
+		bench_result old = run<OldList<uint32> >(count);
+		bench_result current = run<List<uint32> >(count);
+		printf("%8" B_PRIu32 " %-8s %10.2fns %10.2fns %10.2fns %10.2fns\n",
+			count, "old", old.add, old.indexed, old.addList, old.remove);
+		printf("%8" B_PRIu32 " %-8s %10.2fns %10.2fns %10.2fns %10.2fns\n",
+			count, "vector", current.add, current.indexed, current.addList,
+			current.remove);
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _OLD_EMOTICOR_H
+#define _OLD_EMOTICOR_H
+
+// Emoticor::_findTokens() as it was before the automaton, for
+// EmoticonBench to compare it with. Its appends to the view were TODOs;
+// here they're gathered in a string, with the faces counted.
+
+#include <string>
+
+#include <String.h>
+
+#include "Emoconfig.h"
+
+
+struct old_emoticon_output {
+	std::string	text;
+	int32		faces;
+};
+
+
+static void
+old_find_tokens(Emoconfig* config, BString text, int tokenstart,
+	old_emoticon_output* output)
+{
+	//******************************************
+	// "Iteration is human, recursion is divine"
+	//******************************************
+
+	int32	newindex = 0;
+	BString	cur;
+	int	i = tokenstart;
+
+	if (config != NULL) {
+		while (config->FindString("face", i, &cur) == B_OK)
+		{
+			i++;
+
+			newindex = 0;
+
+			while (true) {
+				newindex = text.IFindFirst(cur.String(), 0);
+
+				if (newindex != B_ERROR) {
+					//take a walk on the left side ;)
+					if (newindex - 1 >= 0) {
+						BString left;
+						text.CopyInto(left, 0, newindex);
+						old_find_tokens(config, left, tokenstart + 1, output);
+					}
+
+					text.Remove(0, newindex + cur.Length());
+
+					output->text += cur.String();
+					output->faces++;
+
+					if (text.Length() == 0) return; //useless stack
+				} else
+					break;
+
+			}
+		}
+	}
+
+	output->text += text.String();
+}
+
+
+#endif // _OLD_EMOTICOR_H
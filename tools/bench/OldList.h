@@ -0,0 +1,76 @@
+/*
+ * Copyright 2009-2010, Pier Luigi Fiorini. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _OLD_LIST_H
+#define _OLD_LIST_H
+
+// libsupport's List as it was, backed by std::list, for ListBench to
+// compare the current one with
+
+#include <list>
+
+#include <SupportDefs.h>
+
+template<class T>
+class OldList {
+public:
+	uint32 	CountItems() const;
+
+	void  	AddItem(T type);
+
+	void	RemoveItemAt(uint32 position);
+
+	T		ItemAt(uint32 position);
+
+	void	AddList(OldList<T> appendList);
+
+private:
+	std::list<T> fList;
+	typedef typename std::list<T>::iterator fIter;
+};
+
+
+template<class T>
+uint32 OldList<T>::CountItems() const
+{
+	return fList.size();
+}
+
+
+template<class T>
+void OldList<T>::AddItem(T type)
+{
+	fList.push_back(type);
+}
+
+
+template<class T>
+void OldList<T>::RemoveItemAt(uint32 position)
+{
+	fIter i = fList.begin();
+	std::advance(i, position);
+	fList.erase(i);
+}
+
+
+template<class T>
+T OldList<T>::ItemAt(uint32 position)
+{
+	fIter i = fList.begin();
+	std::advance(i, position);
+	return *i;
+}
+
+
+template<class T>
+void OldList<T>::AddList(OldList<T> appendList)
+{
+	if (appendList.CountItems() == 0)
+		return;
+	for (uint32 i = 0; i < appendList.CountItems(); i++)
+		AddItem(appendList.ItemAt(i));
+}
+
+
+#endif	// _OLD_LIST_H
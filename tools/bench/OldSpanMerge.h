@@ -0,0 +1,139 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _OLD_SPAN_MERGE_H
+#define _OLD_SPAN_MERGE_H
+
+// The loop ConversationView::_AppendMessage() styled message bodies with
+// before TextRunBuilder, for SpanBench to compare it with. Its Append()s
+// to the view are only counted, with their text gathered in a string.
+
+#include <string>
+
+#include <Font.h>
+#include <String.h>
+
+#include <libsupport/KeyMap.h>
+
+#include "ImEvent.h"
+
+
+typedef KeyMap<uint16, int32> UInt16IntMap;
+
+
+static void
+old_enable_starting_faces(const TextSpans& faces, int32 index, uint16* face,
+	UInt16IntMap* indices, int32* next)
+{
+	for (const text_span& span : faces) {
+		// Change 'next' value for new fonts
+		if (span.start > index && span.start < *next)
+			*next = span.start;
+
+		// Set face normally
+		if (span.start == index) {
+			*face |= span.face;
+			indices->AddItem(span.face, index + span.length);
+		}
+	}
+
+	// Change 'next' for ending old fonts
+	for (int i = 0; i < indices->CountItems(); i++) {
+		int faceEnd = indices->ValueAt(i);
+		if (faceEnd > 0 && faceEnd > index && faceEnd < *next)
+			*next = faceEnd;
+	}
+}
+
+
+static void
+old_disable_ending_faces(int32 index, uint16* face, UInt16IntMap* indices)
+{
+	for (int32 i = 0; i < indices->CountItems(); i++) {
+		uint16 key = indices->KeyAt(i);
+		int32 value = indices->ValueAt(i);
+
+		if (value <= index) {
+			indices->RemoveItemAt(i);
+			*face = *face & ~key;
+			if (indices->CountItems() == 0)
+				*face = B_REGULAR_FACE;
+		}
+	}
+}
+
+
+static void
+old_enable_starting_color(const TextSpans& colors, int32 index,
+	rgb_color* color, int32* indice, int32* next)
+{
+	for (const text_span& span : colors) {
+		if (span.start > index && span.start < *next)
+			*next = span.start - 1;
+
+		if (span.start == index) {
+			*indice = span.length + index;
+			*color = span.color;
+			if (*indice > index && (*indice < *next || *next < index))
+				*next = *indice;
+			break;
+		}
+	}
+}
+
+
+// Returns how many times the view would have been appended to
+static int32
+old_append_body(const BString& body, const TextSpans& faces,
+	const TextSpans& colors, rgb_color textColor, std::string* output)
+{
+	int32 appends = 0;
+	uint16 face = 0;
+	UInt16IntMap face_indices;
+	rgb_color color = textColor;
+	int32 colorIndice = -1;
+	int32 next = body.CountChars();
+
+	BFont font;
+	for (int i = 0; i < body.CountChars(); i++) {
+		old_disable_ending_faces(i, &face, &face_indices);
+		old_enable_starting_faces(faces, i, &face, &face_indices, &next);
+		old_enable_starting_color(colors, i, &color, &colorIndice, &next);
+
+		if (face == B_REGULAR_FACE) {
+			font = BFont();
+			face = 0;
+		}
+		else if (face > 0) {
+			font.SetFace(face);
+		}
+
+		if (colorIndice > 0 && colorIndice <= i)
+			color = textColor;
+
+		// If formatting doesn't change for a while, send text in bulk
+		if ((next - i) > 1) {
+			BString append;
+			body.CopyCharsInto(append, i, next - i);
+			output->append(append.String());
+			appends++;
+			i = next - 1;
+			next = body.CountChars();
+		}
+		// Otherwise, send only current character
+		else {
+			int32 bytes;
+			const char* curChar = body.CharAt(i, &bytes);
+			output->append(curChar, bytes);
+			appends++;
+		}
+
+		if (next < i)
+			next = body.CountChars() - 1;
+	}
+	return appends;
+}
+
+
+#endif // _OLD_SPAN_MERGE_H
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _OLD_URL_FINDER_H
+#define _OLD_URL_FINDER_H
+
+// How UrlTextView found URLs before UrlScanner, for UrlScannerBench to
+// compare it with: Insert()'s loop, which copied the text, and
+// FindUrlString(), which took its copy by value.
+
+#include <ctype.h>
+
+#include <String.h>
+
+
+static bool
+old_is_valid_url_char(char c)
+{
+	return (isalpha(c) || isdigit(c) || c == ':' || c == '%' || c == ':'
+		|| c == '/' || c == '?' || c == '#' || c == '[' || c == ']' || c == '@'
+		|| c == '!' || c == '$' || c == '&' || c == '(' || c == ')' || c == '*'
+		|| c == '*' || c == '+' || c == ',' || c == ';' || c == '=' || c == '-'
+		|| c == '.' || c == '_' || c == '~' || c == '\'');
+}
+
+
+static bool
+old_find_url_string(BString text, int32* start, int32* end, int32 offset)
+{
+	int32 urlOffset = text.FindFirst("://", offset);
+	int32 urlStart = text.FindLast(" ", urlOffset) + 1;
+	int32 urlEnd = text.FindFirst(" ", urlOffset);
+
+	if (urlOffset == B_ERROR)
+		return false;
+
+	if (urlStart == B_ERROR)	urlStart = 0;
+	if (urlEnd == B_ERROR)		urlEnd = text.Length();
+
+	// Find first char of protocol
+	for (int32 i = urlStart; i < urlOffset; i++)
+		if (old_is_valid_url_char(text.ByteAt(i)) == true) {
+			urlStart = i;
+			break;
+		}
+
+	// Find last char of URL
+	for (int32 i = urlOffset; i < urlEnd; i++)
+		if (old_is_valid_url_char(text.ByteAt(i)) == false) {
+			urlEnd = i;
+			break;
+		}
+
+	*start = urlStart;
+	*end = urlEnd;
+	return true;
+}
+
+
+// The URLs in text, as UrlTextView::Insert() split them out
+static int32
+old_count_urls(const char* text)
+{
+	BString buf(text);
+
+	int32 specStart = 0;
+	int32 specEnd = 0;
+	int32 lastEnd = 0;
+	int32 count = 0;
+	while (old_find_url_string(buf, &specStart, &specEnd, lastEnd) == true) {
+		count++;
+		lastEnd = specEnd;
+	}
+	return count;
+}
+
+
+#endif // _OLD_URL_FINDER_H
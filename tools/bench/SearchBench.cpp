@@ -0,0 +1,238 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Logs generated messages to a few rooms through a LogWriter, with a
+// LogIndexer behind it, as Chat-O-Matic does; times how long indexing goes
+// on after, and then LogSearch's queries over all of them:
+// terms of different frequency, several terms, a phrase, a sender, and a
+// span of dates.
+// Words follow Zipf's law over a vocabulary of made-up ones, much as
+// chat does; they're picked deterministically, so runs can be compared.
+//	searchbench [messages] [directory]
+// The default is the 10M messages the index is meant for, which takes a
+// few minutes and 2 GB; "searchbench 1000000" is quicker. The directory's
+// emptied first.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <Message.h>
+#include <String.h>
+
+#include <libchatlog/LogIndexer.h>
+#include <libchatlog/LogSearch.h>
+#include <libchatlog/LogWriter.h>
+
+#include "Bench.h"
+
+
+const int32 kRooms = 16;
+const int32 kSenders = 200;
+const int32 kVocabulary = 20000;
+const int32 kRuns = 5;
+
+const char* kSyllables[] = {
+	"ka", "lo", "mi", "ne", "ru", "ta", "so", "vi", "be", "do", "fu", "ga",
+	"hi", "jo", "ku", "la", "ma", "no", "pe", "ri", "se", "tu", "wa", "yo",
+	"zi", "che", "sha", "tho", "qua", "bre", "gli", "spo"
+};
+
+
+// Deterministic, and the same everywhere
+static uint32
+next_random(uint64* state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *state >> 33;
+}
+
+
+// The word of the rank, its syllables being its digits in base 32
+static BString
+make_word(int32 rank)
+{
+	BString word;
+	do {
+		word << kSyllables[rank % 32];
+		rank /= 32;
+	} while (rank > 0);
+	return word;
+}
+
+
+struct query_result {
+	const char*	name;
+	double		best;
+	double		median;
+	uint32		hits;
+};
+
+
+static query_result
+run_query(const char* name, const char* directory, const log_query& query)
+{
+	std::vector<double> times;
+	uint32 hits = 0;
+	for (int32 i = 0; i < kRuns; i++) {
+		List<log_hit> found;
+		double start = bench_now();
+		LogSearch(query).SearchAll(directory, &found);
+		times.push_back((bench_now() - start) * 1000);
+		hits = found.CountItems();
+	}
+	std::sort(times.begin(), times.end());
+	query_result result = { name, times[0], times[kRuns / 2], hits };
+	return result;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	uint64 count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+	const char* directory = argc > 2 ? argv[2] : "/tmp/searchbench";
+	if (count == 0) {
+		fprintf(stderr, "Usage: %s [messages] [directory]\n", argv[0]);
+		return 1;
+	}
+
+	BString remove;
+	remove << "rm -rf '" << directory << "'";
+	if (system(remove.String()) != 0)
+		return 1;
+
+	std::vector<BString> words;
+	std::vector<double> cumulative;
+	double total = 0;
+	for (int32 rank = 0; rank < kVocabulary; rank++) {
+		words.push_back(make_word(rank));
+		total += 1.0 / (rank + 1);
+		cumulative.push_back(total);
+	}
+
+	std::vector<BString> rooms;
+	for (int32 i = 0; i < kRooms; i++) {
+		BString room;
+		room << directory << "/account/room" << i;
+		rooms.push_back(room);
+	}
+
+	// As the preferences' defaults
+	log_policy policy;
+	policy.flushInterval = 1000000;
+	policy.flushRecords = 4096;
+	policy.maxQueued = 65536;
+	policy.sync = false;
+	policy.rotation = 0;
+	policy.textSize = 0;
+
+	uint64 state = 1;
+	int64 first = 1600000000;
+	int64 when = first;
+	double start = bench_now();
+	log_writer_stats stats;
+	{
+		LogWriter writer(policy);
+		LogIndexer indexer(directory, &writer);
+		if (writer.InitCheck() != B_OK || indexer.InitCheck() != B_OK) {
+			fprintf(stderr, "Couldn't start the writer\n");
+			return 1;
+		}
+
+		BMessage message('IMms');
+		message.AddString("body", "");
+		message.AddString("user_id", "");
+		message.AddInt64("when", 0);
+		for (uint64 i = 0; i < count; i++) {
+			BString body;
+			int32 length = 3 + next_random(&state) % 12;
+			for (int32 j = 0; j < length; j++) {
+				double pick = next_random(&state) / (double)0x80000000 * total;
+				int32 rank = std::lower_bound(cumulative.begin(),
+					cumulative.end(), pick) - cumulative.begin();
+				if (j > 0)
+					body << " ";
+				body << words[std::min(rank, kVocabulary - 1)];
+			}
+
+			BString sender;
+			sender << "nick" << (int32)(next_random(&state) % kSenders);
+			when += 1 + next_random(&state) % 3;
+			message.ReplaceString("body", body.String());
+			message.ReplaceString("user_id", sender.String());
+			message.ReplaceInt64("when", when);
+			writer.Log(rooms[i % kRooms].String(), "", &message, when,
+				sender.String(), 0);
+		}
+		stats = writer.Stats();
+	}
+	double took = bench_now() - start;
+	printf("%" B_PRIu64 " messages logged to %" B_PRId32 " rooms in %.2f s"
+		" (%.0f messages/s)\n", count, kRooms, took, count / took);
+	printf("At most %" B_PRIu32 " queued, logging waited %" B_PRIu32
+		" times for %.2f s\n", stats.peakQueued, stats.stalls,
+		stats.stallTime / 1e6);
+
+	// What the indexer didn't get to alongside the writer, as it would be
+	// once Chat-O-Matic's idle or next started
+	start = bench_now();
+	{
+		LogIndexer indexer(directory);
+		indexer.Sync();
+		uint64 after = indexer.Stats().indexed;
+		printf("%" B_PRIu64 " indexed while logging, the other %" B_PRIu64
+			" in %.2f s after\n\n", count - after, after,
+			bench_now() - start);
+	}
+
+	// Otherwise the queries contend with writing all that back
+	sync();
+
+	std::vector<query_result> results;
+	log_query query;
+	query.since = 0;
+	query.until = 0;
+	query.limit = 0;
+
+	query.text = words[kVocabulary - 1];
+	results.push_back(run_query("rare term", directory, query));
+	query.text = words[500];
+	results.push_back(run_query("uncommon term", directory, query));
+	query.text = words[20];
+	results.push_back(run_query("common term", directory, query));
+	query.text = words[20];
+	query.limit = 50;
+	results.push_back(run_query("common term, 50 newest", directory, query));
+	query.limit = 0;
+
+	query.text = "";
+	query.text << words[50] << " " << words[300];
+	results.push_back(run_query("two terms", directory, query));
+	query.text = "";
+	query.text << "\"" << words[2] << " " << words[3] << "\"";
+	results.push_back(run_query("phrase", directory, query));
+
+	query.text = words[100];
+	query.sender = "nick7";
+	results.push_back(run_query("term from a sender", directory, query));
+	query.sender = "";
+
+	// The last hundredth of the time logged
+	query.text = words[10];
+	query.since = when - (when - first) / 100;
+	query.until = when;
+	results.push_back(run_query("term in a date span", directory, query));
+
+	printf("%-24s %10s %10s %10s\n", "query", "best", "median", "hits");
+	for (const query_result& result : results)
+		printf("%-24s %8.2fms %8.2fms %10" B_PRIu32 "\n", result.name,
+			result.best, result.median, result.hits);
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Times TextRunBuilder's merging of a message body's face and color spans
+// into runs, against the character-by-character loop it replaced (see
+// OldSpanMerge.h), on IRC-formatted lines of a few lengths.
+// The old loop's Append()s each became an Insert() into the view, which
+// isn't counted in its time here; the builder's runs go in with one.
+
+#include <stdio.h>
+
+#include <string>
+
+#include "Bench.h"
+#include "OldSpanMerge.h"
+#include "TextRunBuilder.h"
+
+
+// Each measurement is repeated for at least this long, in seconds
+const double kMinTime = 0.3;
+
+
+struct line_case {
+	const char*	name;
+	std::string	body;
+	TextSpans	faces;
+	TextSpans	colors;
+};
+
+
+// A span of every other word, in turn bold, italic and colored, as
+// heavily formatted IRC lines have
+static line_case
+make_case(const char* name, int32 characters, const char* word,
+	bool formatted)
+{
+	line_case line;
+	line.name = name;
+	rgb_color red = { 255, 0, 0, 255 };
+	rgb_color none = { 0, 0, 0, 255 };
+
+	int32 wordLength = 0;
+	for (const char* c = word; *c != '\0'; c++)
+		if ((*c & 0xc0) != 0x80)
+			wordLength++;
+
+	int32 character = 0;
+	for (int32 i = 0; character + wordLength + 1 <= characters; i++) {
+		if (formatted == true && i % 2 == 1) {
+			text_span span = { character, wordLength, 0, none };
+			if (i % 6 == 1) {
+				span.face = B_BOLD_FACE;
+				line.faces.AddItem(span);
+			} else if (i % 6 == 3) {
+				span.face = B_ITALIC_FACE;
+				line.faces.AddItem(span);
+			} else {
+				span.color = red;
+				line.colors.AddItem(span);
+			}
+		}
+		line.body += word;
+		line.body += ' ';
+		character += wordLength + 1;
+	}
+	return line;
+}
+
+
+int
+main()
+{
+	rgb_color black = { 0, 0, 0, 255 };
+	line_case cases[] = {
+		make_case("80 chars, plain", 80, "hello", false),
+		make_case("400 chars, formatted", 400, "hello", true),
+		make_case("400 chars, UTF-8", 400, "héllö", true),
+		make_case("2000 chars, formatted", 2000, "hello", true)
+	};
+
+	printf("%-22s %6s %-8s %10s %10s %8s\n", "line", "spans", "merge",
+		"per line", "MB/s", "inserts");
+	for (const line_case& line : cases) {
+		BString body(line.body.c_str());
+		uint32 spans = line.faces.CountItems() + line.colors.CountItems();
+
+		uint64 lines = 0;
+		int32 appends = 0;
+		double took;
+		double start = bench_now();
+		do {
+			std::string output;
+			appends = old_append_body(body, line.faces, line.colors, black,
+				&output);
+			bench_keep(output.size());
+			lines++;
+		} while ((took = bench_now() - start) < kMinTime);
+		printf("%-22s %6" B_PRIu32 " %-8s %8.2fus %10.1f %8" B_PRId32 "\n",
+			line.name, spans, "old", took * 1e6 / lines,
+			line.body.size() * lines / took / 1e6, appends);
+
+		lines = 0;
+		int32 runs = 0;
+		start = bench_now();
+		do {
+			TextRunBuilder builder;
+			builder.Add(line.body.c_str(), line.faces, line.colors, black);
+			text_run_array* array = builder.RunArray();
+			runs = array->count;
+			BTextView::FreeRunArray(array);
+			bench_keep(builder.Length());
+			lines++;
+		} while ((took = bench_now() - start) < kMinTime);
+		printf("%-22s %6" B_PRIu32 " %-8s %8.2fus %10.1f %8d\n", "", spans,
+			"builder", took * 1e6 / lines,
+			line.body.size() * lines / took / 1e6, 1);
+		bench_keep(runs);
+	}
+	return 0;
+}
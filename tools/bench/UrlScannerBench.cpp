@@ -0,0 +1,206 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Checks that UrlScanner finds the same URLs in random text whether it's
+// fed whole or in random pieces, then measures it in MB/s over an IRC
+// log: a line at a time, as messages are inserted, and the whole log as
+// one stream. The loop it replaced (see OldUrlFinder.h) is measured a
+// line at a time.
+//	urlscannerbench [log file]
+// Without a file, 64 MB of IRC-style lines are made up, one in nine with
+// a URL.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Bench.h"
+#include "OldUrlFinder.h"
+#include "UrlScanner.h"
+
+
+typedef std::vector<std::pair<int32, int32> > Spans;
+
+const int32 kFuzzRounds = 200000;
+const size_t kMadeUpSize = 64 << 20;
+const int32 kPasses = 3;
+
+
+static Spans
+scan_whole(const std::string& text)
+{
+	UrlScanner scanner;
+	scanner.Feed(text.data(), text.size());
+	Spans spans;
+	int32 start, end;
+	while (scanner.Next(&start, &end) == true)
+		spans.push_back(std::make_pair(start, end));
+	return spans;
+}
+
+
+// URLs still going at the end of a piece are given again, longer, once
+// they end, so only the longest of each start is kept
+static Spans
+scan_pieces(const std::string& text, std::mt19937& random, bool* _valid)
+{
+	UrlScanner scanner;
+	std::map<int32, int32> longest;
+	for (size_t position = 0; position < text.size();) {
+		size_t length = std::min(text.size() - position,
+			(size_t)(random() % 12 + 1));
+		scanner.Feed(text.data() + position, length);
+		int32 start, end;
+		while (scanner.Next(&start, &end) == true) {
+			if (end <= start)
+				*_valid = false;
+			if (longest[start] < end)
+				longest[start] = end;
+		}
+		position += length;
+	}
+	return Spans(longest.begin(), longest.end());
+}
+
+
+static bool
+fuzz()
+{
+	const char* kAlphabet = "ab:/ .h\"<>\xc3\xa4x1";
+	std::mt19937 random(1);
+	for (int32 round = 0; round < kFuzzRounds; round++) {
+		std::string text;
+		int32 length = random() % 40;
+		for (int32 i = 0; i < length; i++)
+			text += kAlphabet[random() % strlen(kAlphabet)];
+		if (random() % 3 == 0)
+			text.insert(random() % (text.size() + 1), "http://e.org/x");
+
+		bool valid = true;
+		Spans whole = scan_whole(text);
+		if (scan_pieces(text, random, &valid) != whole || valid == false) {
+			printf("Fed in pieces, URLs differ in \"%s\"\n", text.c_str());
+			return false;
+		}
+		for (const std::pair<int32, int32>& span : whole) {
+			std::string url = text.substr(span.first, span.second - span.first);
+			if (url.find("://") == std::string::npos
+				|| url.find(' ') != std::string::npos) {
+				printf("Not a URL: \"%s\" in \"%s\"\n", url.c_str(),
+					text.c_str());
+				return false;
+			}
+		}
+	}
+	printf("%" B_PRId32 " random strings: the same URLs whole or in pieces\n",
+		kFuzzRounds);
+	return true;
+}
+
+
+static bool
+read_log(const char* path, std::string* log)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+	char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		log->append(buffer, read);
+	fclose(file);
+	return true;
+}
+
+
+static void
+make_log(std::string* log)
+{
+	for (int32 i = 0; log->size() < kMadeUpSize; i++) {
+		char line[256];
+		snprintf(line, sizeof(line), "[12:%02d] <nick%d> %s\n", i % 60,
+			i % 50, i % 9 == 0
+				? "check https://github.com/HaikuArchives/Cardie/issues/42 out"
+				: "well, I think the \xc3\xa4\xc3\xb6\xc3\xbc build's broken "
+					"again: make: *** [objects] Error 1");
+		*log += line;
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (fuzz() == false)
+		return 1;
+
+	std::string log;
+	if (argc > 1) {
+		if (read_log(argv[1], &log) == false) {
+			fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+			return 1;
+		}
+	} else
+		make_log(&log);
+
+	std::vector<std::string> lines;
+	for (size_t start = 0; start < log.size();) {
+		size_t end = log.find('\n', start);
+		if (end == std::string::npos)
+			end = log.size();
+		lines.push_back(log.substr(start, end - start));
+		start = end + 1;
+	}
+	printf("%.1f MB, %zu lines\n\n", log.size() / 1e6, lines.size());
+	printf("%-24s %10s %10s\n", "scan", "MB/s", "URLs");
+
+	// Line by line, as UrlTextView::Insert() and VirtualRunView get them
+	uint64 urls = 0;
+	double start = bench_now();
+	for (int32 pass = 0; pass < kPasses; pass++) {
+		for (const std::string& line : lines)
+			urls += old_count_urls(line.c_str());
+	}
+	double took = bench_now() - start;
+	printf("%-24s %10.1f %10" B_PRIu64 "\n", "old, by line",
+		kPasses * log.size() / took / 1e6, urls / kPasses);
+
+	urls = 0;
+	start = bench_now();
+	for (int32 pass = 0; pass < kPasses; pass++) {
+		UrlScanner scanner;
+		for (const std::string& line : lines) {
+			scanner.Reset();
+			scanner.Feed(line.data(), line.size());
+			int32 urlStart, urlEnd;
+			while (scanner.Next(&urlStart, &urlEnd) == true)
+				urls++;
+		}
+	}
+	took = bench_now() - start;
+	printf("%-24s %10.1f %10" B_PRIu64 "\n", "UrlScanner, by line",
+		kPasses * log.size() / took / 1e6, urls / kPasses);
+
+	urls = 0;
+	start = bench_now();
+	for (int32 pass = 0; pass < kPasses; pass++) {
+		UrlScanner scanner;
+		scanner.Feed(log.data(), log.size());
+		int32 urlStart, urlEnd;
+		while (scanner.Next(&urlStart, &urlEnd) == true)
+			urls++;
+	}
+	took = bench_now() - start;
+	printf("%-24s %10.1f %10" B_PRIu64 "\n", "UrlScanner, whole",
+		kPasses * log.size() / took / 1e6, urls / kPasses);
+	return 0;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_AUTOLOCK_H
+#define _BENCH_AUTOLOCK_H
+
+#include <Locker.h>
+
+
+class BAutolock {
+public:
+						BAutolock(BLocker& locker) : fLocker(&locker)
+							{ fLocker->Lock(); }
+						BAutolock(BLocker* locker) : fLocker(locker)
+							{ fLocker->Lock(); }
+						~BAutolock() { fLocker->Unlock(); }
+
+			bool		IsLocked() const { return true; }
+
+private:
+			BLocker*	fLocker;
+};
+
+
+#endif // _BENCH_AUTOLOCK_H
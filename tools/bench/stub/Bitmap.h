@@ -0,0 +1,52 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_BITMAP_H
+#define _BENCH_BITMAP_H
+
+#include <string.h>
+
+#include <vector>
+
+#include <GraphicsDefs.h>
+#include <Rect.h>
+
+
+// 32-bit pixels in memory; ImportBits() only copies them
+class BBitmap {
+public:
+						BBitmap(BRect bounds, color_space space)
+							: fBounds(bounds),
+							  fBits((bounds.IntegerWidth() + 1)
+								* (bounds.IntegerHeight() + 1) * 4) {}
+
+			status_t	InitCheck() const { return B_OK; }
+			BRect		Bounds() const { return fBounds; }
+			void*		Bits() { return fBits.data(); }
+			int32		BitsLength() const { return fBits.size(); }
+			int32		BytesPerRow() const
+							{ return (fBounds.IntegerWidth() + 1) * 4; }
+
+			status_t	ImportBits(const BBitmap* bitmap, BPoint from,
+							BPoint to, int32 width, int32 height);
+
+private:
+			BRect		fBounds;
+			std::vector<uint8> fBits;
+};
+
+
+inline status_t
+BBitmap::ImportBits(const BBitmap* bitmap, BPoint from, BPoint to,
+	int32 width, int32 height)
+{
+	for (int32 y = 0; y < height; y++)
+		memcpy(&fBits[((int32)to.y + y) * BytesPerRow() + (int32)to.x * 4],
+			&bitmap->fBits[((int32)from.y + y) * bitmap->BytesPerRow()
+				+ (int32)from.x * 4], width * 4);
+	return B_OK;
+}
+
+
+#endif // _BENCH_BITMAP_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_DATA_IO_H
+#define _BENCH_DATA_IO_H
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+#include <SupportDefs.h>
+
+
+class BDataIO {
+public:
+	virtual				~BDataIO() {}
+
+	virtual	ssize_t		Read(void* buffer, size_t size) { return B_ERROR; }
+	virtual	ssize_t		Write(const void* buffer, size_t size) = 0;
+};
+
+
+class BPositionIO : public BDataIO {
+public:
+	virtual	ssize_t		ReadAt(off_t position, void* buffer,
+							size_t size) = 0;
+	virtual	ssize_t		WriteAt(off_t position, const void* buffer,
+							size_t size) = 0;
+	virtual	off_t		Seek(off_t position, uint32 seekMode) = 0;
+	virtual	status_t	SetSize(off_t size) = 0;
+};
+
+
+class BMallocIO : public BPositionIO {
+public:
+						BMallocIO() : fPosition(0) {}
+
+	virtual	ssize_t		Read(void* buffer, size_t size);
+	virtual	ssize_t		Write(const void* buffer, size_t size);
+	virtual	ssize_t		ReadAt(off_t position, void* buffer, size_t size);
+	virtual	ssize_t		WriteAt(off_t position, const void* buffer,
+							size_t size);
+	virtual	off_t		Seek(off_t position, uint32 seekMode);
+	virtual	status_t	SetSize(off_t size);
+			void		SetBlockSize(size_t blockSize)
+							{ fBuffer.reserve(blockSize); }
+
+			off_t		Position() const { return fPosition; }
+			const void*	Buffer() const { return fBuffer.data(); }
+			size_t		BufferLength() const { return fBuffer.size(); }
+
+private:
+			std::string	fBuffer;
+			off_t		fPosition;
+};
+
+
+inline ssize_t
+BMallocIO::Read(void* buffer, size_t size)
+{
+	ssize_t read = ReadAt(fPosition, buffer, size);
+	if (read > 0)
+		fPosition += read;
+	return read;
+}
+
+
+inline ssize_t
+BMallocIO::Write(const void* buffer, size_t size)
+{
+	ssize_t written = WriteAt(fPosition, buffer, size);
+	if (written > 0)
+		fPosition += written;
+	return written;
+}
+
+
+inline ssize_t
+BMallocIO::ReadAt(off_t position, void* buffer, size_t size)
+{
+	if (position >= (off_t)fBuffer.size())
+		return 0;
+	size = std::min(size, (size_t)(fBuffer.size() - position));
+	memcpy(buffer, fBuffer.data() + position, size);
+	return size;
+}
+
+
+inline ssize_t
+BMallocIO::WriteAt(off_t position, const void* buffer, size_t size)
+{
+	if (position + size > fBuffer.size())
+		fBuffer.resize(position + size);
+	memcpy(&fBuffer[position], buffer, size);
+	return size;
+}
+
+
+inline off_t
+BMallocIO::Seek(off_t position, uint32 seekMode)
+{
+	if (seekMode == SEEK_SET)
+		fPosition = position;
+	else if (seekMode == SEEK_END)
+		fPosition = fBuffer.size() + position;
+	else
+		fPosition += position;
+	return fPosition;
+}
+
+
+inline status_t
+BMallocIO::SetSize(off_t size)
+{
+	fBuffer.resize(size);
+	return B_OK;
+}
+
+
+#endif // _BENCH_DATA_IO_H
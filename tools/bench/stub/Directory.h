@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_DIRECTORY_H
+#define _BENCH_DIRECTORY_H
+
+#include <dirent.h>
+#include <errno.h>
+
+#include <Entry.h>
+
+
+class BDirectory {
+public:
+						BDirectory(const char* path);
+						~BDirectory();
+
+			status_t	InitCheck() const
+							{ return fDir != NULL ? B_OK : B_ENTRY_NOT_FOUND; }
+			status_t	GetNextEntry(BEntry* entry);
+			status_t	Rewind();
+
+private:
+			std::string	fPath;
+			DIR*		fDir;
+};
+
+
+// With its parents, as mkdir -p
+inline status_t
+create_directory(const char* path, mode_t mode)
+{
+	std::string directory = path;
+	for (size_t i = 1; i <= directory.size(); i++) {
+		if (i < directory.size() && directory[i] != '/')
+			continue;
+		if (mkdir(directory.substr(0, i).c_str(), mode) != 0 && errno != EEXIST)
+			return B_FILE_ERROR;
+	}
+	return B_OK;
+}
+
+
+inline
+BDirectory::BDirectory(const char* path)
+	:
+	fPath(path),
+	fDir(opendir(path))
+{
+}
+
+
+inline
+BDirectory::~BDirectory()
+{
+	if (fDir != NULL)
+		closedir(fDir);
+}
+
+
+inline status_t
+BDirectory::GetNextEntry(BEntry* entry)
+{
+	if (fDir == NULL)
+		return B_NO_INIT;
+
+	struct dirent* next;
+	while ((next = readdir(fDir)) != NULL) {
+		if (strcmp(next->d_name, ".") == 0 || strcmp(next->d_name, "..") == 0)
+			continue;
+		entry->SetTo((fPath + "/" + next->d_name).c_str());
+		return B_OK;
+	}
+	return B_ENTRY_NOT_FOUND;
+}
+
+
+inline status_t
+BDirectory::Rewind()
+{
+	if (fDir == NULL)
+		return B_NO_INIT;
+	rewinddir(fDir);
+	return B_OK;
+}
+
+
+#endif // _BENCH_DIRECTORY_H
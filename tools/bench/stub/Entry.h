@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_ENTRY_H
+#define _BENCH_ENTRY_H
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <StorageDefs.h>
+
+
+// A path, whether or not there's anything there
+class BEntry {
+public:
+						BEntry() {}
+						BEntry(const char* path) : fPath(path) {}
+
+			status_t	SetTo(const char* path)
+							{ fPath = path; return B_OK; }
+			status_t	GetName(char* name) const;
+
+			bool		Exists() const;
+			bool		IsDirectory() const;
+			status_t	GetSize(off_t* size) const;
+
+			status_t	Remove();
+	// A name in the same directory, or an absolute path
+			status_t	Rename(const char* path, bool clobber = false);
+
+private:
+			std::string	fPath;
+};
+
+
+inline status_t
+BEntry::GetName(char* name) const
+{
+	size_t slash = fPath.rfind('/');
+	strcpy(name, fPath.c_str() + (slash == std::string::npos ? 0 : slash + 1));
+	return B_OK;
+}
+
+
+inline bool
+BEntry::Exists() const
+{
+	struct stat st;
+	return stat(fPath.c_str(), &st) == 0;
+}
+
+
+inline bool
+BEntry::IsDirectory() const
+{
+	struct stat st;
+	return stat(fPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+inline status_t
+BEntry::GetSize(off_t* size) const
+{
+	struct stat st;
+	if (stat(fPath.c_str(), &st) != 0)
+		return B_ENTRY_NOT_FOUND;
+	*size = st.st_size;
+	return B_OK;
+}
+
+
+inline status_t
+BEntry::Remove()
+{
+	return unlink(fPath.c_str()) == 0 ? B_OK : B_ENTRY_NOT_FOUND;
+}
+
+
+inline status_t
+BEntry::Rename(const char* path, bool clobber)
+{
+	std::string target = path;
+	if (path[0] != '/')
+		target = fPath.substr(0, fPath.rfind('/') + 1) + path;
+	if (rename(fPath.c_str(), target.c_str()) != 0)
+		return B_FILE_ERROR;
+	fPath = target;
+	return B_OK;
+}
+
+
+#endif // _BENCH_ENTRY_H
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_FILE_H
+#define _BENCH_FILE_H
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <DataIO.h>
+#include <StorageDefs.h>
+
+
+// A file descriptor; only InitCheck() tells what went wrong, and that
+// coarsely
+class BFile : public BPositionIO {
+public:
+						BFile() : fFD(-1) {}
+						BFile(const char* path, uint32 openMode)
+							: fFD(-1) { SetTo(path, openMode); }
+	virtual				~BFile() { Unset(); }
+
+			status_t	SetTo(const char* path, uint32 openMode);
+			void		Unset();
+			status_t	InitCheck() const
+							{ return fFD < 0 ? B_NO_INIT : B_OK; }
+
+	virtual	ssize_t		Read(void* buffer, size_t size)
+							{ return read(fFD, buffer, size); }
+	virtual	ssize_t		Write(const void* buffer, size_t size)
+							{ return write(fFD, buffer, size); }
+	virtual	ssize_t		ReadAt(off_t position, void* buffer, size_t size)
+							{ return pread(fFD, buffer, size, position); }
+	virtual	ssize_t		WriteAt(off_t position, const void* buffer,
+							size_t size)
+							{ return pwrite(fFD, buffer, size, position); }
+	virtual	off_t		Seek(off_t position, uint32 seekMode)
+							{ return lseek(fFD, position, seekMode); }
+	virtual	status_t	SetSize(off_t size)
+							{ return ftruncate(fFD, size) == 0
+								? B_OK : B_IO_ERROR; }
+
+			status_t	GetSize(off_t* size) const;
+			status_t	GetModificationTime(time_t* modified) const;
+			status_t	Sync()
+							{ return fsync(fFD) == 0 ? B_OK : B_IO_ERROR; }
+
+private:
+			int			fFD;
+};
+
+
+inline status_t
+BFile::SetTo(const char* path, uint32 openMode)
+{
+	Unset();
+	fFD = open(path, openMode, 0644);
+	if (fFD >= 0)
+		return B_OK;
+	return errno == ENOENT ? B_ENTRY_NOT_FOUND : B_FILE_ERROR;
+}
+
+
+inline void
+BFile::Unset()
+{
+	if (fFD >= 0)
+		close(fFD);
+	fFD = -1;
+}
+
+
+inline status_t
+BFile::GetSize(off_t* size) const
+{
+	struct stat st;
+	if (fstat(fFD, &st) != 0)
+		return B_FILE_ERROR;
+	*size = st.st_size;
+	return B_OK;
+}
+
+
+inline status_t
+BFile::GetModificationTime(time_t* modified) const
+{
+	struct stat st;
+	if (fstat(fFD, &st) != 0)
+		return B_FILE_ERROR;
+	*modified = st.st_mtime;
+	return B_OK;
+}
+
+
+#endif // _BENCH_FILE_H
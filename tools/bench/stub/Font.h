@@ -0,0 +1,35 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_FONT_H
+#define _BENCH_FONT_H
+
+#include <SupportDefs.h>
+
+
+enum {
+	B_ITALIC_FACE		= 0x0001,
+	B_UNDERSCORE_FACE	= 0x0002,
+	B_NEGATIVE_FACE		= 0x0004,
+	B_OUTLINED_FACE		= 0x0008,
+	B_STRIKEOUT_FACE	= 0x0010,
+	B_BOLD_FACE			= 0x0020,
+	B_REGULAR_FACE		= 0x0040
+};
+
+
+// Only its face
+class BFont {
+public:
+						BFont() : fFace(B_REGULAR_FACE) {}
+
+			void		SetFace(uint16 face) { fFace = face; }
+			uint16		Face() const { return fFace; }
+
+private:
+			uint16		fFace;
+};
+
+
+#endif // _BENCH_FONT_H
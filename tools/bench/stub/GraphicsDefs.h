@@ -0,0 +1,31 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_GRAPHICS_DEFS_H
+#define _BENCH_GRAPHICS_DEFS_H
+
+#include <SupportDefs.h>
+
+
+enum color_space {
+	B_RGB32		= 0x0008,
+	B_RGBA32	= 0x2008
+};
+
+
+struct rgb_color {
+	uint8		red;
+	uint8		green;
+	uint8		blue;
+	uint8		alpha;
+
+	bool		operator==(const rgb_color& other) const
+					{ return red == other.red && green == other.green
+						&& blue == other.blue && alpha == other.alpha; }
+	bool		operator!=(const rgb_color& other) const
+					{ return !(*this == other); }
+};
+
+
+#endif // _BENCH_GRAPHICS_DEFS_H
@@ -0,0 +1,25 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_LOCKER_H
+#define _BENCH_LOCKER_H
+
+#include <mutex>
+
+#include <SupportDefs.h>
+
+
+class BLocker {
+public:
+						BLocker(const char* name = NULL) {}
+
+			bool		Lock() { fMutex.lock(); return true; }
+			void		Unlock() { fMutex.unlock(); }
+
+private:
+			std::recursive_mutex fMutex;
+};
+
+
+#endif // _BENCH_LOCKER_H
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_MESSAGE_H
+#define _BENCH_MESSAGE_H
+
+#include <string>
+#include <vector>
+
+#include <DataIO.h>
+#include <String.h>
+
+
+// Named, typed fields, flattened to a format of its own: the size, what,
+// and each field's name, type and values, all lengths as uint32
+class BMessage {
+public:
+						BMessage(uint32 what = 0) : what(what) {}
+
+			status_t	AddData(const char* name, type_code type,
+							const void* data, ssize_t size);
+			status_t	AddString(const char* name, const char* string)
+							{ return AddData(name, B_STRING_TYPE, string,
+								strlen(string) + 1); }
+			status_t	AddString(const char* name, const BString& string)
+							{ return AddString(name, string.String()); }
+			status_t	AddInt32(const char* name, int32 value)
+							{ return AddData(name, B_INT32_TYPE, &value,
+								sizeof(value)); }
+			status_t	AddInt64(const char* name, int64 value)
+							{ return AddData(name, B_INT64_TYPE, &value,
+								sizeof(value)); }
+			status_t	AddBool(const char* name, bool value)
+							{ return AddData(name, B_BOOL_TYPE, &value,
+								sizeof(value)); }
+			status_t	AddMessage(const char* name,
+							const BMessage* message);
+
+			status_t	FindData(const char* name, type_code type,
+							int32 index, const void** data,
+							ssize_t* size) const;
+			status_t	FindString(const char* name, int32 index,
+							const char** string) const
+							{ return FindData(name, B_STRING_TYPE, index,
+								(const void**)string, NULL); }
+			status_t	FindString(const char* name,
+							const char** string) const
+							{ return FindString(name, 0, string); }
+			status_t	FindString(const char* name, int32 index,
+							BString* string) const;
+			const char*	FindString(const char* name, int32 index = 0) const
+							{ return GetString(name, index, NULL); }
+			const char*	GetString(const char* name,
+							const char* defaultValue = NULL) const
+							{ return GetString(name, 0, defaultValue); }
+			const char*	GetString(const char* name, int32 index,
+							const char* defaultValue) const;
+			int32		GetInt32(const char* name, int32 defaultValue) const;
+			int64		GetInt64(const char* name, int64 defaultValue) const;
+			bool		GetBool(const char* name,
+							bool defaultValue = false) const;
+			status_t	FindMessage(const char* name, int32 index,
+							BMessage* message) const;
+			status_t	FindMessage(const char* name,
+							BMessage* message) const
+							{ return FindMessage(name, 0, message); }
+
+			status_t	GetInfo(const char* name, type_code* type,
+							int32* count = NULL) const;
+			status_t	RemoveName(const char* name);
+	// In place, as Haiku's, so the field keeps its position
+			status_t	ReplaceData(const char* name, type_code type,
+							const void* data, ssize_t size);
+			status_t	ReplaceString(const char* name, const char* string)
+							{ return ReplaceData(name, B_STRING_TYPE, string,
+								strlen(string) + 1); }
+			status_t	ReplaceInt64(const char* name, int64 value)
+							{ return ReplaceData(name, B_INT64_TYPE, &value,
+								sizeof(value)); }
+			bool		IsEmpty() const { return fFields.empty(); }
+			void		MakeEmpty() { fFields.clear(); }
+
+			ssize_t		FlattenedSize() const;
+			status_t	Flatten(char* buffer, ssize_t size) const;
+			status_t	Flatten(BDataIO* stream, ssize_t* size = NULL) const;
+			status_t	Unflatten(const char* buffer);
+			status_t	Unflatten(BDataIO* stream);
+
+			uint32		what;
+
+private:
+	struct field {
+		std::string	name;
+		type_code	type;
+		std::vector<std::string> values;
+	};
+
+			field*		_Field(const char* name);
+			const field* _Field(const char* name) const;
+
+			std::vector<field> fFields;
+};
+
+
+inline BMessage::field*
+BMessage::_Field(const char* name)
+{
+	for (field& item : fFields)
+		if (item.name == name)
+			return &item;
+	return NULL;
+}
+
+
+inline const BMessage::field*
+BMessage::_Field(const char* name) const
+{
+	return const_cast<BMessage*>(this)->_Field(name);
+}
+
+
+inline status_t
+BMessage::AddData(const char* name, type_code type, const void* data,
+	ssize_t size)
+{
+	field* item = _Field(name);
+	if (item == NULL) {
+		fFields.push_back(field());
+		item = &fFields.back();
+		item->name = name;
+		item->type = type;
+	} else if (item->type != type)
+		return B_BAD_TYPE;
+	item->values.push_back(std::string((const char*)data, size));
+	return B_OK;
+}
+
+
+inline status_t
+BMessage::ReplaceData(const char* name, type_code type, const void* data,
+	ssize_t size)
+{
+	field* item = _Field(name);
+	if (item == NULL || item->values.empty())
+		return B_NAME_NOT_FOUND;
+	if (item->type != type)
+		return B_BAD_TYPE;
+	item->values[0].assign((const char*)data, size);
+	return B_OK;
+}
+
+
+inline status_t
+BMessage::GetInfo(const char* name, type_code* type, int32* count) const
+{
+	const field* item = _Field(name);
+	if (item == NULL)
+		return B_NAME_NOT_FOUND;
+	*type = item->type;
+	if (count != NULL)
+		*count = item->values.size();
+	return B_OK;
+}
+
+
+inline status_t
+BMessage::AddMessage(const char* name, const BMessage* message)
+{
+	std::string flat(message->FlattenedSize(), '\0');
+	message->Flatten(&flat[0], flat.size());
+	return AddData(name, B_MESSAGE_TYPE, flat.data(), flat.size());
+}
+
+
+inline status_t
+BMessage::FindData(const char* name, type_code type, int32 index,
+	const void** data, ssize_t* size) const
+{
+	const field* item = _Field(name);
+	if (item == NULL)
+		return B_NAME_NOT_FOUND;
+	if (type != B_ANY_TYPE && item->type != type)
+		return B_BAD_TYPE;
+	if (index < 0 || index >= (int32)item->values.size())
+		return B_BAD_INDEX;
+	*data = item->values[index].data();
+	if (size != NULL)
+		*size = item->values[index].size();
+	return B_OK;
+}
+
+
+inline status_t
+BMessage::FindString(const char* name, int32 index, BString* string) const
+{
+	const char* found;
+	status_t status = FindString(name, index, &found);
+	if (status == B_OK)
+		string->SetTo(found);
+	return status;
+}
+
+
+inline const char*
+BMessage::GetString(const char* name, int32 index,
+	const char* defaultValue) const
+{
+	const char* string;
+	return FindString(name, index, &string) == B_OK ? string : defaultValue;
+}
+
+
+inline int32
+BMessage::GetInt32(const char* name, int32 defaultValue) const
+{
+	const void* data;
+	if (FindData(name, B_INT32_TYPE, 0, &data, NULL) != B_OK)
+		return defaultValue;
+	int32 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+inline int64
+BMessage::GetInt64(const char* name, int64 defaultValue) const
+{
+	const void* data;
+	if (FindData(name, B_INT64_TYPE, 0, &data, NULL) != B_OK)
+		return defaultValue;
+	int64 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+
+inline bool
+BMessage::GetBool(const char* name, bool defaultValue) const
+{
+	const void* data;
+	if (FindData(name, B_BOOL_TYPE, 0, &data, NULL) != B_OK)
+		return defaultValue;
+	return *(const bool*)data;
+}
+
+
+inline status_t
+BMessage::FindMessage(const char* name, int32 index, BMessage* message) const
+{
+	const void* data;
+	status_t ret = FindData(name, B_MESSAGE_TYPE, index, &data, NULL);
+	if (ret != B_OK)
+		return ret;
+	return message->Unflatten((const char*)data);
+}
+
+
+inline status_t
+BMessage::RemoveName(const char* name)
+{
+	for (size_t i = 0; i < fFields.size(); i++)
+		if (fFields[i].name == name) {
+			fFields.erase(fFields.begin() + i);
+			return B_OK;
+		}
+	return B_NAME_NOT_FOUND;
+}
+
+
+inline ssize_t
+BMessage::FlattenedSize() const
+{
+	ssize_t size = 3 * sizeof(uint32);
+	for (const field& item : fFields) {
+		size += 3 * sizeof(uint32) + item.name.size();
+		for (const std::string& value : item.values)
+			size += sizeof(uint32) + value.size();
+	}
+	return size;
+}
+
+
+inline status_t
+BMessage::Flatten(char* buffer, ssize_t size) const
+{
+	if (size < FlattenedSize())
+		return B_BAD_VALUE;
+
+	auto put = [&buffer](const void* data, size_t length) {
+		memcpy(buffer, data, length);
+		buffer += length;
+	};
+	auto putLength = [&put](size_t length) {
+		uint32 value = length;
+		put(&value, sizeof(value));
+	};
+	putLength(FlattenedSize());
+	put(&what, sizeof(what));
+	putLength(fFields.size());
+	for (const field& item : fFields) {
+		putLength(item.name.size());
+		put(item.name.data(), item.name.size());
+		put(&item.type, sizeof(item.type));
+		putLength(item.values.size());
+		for (const std::string& value : item.values) {
+			putLength(value.size());
+			put(value.data(), value.size());
+		}
+	}
+	return B_OK;
+}
+
+
+inline status_t
+BMessage::Flatten(BDataIO* stream, ssize_t* _size) const
+{
+	std::string flat(FlattenedSize(), '\0');
+	Flatten(&flat[0], flat.size());
+	ssize_t written = stream->Write(flat.data(), flat.size());
+	if (written < 0)
+		return written;
+	if (_size != NULL)
+		*_size = written;
+	return written == (ssize_t)flat.size() ? B_OK : B_IO_ERROR;
+}
+
+
+inline status_t
+BMessage::Unflatten(BDataIO* stream)
+{
+	// The flattened size comes first
+	uint32 size = 0;
+	if (stream->Read(&size, sizeof(size)) != sizeof(size)
+		|| size < 3 * sizeof(uint32))
+		return B_BAD_DATA;
+	std::string flat(size, '\0');
+	memcpy(&flat[0], &size, sizeof(size));
+	ssize_t rest = size - sizeof(size);
+	if (stream->Read(&flat[sizeof(size)], rest) != rest)
+		return B_BAD_DATA;
+	return Unflatten(flat.data());
+}
+
+
+inline status_t
+BMessage::Unflatten(const char* buffer)
+{
+	auto get = [&buffer](void* data, size_t length) {
+		memcpy(data, buffer, length);
+		buffer += length;
+	};
+	auto getLength = [&get]() {
+		uint32 value;
+		get(&value, sizeof(value));
+		return value;
+	};
+
+	uint32 size = getLength();
+	if (size < 3 * sizeof(uint32))
+		return B_BAD_DATA;
+	get(&what, sizeof(what));
+	fFields.resize(getLength());
+	for (field& item : fFields) {
+		uint32 length = getLength();
+		item.name.assign(buffer, length);
+		buffer += length;
+		get(&item.type, sizeof(item.type));
+		item.values.resize(getLength());
+		for (std::string& value : item.values) {
+			length = getLength();
+			value.assign(buffer, length);
+			buffer += length;
+		}
+	}
+	return B_OK;
+}
+
+
+#endif // _BENCH_MESSAGE_H
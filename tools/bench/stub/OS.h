@@ -0,0 +1,238 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_OS_H
+#define _BENCH_OS_H
+
+// Semaphores and threads over the standard library's and pthreads; IDs
+// index tables that are never shrunk, as the benchmarks only make a few
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <SupportDefs.h>
+
+
+#define B_INFINITE_TIMEOUT			(9223372036854775807LL)
+#define B_RELATIVE_TIMEOUT			0x8
+#define B_DO_NOT_RESCHEDULE			0x2
+
+#define B_LOWEST_ACTIVE_PRIORITY	1
+#define B_LOW_PRIORITY				5
+#define B_NORMAL_PRIORITY			10
+
+typedef status_t (*thread_func)(void*);
+
+
+struct bench_sem {
+	std::mutex				lock;
+	std::condition_variable	changed;
+	int32					count;
+};
+
+
+struct bench_thread {
+	pthread_t				thread;
+	thread_func				function;
+	void*					data;
+	int32					priority;
+	status_t				result;
+};
+
+
+static inline std::mutex&
+bench_os_lock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+
+// A deque, so that what's been handed out doesn't move
+static inline std::deque<bench_sem>&
+bench_sems()
+{
+	static std::deque<bench_sem> sems;
+	return sems;
+}
+
+
+static inline std::deque<bench_thread>&
+bench_threads()
+{
+	static std::deque<bench_thread> threads;
+	return threads;
+}
+
+
+static inline bench_sem*
+bench_sem_for(sem_id id)
+{
+	std::lock_guard<std::mutex> _(bench_os_lock());
+	return id > 0 && (size_t)id <= bench_sems().size()
+		? &bench_sems()[id - 1] : NULL;
+}
+
+
+static inline bigtime_t
+system_time()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec * 1000000LL + time.tv_nsec / 1000;
+}
+
+
+static inline status_t
+snooze(bigtime_t timeout)
+{
+	usleep(timeout);
+	return B_OK;
+}
+
+
+static inline sem_id
+create_sem(int32 count, const char* name)
+{
+	std::lock_guard<std::mutex> _(bench_os_lock());
+	bench_sems().emplace_back();
+	bench_sems().back().count = count;
+	return bench_sems().size();
+}
+
+
+static inline status_t
+delete_sem(sem_id id)
+{
+	return bench_sem_for(id) != NULL ? B_OK : B_BAD_VALUE;
+}
+
+
+static inline status_t
+release_sem_etc(sem_id id, int32 count, uint32 flags)
+{
+	bench_sem* sem = bench_sem_for(id);
+	if (sem == NULL)
+		return B_BAD_VALUE;
+
+	std::lock_guard<std::mutex> _(sem->lock);
+	sem->count += count;
+	sem->changed.notify_all();
+	return B_OK;
+}
+
+
+static inline status_t
+release_sem(sem_id id)
+{
+	return release_sem_etc(id, 1, 0);
+}
+
+
+static inline status_t
+acquire_sem_etc(sem_id id, int32 count, uint32 flags, bigtime_t timeout)
+{
+	bench_sem* sem = bench_sem_for(id);
+	if (sem == NULL)
+		return B_BAD_VALUE;
+
+	std::unique_lock<std::mutex> lock(sem->lock);
+	auto available = [&] { return sem->count >= count; };
+	if (timeout == B_INFINITE_TIMEOUT)
+		sem->changed.wait(lock, available);
+	else if (sem->changed.wait_for(lock, std::chrono::microseconds(timeout),
+			available) == false)
+		return B_TIMED_OUT;
+	sem->count -= count;
+	return B_OK;
+}
+
+
+static inline status_t
+acquire_sem(sem_id id)
+{
+	return acquire_sem_etc(id, 1, 0, B_INFINITE_TIMEOUT);
+}
+
+
+static inline void*
+bench_thread_entry(void* data)
+{
+	bench_thread* thread = (bench_thread*)data;
+	// As Haiku only gives them what's left, on Linux a nice applies to
+	// the calling thread alone
+	if (thread->priority < B_LOW_PRIORITY)
+		setpriority(PRIO_PROCESS, 0, 19);
+	thread->result = thread->function(thread->data);
+	return NULL;
+}
+
+
+static inline thread_id
+spawn_thread(thread_func function, const char* name, int32 priority,
+	void* data)
+{
+	std::lock_guard<std::mutex> _(bench_os_lock());
+	bench_threads().emplace_back();
+	bench_thread& thread = bench_threads().back();
+	thread.function = function;
+	thread.data = data;
+	thread.priority = priority;
+	thread.result = B_OK;
+	return bench_threads().size();
+}
+
+
+static inline bench_thread*
+bench_thread_for(thread_id id)
+{
+	std::lock_guard<std::mutex> _(bench_os_lock());
+	return id > 0 && (size_t)id <= bench_threads().size()
+		? &bench_threads()[id - 1] : NULL;
+}
+
+
+// Unique per thread, if not the ID spawn_thread() gave it
+static inline thread_id
+find_thread(const char* name)
+{
+	static std::atomic<thread_id> sNext(1000000);
+	static thread_local thread_id sID = sNext++;
+	return sID;
+}
+
+
+static inline status_t
+resume_thread(thread_id id)
+{
+	bench_thread* thread = bench_thread_for(id);
+	if (thread == NULL)
+		return B_BAD_VALUE;
+	return pthread_create(&thread->thread, NULL, bench_thread_entry, thread)
+		== 0 ? B_OK : B_ERROR;
+}
+
+
+static inline status_t
+wait_for_thread(thread_id id, status_t* _result)
+{
+	bench_thread* thread = bench_thread_for(id);
+	if (thread == NULL)
+		return B_BAD_VALUE;
+	pthread_join(thread->thread, NULL);
+	if (_result != NULL)
+		*_result = thread->result;
+	return B_OK;
+}
+
+
+#endif // _BENCH_OS_H
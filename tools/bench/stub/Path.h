@@ -0,0 +1,50 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_PATH_H
+#define _BENCH_PATH_H
+
+#include <string>
+
+#include <SupportDefs.h>
+
+
+// A path's string; nothing is normalized or checked
+class BPath {
+public:
+						BPath() {}
+						BPath(const char* path)
+							: fPath(path != NULL ? path : "") {}
+
+			const char*	Path() const { return fPath.c_str(); }
+			status_t	Append(const char* leaf);
+			status_t	GetParent(BPath* parent) const;
+
+private:
+			std::string	fPath;
+};
+
+
+inline status_t
+BPath::Append(const char* leaf)
+{
+	if (fPath.empty() == false && fPath[fPath.size() - 1] != '/')
+		fPath += '/';
+	fPath += leaf;
+	return B_OK;
+}
+
+
+inline status_t
+BPath::GetParent(BPath* parent) const
+{
+	size_t slash = fPath.rfind('/');
+	if (slash == std::string::npos)
+		return B_ENTRY_NOT_FOUND;
+	parent->fPath = fPath.substr(0, slash == 0 ? 1 : slash);
+	return B_OK;
+}
+
+
+#endif // _BENCH_PATH_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_RECT_H
+#define _BENCH_RECT_H
+
+#include <SupportDefs.h>
+
+
+class BPoint {
+public:
+						BPoint() : x(0), y(0) {}
+						BPoint(float x, float y) : x(x), y(y) {}
+
+			float		x;
+			float		y;
+};
+
+
+#define B_ORIGIN BPoint(0, 0)
+
+
+class BRect {
+public:
+						BRect() : left(0), top(0), right(-1), bottom(-1) {}
+						BRect(float left, float top, float right,
+							float bottom)
+							: left(left), top(top), right(right),
+							  bottom(bottom) {}
+
+			float		Width() const { return right - left; }
+			float		Height() const { return bottom - top; }
+			int32		IntegerWidth() const
+							{ return (int32)(right - left); }
+			int32		IntegerHeight() const
+							{ return (int32)(bottom - top); }
+
+			float		left;
+			float		top;
+			float		right;
+			float		bottom;
+};
+
+
+#endif // _BENCH_RECT_H
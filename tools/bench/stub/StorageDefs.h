@@ -0,0 +1,25 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_STORAGE_DEFS_H
+#define _BENCH_STORAGE_DEFS_H
+
+#include <fcntl.h>
+
+#include <SupportDefs.h>
+
+
+#define B_FILE_NAME_LENGTH	256
+#define B_PATH_NAME_LENGTH	1024
+
+#define B_READ_ONLY			O_RDONLY
+#define B_WRITE_ONLY		O_WRONLY
+#define B_READ_WRITE		O_RDWR
+#define B_CREATE_FILE		O_CREAT
+#define B_ERASE_FILE		O_TRUNC
+#define B_OPEN_AT_END		O_APPEND
+#define B_FAIL_IF_EXISTS	O_EXCL
+
+
+#endif // _BENCH_STORAGE_DEFS_H
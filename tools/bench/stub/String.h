@@ -0,0 +1,332 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_STRING_H
+#define _BENCH_STRING_H
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include <string>
+
+#include <SupportDefs.h>
+
+
+// BString over std::string; offsets and lengths are in bytes, but for
+// the "Chars" ones, which walk the UTF-8 as Haiku's do
+class BString {
+public:
+						BString() {}
+						BString(const char* string)
+							: fString(string != NULL ? string : "") {}
+						BString(const char* string, int32 length)
+							{ SetTo(string, length); }
+
+			const char*	String() const { return fString.c_str(); }
+			int32		Length() const { return fString.size(); }
+			bool		IsEmpty() const { return fString.empty(); }
+			int32		CountChars() const;
+			char		ByteAt(int32 index) const;
+			const char*	CharAt(int32 charIndex, int32* bytes = NULL) const;
+			char		operator[](int32 index) const
+							{ return fString[index]; }
+
+			BString&	SetTo(const char* string);
+			BString&	SetTo(const char* string, int32 length);
+			BString&	SetToFormat(const char* format, ...);
+			BString&	Append(const BString& string)
+							{ fString += string.fString; return *this; }
+			BString&	Append(const char* string)
+							{ fString += string; return *this; }
+			BString&	Append(const char* string, int32 length);
+			BString&	Truncate(int32 length);
+			BString&	Remove(int32 from, int32 length)
+							{ fString.erase(from, length); return *this; }
+			BString&	CopyInto(BString& into, int32 from,
+							int32 length) const;
+			BString&	CopyCharsInto(BString& into, int32 fromChar,
+							int32 charCount) const;
+			BString&	RemoveAll(const char* string);
+			BString&	ToLower();
+
+			int32		FindFirst(const char* string, int32 from = 0) const;
+			int32		FindFirst(char c, int32 from = 0) const;
+			int32		FindLast(const char* string) const;
+			int32		FindLast(const char* string,
+							int32 beforeOffset) const;
+			int32		FindLast(char c) const;
+			int32		IFindFirst(const char* string,
+							int32 from = 0) const;
+			bool		StartsWith(const char* string) const;
+			bool		EndsWith(const char* string) const;
+			int			Compare(const char* string) const
+							{ return strcmp(String(), string); }
+			int			ICompare(const char* string) const
+							{ return strcasecmp(String(), string); }
+
+			char*		LockBuffer(int32 length);
+			BString&	UnlockBuffer(int32 length = -1);
+
+			BString&	operator=(const char* string)
+							{ return SetTo(string); }
+			BString&	operator+=(const char* string)
+							{ return Append(string); }
+			BString&	operator+=(char c)
+							{ fString += c; return *this; }
+			BString&	operator<<(const char* string)
+							{ return Append(string != NULL ? string : ""); }
+			BString&	operator<<(const BString& string)
+							{ return Append(string); }
+			BString&	operator<<(char c)
+							{ fString += c; return *this; }
+			BString&	operator<<(int32 value)
+							{ fString += std::to_string(value); return *this; }
+			BString&	operator<<(uint32 value)
+							{ fString += std::to_string(value); return *this; }
+			BString&	operator<<(int64 value)
+							{ fString += std::to_string(value); return *this; }
+			BString&	operator<<(uint64 value)
+							{ fString += std::to_string(value); return *this; }
+
+			bool		operator==(const BString& other) const
+							{ return fString == other.fString; }
+			bool		operator==(const char* other) const
+							{ return Compare(other) == 0; }
+			bool		operator!=(const BString& other) const
+							{ return fString != other.fString; }
+			bool		operator!=(const char* other) const
+							{ return Compare(other) != 0; }
+			bool		operator<(const BString& other) const
+							{ return fString < other.fString; }
+			bool		operator<(const char* other) const
+							{ return Compare(other) < 0; }
+
+private:
+			int32		_Offset(int32 charIndex) const;
+
+			std::string	fString;
+};
+
+
+inline bool
+operator<(const char* string, const BString& other)
+{
+	return other.Compare(string) > 0;
+}
+
+
+inline int32
+BString::CountChars() const
+{
+	int32 count = 0;
+	for (unsigned char c : fString)
+		if ((c & 0xc0) != 0x80)
+			count++;
+	return count;
+}
+
+
+inline char
+BString::ByteAt(int32 index) const
+{
+	return index < 0 || index >= Length() ? 0 : fString[index];
+}
+
+
+inline const char*
+BString::CharAt(int32 charIndex, int32* bytes) const
+{
+	int32 offset = _Offset(charIndex);
+	if (bytes != NULL)
+		*bytes = _Offset(charIndex + 1) - offset;
+	return String() + offset;
+}
+
+
+inline BString&
+BString::SetTo(const char* string)
+{
+	fString = string != NULL ? string : "";
+	return *this;
+}
+
+
+inline BString&
+BString::SetTo(const char* string, int32 length)
+{
+	fString.clear();
+	return Append(string, length);
+}
+
+
+inline BString&
+BString::SetToFormat(const char* format, ...)
+{
+	char buffer[4096];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	return SetTo(buffer);
+}
+
+
+// Up to length, or the first NUL
+inline BString&
+BString::Append(const char* string, int32 length)
+{
+	if (string != NULL && length > 0)
+		fString.append(string, strnlen(string, length));
+	return *this;
+}
+
+
+inline BString&
+BString::Truncate(int32 length)
+{
+	if (length < Length())
+		fString.resize(length);
+	return *this;
+}
+
+
+inline BString&
+BString::CopyInto(BString& into, int32 from, int32 length) const
+{
+	into.fString = fString.substr(from, length);
+	return into;
+}
+
+
+inline BString&
+BString::CopyCharsInto(BString& into, int32 fromChar, int32 charCount) const
+{
+	int32 from = _Offset(fromChar);
+	return CopyInto(into, from, _Offset(fromChar + charCount) - from);
+}
+
+
+inline BString&
+BString::RemoveAll(const char* string)
+{
+	size_t length = strlen(string);
+	if (length == 0)
+		return *this;
+	for (size_t found = 0;
+		(found = fString.find(string, found)) != std::string::npos;)
+		fString.erase(found, length);
+	return *this;
+}
+
+
+inline BString&
+BString::ToLower()
+{
+	for (char& c : fString)
+		c = tolower(c);
+	return *this;
+}
+
+
+inline int32
+BString::FindFirst(const char* string, int32 from) const
+{
+	size_t found = fString.find(string, from);
+	return found == std::string::npos ? -1 : found;
+}
+
+
+inline int32
+BString::FindFirst(char c, int32 from) const
+{
+	size_t found = fString.find(c, from);
+	return found == std::string::npos ? -1 : found;
+}
+
+
+inline int32
+BString::FindLast(const char* string) const
+{
+	size_t found = fString.rfind(string);
+	return found == std::string::npos ? -1 : found;
+}
+
+
+inline int32
+BString::FindLast(const char* string, int32 beforeOffset) const
+{
+	if (beforeOffset < 0)
+		return -1;
+	size_t found = fString.rfind(string, beforeOffset);
+	return found == std::string::npos ? -1 : found;
+}
+
+
+inline int32
+BString::FindLast(char c) const
+{
+	size_t found = fString.rfind(c);
+	return found == std::string::npos ? -1 : found;
+}
+
+
+inline int32
+BString::IFindFirst(const char* string, int32 from) const
+{
+	if (from > Length())
+		return -1;
+	const char* found = strcasestr(String() + from, string);
+	return found != NULL ? found - String() : -1;
+}
+
+
+inline bool
+BString::StartsWith(const char* string) const
+{
+	return fString.compare(0, strlen(string), string) == 0;
+}
+
+
+inline bool
+BString::EndsWith(const char* string) const
+{
+	size_t length = strlen(string);
+	return fString.size() >= length
+		&& fString.compare(fString.size() - length, length, string) == 0;
+}
+
+
+inline char*
+BString::LockBuffer(int32 length)
+{
+	if (length > Length())
+		fString.resize(length);
+	return &fString[0];
+}
+
+
+inline BString&
+BString::UnlockBuffer(int32 length)
+{
+	fString.resize(length < 0 ? strlen(fString.c_str()) : length);
+	return *this;
+}
+
+
+inline int32
+BString::_Offset(int32 charIndex) const
+{
+	int32 offset = 0;
+	for (; charIndex > 0 && offset < Length(); charIndex--) {
+		offset++;
+		while (offset < Length() && (fString[offset] & 0xc0) == 0x80)
+			offset++;
+	}
+	return offset;
+}
+
+
+#endif // _BENCH_STRING_H
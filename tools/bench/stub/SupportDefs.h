@@ -0,0 +1,65 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_SUPPORT_DEFS_H
+#define _BENCH_SUPPORT_DEFS_H
+
+// Just enough of Haiku's SupportDefs.h for the benchmarks to build off it
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+
+typedef int8_t		int8;
+typedef uint8_t		uint8;
+typedef int16_t		int16;
+typedef uint16_t	uint16;
+typedef int32_t		int32;
+typedef uint32_t	uint32;
+typedef int64_t		int64;
+typedef uint64_t	uint64;
+
+typedef int64		bigtime_t;
+typedef int32		status_t;
+typedef uint32		type_code;
+typedef int32		thread_id;
+typedef int32		sem_id;
+
+#define B_PRId32	PRId32
+#define B_PRIu32	PRIu32
+#define B_PRId64	PRId64
+#define B_PRIu64	PRIu64
+
+// Haiku's are negative errno values, and errnos are the same; here
+// they're only told apart
+#define B_OK				0
+#define B_ERROR				(-1)
+#define B_NO_MEMORY			(-2)
+#define B_BAD_VALUE			(-3)
+#define B_ENTRY_NOT_FOUND	(-4)
+#define B_NO_INIT			(-5)
+#define B_BAD_DATA			(-6)
+#define B_FILE_ERROR		(-7)
+#define B_IO_ERROR			(-8)
+#define B_BAD_INDEX			(-9)
+#define B_NAME_NOT_FOUND	(-10)
+#define B_BAD_TYPE			(-11)
+#define B_TIMED_OUT			(-12)
+#define B_INTERRUPTED		(-13)
+#define B_FILE_EXISTS		(-14)
+
+#define B_ANY_TYPE			'ANYT'
+#define B_BOOL_TYPE			'BOOL'
+#define B_INT32_TYPE		'LONG'
+#define B_INT64_TYPE		'LLNG'
+#define B_MESSAGE_TYPE		'MSGG'
+#define B_RAW_TYPE			'RAWT'
+#define B_STRING_TYPE		'CSTR'
+#define B_UINT32_TYPE		'ULNG'
+
+
+#endif // _BENCH_SUPPORT_DEFS_H
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_TEXT_VIEW_H
+#define _BENCH_TEXT_VIEW_H
+
+#include <stdlib.h>
+
+#include <new>
+
+#include <Font.h>
+#include <GraphicsDefs.h>
+
+
+struct text_run {
+	int32		offset;
+	BFont		font;
+	rgb_color	color;
+};
+
+
+struct text_run_array {
+	int32		count;
+	text_run	runs[1];
+};
+
+
+// Only its run arrays
+class BTextView {
+public:
+	static	text_run_array* AllocRunArray(int32 count, int32* _size = NULL);
+	static	void		FreeRunArray(text_run_array* array) { free(array); }
+};
+
+
+inline text_run_array*
+BTextView::AllocRunArray(int32 count, int32* _size)
+{
+	size_t size = sizeof(text_run_array)
+		+ sizeof(text_run) * (count > 0 ? count - 1 : 0);
+	text_run_array* array = (text_run_array*)calloc(1, size);
+	if (array == NULL)
+		return NULL;
+
+	array->count = count;
+	for (int32 i = 0; i < count; i++)
+		new (&array->runs[i]) text_run();
+	if (_size != NULL)
+		*_size = size;
+	return array;
+}
+
+
+#endif // _BENCH_TEXT_VIEW_H
@@ -0,0 +1,18 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_TRANSLATION_UTILS_H
+#define _BENCH_TRANSLATION_UTILS_H
+
+#include <Bitmap.h>
+
+
+// There are no translators; every picture fails to load
+class BTranslationUtils {
+public:
+	static	BBitmap*	GetBitmap(const char* path) { return NULL; }
+};
+
+
+#endif // _BENCH_TRANSLATION_UTILS_H
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BENCH_UNICODE_CHAR_H
+#define _BENCH_UNICODE_CHAR_H
+
+#include <ctype.h>
+#include <wctype.h>
+
+#include <SupportDefs.h>
+
+
+// Beyond ASCII, as the C library's locale has it
+class BUnicodeChar {
+public:
+	static	bool		IsAlNum(uint32 c)
+							{ return c < 0x80 ? isalnum(c) : iswalnum(c); }
+	static	uint32		ToLower(uint32 c)
+							{ return c < 0x80 ? tolower(c) : towlower(c); }
+
+	static	uint32		FromUTF8(const char** in);
+	static	void		ToUTF8(uint32 c, char** out);
+};
+
+
+inline uint32
+BUnicodeChar::FromUTF8(const char** in)
+{
+	const uint8* c = (const uint8*)*in;
+	uint32 code;
+	int32 length;
+	if (c[0] < 0x80) {
+		code = c[0];
+		length = 1;
+	} else if ((c[0] & 0xe0) == 0xc0 && c[1] != 0) {
+		code = (c[0] & 0x1f) << 6 | (c[1] & 0x3f);
+		length = 2;
+	} else if ((c[0] & 0xf0) == 0xe0 && c[1] != 0 && c[2] != 0) {
+		code = (c[0] & 0x0f) << 12 | (c[1] & 0x3f) << 6 | (c[2] & 0x3f);
+		length = 3;
+	} else if ((c[0] & 0xf8) == 0xf0 && c[1] != 0 && c[2] != 0
+		&& c[3] != 0) {
+		code = (c[0] & 0x07) << 18 | (c[1] & 0x3f) << 12
+			| (c[2] & 0x3f) << 6 | (c[3] & 0x3f);
+		length = 4;
+	} else {
+		code = 0xfffd;
+		length = 1;
+	}
+	*in += length;
+	return code;
+}
+
+
+inline void
+BUnicodeChar::ToUTF8(uint32 c, char** out)
+{
+	uint8* p = (uint8*)*out;
+	if (c < 0x80)
+		*p++ = c;
+	else if (c < 0x800) {
+		*p++ = 0xc0 | c >> 6;
+		*p++ = 0x80 | (c & 0x3f);
+	} else if (c < 0x10000) {
+		*p++ = 0xe0 | c >> 12;
+		*p++ = 0x80 | (c >> 6 & 0x3f);
+		*p++ = 0x80 | (c & 0x3f);
+	} else {
+		*p++ = 0xf0 | c >> 18;
+		*p++ = 0x80 | (c >> 12 & 0x3f);
+		*p++ = 0x80 | (c >> 6 & 0x3f);
+		*p++ = 0x80 | (c & 0x3f);
+	}
+	*out = (char*)p;
+}
+
+
+#endif // _BENCH_UNICODE_CHAR_H
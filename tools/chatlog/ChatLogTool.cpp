@@ -0,0 +1,450 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Command-line export and import of Chat-O-Matic's chat logs, for
+// archiving them and for migrating from other clients, and management of
+// their retention. It should be run while Chat-O-Matic isn't, as only one
+// writer's allowed per log.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <DataIO.h>
+#include <Entry.h>
+#include <File.h>
+#include <Message.h>
+#include <Node.h>
+
+#include <libchatlog/ChatLog.h>
+#include <libchatlog/LogCompactor.h>
+#include <libchatlog/LogExporter.h>
+#include <libchatlog/LogImporter.h>
+#include <libchatlog/LogIndex.h>
+
+#include "ChatProtocolMessages.h"
+
+
+const char* kUsage =
+	"Usage:\n"
+	"  chatlog export [-f text|jsonl|html] [-o file] <log directory>...\n"
+	"  chatlog import [-f auto|text|irssi|weechat|znc] [-n own nick]\n"
+	"                 [-c chat ID] <log directory> <file>...\n"
+	"  chatlog import-cache [-n own ID] <log directory> <room cache file>\n"
+	"  chatlog retention [-a days] [-s MiB] [-n messages] [-c] <directory>\n"
+	"  chatlog compact [-z] [-r KiB/s] <directory>\n"
+	"\n"
+	"Log directories are in\n"
+	"~/config/settings/Chat-O-Matic/Cache/Accounts/<account>/Logs/, room\n"
+	"cache files in .../<account>/Rooms/. Files are imported in the order\n"
+	"given, which should be oldest first.\n"
+	"Retention is set for a log directory, or for all of an account's if\n"
+	"given their Logs/ directory; 0 is no limit, -c goes back to the\n"
+	"account's or the preferences'. Compaction applies it to the logs under\n"
+	"the directory, and with -z compresses them.\n";
+
+
+class StandardOutput : public BDataIO {
+public:
+	virtual ssize_t Write(const void* buffer, size_t size)
+	{
+		return fwrite(buffer, 1, size, stdout);
+	}
+};
+
+
+static int
+usage()
+{
+	fputs(kUsage, stderr);
+	return 1;
+}
+
+
+static const char*
+leaf(const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	return slash != NULL && slash[1] != '\0' ? slash + 1 : path;
+}
+
+
+static int
+export_logs(int argc, char** argv)
+{
+	export_format format = LOG_EXPORT_TEXT;
+	const char* output = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "f:o:")) != -1) {
+		switch (option) {
+			case 'f':
+				if (strcmp(optarg, "jsonl") == 0)
+					format = LOG_EXPORT_JSONL;
+				else if (strcmp(optarg, "html") == 0)
+					format = LOG_EXPORT_HTML;
+				else if (strcmp(optarg, "text") != 0)
+					return usage();
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			default:
+				return usage();
+		}
+	}
+	if (optind >= argc)
+		return usage();
+
+	StandardOutput standardOutput;
+	BFile file;
+	BDataIO* io = &standardOutput;
+	if (output != NULL) {
+		status_t ret = file.SetTo(output,
+			B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+		if (ret != B_OK) {
+			fprintf(stderr, "%s: %s\n", output, strerror(ret));
+			return 1;
+		}
+		io = &file;
+	}
+
+	LogExporter exporter(io, format);
+	exporter.SetTitle(leaf(argv[optind]));
+	for (int i = optind; i < argc; i++) {
+		ChatLog log(argv[i]);
+		status_t ret = exporter.Export(log);
+		if (ret != B_OK) {
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(ret));
+			return 1;
+		}
+	}
+	status_t ret = exporter.Finish();
+	if (ret != B_OK) {
+		fprintf(stderr, "%s\n", strerror(ret));
+		return 1;
+	}
+	fprintf(stderr, "%" B_PRIu64 " messages exported\n",
+		exporter.CountExported());
+	return 0;
+}
+
+
+// What's been imported before failed, if anything did, is kept and
+// indexed; it's still an error.
+static int
+finish_import(ChatLog& log, LogImporter& importer, bigtime_t start,
+	status_t failed)
+{
+	status_t ret = importer.Flush();
+	bigtime_t took = system_time() - start;
+	fprintf(stderr, "%" B_PRIu64 " messages imported, %" B_PRIu64
+		" other lines skipped, in %.2f s\n", importer.CountImported(),
+		importer.CountSkipped(), took / 1000000.0);
+	if (ret != B_OK) {
+		fprintf(stderr, "%s: %s\n", log.Path(), strerror(ret));
+		return 1;
+	}
+
+	// Otherwise it's only caught up on once Chat-O-Matic next starts
+	LogIndex index(log.Path());
+	ret = index.CatchUp(&log);
+	if (ret == B_OK)
+		ret = index.Flush();
+	if (ret == B_OK)
+		ret = index.Merge();
+	if (ret != B_OK)
+		fprintf(stderr, "%s: couldn't be indexed: %s\n", log.Path(),
+			strerror(ret));
+	return failed == B_OK && ret == B_OK ? 0 : 1;
+}
+
+
+static int
+import_logs(int argc, char** argv)
+{
+	import_format format = LOG_IMPORT_AUTO;
+	const char* ownNick = NULL;
+	const char* chatId = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "f:n:c:")) != -1) {
+		switch (option) {
+			case 'f':
+				if (strcmp(optarg, "text") == 0)
+					format = LOG_IMPORT_TEXT;
+				else if (strcmp(optarg, "irssi") == 0)
+					format = LOG_IMPORT_IRSSI;
+				else if (strcmp(optarg, "weechat") == 0)
+					format = LOG_IMPORT_WEECHAT;
+				else if (strcmp(optarg, "znc") == 0)
+					format = LOG_IMPORT_ZNC;
+				else if (strcmp(optarg, "auto") != 0)
+					return usage();
+				break;
+			case 'n':
+				ownNick = optarg;
+				break;
+			case 'c':
+				chatId = optarg;
+				break;
+			default:
+				return usage();
+		}
+	}
+	if (argc - optind < 2)
+		return usage();
+
+	ChatLog log(argv[optind]);
+	if (log.InitCheck() != B_OK) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(log.InitCheck()));
+		return 1;
+	}
+
+	BMessage base(IM_MESSAGE);
+	base.AddInt32("im_what", IM_MESSAGE_RECEIVED);
+	base.AddString("chat_id", chatId != NULL ? chatId : leaf(argv[optind]));
+
+	LogImporter importer(&log, base);
+	importer.SetOwnNick(ownNick);
+	bigtime_t start = system_time();
+	status_t ret = B_OK;
+	for (int i = optind + 1; i < argc && ret == B_OK; i++) {
+		uint64 before = importer.CountImported();
+		ret = importer.ImportFile(argv[i], format);
+		if (ret != B_OK) {
+			// Later files can't be appended before the rest of this one
+			fprintf(stderr, "%s: %s\nStopped after %" B_PRIu64 " of its "
+				"messages; %d file(s) before it imported, %d after it not\n",
+				argv[i], strerror(ret), importer.CountImported() - before,
+				i - optind - 1, argc - i - 1);
+		}
+	}
+	return finish_import(log, importer, start, ret);
+}
+
+
+// Rooms' cache files have the plain-text log as their content, and the
+// last few messages as they were received in their "Chat:logs" attribute.
+// The text has all of them, the attribute's only used if it's missing.
+static int
+import_cache(int argc, char** argv)
+{
+	const char* ownId = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "n:")) != -1) {
+		if (option != 'n')
+			return usage();
+		ownId = optarg;
+	}
+	if (argc - optind != 2)
+		return usage();
+
+	const char* cachePath = argv[optind + 1];
+	ChatLog log(argv[optind]);
+	if (log.InitCheck() != B_OK) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(log.InitCheck()));
+		return 1;
+	}
+
+	BMessage base(IM_MESSAGE);
+	base.AddInt32("im_what", IM_MESSAGE_RECEIVED);
+	base.AddString("chat_id", leaf(argv[optind]));
+	LogImporter importer(&log, base);
+	importer.SetOwnNick(ownId);
+	bigtime_t start = system_time();
+
+	BFile cache(cachePath, B_READ_ONLY);
+	off_t size = 0;
+	if (cache.InitCheck() == B_OK && cache.GetSize(&size) == B_OK
+		&& size > 0) {
+		status_t ret = importer.ImportFile(cachePath, LOG_IMPORT_TEXT);
+		if (ret != B_OK)
+			fprintf(stderr, "%s: %s\nStopped after %" B_PRIu64 " of its "
+				"messages\n", cachePath, strerror(ret),
+				importer.CountImported());
+		return finish_import(log, importer, start, ret);
+	}
+
+	BNode node(cachePath);
+	attr_info info;
+	status_t ret = node.GetAttrInfo("Chat:logs", &info);
+	char* buffer = NULL;
+	if (ret == B_OK && (buffer = (char*)malloc(info.size)) == NULL)
+		ret = B_NO_MEMORY;
+	if (ret == B_OK) {
+		ssize_t read = node.ReadAttr("Chat:logs", info.type, 0, buffer,
+			info.size);
+		ret = read == info.size ? B_OK : B_IO_ERROR;
+	}
+
+	BMessage logs;
+	if (ret == B_OK)
+		ret = logs.Unflatten(buffer);
+	free(buffer);
+	if (ret != B_OK) {
+		fprintf(stderr, "%s: %s\n", cachePath, strerror(ret));
+		return 1;
+	}
+
+	BMessage message;
+	int32 count = 0;
+	type_code type;
+	logs.GetInfo("message", &type, &count);
+	for (int32 i = 0; i < count && ret == B_OK; i++) {
+		ret = logs.FindMessage("message", i, &message);
+		if (ret != B_OK)
+			break;
+		uint32 flags = 0;
+		if (message.GetInt32("im_what", 0) == IM_MESSAGE_SENT)
+			flags |= LOG_OWN_MESSAGE;
+		if (BString(message.GetString("body", "")).StartsWith("/me ") == true)
+			flags |= LOG_ACTION;
+		ret = importer.Add(&message, message.GetInt64("when", 0),
+			message.GetString("user_id", NULL), flags);
+		if (ret != B_OK)
+			fprintf(stderr, "%s: %s\nStopped at message %" B_PRId32 " of %"
+				B_PRId32 "\n", cachePath, strerror(ret), i + 1, count);
+	}
+	return finish_import(log, importer, start, ret);
+}
+
+
+static int
+set_retention(int argc, char** argv)
+{
+	BMessage settings;
+	bool clear = false;
+	int option;
+	while ((option = getopt(argc, argv, "a:s:n:c")) != -1) {
+		switch (option) {
+			case 'a':
+				settings.AddInt64("max_age", strtoll(optarg, NULL, 10)
+					* 24 * 60 * 60);
+				break;
+			case 's':
+				settings.AddInt64("max_size", strtoll(optarg, NULL, 10)
+					* 1024 * 1024);
+				break;
+			case 'n':
+				settings.AddInt64("keep_last", strtoll(optarg, NULL, 10));
+				break;
+			case 'c':
+				clear = true;
+				break;
+			default:
+				return usage();
+		}
+	}
+	if (argc - optind != 1)
+		return usage();
+
+	BString path(argv[optind]);
+	path << "/retention";
+	if (clear == true) {
+		status_t ret = BEntry(path.String()).Remove();
+		if (ret != B_OK && ret != B_ENTRY_NOT_FOUND) {
+			fprintf(stderr, "%s: %s\n", path.String(), strerror(ret));
+			return 1;
+		}
+		return 0;
+	}
+
+	// What's not given is kept as it was
+	log_retention retention = { -1, -1, (uint64)-1 };
+	LogCompactor::ReadRetention(argv[optind], &retention);
+	if (settings.HasInt64("max_age") == false && retention.maxAge >= 0)
+		settings.AddInt64("max_age", retention.maxAge);
+	if (settings.HasInt64("max_size") == false && retention.maxSize >= 0)
+		settings.AddInt64("max_size", retention.maxSize);
+	if (settings.HasInt64("keep_last") == false
+		&& retention.keepLast != (uint64)-1)
+		settings.AddInt64("keep_last", retention.keepLast);
+
+	BFile file(path.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	status_t ret = file.InitCheck();
+	if (ret == B_OK)
+		ret = settings.Flatten(&file);
+	if (ret != B_OK) {
+		fprintf(stderr, "%s: %s\n", path.String(), strerror(ret));
+		return 1;
+	}
+	return 0;
+}
+
+
+static int
+compact_logs(int argc, char** argv)
+{
+	bool compress = false;
+	size_t rate = 0;
+	int option;
+	while ((option = getopt(argc, argv, "zr:")) != -1) {
+		switch (option) {
+			case 'z':
+				compress = true;
+				break;
+			case 'r':
+				rate = strtoul(optarg, NULL, 10) * 1024;
+				break;
+			default:
+				return usage();
+		}
+	}
+	if (argc - optind != 1)
+		return usage();
+
+	// Only the retention files apply here, the preferences aren't read
+	log_retention none = { 0, 0, 0 };
+	LogCompactor compactor(argv[optind], none, B_INFINITE_TIMEOUT);
+	if (compactor.InitCheck() != B_OK) {
+		fprintf(stderr, "%s\n", strerror(compactor.InitCheck()));
+		return 1;
+	}
+	compactor.SetRateLimit(rate);
+	compactor.SetCompression(compress);
+	compactor.Compact();
+
+	log_compactor_progress progress;
+	do {
+		snooze(500000);
+		progress = compactor.Progress();
+		fprintf(stderr, "\r%" B_PRIu32 "/%" B_PRIu32 " logs, %" B_PRIu64
+			" messages pruned, %" B_PRIu64 " KiB freed, %" B_PRIu64
+			" KiB compressed to %" B_PRIu64, progress.logsDone,
+			progress.logsTotal, progress.entriesPruned,
+			progress.bytesFreed / 1024, progress.bytesRead / 1024,
+			progress.bytesWritten / 1024);
+	} while (progress.passes == 0);
+	fputc('\n', stderr);
+
+	if (progress.errors > 0) {
+		fprintf(stderr, "%" B_PRIu32 " logs couldn't be compacted\n",
+			progress.errors);
+		return 1;
+	}
+	return 0;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	if (argc < 2)
+		return usage();
+
+	// The command's options come after it
+	const char* command = argv[1];
+	if (strcmp(command, "export") == 0)
+		return export_logs(argc - 1, argv + 1);
+	if (strcmp(command, "import") == 0)
+		return import_logs(argc - 1, argv + 1);
+	if (strcmp(command, "import-cache") == 0)
+		return import_cache(argc - 1, argv + 1);
+	if (strcmp(command, "retention") == 0)
+		return set_retention(argc - 1, argv + 1);
+	if (strcmp(command, "compact") == 0)
+		return compact_logs(argc - 1, argv + 1);
+	return usage();
+}
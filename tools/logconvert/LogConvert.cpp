@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021, Jaidyn Levesque <jadedctrl@teknik.io>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Converts IRC clients' and bouncers' logs to plain text, JSON lines or
+// HTML, with the parser and formatter the chatlog tool imports and
+// exports with. It's plain C++ and POSIX, so that it builds (and the
+// parser can be measured) on any system.
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+#include <libchatlog/LogFormatter.h>
+#include <libchatlog/LogParser.h>
+
+
+const char* kUsage =
+	"Usage:\n"
+	"  logconvert [-f auto|text|irssi|weechat|znc] [-t text|jsonl|html]\n"
+	"             [-n own nick] [-o file] <file>...\n"
+	"\n"
+	"Files are converted in the order given, and written out one after\n"
+	"the other; statistics go to the standard error.\n";
+
+
+class LogConverter : public LogParser, public LogFormatter {
+public:
+	LogConverter(FILE* output, export_format format)
+		:
+		LogFormatter(format),
+		fOutput(output)
+	{
+	}
+
+	void SetOwnNick(const char* nick) { fOwnNick = nick != NULL ? nick : ""; }
+
+	virtual int MessageParsed(const parsed_message& message)
+	{
+		fNick.assign(message.nick, message.nickLength);
+		fBody.assign(message.body, message.bodyLength);
+		return Add(message.when, fNick.c_str(), NULL, fBody.c_str(),
+			fNick == fOwnNick, message.action);
+	}
+
+protected:
+	virtual int Write(const char* data, size_t length)
+	{
+		if (fwrite(data, 1, length, fOutput) != length)
+			return errno != 0 ? errno : EIO;
+		return 0;
+	}
+
+private:
+	FILE*		fOutput;
+	std::string	fOwnNick;
+	std::string	fNick;
+	std::string	fBody;
+};
+
+
+static int
+usage()
+{
+	fputs(kUsage, stderr);
+	return 1;
+}
+
+
+static double
+now()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	import_format format = LOG_IMPORT_AUTO;
+	export_format output = LOG_EXPORT_TEXT;
+	const char* ownNick = NULL;
+	const char* path = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "f:t:n:o:")) != -1) {
+		switch (option) {
+			case 'f':
+				if (strcmp(optarg, "text") == 0)
+					format = LOG_IMPORT_TEXT;
+				else if (strcmp(optarg, "irssi") == 0)
+					format = LOG_IMPORT_IRSSI;
+				else if (strcmp(optarg, "weechat") == 0)
+					format = LOG_IMPORT_WEECHAT;
+				else if (strcmp(optarg, "znc") == 0)
+					format = LOG_IMPORT_ZNC;
+				else if (strcmp(optarg, "auto") != 0)
+					return usage();
+				break;
+			case 't':
+				if (strcmp(optarg, "jsonl") == 0)
+					output = LOG_EXPORT_JSONL;
+				else if (strcmp(optarg, "html") == 0)
+					output = LOG_EXPORT_HTML;
+				else if (strcmp(optarg, "text") != 0)
+					return usage();
+				break;
+			case 'n':
+				ownNick = optarg;
+				break;
+			case 'o':
+				path = optarg;
+				break;
+			default:
+				return usage();
+		}
+	}
+	if (optind >= argc)
+		return usage();
+
+	FILE* file = stdout;
+	if (path != NULL && (file = fopen(path, "w")) == NULL) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	LogConverter converter(file, output);
+	converter.SetOwnNick(ownNick);
+	const char* slash = strrchr(argv[optind], '/');
+	converter.SetTitle(slash != NULL ? slash + 1 : argv[optind]);
+
+	double start = now();
+	int ret = 0;
+	for (int i = optind; i < argc && ret == 0; i++) {
+		ret = converter.ParseFile(argv[i], format);
+		if (ret != 0)
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(ret));
+	}
+	if (ret == 0 && (ret = converter.Finish()) != 0)
+		fprintf(stderr, "%s\n", strerror(ret));
+	if (file != stdout && fclose(file) != 0 && ret == 0) {
+		ret = errno;
+		fprintf(stderr, "%s: %s\n", path, strerror(ret));
+	}
+
+	double took = now() - start;
+	uint64_t lines = converter.CountParsed() + converter.CountSkipped();
+	fprintf(stderr, "%llu messages converted, %llu other lines skipped, "
+		"in %.2f s (%.0f lines/s)\n",
+		(unsigned long long)converter.CountParsed(),
+		(unsigned long long)converter.CountSkipped(), took,
+		took > 0 ? lines / took : 0.0);
+	return ret == 0 ? 0 : 1;
+}